@@ -0,0 +1,157 @@
+/*
+ * Compare les arborescences plate (logs/<ID>/) et répartie (logs/<AA>/<BB>/<ID>/)
+ * sur N tâches : création du répertoire et du premier enregistrement
+ * d'historique, ouverture de l'historique de chaque tâche, puis suppression.
+ * Les répertoires sont maintenus ouverts comme dans le démon (storage_dirs_t),
+ * sauf avec -u : chaque appel rouvre logs/ et le répertoire de la tâche.
+ *
+ * Usage : logs_layout [-n N] [-d DIR] [-u]   (défauts : 100000, /tmp/erraid-bench)
+ */
+#include "storage.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+typedef enum {
+    PHASE_CREATE = 0,
+    PHASE_LOAD,
+    PHASE_REMOVE,
+    PHASE_COUNT,
+} phase_t;
+
+static const char *const phase_names[PHASE_COUNT] = {"création", "chargement", "suppression"};
+
+static int run_phase(const storage_paths_t *paths, phase_t phase, uint64_t count, int64_t *elapsed_ns) {
+    int64_t start = 0;
+    int64_t end = 0;
+    utils_now_monotonic_ns(&start);
+    for (uint64_t id = 1; id <= count; ++id) {
+        int rc = 0;
+        if (phase == PHASE_CREATE) {
+            task_run_entry_t entry;
+            memset(&entry, 0, sizeof(entry));
+            entry.epoch = (int64_t)id;
+            rc = storage_append_history_entry(paths, id, &entry);
+        } else if (phase == PHASE_LOAD) {
+            history_view_t view;
+            rc = storage_open_history(paths, id, &view);
+            if (rc == 0) {
+                rc = view.count == 1 ? 0 : -1;
+                history_close(&view);
+            }
+        } else {
+            rc = storage_remove_task_logs(paths, id);
+        }
+        if (rc != 0) {
+            fprintf(stderr, "logs_layout: %s de la tâche %llu échouée (%s)\n", phase_names[phase],
+                    (unsigned long long)id, strerror(errno));
+            return -1;
+        }
+    }
+    utils_now_monotonic_ns(&end);
+    *elapsed_ns = end - start;
+    return 0;
+}
+
+static int run_layout(const char *base_dir,
+                      storage_layout_t layout,
+                      uint64_t count,
+                      bool cached,
+                      int64_t elapsed_ns[PHASE_COUNT]) {
+    char root_dir[PATH_MAX];
+    char logs_dir[PATH_MAX];
+    if (utils_join_path(base_dir, layout == STORAGE_LAYOUT_FLAT ? "flat" : "sharded", root_dir, sizeof(root_dir)) !=
+            0 ||
+        utils_join_path(root_dir, "logs", logs_dir, sizeof(logs_dir)) != 0) {
+        return -1;
+    }
+    if ((mkdir(base_dir, 0700) != 0 && errno != EEXIST) || (mkdir(root_dir, 0700) != 0 && errno != EEXIST) ||
+        (mkdir(logs_dir, 0700) != 0 && errno != EEXIST)) {
+        fprintf(stderr, "logs_layout: création de %s impossible (%s)\n", logs_dir, strerror(errno));
+        return -1;
+    }
+    storage_paths_t paths;
+    memset(&paths, 0, sizeof(paths));
+    paths.root_dir = root_dir;
+    paths.tasks_dir = root_dir; /* aucune tâche écrite : seul logs/ sert */
+    paths.logs_dir = logs_dir;
+    paths.durability = STORAGE_DURABILITY_ASYNC; /* coût des répertoires, pas des fsync */
+    paths.layout = layout;
+    storage_dirs_t dirs;
+    if (cached) {
+        if (storage_dirs_open(&dirs, &paths) != 0) {
+            fprintf(stderr, "logs_layout: ouverture de %s impossible (%s)\n", logs_dir, strerror(errno));
+            return -1;
+        }
+        paths.dirs = &dirs;
+    }
+    int rc = 0;
+    for (int phase = 0; phase < PHASE_COUNT && rc == 0; ++phase) {
+        rc = run_phase(&paths, (phase_t)phase, count, &elapsed_ns[phase]);
+    }
+    if (cached) {
+        storage_dirs_close(&dirs);
+    }
+    if (rc != 0) {
+        return -1;
+    }
+    rmdir(logs_dir);
+    rmdir(root_dir);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    uint64_t count = 100000;
+    const char *base_dir = "/tmp/erraid-bench";
+    bool cached = true;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:d:u")) != -1) {
+        switch (opt) {
+            case 'n':
+                if (utils_parse_uint64(optarg, &count) != 0 || count == 0) {
+                    fprintf(stderr, "logs_layout: nombre de tâches invalide\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'd':
+                base_dir = optarg;
+                break;
+            case 'u':
+                cached = false;
+                break;
+            default:
+                fprintf(stderr, "Usage : %s [-n N] [-d DIR] [-u]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    int64_t elapsed[2][PHASE_COUNT];
+    if (run_layout(base_dir, STORAGE_LAYOUT_FLAT, count, cached, elapsed[0]) != 0 ||
+        run_layout(base_dir, STORAGE_LAYOUT_SHARDED, count, cached, elapsed[1]) != 0) {
+        return EXIT_FAILURE;
+    }
+    rmdir(base_dir);
+
+    printf("%llu tâches, µs par tâche, répertoires %s\n", (unsigned long long)count,
+           cached ? "maintenus ouverts" : "rouverts à chaque appel");
+    printf("%-12s %12s %12s\n", "", "plate", "répartie");
+    for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+        printf("%-12s %12.2f %12.2f\n",
+               phase_names[phase],
+               (double)elapsed[0][phase] / 1000.0 / (double)count,
+               (double)elapsed[1][phase] / 1000.0 / (double)count);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,38 @@
+#ifndef ERRAID_ADMISSION_H
+#define ERRAID_ADMISSION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Intervalle minimal entre deux lectures de /proc. */
+#define ERRAID_PRESSURE_SAMPLE_MS 1000
+/* Intervalle de réévaluation d'une occurrence différée. */
+#define ERRAID_ADMISSION_RECHECK_MS 5000
+
+/*
+ * Pression système en pourcentage : moyenne « some avg10 » de
+ * /proc/pressure/{cpu,memory,io}, ou à défaut charge moyenne sur une
+ * minute rapportée au nombre de processeurs (cpu uniquement).
+ */
+typedef struct {
+    double cpu;
+    double memory;
+    double io;
+    bool from_psi;
+    int64_t sampled_ms; /* 0 : jamais lu */
+} admission_pressure_t;
+
+/* Relit les sources si le dernier échantillon a plus de ERRAID_PRESSURE_SAMPLE_MS. */
+int admission_sample(admission_pressure_t *pressure, int64_t now_ms);
+
+double admission_level(const admission_pressure_t *pressure);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ERRAID_ADMISSION_H */
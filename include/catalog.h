@@ -0,0 +1,113 @@
+#ifndef ERRAID_CATALOG_H
+#define ERRAID_CATALOG_H
+
+#include "common.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Catalogue des tâches : un instantané binaire et un journal d'écriture anticipée (WAL).
+ *
+ * tasks/catalog.snap : en-tête catalog_snapshot_header_t puis, pour chaque tâche,
+ * sa longueur (uint32_t) et son encodage.
+ * tasks/catalog.wal  : suite d'enregistrements catalog_wal_record_t suivis de l'encodage
+ * de la tâche (CATALOG_OP_PUT) ou de rien (CATALOG_OP_REMOVE).
+ *
+ * Au chargement, l'instantané est lu puis le journal rejoué ; une fin de journal
+ * incomplète ou corrompue est tronquée. Le point de contrôle réécrit l'instantané
+ * (fichier temporaire + rename) puis vide le journal ; rejouer un journal déjà
+ * intégré est sans effet, un arrêt entre les deux étapes est donc sans risque.
+ */
+
+#define CATALOG_MAGIC "ERRC"
+#define CATALOG_VERSION 1
+#define CATALOG_SNAPSHOT_NAME "catalog.snap"
+#define CATALOG_WAL_NAME "catalog.wal"
+#define CATALOG_CHECKPOINT_BYTES (1024 * 1024) /* journal minimal avant point de contrôle */
+
+typedef enum {
+    CATALOG_OP_PUT = 1,    /* création ou mise à jour */
+    CATALOG_OP_REMOVE = 2,
+} catalog_op_t;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t task_count;
+    uint64_t body_length;
+    uint32_t body_crc;
+    uint32_t reserved;
+} catalog_snapshot_header_t;
+
+typedef struct {
+    uint32_t length;       /* octets de données après l'en-tête */
+    uint32_t crc;          /* CRC-32 de task_id, op, reserved puis des données */
+    uint64_t task_id;
+    uint32_t op;           /* catalog_op_t */
+    uint32_t reserved;
+} catalog_wal_record_t;
+
+typedef struct {
+    unsigned char *data;
+    size_t length;
+    size_t capacity;
+} catalog_buffer_t;
+
+typedef struct {
+    char snapshot_path[PATH_MAX];
+    char wal_path[PATH_MAX];
+    int wal_fd;
+    int dir_fd;                /* tasks/ : fsync après le rename de l'instantané */
+    bool fresh;                /* ni instantané ni journal à l'ouverture */
+    uint64_t wal_bytes;
+    uint64_t wal_records;
+    uint64_t snapshot_bytes;
+    catalog_buffer_t scratch;  /* encodage des enregistrements */
+} catalog_t;
+
+int catalog_open(catalog_t *catalog, const char *tasks_dir);
+
+/* Instantané puis journal ; tasks_out est trié par identifiant. */
+int catalog_load(catalog_t *catalog, task_t **tasks_out, size_t *count_out);
+
+int catalog_put(catalog_t *catalog, const task_t *task);
+
+int catalog_remove(catalog_t *catalog, uint64_t task_id);
+
+/* Vrai lorsque le journal dépasse CATALOG_CHECKPOINT_BYTES et la taille de l'instantané. */
+bool catalog_should_checkpoint(const catalog_t *catalog);
+
+int catalog_checkpoint(catalog_t *catalog, const task_t *tasks, size_t count);
+
+/*
+ * Point de contrôle hors de la boucle, en trois temps : encodage en mémoire
+ * (catalog_encode_snapshot, out est à libérer par l'appelant), écriture de
+ * l'instantané par un autre fil (catalog_write_snapshot ne lit que les chemins
+ * et dir_fd, fixés à l'ouverture), puis catalog_checkpoint_done sur le fil qui
+ * ajoute au journal.
+ */
+int catalog_encode_snapshot(const task_t *tasks, size_t count, catalog_buffer_t *out);
+
+int catalog_write_snapshot(const catalog_t *catalog, const catalog_buffer_t *snapshot);
+
+/* Vide le journal s'il n'a pas grandi depuis l'encodage (wal_bytes == covered_wal_bytes). */
+int catalog_checkpoint_done(catalog_t *catalog, size_t snapshot_bytes, uint64_t covered_wal_bytes);
+
+void catalog_close(catalog_t *catalog);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ERRAID_CATALOG_H */
@@ -21,6 +21,7 @@
 #define ERRAID_MAX_TASK_COMMANDS 16
 #define ERRAID_MAX_STDIO_SNAPSHOT 65536
 #define ERRAID_STDIO_SNAPSHOT_COUNT 5
+#define ERRAID_MAX_TASK_OPTIONS 32
 #define ERRAID_PIPE_MESSAGE_LIMIT 4096
 
 #define ERRAID_MAGIC 0x44495245u /* "ERID" */
@@ -44,6 +45,81 @@ typedef struct {
     bool enabled;         /* false pour les tâches abstraites */
 } schedule_t;
 
+/* Classes d'ordonnancement E/S (ioprio_set(2)). */
+typedef enum {
+    TASK_IOPRIO_NONE = 0, /* inchangée */
+    TASK_IOPRIO_RT = 1,
+    TASK_IOPRIO_BE = 2,
+    TASK_IOPRIO_IDLE = 3,
+} task_ioprio_class_t;
+
+/* Limites appliquées dans le fils avant execvp ; 0 signifie « non limité ». */
+typedef struct {
+    uint64_t as_bytes;   /* RLIMIT_AS */
+    uint64_t cpu_seconds; /* RLIMIT_CPU */
+    uint64_t nofile;     /* RLIMIT_NOFILE */
+    uint64_t nproc;      /* RLIMIT_NPROC */
+    int32_t nice;        /* 0 : inchangé */
+    task_ioprio_class_t ioprio_class;
+    uint8_t ioprio_level; /* 0..7, ignoré pour IDLE */
+} task_limits_t;
+
+#define TASK_LIMIT_HIT_CPU 0x1u
+#define TASK_LIMIT_HIT_AS 0x2u
+
+#define ERRAID_DEFAULT_TIMEOUT_GRACE 5
+#define ERRAID_DEFAULT_RETRY_DELAY 10
+#define ERRAID_DEFAULT_RETRY_CAP 3600
+#define ERRAID_DEFAULT_DEFER_MAX 600
+#define ERRAID_DEFAULT_WATCH_DEBOUNCE_MS 1000
+
+/* Événements déclencheurs d'une tâche surveillant un chemin (option watch.events). */
+#define TASK_WATCH_CREATE 0x1u
+#define TASK_WATCH_CLOSE_WRITE 0x2u
+#define TASK_WATCH_MOVED_TO 0x4u
+#define TASK_WATCH_ALL (TASK_WATCH_CREATE | TASK_WATCH_CLOSE_WRITE | TASK_WATCH_MOVED_TO)
+
+/* Comportement lorsqu'une occurrence arrive alors qu'une exécution précédente est encore active. */
+typedef enum {
+    TASK_OVERLAP_QUEUE = 0,      /* une seule occurrence mise en attente, lancée à la fin de l'exécution */
+    TASK_OVERLAP_SKIP = 1,       /* occurrence ignorée */
+    TASK_OVERLAP_CONCURRENT = 2, /* jusqu'à max_concurrent exécutions simultanées, les suivantes ignorées */
+    TASK_OVERLAP_KILL = 3,       /* l'exécution précédente est interrompue */
+} task_overlap_t;
+
+/* Capture des sorties : dernier contenu seulement, ou journal horodaté ligne par ligne (runlog.h). */
+typedef enum {
+    TASK_CAPTURE_BLOB = 0,
+    TASK_CAPTURE_LINES = 1,
+} task_capture_t;
+
+/* Résultat de la tâche amont qui déclenche la tâche (option after.on). */
+typedef enum {
+    TASK_AFTER_SUCCESS = 0,
+    TASK_AFTER_FAILURE = 1,
+    TASK_AFTER_ANY = 2,
+} task_after_t;
+
+typedef struct {
+    uint32_t timeout_seconds; /* 0 : pas de délai d'exécution */
+    uint32_t grace_seconds;   /* entre SIGTERM et SIGKILL, 0 : ERRAID_DEFAULT_TIMEOUT_GRACE */
+    task_overlap_t overlap;
+    uint32_t max_concurrent;  /* TASK_OVERLAP_CONCURRENT uniquement */
+    uint32_t retry_max;       /* nouvelles tentatives après un échec, 0 : aucune */
+    uint32_t retry_delay_seconds; /* délai de la première tentative, doublé ensuite */
+    uint32_t retry_cap_seconds;   /* plafond du délai, 0 : ERRAID_DEFAULT_RETRY_CAP */
+    uint32_t retry_jitter_percent; /* variation aléatoire appliquée au délai (0..100) */
+    uint32_t defer_pressure_percent; /* seuil de pression, 0 : tâche non différable */
+    uint32_t defer_max_seconds;      /* report maximal, 0 : ERRAID_DEFAULT_DEFER_MAX */
+    task_capture_t capture;
+    uint32_t history_max_age_seconds; /* 0 : rétention globale du démon (erraid -k) */
+    uint32_t history_max_entries;     /* 0 : rétention globale du démon (erraid -k) */
+    uint32_t watch_events;       /* TASK_WATCH_*, 0 : TASK_WATCH_ALL */
+    uint32_t watch_debounce_ms;  /* 0 : ERRAID_DEFAULT_WATCH_DEBOUNCE_MS */
+    uint64_t after_task_id;      /* tâche amont, 0 : aucune */
+    task_after_t after_on;
+} task_policy_t;
+
 typedef struct {
     uint64_t task_id;
     task_type_t type;
@@ -51,13 +127,57 @@ typedef struct {
     size_t command_count;
     schedule_t schedule;
     int64_t last_run_epoch;
+    task_limits_t limits;
+    task_policy_t policy;
+    char *watch_path;        /* chemin surveillé (inotify), NULL : aucun */
+    /* État d'exécution, non persisté : nouvelle tentative programmée, occurrence différée, lot d'événements. */
+    uint64_t retry_token;
+    uint32_t retry_attempt;
+    uint64_t defer_token;
+    int64_t defer_epoch;
+    int64_t defer_deadline_ms;
+    int64_t defer_since_ms;
+    int watch_wd;            /* 0 : pas de surveillance active */
+    uint64_t watch_token;
+    uint32_t watch_pending;  /* événements accumulés depuis le dernier déclenchement */
+    int64_t watch_first_ms;
+    int64_t watch_last_ms;
+    uint32_t state_slot;     /* emplacement runstate + 1, 0 : pas encore attribué */
+    uint32_t history_appends; /* ajouts à l'historique depuis la dernière compaction demandée */
 } task_t;
 
+typedef struct {
+    int64_t start_ns;        /* CLOCK_MONOTONIC au lancement de la première commande */
+    int64_t end_ns;          /* CLOCK_MONOTONIC à la fin de la dernière commande */
+    int64_t cpu_user_us;     /* somme sur toutes les commandes */
+    int64_t cpu_sys_us;
+    int64_t max_rss_kb;      /* maximum sur toutes les commandes */
+    int64_t blocks_in;
+    int64_t blocks_out;
+    int64_t ctx_voluntary;
+    int64_t ctx_involuntary;
+} task_run_usage_t;
+
+typedef enum {
+    TASK_RUN_COMPLETED = 0,
+    TASK_RUN_TIMEOUT = 1,
+    TASK_RUN_SKIPPED = 2, /* occurrence non exécutée (politique de chevauchement) */
+    TASK_RUN_KILLED = 3,  /* interrompue par une occurrence suivante */
+} task_run_outcome_t;
+
 typedef struct {
     int64_t epoch;
     int32_t status;
     size_t stdout_len;
     size_t stderr_len;
+    task_run_usage_t usage;
+    uint32_t limits_hit; /* combinaison de TASK_LIMIT_HIT_* */
+    task_run_outcome_t outcome;
+    uint32_t attempt; /* 1 pour l'occurrence planifiée, puis 2, 3... pour les nouvelles tentatives */
+    int64_t deferred_ms; /* report imposé par le contrôle d'admission */
+    int64_t lag_us;      /* de l'échéance prévue à l'exec de la première commande, 0 si inconnu */
+    uint64_t stdout_hash; /* utils_hash64 des sorties conservées, 0 si vides ou inconnues */
+    uint64_t stderr_hash;
 } task_run_entry_t;
 
 typedef enum {
@@ -79,6 +199,10 @@ typedef enum {
     MSG_RSP_GET_STDERR = 0x53,
     MSG_REQ_SHUTDOWN = 0x60,
     MSG_RSP_SHUTDOWN = 0x61,
+    MSG_REQ_STATS = 0x70,
+    MSG_RSP_STATS = 0x71,
+    MSG_REQ_GET_RECORDS = 0x72,
+    MSG_RSP_GET_RECORDS = 0x73,
     MSG_RSP_ERROR = 0x7F,
 } message_type_t;
 
@@ -1,25 +1,106 @@
 #ifndef ERRAID_DAEMON_H
 #define ERRAID_DAEMON_H
 
+#include "admission.h"
+#include "catalog.h"
 #include "common.h"
+#include "executor.h"
+#include "persist.h"
 #include "proto.h"
+#include "runstate.h"
 #include "scheduler.h"
 #include "storage.h"
 #include "utils.h"
 
 #include <limits.h>
+#include <poll.h>
 #include <stddef.h>
 
 #ifndef PATH_MAX
 #define PATH_MAX 4096
 #endif
 
+#define ERRAID_DEFAULT_PREARM_MS 500
+#define ERRAID_DEFAULT_GROUP_MS 100   /* fenêtre de validation groupée de l'historique */
+#define ERRAID_DEFAULT_GROUP_RUNS 64  /* exécutions déclenchant la validation avant la fin de la fenêtre */
+#define ERRAID_COMPACT_INTERVAL_MS 3600000 /* passage de compaction sur toutes les tâches (rétention par âge) */
+#define ERRAID_COMPACT_SLACK 8        /* compaction après max_entries / 8 + 1 ajouts */
+#define ERRAID_ID_LEASE 1024          /* identifiants réservés par écriture de tasks/next_id */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Réglages du démon fournis en ligne de commande. */
+typedef struct {
+    const char *run_dir;     /* NULL : répertoire par défaut */
+    int64_t prearm_lead_ms;  /* avance du pré-armement, 0 : désactivé */
+    runstate_sync_t state_sync;
+    int64_t state_sync_ms;   /* RUNSTATE_SYNC_INTERVAL uniquement */
+    storage_durability_t history_durability;
+    int64_t history_group_ms;     /* STORAGE_DURABILITY_GROUP uniquement */
+    uint32_t history_group_runs;
+    storage_retention_t history_retention; /* défaut des tâches sans history.max_age/max_entries */
+} erraid_config_t;
+
+/* Validation groupée de l'historique (STORAGE_DURABILITY_GROUP). */
+typedef struct {
+    int64_t window_ms;
+    uint32_t max_runs;
+    uint32_t pending;  /* exécutions écrites, pas encore synchronisées */
+    int64_t due_ms;    /* -1 : aucune validation prévue */
+} erraid_group_commit_t;
+
+typedef struct {
+    uint64_t task_id;
+    int64_t epoch; /* occurrence mise en attente (politique queue) */
+    int64_t deadline_ms;
+} erraid_pending_run_t;
+
+/* Entrée de l'index des dépendances, trié par upstream_id. */
+typedef struct {
+    uint64_t upstream_id;
+    size_t task_index;  /* tâche déclenchée, indice dans tasks */
+} erraid_dependent_t;
+
+/* Compteurs cumulés depuis le démarrage du démon (requête STATS). */
+typedef struct {
+    uint64_t runs_started;
+    uint64_t runs_completed; /* toutes issues confondues */
+    uint64_t runs_timed_out;
+    uint64_t runs_killed;
+    uint64_t firings_skipped;
+    uint64_t firings_queued;
+    uint64_t retries_scheduled;
+    uint64_t firings_deferred;
+    uint64_t deferrals_expired; /* lancées à l'échéance de defer.max malgré la pression */
+    uint64_t deferral_ms_total;
+    uint64_t launches_prearmed; /* fils préparé avant l'échéance puis libéré */
+    uint64_t launches_cold;
+    uint64_t watch_events;    /* événements inotify retenus par au moins une tâche */
+    uint64_t watch_triggers;  /* lots d'événements ayant déclenché une occurrence */
+    uint64_t chain_triggers;  /* occurrences déclenchées par la fin d'une tâche amont */
+    uint64_t history_commits;         /* fsync (strict) ou syncfs (groupé) de l'historique */
+    uint64_t history_committed;       /* exécutions couvertes par ces validations */
+    uint64_t history_commit_us_total;
+    uint64_t history_commit_us_max;
+    uint64_t history_batch_max;
+    uint64_t persist_waits;           /* attentes du fil de persistance (file pleine, lecture) */
+    uint64_t history_compactions;     /* compactions ayant retiré au moins un enregistrement */
+    uint64_t history_compacted;       /* enregistrements agrégés dans rollup.bin */
+    uint64_t startup_us;              /* durée de erraid_init, chargement des tâches compris */
+} erraid_stats_t;
+
 typedef struct {
     storage_paths_t paths;
+    storage_dirs_t dirs;      /* répertoires ouverts du fil principal (paths.dirs) */
+    catalog_t catalog;
+    bool catalog_synced;      /* tasks reflète le catalogue : point de contrôle possible */
+    bool checkpoint_pending;  /* instantané confié au fil de persistance, pas encore récupéré */
+    runstate_t runstate;      /* last_run, prochaine occurrence, compteurs (state/runstate.bin) */
+    persist_queue_t persist;  /* écritures de storage.c, exécutées par le fil de persistance */
+    uint64_t next_task_id;    /* prochain identifiant, attribué en mémoire */
+    uint64_t id_lease_end;    /* fin du bail en cours, écrite dans tasks/next_id */
     char root_dir[PATH_MAX];
     char tasks_dir[PATH_MAX];
     char logs_dir[PATH_MAX];
@@ -27,19 +108,43 @@ typedef struct {
     char pipes_dir[PATH_MAX];
     char request_pipe_path[PATH_MAX];
     char reply_pipe_path[PATH_MAX];
-    task_t *tasks;
+    task_t *tasks;            /* trié par identifiant */
     size_t task_count;
     schedule_entry_t *plan;
     size_t plan_capacity;
     size_t plan_count;
+    scheduler_queue_t timers;
+    erraid_dependent_t *dependents; /* reconstruit avec le plan */
+    size_t dependent_count;
+    size_t dependent_capacity;
+    executor_run_t *runs;
+    executor_pool_t output_pool; /* tampons de capture stdout/stderr */
+    size_t run_count;
+    size_t run_capacity;
+    uint64_t next_run_id;
+    uint64_t next_token; /* jetons retry_token / defer_token */
+    admission_pressure_t pressure;
+    int64_t prearm_lead_ms; /* avance du pré-armement, 0 : désactivé */
+    erraid_pending_run_t *pending;
+    size_t pending_count;
+    size_t pending_capacity;
+    erraid_group_commit_t group_commit;
+    storage_retention_t retention; /* rétention globale (erraid -k) */
+    int64_t compact_due_ms;        /* prochain passage de compaction, 0 : au premier tour */
+    erraid_stats_t stats;
+    struct pollfd *pollfds;
+    size_t pollfd_capacity;
     int request_fd;
     int reply_fd;
     int wake_pipe[2];
+    int watch_fd;             /* inotify, -1 si indisponible */
     int request_dummy_fd;
     bool should_quit;
 } erraid_context_t;
 
-int erraid_init(erraid_context_t *ctx, const char *run_dir);
+void erraid_config_defaults(erraid_config_t *config);
+
+int erraid_init(erraid_context_t *ctx, const erraid_config_t *config);
 
 int erraid_run(erraid_context_t *ctx);
 
@@ -47,6 +152,14 @@ void erraid_shutdown(erraid_context_t *ctx);
 
 int erraid_reload_tasks(erraid_context_t *ctx);
 
+/* Outils hors ligne (démon arrêté) : copie du catalogue vers/depuis des fichiers <ID>.task. */
+int erraid_export_tasks(const erraid_config_t *config, const char *dir, size_t *count_out);
+
+int erraid_import_tasks(const erraid_config_t *config, const char *dir, size_t *count_out);
+
+/* Hors ligne : logs/<ID>/ vers l'arborescence répartie (storage_migrate_layout). */
+int erraid_migrate_layout(const erraid_config_t *config, size_t *count_out);
+
 int erraid_handle_message(erraid_context_t *ctx, const proto_message_t *request);
 
 int erraid_schedule_loop(erraid_context_t *ctx);
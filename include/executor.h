@@ -2,26 +2,104 @@
 #define ERRAID_EXECUTOR_H
 
 #include "common.h"
+#include "runlog.h"
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <sys/resource.h>
+#include <sys/types.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Nombre de tampons de capture préalloués (deux par exécution simultanée). */
+#define EXECUTOR_POOL_DEFAULT_BUFFERS 16
+
+/*
+ * Réserve de tampons de capture de ERRAID_MAX_STDIO_SNAPSHOT octets. Une
+ * exécution emprunte un tampon au premier octet lu sur un flux et le rend à
+ * la libération de son résultat ; en régime établi aucune allocation n'a lieu.
+ */
+typedef struct {
+    char **free_buffers;    /* pile des tampons disponibles */
+    size_t free_count;
+    size_t capacity;        /* nombre maximal de tampons conservés */
+    uint64_t hits;          /* emprunts servis par la réserve */
+    uint64_t misses;        /* emprunts ayant dû allouer */
+} executor_pool_t;
+
 typedef struct {
+    executor_pool_t *pool;  /* propriétaire des tampons, NULL : malloc/free */
     char *stdout_buf;
     size_t stdout_len;
     char *stderr_buf;
     size_t stderr_len;
     int status;
+    task_run_usage_t usage;
+    uint32_t limits_hit;
+    int64_t exec_epoch_ns;  /* CLOCK_REALTIME juste avant execvp de la première commande, 0 si inconnu */
     bool stdout_truncated;
     bool stderr_truncated;
 } executor_result_t;
 
-int executor_run_task(const task_t *task, executor_result_t *result);
+/*
+ * Exécution en cours d'une tâche. Chaque commande tourne dans son propre
+ * groupe de processus ; la boucle du démon surveille stdout_fd/stderr_fd,
+ * récolte les fils et fait avancer l'exécution avec executor_step().
+ */
+typedef struct {
+    uint64_t run_id;
+    uint64_t task_id;
+    int64_t epoch;          /* instant de déclenchement, enregistré dans l'historique */
+    uint32_t attempt;
+    int64_t deferred_ms;
+    int64_t deadline_ms;    /* échéance prévue de l'occurrence (origine de lag_us), visée par un pré-armement */
+    size_t command_index;
+    pid_t pid;              /* commande courante, -1 une fois récoltée */
+    pid_t pgid;             /* conservé après la récolte pour atteindre les descendants */
+    int stdout_fd;          /* -1 après EOF */
+    int stderr_fd;
+    int gate_fd;            /* lancement pré-armé : écriture libère le fils, fermeture l'annule */
+    int exec_fd;            /* horodatage d'exec transmis par le fils */
+    task_limits_t limits;
+    runlog_writer_t *records; /* capture=lines : journal horodaté, fermé par executor_finish */
+    executor_result_t result;
+    task_run_outcome_t outcome;
+    bool stopping;          /* SIGTERM envoyé : plus aucune commande n'est lancée */
+    bool failed;            /* échec de lancement : statut -1 */
+    bool armed;             /* fils créé, bloqué sur gate_fd */
+    bool discard;           /* pré-armement annulé : rien à enregistrer */
+} executor_run_t;
+
+int executor_pool_init(executor_pool_t *pool, size_t count);
+
+void executor_pool_destroy(executor_pool_t *pool);
+
+int executor_start(executor_run_t *run, executor_pool_t *pool, const task_t *task, uint64_t run_id, int64_t epoch);
+
+/* Prépare la première commande (fork, tubes, lecture anticipée) sans la lancer. */
+int executor_prepare(executor_run_t *run, executor_pool_t *pool, const task_t *task, uint64_t run_id);
+
+int executor_release(executor_run_t *run, int64_t epoch);
+
+void executor_cancel(executor_run_t *run);
+
+int executor_read_output(executor_run_t *run, int fd);
+
+void executor_child_exited(executor_run_t *run, int wait_status, const struct rusage *ru);
+
+/* Retourne 1 si l'exécution est terminée, 0 sinon. task peut être NULL (tâche supprimée). */
+int executor_step(executor_run_t *run, const task_t *task);
+
+int executor_signal(executor_run_t *run, int signo);
+
+/* Transfère les tampons dans result puis libère les ressources de l'exécution. */
+void executor_finish(executor_run_t *run, executor_result_t *result);
+
+void executor_run_free(executor_run_t *run);
 
+/* Rend les tampons de capture à leur réserve. */
 void executor_result_free(executor_result_t *result);
 
 #ifdef __cplusplus
@@ -0,0 +1,145 @@
+#ifndef ERRAID_HISTORY_H
+#define ERRAID_HISTORY_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Historique binaire d'une tâche : logs/<TASKID>/history.bin.
+ *
+ * En-tête history_header_t puis enregistrements history_record_t de taille fixe,
+ * dans l'ordre de fin des exécutions (epochs croissants, sauf exécutions qui se
+ * chevauchent). Le fichier est lu par mmap : l'enregistrement i est à un
+ * décalage calculable, les N derniers s'obtiennent sans rien parcourir. Un
+ * enregistrement incomplet en fin de fichier (arrêt brutal) est ignoré à la
+ * lecture et écrasé par l'ajout suivant.
+ *
+ * Rétention : history_compact retire les enregistrements les plus anciens et les
+ * agrège dans logs/<TASKID>/rollup.bin, par heure pendant HISTORY_ROLLUP_HOURLY_SPAN
+ * puis par jour. Les deux fichiers sont réécrits (fichier temporaire, fsync, rename),
+ * agrégats d'abord ; le champ generation des en-têtes permet de terminer une
+ * compaction interrompue entre les deux sans compter deux fois les mêmes exécutions.
+ * Le champ dropped de history.bin cumule les enregistrements retirés : base + indice
+ * numérote une exécution de façon stable d'une compaction à l'autre (curseurs de page).
+ */
+
+#define HISTORY_MAGIC "ERRH"
+#define HISTORY_VERSION 2
+#define HISTORY_RECORD_V1_SIZE 128 /* version 1, sans empreintes : lue telle quelle, convertie au premier ajout */
+#define HISTORY_FILE_NAME "history.bin"
+#define HISTORY_TEXT_NAME "history.log" /* ancien format texte, converti au premier accès */
+#define HISTORY_ROLLUP_MAGIC "ERRR"
+#define HISTORY_ROLLUP_VERSION 1
+#define HISTORY_ROLLUP_NAME "rollup.bin"
+#define HISTORY_ROLLUP_HOUR 3600
+#define HISTORY_ROLLUP_DAY 86400
+#define HISTORY_ROLLUP_HOURLY_SPAN (7 * HISTORY_ROLLUP_DAY) /* agrégats horaires plus récents, quotidiens au-delà */
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved0;
+    uint64_t generation; /* compactions appliquées */
+    uint64_t dropped;    /* history.bin : enregistrements retirés depuis la création ; rollup.bin : à cette génération */
+} history_header_t;
+
+typedef struct {
+    int64_t epoch;
+    int32_t status;
+    uint32_t attempt;
+    uint64_t stdout_len;
+    uint64_t stderr_len;
+    int64_t start_ns;
+    int64_t end_ns;
+    int64_t cpu_user_us;
+    int64_t cpu_sys_us;
+    int64_t max_rss_kb;
+    int64_t blocks_in;
+    int64_t blocks_out;
+    int64_t ctx_voluntary;
+    int64_t ctx_involuntary;
+    uint32_t limits_hit;
+    uint32_t outcome;
+    int64_t deferred_ms;
+    int64_t lag_us;
+    uint64_t stdout_hash; /* version 2 */
+    uint64_t stderr_hash;
+} history_record_t;
+
+/* Agrégat des exécutions terminées dans [period_start, period_start + period_seconds). */
+typedef struct {
+    int64_t period_start;
+    uint32_t period_seconds; /* HISTORY_ROLLUP_HOUR ou HISTORY_ROLLUP_DAY */
+    uint32_t runs;           /* occurrences ignorées comprises */
+    uint32_t failures;       /* statut non nul, occurrences ignorées exclues */
+    uint32_t skipped;
+    uint32_t timed;          /* exécutions dont la durée est connue */
+    uint32_t reserved0;
+    uint64_t duration_us_total; /* moyenne : duration_us_total / timed */
+    uint64_t duration_us_min;
+    uint64_t duration_us_max;
+    uint64_t stdout_bytes;
+    uint64_t stderr_bytes;
+} history_rollup_t;
+
+typedef struct {
+    int fd;
+    const unsigned char *map;  /* NULL pour un historique vide */
+    size_t map_length;
+    size_t record_size; /* sizeof(history_record_t) ou HISTORY_RECORD_V1_SIZE */
+    size_t count;
+    uint64_t base; /* enregistrements déjà retirés : l'indice i est l'exécution numéro base + i */
+} history_view_t;
+
+/*
+ * Les fichiers sont désignés par un nom relatif à dir_fd (openat) : le
+ * répertoire de journaux reste ouvert d'un appel à l'autre. AT_FDCWD : chemin.
+ */
+
+/* Ajoute un enregistrement ; sync : fsync avant de rendre la main. */
+int history_append(int dir_fd, const char *name, const task_run_entry_t *entry, bool sync);
+
+/* Réécrit le fichier entier (fichier temporaire, fsync, rename). */
+int history_write_all(int dir_fd, const char *name, const task_run_entry_t *entries, size_t count);
+
+/* Projette le fichier ; absent : vue vide, sans erreur. */
+int history_open(history_view_t *view, int dir_fd, const char *name);
+
+void history_get(const history_view_t *view, size_t index, task_run_entry_t *entry);
+
+int64_t history_epoch_at(const history_view_t *view, size_t index);
+
+/* Premier indice dont l'epoch est >= epoch (recherche dichotomique), count si aucun. */
+size_t history_lower_bound(const history_view_t *view, int64_t epoch);
+
+void history_close(history_view_t *view);
+
+/*
+ * Retire les enregistrements d'epoch < cutoff_epoch et les plus anciens au-delà de
+ * max_entries (0 : sans limite), puis les agrège dans rollup_name. now_epoch fixe
+ * la limite entre agrégats horaires et quotidiens. dropped_out : enregistrements retirés.
+ */
+int history_compact(int dir_fd,
+                    const char *name,
+                    const char *rollup_name,
+                    int64_t cutoff_epoch,
+                    size_t max_entries,
+                    int64_t now_epoch,
+                    size_t *dropped_out);
+
+/* Agrégats triés par période croissante ; fichier absent : aucun. À libérer avec free. */
+int history_load_rollups(int dir_fd, const char *rollup_name, history_rollup_t **rollups_out, size_t *count_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ERRAID_HISTORY_H */
@@ -0,0 +1,105 @@
+#ifndef ERRAID_PERSIST_H
+#define ERRAID_PERSIST_H
+
+#include "catalog.h"
+#include "common.h"
+#include "executor.h"
+#include "runlog.h"
+#include "storage.h"
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fil de persistance : exécute les écritures de storage.c, l'écriture de
+ * l'instantané du catalogue et celle des journaux horodatés hors de la boucle du démon.
+ *
+ * File circulaire à un producteur (boucle) et un consommateur (fil), sans verrou.
+ * Trois compteurs croissants : tail (soumises), head (traitées), reclaimed
+ * (récupérées par la boucle). Un emplacement n'est réutilisé qu'une fois
+ * récupéré, ce qui laisse à la boucle le soin de rendre les tampons de sortie
+ * à leur réserve et de compter les validations. Le fil écrit dans wake_fd
+ * après chaque lot traité.
+ */
+
+#define PERSIST_QUEUE_CAPACITY 256 /* puissance de deux */
+
+typedef enum {
+    PERSIST_OP_HISTORY = 1,   /* storage_append_history avec les sorties de result */
+    PERSIST_OP_HISTORY_ENTRY, /* storage_append_history_entry (ligne seule) */
+    PERSIST_OP_REMOVE_LOGS,   /* storage_remove_task_logs */
+    PERSIST_OP_RESERVE_IDS,   /* storage_reserve_task_ids(value) */
+    PERSIST_OP_SYNC_LOGS,     /* storage_sync_logs, value : exécutions couvertes */
+    PERSIST_OP_COMPACT,       /* storage_compact_history(retention), value : enregistrements retirés */
+    PERSIST_OP_CHECKPOINT,    /* catalog_write_snapshot(snapshot), value : wal_bytes à l'encodage */
+    PERSIST_OP_RUNLOG,        /* runlog_write_chunk(runlog), qui libère le bloc */
+} persist_op_kind_t;
+
+typedef struct {
+    persist_op_kind_t kind;
+    uint64_t task_id;
+    uint64_t value;
+    task_run_entry_t entry;
+    storage_retention_t retention;
+    executor_result_t result; /* PERSIST_OP_HISTORY : tampons appartenant à la boucle */
+    const catalog_t *catalog; /* PERSIST_OP_CHECKPOINT : chemins et dir_fd seulement */
+    catalog_buffer_t snapshot;
+    runlog_chunk_t *runlog;
+    /* Rempli par le fil de persistance. */
+    int rc;
+    int error;
+    int64_t latency_ns;
+} persist_op_t;
+
+typedef struct {
+    persist_op_t slots[PERSIST_QUEUE_CAPACITY];
+    _Atomic uint64_t tail;
+    _Atomic uint64_t head;
+    uint64_t reclaimed;
+    atomic_bool stopping;
+    sem_t ready;              /* un jeton par soumission, plus un pour l'arrêt */
+    const storage_paths_t *paths;
+    int wake_fd;
+    pthread_t thread;
+    bool running;
+} persist_queue_t;
+
+int persist_start(persist_queue_t *queue, const storage_paths_t *paths, int wake_fd);
+
+/* Emplacement libre en fin de file, NULL si la file est pleine. */
+persist_op_t *persist_reserve(persist_queue_t *queue);
+
+/* Publie l'emplacement obtenu par persist_reserve. */
+void persist_submit(persist_queue_t *queue);
+
+/* Plus ancienne opération traitée et non récupérée, NULL sinon. */
+persist_op_t *persist_completed(persist_queue_t *queue);
+
+void persist_reclaim(persist_queue_t *queue);
+
+/* Nombre d'opérations soumises / traitées depuis le démarrage. */
+uint64_t persist_submitted(const persist_queue_t *queue);
+
+uint64_t persist_processed(const persist_queue_t *queue);
+
+/*
+ * Valeur de persist_processed à atteindre pour que les opérations de task_id
+ * déjà soumises soient faites ; persist_processed si aucune n'est en attente.
+ */
+uint64_t persist_pending_for_task(const persist_queue_t *queue, uint64_t task_id);
+
+/* Traite les opérations restantes puis arrête le fil ; les opérations restent à récupérer. */
+void persist_stop(persist_queue_t *queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ERRAID_PERSIST_H */
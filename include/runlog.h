@@ -0,0 +1,150 @@
+#ifndef ERRAID_RUNLOG_H
+#define ERRAID_RUNLOG_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Journal horodaté des sorties d'une exécution (option de tâche capture=lines).
+ *
+ * <TASKDIR>/records/<EPOCH>-<ATTEMPT>.rec : en-tête runlog_header_t puis une
+ * suite d'enregistrements runlog_record_t suivis de leurs octets.
+ * <TASKDIR>/records/<EPOCH>-<ATTEMPT>.idx : index clairsemé (t_ns, offset),
+ * une entrée tous les RUNLOG_INDEX_STRIDE octets de journal.
+ *
+ * <TASKDIR> est le répertoire de journaux de la tâche (storage_task_log_dir).
+ */
+
+#define RUNLOG_MAGIC "ERRL"
+#define RUNLOG_VERSION 1
+#define RUNLOG_MAX_LINE 1024        /* ligne plus longue : découpée en plusieurs enregistrements */
+#define RUNLOG_INDEX_STRIDE 4096
+#define RUNLOG_WRITE_BUFFER 16384
+#define RUNLOG_RUNS_KEPT 16         /* journaux conservés par tâche */
+
+typedef enum {
+    RUNLOG_STREAM_STDOUT = 1,
+    RUNLOG_STREAM_STDERR = 2,
+} runlog_stream_t;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    int64_t start_mono_ns;   /* CLOCK_MONOTONIC au lancement de l'exécution */
+    int64_t start_epoch_ns;  /* CLOCK_REALTIME au même instant */
+    uint64_t reserved;
+} runlog_header_t;
+
+typedef struct {
+    int64_t t_ns;            /* lecture de la fin de ligne, relatif au lancement */
+    uint32_t length;
+    uint8_t stream;          /* runlog_stream_t */
+    uint8_t reserved[3];
+} runlog_record_t;
+
+typedef struct {
+    int64_t t_ns;
+    uint64_t offset;
+} runlog_index_entry_t;
+
+/* Fichiers d'un journal : ouverts, écrits et fermés par runlog_write_chunk seulement. */
+typedef struct {
+    int fd;
+    int index_fd;
+} runlog_files_t;
+
+/*
+ * Bloc de journal prêt à écrire : octets du journal (l'en-tête pour le premier
+ * bloc) et entrées d'index qui désignent ses enregistrements. Un bloc contient
+ * au plus RUNLOG_WRITE_BUFFER / RUNLOG_INDEX_STRIDE + 1 entrées.
+ */
+typedef struct {
+    runlog_files_t *files;
+    uint64_t task_id;
+    int64_t epoch;
+    uint32_t attempt;
+    bool first;                  /* créer records/, élaguer, ouvrir les fichiers */
+    bool last;                   /* fermer les fichiers et libérer files */
+    size_t length;
+    size_t index_count;
+    runlog_index_entry_t index[RUNLOG_WRITE_BUFFER / RUNLOG_INDEX_STRIDE + 1];
+    char data[RUNLOG_WRITE_BUFFER];
+} runlog_chunk_t;
+
+/* Reçoit chaque bloc, dans l'ordre ; runlog_write_chunk doit ensuite l'écrire et le libérer. */
+typedef void (*runlog_submit_fn)(runlog_chunk_t *chunk, void *arg);
+
+/*
+ * Découpage des sorties en enregistrements, sans entrée/sortie : les blocs
+ * remplis sont confiés à submit (le fil de persistance pour le démon).
+ */
+typedef struct {
+    runlog_submit_fn submit;
+    void *submit_arg;
+    runlog_chunk_t *chunk;       /* bloc en cours de remplissage, jamais NULL */
+    int64_t start_ns;
+    uint64_t offset;             /* taille logique du journal, bloc en cours compris */
+    uint64_t next_index_offset;
+    size_t partial_len[2];       /* ligne en cours par flux */
+    char partial[2][RUNLOG_MAX_LINE];
+} runlog_writer_t;
+
+/* Appelé pour chaque enregistrement de la fenêtre ; retourne 1 pour s'arrêter. */
+typedef int (*runlog_visit_fn)(const runlog_record_t *record, const char *data, uint64_t offset, void *arg);
+
+/* Soumet aussitôt le bloc d'ouverture, pour que les fichiers existent dans l'ordre des autres écritures. */
+int runlog_open(runlog_writer_t **out,
+                uint64_t task_id,
+                int64_t epoch,
+                uint32_t attempt,
+                int64_t start_mono_ns,
+                runlog_submit_fn submit,
+                void *submit_arg);
+
+/* Découpe data en lignes ; now_ns est l'instant CLOCK_MONOTONIC de la lecture. */
+int runlog_append(runlog_writer_t *writer, runlog_stream_t stream, int64_t now_ns, const char *data, size_t length);
+
+/* Soumet le bloc en cours s'il n'est pas vide. */
+int runlog_flush(runlog_writer_t *writer);
+
+/* Émet les lignes incomplètes, soumet le dernier bloc et libère le découpage. */
+int runlog_close(runlog_writer_t *writer, int64_t now_ns);
+
+/*
+ * Écrit chunk puis le libère. Le premier bloc demande task_dir (storage_task_log_dir
+ * avec create) ; si ses fichiers n'ont pu être ouverts, les blocs suivants sont ignorés.
+ */
+int runlog_write_chunk(runlog_chunk_t *chunk, const char *task_dir);
+
+/* Exécution la plus récente disposant d'un journal. */
+int runlog_latest(const char *task_dir, int64_t *epoch_out, uint32_t *attempt_out);
+
+/*
+ * Parcourt les enregistrements dont t_ns est dans [from_ns, to_ns]. Sans curseur
+ * (cursor == 0) le départ est trouvé par recherche dans l'index ; sinon la lecture
+ * reprend à l'offset donné. start_epoch_ns reçoit l'horodatage du lancement.
+ */
+int runlog_read_window(const char *task_dir,
+                       int64_t epoch,
+                       uint32_t attempt,
+                       int64_t from_ns,
+                       int64_t to_ns,
+                       uint64_t cursor,
+                       int64_t *start_epoch_ns,
+                       runlog_visit_fn visit,
+                       void *arg);
+
+int runlog_remove_task(const char *task_dir);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ERRAID_RUNLOG_H */
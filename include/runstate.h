@@ -0,0 +1,86 @@
+#ifndef ERRAID_RUNSTATE_H
+#define ERRAID_RUNSTATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * État d'exécution des tâches : state/runstate.bin, projeté en mémoire.
+ *
+ * En-tête runstate_header_t puis `capacity` emplacements fixes runstate_slot_t.
+ * Un emplacement dont task_id vaut 0 est libre. Les champs sont modifiés en
+ * place ; seule la politique de synchronisation décide quand les pages sont
+ * forcées sur disque. La définition de la tâche (catalogue) n'est plus réécrite
+ * après une exécution.
+ */
+
+#define RUNSTATE_MAGIC "ERRS"
+#define RUNSTATE_VERSION 1
+#define RUNSTATE_FILE_NAME "runstate.bin"
+#define RUNSTATE_INITIAL_SLOTS 256
+#define RUNSTATE_DEFAULT_SYNC_MS 1000
+
+typedef enum {
+    RUNSTATE_SYNC_NONE = 0,     /* écriture laissée au noyau */
+    RUNSTATE_SYNC_INTERVAL = 1, /* msync au plus tard sync_interval_ms après la première modification */
+    RUNSTATE_SYNC_ALWAYS = 2,   /* msync à chaque validation */
+} runstate_sync_t;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t slot_size;
+    uint32_t capacity;
+    uint64_t reserved[6];
+} runstate_header_t;
+
+typedef struct {
+    uint64_t task_id;          /* 0 : emplacement libre */
+    int64_t last_run_epoch;    /* -1 : jamais exécutée */
+    int64_t next_epoch;        /* prochaine occurrence planifiée, -1 : aucune */
+    uint64_t runs;             /* exécutions terminées */
+    uint64_t failures;         /* dont code de retour non nul */
+    int32_t last_status;
+    uint32_t reserved0;
+    uint64_t reserved[2];
+} runstate_slot_t;
+
+typedef struct {
+    int fd;
+    void *map;
+    size_t map_length;
+    uint32_t capacity;
+    uint32_t free_hint;        /* premier emplacement possiblement libre */
+    runstate_sync_t sync;
+    int64_t sync_interval_ms;
+    bool dirty;
+    int64_t sync_due_ms;       /* échéance du msync en mode intervalle, -1 : aucune */
+} runstate_t;
+
+int runstate_open(runstate_t *state, const char *state_dir, runstate_sync_t sync, int64_t sync_interval_ms);
+
+/* Pointeur valable jusqu'au prochain runstate_allocate (la projection peut être déplacée). */
+runstate_slot_t *runstate_slot(runstate_t *state, uint32_t index);
+
+/* Réserve un emplacement libre pour task_id, en agrandissant le fichier si besoin. */
+int runstate_allocate(runstate_t *state, uint64_t task_id, uint32_t *index_out);
+
+void runstate_release(runstate_t *state, uint32_t index);
+
+/* À appeler après une série de modifications : applique la politique de synchronisation. */
+void runstate_commit(runstate_t *state, int64_t now_ms);
+
+int runstate_sync(runstate_t *state);
+
+void runstate_close(runstate_t *state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ERRAID_RUNSTATE_H */
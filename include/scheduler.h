@@ -15,6 +15,31 @@ typedef struct {
     int64_t next_epoch; /* -1 si aucune occurrence trouvée */
 } schedule_entry_t;
 
+typedef enum {
+    SCHED_TIMER_RUN = 0,     /* occurrence planifiée, cookie = index dans le plan */
+    SCHED_TIMER_TIMEOUT = 1, /* délai d'exécution écoulé, cookie = identifiant d'exécution */
+    SCHED_TIMER_KILL = 2,    /* fin du délai de grâce, cookie = identifiant d'exécution */
+    SCHED_TIMER_RETRY = 3,   /* nouvelle tentative après échec, cookie = task_t.retry_token */
+    SCHED_TIMER_ADMIT = 4,   /* réévaluation d'une occurrence différée, cookie = task_t.defer_token */
+    SCHED_TIMER_PREARM = 5,  /* préparation du lancement avant l'échéance, cookie = index dans le plan */
+    SCHED_TIMER_WATCH = 6,   /* fin de l'anti-rebond d'une tâche surveillée, cookie = task_t.watch_token */
+} scheduler_timer_kind_t;
+
+/* Les entrées ne sont jamais retirées au cas par cas : elles sont revalidées au déclenchement. */
+typedef struct {
+    int64_t due_ms; /* CLOCK_REALTIME, en millisecondes */
+    uint64_t task_id;
+    uint64_t cookie;
+    scheduler_timer_kind_t kind;
+} scheduler_timer_t;
+
+/* Tas binaire minimal ordonné par due_ms. */
+typedef struct {
+    scheduler_timer_t *items;
+    size_t count;
+    size_t capacity;
+} scheduler_queue_t;
+
 int64_t scheduler_next_occurrence(const schedule_t *schedule, int64_t from_epoch);
 
 int scheduler_compute_plan(const task_t *tasks,
@@ -23,6 +48,16 @@ int scheduler_compute_plan(const task_t *tasks,
                            schedule_entry_t *entries,
                            size_t entry_capacity);
 
+int scheduler_queue_push(scheduler_queue_t *queue, const scheduler_timer_t *timer);
+
+const scheduler_timer_t *scheduler_queue_peek(const scheduler_queue_t *queue);
+
+int scheduler_queue_pop(scheduler_queue_t *queue, scheduler_timer_t *out);
+
+void scheduler_queue_remove_kind(scheduler_queue_t *queue, scheduler_timer_kind_t kind);
+
+void scheduler_queue_free(scheduler_queue_t *queue);
+
 #ifdef __cplusplus
 }
 #endif
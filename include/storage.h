@@ -2,29 +2,109 @@
 #define ERRAID_STORAGE_H
 
 #include "common.h"
+#include "history.h"
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Synchronisation des écritures d'historique (last.stdout, last.stderr, history.bin). */
+typedef enum {
+    STORAGE_DURABILITY_STRICT = 0, /* fsync de chaque fichier à chaque exécution */
+    STORAGE_DURABILITY_GROUP = 1,  /* aucun fsync : storage_sync_logs couvre un lot d'exécutions */
+    STORAGE_DURABILITY_ASYNC = 2,  /* écriture laissée au noyau */
+} storage_durability_t;
+
+/*
+ * Emplacement des journaux d'une tâche sous logs/. Plate par défaut :
+ * logs/<ID>/. Répartie après storage_migrate_layout (erraid -M), signalée par
+ * logs/layout : logs/<AA>/<BB>/<ID>/ (AA, BB : deux octets de l'identifiant
+ * mélangé, en hexadécimal), des répertoires de quelques entrées quel que soit
+ * le nombre de tâches. bench/logs_layout compare les deux.
+ */
+typedef enum {
+    STORAGE_LAYOUT_FLAT = 0,
+    STORAGE_LAYOUT_SHARDED = 1,
+} storage_layout_t;
+
+#define STORAGE_LAYOUT_FILE "layout"
+#define STORAGE_LAYOUT_PENDING_SUFFIX ".flat" /* <logs>.flat : migration en cours */
+
+/*
+ * Répertoires maintenus ouverts : tasks/, logs/ et, dans un cache LRU, les
+ * répertoires de journaux des tâches récemment lues ou écrites. Les fichiers y
+ * sont ouverts, renommés et supprimés par openat, renameat, unlinkat et fstatat
+ * relativement à ces descripteurs, sans reconstruire ni résoudre de chemin
+ * complet. Un cache n'appartient qu'à un fil : la boucle du démon et le fil de
+ * persistance ont chacun le leur. À ouvrir après storage_load_layout.
+ */
+#define STORAGE_DIR_CACHE_SIZE 64
+
+typedef struct {
+    uint64_t task_id;
+    int fd;             /* -1 : entrée libre */
+    uint64_t last_used; /* horloge du cache au dernier accès */
+} storage_dir_entry_t;
+
+typedef struct {
+    int tasks_fd;
+    int logs_fd;
+    uint64_t clock;
+    storage_dir_entry_t entries[STORAGE_DIR_CACHE_SIZE];
+} storage_dirs_t;
+
 typedef struct {
     const char *root_dir;
     const char *tasks_dir;
     const char *logs_dir;
     const char *state_dir;
     const char *pipes_dir;
+    storage_durability_t durability; /* STRICT par défaut (structure mise à zéro) */
+    storage_layout_t layout;         /* fixé par storage_load_layout */
+    storage_dirs_t *dirs;            /* NULL : répertoires ouverts le temps de chaque appel */
 } storage_paths_t;
 
+/* Rétention de l'historique d'une tâche ; 0 : sans limite. */
+typedef struct {
+    uint32_t max_age_seconds;
+    uint32_t max_entries;
+} storage_retention_t;
+
 int storage_init_directories(const storage_paths_t *paths);
 
+/* Descripteurs à -1 : storage_dirs_close peut être appelé sans ouverture préalable. */
+void storage_dirs_init(storage_dirs_t *dirs);
+
+int storage_dirs_open(storage_dirs_t *dirs, const storage_paths_t *paths);
+
+void storage_dirs_close(storage_dirs_t *dirs);
+
+/* Ferme le répertoire de journaux de la tâche s'il est dans le cache (tâche supprimée). */
+void storage_dirs_forget(storage_dirs_t *dirs, uint64_t task_id);
+
+/* Détermine paths->layout d'après logs/layout ; une migration interrompue est d'abord terminée. */
+int storage_load_layout(storage_paths_t *paths);
+
+/* Déplace logs/<ID>/ vers l'arborescence répartie ; moved_out : tâches déplacées. Démon arrêté. */
+int storage_migrate_layout(storage_paths_t *paths, size_t *moved_out);
+
+/* Répertoire de journaux de la tâche ; create : créé avec ses parents. */
+int storage_task_log_dir(const storage_paths_t *paths, uint64_t task_id, bool create, char *buffer, size_t buflen);
+
+/* Format texte tasks_dir/<ID>.task : chemin d'import/export du catalogue (catalog.h). */
 int storage_load_tasks(const storage_paths_t *paths, task_t **tasks_out, size_t *count_out);
 
 int storage_write_task(const storage_paths_t *paths, const task_t *task);
 
+/* Supprime le fichier .task puis les journaux (storage_remove_task_logs). */
 int storage_remove_task(const storage_paths_t *paths, uint64_t task_id);
 
+/* Historique, dernières sorties et journaux horodatés d'une tâche. */
+int storage_remove_task_logs(const storage_paths_t *paths, uint64_t task_id);
+
 int storage_append_history(const storage_paths_t *paths,
                            uint64_t task_id,
                            const task_run_entry_t *entry,
@@ -33,20 +113,71 @@ int storage_append_history(const storage_paths_t *paths,
                            const void *stderr_buf,
                            size_t stderr_len);
 
+/* Ajoute une ligne d'historique sans toucher à last.stdout/last.stderr (occurrence non exécutée). */
+int storage_append_history_entry(const storage_paths_t *paths, uint64_t task_id, const task_run_entry_t *entry);
+
+/* Un seul syncfs pour toutes les écritures de logs_dir non synchronisées (validation groupée). */
+int storage_sync_logs(const storage_paths_t *paths);
+
+/* Vue projetée de logs/<ID>/history.bin, convertie depuis history.log au besoin. */
+int storage_open_history(const storage_paths_t *paths, uint64_t task_id, history_view_t *view);
+
+/* Applique la rétention (history_compact) ; dropped_out : enregistrements agrégés dans rollup.bin. */
+int storage_compact_history(const storage_paths_t *paths,
+                            uint64_t task_id,
+                            const storage_retention_t *retention,
+                            size_t *dropped_out);
+
+/* Agrégats de logs/<ID>/rollup.bin, par période croissante. À libérer avec free. */
+int storage_load_rollups(const storage_paths_t *paths,
+                         uint64_t task_id,
+                         history_rollup_t **rollups_out,
+                         size_t *count_out);
+
 int storage_load_history(const storage_paths_t *paths,
                          uint64_t task_id,
                          task_run_entry_t **entries_out,
                          size_t *entry_count_out);
 
-int storage_load_last_stdio(const storage_paths_t *paths,
-                            uint64_t task_id,
-                            void **stdout_buf,
-                            size_t *stdout_len,
-                            void **stderr_buf,
-                            size_t *stderr_len);
+/* Sortie conservée : par epoch d'exécution, ou index 0 (last.<flux>) à 5 (la plus ancienne). */
+typedef struct {
+    bool by_epoch;
+    int64_t epoch;
+    uint32_t index;
+} storage_stdio_select_t;
+
+typedef struct {
+    int64_t epoch;    /* exécution ayant produit la sortie, 0 si inconnue */
+    uint64_t total;   /* taille du fichier */
+    uint64_t offset;
+    size_t length;    /* octets lus à partir de offset */
+} storage_stdio_range_t;
+
+/*
+ * Lit au plus capacity octets d'un seul flux à partir de offset (pread, sans
+ * charger le fichier). ENOENT : exécution non conservée ; index 0 sans
+ * exécution : sortie vide.
+ */
+int storage_read_stdio(const storage_paths_t *paths,
+                       uint64_t task_id,
+                       bool stdout_stream,
+                       const storage_stdio_select_t *select,
+                       uint64_t offset,
+                       void *buffer,
+                       size_t capacity,
+                       storage_stdio_range_t *range);
 
 int storage_allocate_task_id(const storage_paths_t *paths, uint64_t *task_id_out);
 
+/* Lit le prochain identifiant sans le consommer. */
+int storage_load_next_task_id(const storage_paths_t *paths, uint64_t *next_id_out);
+
+/* Garantit que les prochains identifiants alloués seront au moins next_id (import). */
+int storage_reserve_task_ids(const storage_paths_t *paths, uint64_t next_id);
+
+/* Libère le contenu d'une tâche, pas la structure elle-même. */
+void storage_free_task(task_t *task);
+
 void storage_free_tasks(task_t *tasks, size_t count);
 
 #ifdef __cplusplus
@@ -34,13 +34,34 @@ typedef struct {
     bool opt_history;
     bool opt_stdout;
     bool opt_stderr;
+    bool opt_stats;
+    bool opt_records;
+    bool has_records_epoch;
+    bool has_records_attempt;
+    bool has_records_from;
+    bool has_records_to;
+    bool has_history_before;
+    bool has_history_after;
+    bool history_rollups;      /* -R : agrégats de rollup.bin au lieu des exécutions */
+    bool has_stdio_index;
     bool has_schedule;
     char minutes[32];
     char hours[16];
     char weekdays[16];
     uint64_t task_id;
+    uint64_t records_epoch;    /* -E (-L, -o, -e) */
+    uint64_t records_attempt;  /* -A */
+    uint64_t records_from_ms;  /* -W FROM:TO, relatif au lancement */
+    uint64_t records_to_ms;
+    uint64_t records_cursor;   /* -C, champ "next" de la réponse précédente (-L, -x, -o, -e) */
+    uint64_t history_limit;    /* -N, 0 : autant que la réponse peut contenir ; octets pour -o/-e */
+    uint64_t stdio_index;      /* -I, sortie précédente de rang N (-o, -e) */
+    uint64_t history_before;   /* -B */
+    uint64_t history_after;    /* -F */
     command_t *commands;
     size_t command_count;
+    const char *task_options[ERRAID_MAX_TASK_OPTIONS]; /* "clé=valeur" (-O) */
+    size_t task_option_count;
     const char *pipes_dir_arg;
 } tadmor_options_t;
 
@@ -0,0 +1,29 @@
+#ifndef ERRAID_TASKOPT_H
+#define ERRAID_TASKOPT_H
+
+#include "common.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Options de tâche « clé=valeur » partagées entre le fichier .task et le protocole. */
+
+int taskopt_set(task_t *task, const char *key, const char *value);
+
+int taskopt_set_line(task_t *task, const char *line);
+
+int taskopt_format(const task_t *task, char *buffer, size_t buflen, size_t *length_out);
+
+const char *taskopt_limit_name(uint32_t limit_flag);
+
+/* Durée en secondes, suffixe optionnel s, m, h ou d (history.max_age, erraid -k). */
+int taskopt_parse_age(const char *value, uint32_t *seconds_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ERRAID_TASKOPT_H */
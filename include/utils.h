@@ -27,6 +27,16 @@ int utils_parse_int64(const char *str, int64_t *out);
 
 int utils_now_epoch(int64_t *out_epoch);
 
+int utils_now_epoch_ms(int64_t *out_ms);
+
+int utils_now_monotonic_ns(int64_t *out_ns);
+
+/* CRC-32 incrémental : passer 0 au premier appel, puis le résultat précédent. */
+uint32_t utils_crc32(uint32_t crc, const void *data, size_t length);
+
+/* Empreinte FNV-1a 64 bits du contenu (identité des sorties, pas d'usage cryptographique). */
+uint64_t utils_hash64(const void *data, size_t length);
+
 #ifdef __cplusplus
 }
 #endif
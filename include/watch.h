@@ -0,0 +1,34 @@
+#ifndef ERRAID_WATCH_H
+#define ERRAID_WATCH_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Un lot accumule des événements au plus ce multiple du délai d'anti-rebond. */
+#define ERRAID_WATCH_BATCH_FACTOR 10
+
+/* wd vaut -1 pour un débordement de la file du noyau (tous les chemins sont concernés). */
+typedef void (*watch_event_fn)(int wd, uint32_t events, void *arg);
+
+/* Descripteur inotify non bloquant, surveillé par la boucle principale. */
+int watch_open(void);
+
+/* Retourne le descripteur de surveillance (partagé si le chemin est déjà surveillé). */
+int watch_add(int fd, const char *path);
+
+void watch_remove(int fd, int wd);
+
+/*
+ * Vide la file d'événements. events est une combinaison de TASK_WATCH_* ;
+ * 0 signale que la surveillance a disparu (chemin supprimé ou démonté).
+ */
+int watch_read(int fd, watch_event_fn callback, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ERRAID_WATCH_H */
@@ -25,11 +25,40 @@ if [ ! -x "$tadmor_bin" ]; then
     exit 1
 fi
 
+# Répertoire de journaux d'une tâche : logs/<AA>/<BB>/<ID> (ou logs/<ID>, arborescence plate)
+task_log_dir() {
+    find "$rundir/logs" -mindepth 1 -maxdepth 3 -type d -name "$1" | head -n 1
+}
+
+fail() {
+    echo "[e2e][ERREUR] $*" >&2
+    exit 1
+}
+
+# Identifiant renvoyé par une création : {"status":"OK","task_id":N}
+task_id_of() {
+    sed -n 's/.*"task_id":\([0-9][0-9]*\).*/\1/p' | head -n 1
+}
+
+# Tâche simple déclenchée par un fichier créé dans $1 ; les arguments suivants (options, commande) vont à tadmor -c.
+create_watched() {
+    watch="$1"
+    shift
+    mkdir -p "$watch"
+    "$tadmor_bin" -p "$pipes_dir" -c -m "$minutes_mask" -H "$hours_mask" -w "$weekdays_mask" \
+        -O watch.path="$watch" -O watch.debounce=100 "$@" | task_id_of
+}
+
+# Tâches des sections par fonctionnalité, supprimées avant l'arrêt final.
+extra_task_ids=""
+
 cleanup() {
-    if [ "${daemon_pid-}" != "" ]; then
-        kill "$daemon_pid" 2>/dev/null || true
-        wait "$daemon_pid" 2>/dev/null || true
-    fi
+    for pid in "${daemon_pid-}" "${prearm_pid-}"; do
+        if [ "$pid" != "" ]; then
+            kill "$pid" 2>/dev/null || true
+            wait "$pid" 2>/dev/null || true
+        fi
+    done
 }
 trap cleanup EXIT
 
@@ -38,7 +67,9 @@ if [ -d "$rundir" ]; then
     rm -rf "$rundir"
 fi
 
-mkdir -p "$rundir"
+# Les tâches surveillent watch_dir : un fichier créé les déclenche sans attendre leur minute.
+watch_dir="$rundir/watch"
+mkdir -p "$rundir" "$watch_dir"
 "$erraid_bin" -r "$rundir" &
 daemon_pid=$!
 
@@ -48,16 +79,35 @@ minutes_mask="0FFFFFFFFFFFFFF"
 hours_mask="00000F"
 weekdays_mask="7F"
 
+# Pré-armement : second démon, avance de 60 s, tâche de chaque minute (y compris 56 à 59,
+# absentes de minutes_mask). Il a toujours un fils armé ; vérifié à la fin du script,
+# une fois passée la minute suivante.
+prearm_dir="$rundir/prearm"
+mkdir -p "$prearm_dir"
+"$erraid_bin" -r "$prearm_dir" -a 60000 &
+prearm_pid=$!
+sleep 1
+prearm_task_id="$("$tadmor_bin" -p "$prearm_dir/pipes" -c -m FFFFFFFFFFFFFFF -H FFFFFF -w "$weekdays_mask" \
+    /bin/echo armed | task_id_of)"
+[ -n "$prearm_task_id" ] || fail "création de la tâche pré-armée"
+
 echo "[e2e] création tâche simple"
-create_simple_output="$("$tadmor_bin" -p "$pipes_dir" -c -m "$minutes_mask" -H "$hours_mask" -w "$weekdays_mask" /bin/echo "hello end-to-end")"
+create_simple_output="$("$tadmor_bin" -p "$pipes_dir" -c -m "$minutes_mask" -H "$hours_mask" -w "$weekdays_mask" \
+    -O watch.path="$watch_dir" -O watch.debounce=100 /bin/echo "hello end-to-end")"
 echo "$create_simple_output"
-simple_task_id="$(echo "$create_simple_output" | awk -F':' '/task_id/ {gsub(/[^0-9]/, "", $2); print $2}')"
+simple_task_id="$(echo "$create_simple_output" | task_id_of)"
 
 echo "[e2e] création tâche séquentielle"
-create_sequence_output="$("$tadmor_bin" -p "$pipes_dir" -s -m "$minutes_mask" -H "$hours_mask" -w "$weekdays_mask" /bin/echo "first" -- /bin/sh -c "echo second" )"
+create_sequence_output="$("$tadmor_bin" -p "$pipes_dir" -s -m "$minutes_mask" -H "$hours_mask" -w "$weekdays_mask" \
+    -O watch.path="$watch_dir" -O watch.debounce=100 /bin/echo "first" -- /bin/sh -c "echo second" )"
 echo "$create_sequence_output"
-sequence_task_id="$(echo "$create_sequence_output" | awk -F':' '/task_id/ {gsub(/[^0-9]/, "", $2); print $2}')"
+sequence_task_id="$(echo "$create_sequence_output" | task_id_of)"
+
+[ -n "$simple_task_id" ] || fail "création de la tâche simple"
+[ -n "$sequence_task_id" ] || fail "création de la tâche séquentielle"
 
+echo "[e2e] déclenchement des deux tâches"
+touch "$watch_dir/trigger"
 sleep 2
 
 echo "[e2e] liste des tâches"
@@ -65,15 +115,24 @@ echo "[e2e] liste des tâches"
 
 if [ -n "$simple_task_id" ]; then
     echo "[e2e] récupération stdout/stderr tâche simple"
-    "$tadmor_bin" -p "$pipes_dir" -o "$simple_task_id" || true
+    stdout_simple="$("$tadmor_bin" -p "$pipes_dir" -o "$simple_task_id")" || fail "stdout de la tâche $simple_task_id"
+    echo "$stdout_simple"
+    echo "$stdout_simple" | grep -q "hello end-to-end" || fail "-o ne renvoie pas la sortie attendue"
     "$tadmor_bin" -p "$pipes_dir" -e "$simple_task_id" || true
     echo "[e2e] historique tâche simple"
-    "$tadmor_bin" -p "$pipes_dir" -x "$simple_task_id" || true
+    history_simple="$("$tadmor_bin" -p "$pipes_dir" -x "$simple_task_id")" || fail "historique de la tâche $simple_task_id"
+    echo "$history_simple"
+    # echo "hello end-to-end" : statut 0, 17 octets sur stdout, exécution complète
+    echo "$history_simple" | grep -q '"status":0,"stdout_len":17,"stderr_len":0' ||
+        fail "l'historique ne contient pas l'exécution attendue"
+    echo "$history_simple" | grep -q '"outcome":"COMPLETED","attempt":1' ||
+        fail "l'exécution de la tâche simple n'est pas COMPLETED"
 
-    log_dir_simple="$rundir/logs/$simple_task_id"
+    log_dir_simple="$(task_log_dir "$simple_task_id")"
+    [ -n "$log_dir_simple" ] || fail "répertoire de journaux introuvable pour tâche $simple_task_id"
     stdout_file="$log_dir_simple/last.stdout"
     stderr_file="$log_dir_simple/last.stderr"
-    history_file="$log_dir_simple/history.log"
+    history_file="$log_dir_simple/history.bin"
 
     if [ ! -f "$stdout_file" ]; then
         echo "[e2e][ERREUR] stdout introuvable pour tâche $simple_task_id" >&2
@@ -84,25 +143,310 @@ if [ -n "$simple_task_id" ]; then
         exit 1
     fi
     if [ ! -f "$history_file" ]; then
-        echo "[e2e][ERREUR] history.log introuvable pour tâche $simple_task_id" >&2
-        exit 1
-    fi
-    if ! grep -q "hello" "$history_file"; then
-        echo "[e2e][ERREUR] history.log ne contient pas l'entrée attendue" >&2
+        echo "[e2e][ERREUR] history.bin introuvable pour tâche $simple_task_id" >&2
         exit 1
     fi
 fi
 
+# Arborescence répartie : migration hors ligne, puis mêmes exécutions relues par le démon.
+echo "[e2e] répartition de logs/ (erraid -M)"
+"$tadmor_bin" -p "$pipes_dir" -q
+wait "$daemon_pid" || true
+daemon_pid=""
+"$erraid_bin" -r "$rundir" -M || fail "migration de logs/"
+for task_id in "$simple_task_id" "$sequence_task_id"; do
+    case "$(task_log_dir "$task_id")" in
+        "$rundir"/logs/??/??/"$task_id") ;;
+        *) fail "tâche $task_id absente de logs/<AA>/<BB>/ après la migration" ;;
+    esac
+done
+"$erraid_bin" -r "$rundir" &
+daemon_pid=$!
+sleep 1
+"$tadmor_bin" -p "$pipes_dir" -x "$simple_task_id" | grep -q '"status":0,"stdout_len":17,"stderr_len":0' ||
+    fail "historique de la tâche simple perdu par la migration"
+"$tadmor_bin" -p "$pipes_dir" -o "$simple_task_id" | grep -q "hello end-to-end" ||
+    fail "stdout de la tâche simple perdu par la migration"
+
+# Sorties conservées : trois exécutions numérotées, relues par epoch (-E), par rang (-I)
+# et page par page (-N, -C), puis comparées à la sortie attendue.
+echo "[e2e] sorties conservées par epoch, rang et plage (-E, -I, -N, -C)"
+echo 0 > "$rundir/stdio.count"
+stdio_task_id="$(create_watched "$rundir/watch-stdio" \
+    /bin/sh -c 'n=$(($(cat "$0") + 1)); echo $n > "$0"; echo "run $n"; seq 5000' "$rundir/stdio.count")"
+[ -n "$stdio_task_id" ] || fail "création de la tâche à sorties numérotées"
+extra_task_ids="$extra_task_ids $stdio_task_id"
+for run in 1 2 3; do
+    touch "$rundir/watch-stdio/$run"
+    sleep 1.1
+done
+first_line() {
+    "$tadmor_bin" -p "$pipes_dir" -o "$stdio_task_id" -N 16 "$@" | sed -n 2p
+}
+set -- $("$tadmor_bin" -p "$pipes_dir" -x "$stdio_task_id" | grep -o '"epoch":[0-9]*' | cut -d: -f2)
+[ $# -eq 3 ] || fail "trois exécutions attendues"
+[ "$(first_line)" = "run 3" ] || fail "-o : dernière sortie attendue"
+[ "$(first_line -I 1)" = "run 2" ] || fail "-I 1 : sortie précédente attendue"
+[ "$(first_line -I 2)" = "run 1" ] || fail "-I 2 : avant-dernière sortie précédente attendue"
+[ "$(first_line -E "$3")" = "run 1" ] || fail "-E $3 : sortie de la première exécution attendue"
+[ "$(first_line -E "$2")" = "run 2" ] || fail "-E $2 : sortie de la deuxième exécution attendue"
+{ echo "run 2"; seq 5000; } > "$rundir/stdio.expected"
+: > "$rundir/stdio.pages"
+cursor=0
+pages=0
+for _ in $(seq 20); do
+    # Fichier plutôt que variable : la page garde ses octets exacts, sans fin de ligne ajoutée.
+    "$tadmor_bin" -p "$pipes_dir" -o "$stdio_task_id" -E "$2" -N 2000 -C "$cursor" > "$rundir/stdio.page" ||
+        fail "page de la sortie"
+    sed 1d "$rundir/stdio.page" >> "$rundir/stdio.pages"
+    pages=$((pages + 1))
+    cursor="$(sed -n '1s/.*"next":\([0-9][0-9]*\).*/\1/p' "$rundir/stdio.page")"
+    [ "$cursor" != 0 ] || break
+done
+[ "$pages" -eq 12 ] || fail "douze pages de 2000 octets attendues, $pages lues"
+cmp -s "$rundir/stdio.expected" "$rundir/stdio.pages" || fail "sortie reconstituée par pages différente"
+
+# Blobs partagés : deux sorties identiques sont deux liens d'un même blob ; six sorties
+# différentes ensuite font sortir la première de last.stdout et des cinq emplacements,
+# et son blob disparaît avec sa dernière référence.
+echo "[e2e] sorties identiques partagées (blobs/)"
+echo same > "$rundir/blob.src"
+blob_task_id="$(create_watched "$rundir/watch-blob" /bin/cat "$rundir/blob.src")"
+[ -n "$blob_task_id" ] || fail "création de la tâche à sortie fixe"
+extra_task_ids="$extra_task_ids $blob_task_id"
+for run in 1 2; do
+    touch "$rundir/watch-blob/$run"
+    sleep 1.1
+done
+blob_dir="$(task_log_dir "$blob_task_id")/blobs"
+set -- "$blob_dir"/*
+[ $# -eq 1 ] && [ -f "$1" ] || fail "un seul blob attendu pour deux sorties identiques"
+first_blob="$1"
+# Le blob, last.stdout et last.stdout.0
+[ "$(stat -c %h "$first_blob")" -eq 3 ] || fail "sortie identique non partagée : $(stat -c %h "$first_blob") liens"
+echo other > "$rundir/blob.src"
+for run in 3 4 5 6 7 8; do
+    touch "$rundir/watch-blob/$run"
+    sleep 1.1
+done
+[ ! -e "$first_blob" ] || fail "blob encore présent après la rotation de sa dernière référence"
+set -- "$blob_dir"/*
+[ $# -eq 1 ] && [ -f "$1" ] || fail "un seul blob attendu après la rotation"
+# Le blob, last.stdout et les cinq emplacements
+[ "$(stat -c %h "$1")" -eq 7 ] || fail "sortie répétée non partagée : $(stat -c %h "$1") liens"
+"$tadmor_bin" -p "$pipes_dir" -o "$blob_task_id" -I 5 | sed -n 2p | grep -qx other || fail "-I 5 : sortie attendue 'other'"
+
+# Limites : limit.cpu atteinte (SIGXCPU) signalée dans limits_hit ; limit.nofile et nice appliqués au fils.
+echo "[e2e] limites de ressources (limit.*, nice)"
+cpu_task_id="$(create_watched "$rundir/watch-limits" -O limit.cpu=1 /bin/sh -c 'while :; do :; done')"
+rlimit_task_id="$(create_watched "$rundir/watch-limits" -O limit.nofile=17 -O nice=7 /bin/sh -c 'ulimit -n; nice')"
+[ -n "$cpu_task_id" ] && [ -n "$rlimit_task_id" ] || fail "création des tâches limitées"
+extra_task_ids="$extra_task_ids $cpu_task_id $rlimit_task_id"
+touch "$rundir/watch-limits/trigger"
+sleep 3
+history_cpu="$("$tadmor_bin" -p "$pipes_dir" -x "$cpu_task_id")" || fail "historique de la tâche $cpu_task_id"
+echo "$history_cpu"
+echo "$history_cpu" | grep -q '"limits_hit":\["cpu"\]' || fail "limit.cpu atteinte mais absente de limits_hit"
+[ "$("$tadmor_bin" -p "$pipes_dir" -o "$rlimit_task_id" | tail -n 2 | tr '\n' ' ')" = "17 7 " ] ||
+    fail "limit.nofile=17 ou nice=7 non appliqué"
+
+# Délai dépassé : SIGTERM au groupe, ignoré ici (ainsi que par le sleep lancé en arrière-plan),
+# puis SIGKILL au groupe après timeout.grace ; résultat TIMEOUT et plus aucun processus du groupe.
+echo "[e2e] délai d'exécution (timeout, timeout.grace)"
+timeout_task_id="$(create_watched "$rundir/watch-timeout" -O timeout=1 -O timeout.grace=1 \
+    /bin/sh -c "trap '' TERM; sleep 30 & echo \$! > '$rundir/timeout.pid'; wait")"
+[ -n "$timeout_task_id" ] || fail "création de la tâche timeout"
+extra_task_ids="$extra_task_ids $timeout_task_id"
+touch "$rundir/watch-timeout/trigger"
+sleep 3.5
+history_timeout="$("$tadmor_bin" -p "$pipes_dir" -x "$timeout_task_id")" || fail "historique de la tâche $timeout_task_id"
+echo "$history_timeout"
+echo "$history_timeout" | grep -q '"outcome":"TIMEOUT"' || fail "exécution trop longue non enregistrée TIMEOUT"
+orphan_pid="$(cat "$rundir/timeout.pid")"
+# Un zombie sans parent pour le récolter ne compte pas : seul un état autre que Z est vivant.
+if [ -e "/proc/$orphan_pid/stat" ] && ! grep -q '^[0-9]* ([^)]*) Z' "/proc/$orphan_pid/stat"; then
+    fail "le sleep du groupe ($orphan_pid) a survécu au délai"
+fi
+
+# overlap=skip : une occurrence arrivée pendant l'exécution est enregistrée SKIPPED, sans lancement.
+echo "[e2e] chevauchement (overlap=skip)"
+skip_task_id="$(create_watched "$rundir/watch-skip" -O overlap=skip /bin/sleep 3)"
+[ -n "$skip_task_id" ] || fail "création de la tâche overlap=skip"
+extra_task_ids="$extra_task_ids $skip_task_id"
+touch "$rundir/watch-skip/first"
+sleep 1
+touch "$rundir/watch-skip/second"
+sleep 3
+history_skip="$("$tadmor_bin" -p "$pipes_dir" -x "$skip_task_id")" || fail "historique de la tâche $skip_task_id"
+echo "$history_skip"
+echo "$history_skip" | grep -q '"outcome":"SKIPPED"' || fail "overlap=skip : deuxième occurrence non ignorée"
+[ "$(echo "$history_skip" | grep -o '"outcome":"COMPLETED"' | wc -l)" -eq 1 ] ||
+    fail "overlap=skip : deux exécutions simultanées"
+
+# Nouvelles tentatives : /bin/false, délai 1 s doublé à chaque échec, ± 25 %.
+echo "[e2e] nouvelles tentatives (retry.*)"
+retry_task_id="$(create_watched "$rundir/watch-retry" -O retry.max=2 -O retry.delay=1 -O retry.jitter=25 /bin/false)"
+[ -n "$retry_task_id" ] || fail "création de la tâche retry"
+extra_task_ids="$extra_task_ids $retry_task_id"
+touch "$rundir/watch-retry/trigger"
+sleep 5
+history_retry="$("$tadmor_bin" -p "$pipes_dir" -x "$retry_task_id")" || fail "historique de la tâche $retry_task_id"
+echo "$history_retry"
+[ "$(echo "$history_retry" | grep -o '"attempt":[0-9]*' | tr '\n' ' ')" = '"attempt":3 "attempt":2 "attempt":1 ' ] ||
+    fail "tentatives attendues : 1, 2 puis 3"
+[ "$(echo "$history_retry" | grep -o '"status":1,' | wc -l)" -eq 3 ] || fail "une tentative n'a pas échoué"
+# start_ns, de la plus récente à la plus ancienne : écarts d'environ 1 s puis 2 s
+set -- $(echo "$history_retry" | grep -o '"start_ns":[0-9]*' | cut -d: -f2)
+[ $# -eq 3 ] || fail "start_ns manquants dans l'historique des tentatives"
+first_delay_ms=$((($2 - $3) / 1000000))
+second_delay_ms=$((($1 - $2) / 1000000))
+[ "$first_delay_ms" -ge 750 ] && [ "$first_delay_ms" -le 1500 ] ||
+    fail "premier délai hors de 1 s ± 25 % : $first_delay_ms ms"
+[ "$second_delay_ms" -ge 1500 ] && [ "$second_delay_ms" -le 2750 ] ||
+    fail "second délai hors de 2 s ± 25 % : $second_delay_ms ms"
+
+# Journal horodaté : 2000 lignes, une pause d'une seconde puis une ligne sur chaque flux.
+echo "[e2e] journal horodaté par fenêtre (capture=lines, -L, -W, -C)"
+lines_task_id="$(create_watched "$rundir/watch-lines" -O capture=lines \
+    /bin/sh -c 'seq 2000; sleep 1; echo late; echo oops >&2')"
+[ -n "$lines_task_id" ] || fail "création de la tâche capture=lines"
+extra_task_ids="$extra_task_ids $lines_task_id"
+touch "$rundir/watch-lines/trigger"
+sleep 2
+late_page="$("$tadmor_bin" -p "$pipes_dir" -L "$lines_task_id" -W 500:)" || fail "fenêtre 500 ms et au-delà"
+echo "$late_page"
+# "late\n" sur stdout, "oops\n" sur stderr, et rien d'autre.
+[ "$(echo "$late_page" | grep -o '"t_us"' | wc -l)" -eq 2 ] || fail "fenêtre tardive : deux enregistrements attendus"
+echo "$late_page" | grep -q '"stream":"stdout","data":"bGF0ZQo="' || fail "ligne 'late' absente de la fenêtre"
+echo "$late_page" | grep -q '"stream":"stderr","data":"b29wcwo="' || fail "ligne 'oops' absente de la fenêtre"
+# Début de l'exécution : plusieurs pages, reprises au curseur, sans perte ni répétition.
+early_records=0
+cursor=0
+for _ in $(seq 50); do
+    page="$("$tadmor_bin" -p "$pipes_dir" -L "$lines_task_id" -W :500 -C "$cursor")" || fail "fenêtre des 500 premières ms"
+    [ "$cursor" != 0 ] || echo "$page" | grep -q '"records":\[{"t_us":[0-9]*,"stream":"stdout","data":"MQo="}' ||
+        fail "la première page ne commence pas par la ligne 1"
+    echo "$page" | grep -q 'bGF0ZQo=' && fail "ligne tardive dans la fenêtre des 500 premières ms"
+    early_records=$((early_records + $(echo "$page" | grep -o '"t_us"' | wc -l)))
+    cursor="$(echo "$page" | sed -n 's/.*"next":\([0-9][0-9]*\).*/\1/p')"
+    [ "$cursor" != 0 ] || break
+done
+[ "$early_records" -eq 2000 ] || fail "2000 lignes attendues dans la fenêtre, $early_records lues"
+
+# Admission : deux boucles actives par processeur portent la pression CPU au-dessus de 1 % ;
+# l'occurrence est reportée puis lancée à l'échéance de defer.max (1 s) malgré la pression.
+echo "[e2e] report sous pression (defer.pressure, defer.max)"
+defer_task_id="$(create_watched "$rundir/watch-defer" -O defer.pressure=1 -O defer.max=1 /bin/true)"
+[ -n "$defer_task_id" ] || fail "création de la tâche defer.pressure"
+extra_task_ids="$extra_task_ids $defer_task_id"
+busy_pids=""
+for _ in $(seq $((2 * $(nproc)))); do
+    /bin/sh -c 'while :; do :; done' &
+    busy_pids="$busy_pids $!"
+done
+sleep 2
+touch "$rundir/watch-defer/trigger"
+sleep 0.5
+kill $busy_pids
+sleep 1.5
+history_defer="$("$tadmor_bin" -p "$pipes_dir" -x "$defer_task_id")" || fail "historique de la tâche $defer_task_id"
+echo "$history_defer"
+echo "$history_defer" | grep -q '"deferred_ms":1[0-9][0-9][0-9],' || fail "occurrence non reportée d'environ 1 s"
+stats_defer="$("$tadmor_bin" -p "$pipes_dir" -S)"
+echo "$stats_defer" | grep -q '"firings_deferred":1,' || fail "firings_deferred attendu : 1"
+echo "$stats_defer" | grep -q '"deferrals_expired":1,' || fail "deferrals_expired attendu : 1"
+
+# Chaînes : /bin/true et /bin/false déclenchent leurs dépendantes selon after.on.
+echo "[e2e] chaînes de tâches (after, after.on)"
+chain_ok_id="$(create_watched "$rundir/watch-chain" /bin/true)"
+chain_ko_id="$(create_watched "$rundir/watch-chain" /bin/false)"
+[ -n "$chain_ok_id" ] && [ -n "$chain_ko_id" ] || fail "création des tâches amont"
+create_dependent() {
+    "$tadmor_bin" -p "$pipes_dir" -c -m 000000000000000 -H 000000 -w 00 "$@" /bin/true | task_id_of
+}
+ok_success_id="$(create_dependent -O after="$chain_ok_id")"
+ok_failure_id="$(create_dependent -O after="$chain_ok_id" -O after.on=failure)"
+ko_success_id="$(create_dependent -O after="$chain_ko_id" -O after.on=success)"
+ko_failure_id="$(create_dependent -O after="$chain_ko_id" -O after.on=failure)"
+ko_any_id="$(create_dependent -O after="$chain_ko_id" -O after.on=any)"
+[ -n "$ok_success_id" ] && [ -n "$ok_failure_id" ] && [ -n "$ko_success_id" ] && [ -n "$ko_failure_id" ] &&
+    [ -n "$ko_any_id" ] || fail "création des tâches dépendantes"
+# Dépendantes d'abord : les tâches amont ne peuvent être supprimées qu'après elles.
+extra_task_ids="$extra_task_ids $ok_success_id $ok_failure_id $ko_success_id $ko_failure_id $ko_any_id"
+extra_task_ids="$extra_task_ids $chain_ok_id $chain_ko_id"
+[ -z "$(create_dependent -O after=999999 2>/dev/null)" ] || fail "after= accepté vers une tâche inconnue"
+touch "$rundir/watch-chain/trigger"
+sleep 1
+chain_runs() {
+    "$tadmor_bin" -p "$pipes_dir" -x "$1" | grep -o '"outcome":"COMPLETED"' | wc -l
+}
+[ "$(chain_runs "$ok_success_id")" -eq 1 ] || fail "after.on=success non déclenchée par un succès"
+[ "$(chain_runs "$ok_failure_id")" -eq 0 ] || fail "after.on=failure déclenchée par un succès"
+[ "$(chain_runs "$ko_success_id")" -eq 0 ] || fail "after.on=success déclenchée par un échec"
+[ "$(chain_runs "$ko_failure_id")" -eq 1 ] || fail "after.on=failure non déclenchée par un échec"
+[ "$(chain_runs "$ko_any_id")" -eq 1 ] || fail "after.on=any non déclenchée par un échec"
+"$tadmor_bin" -p "$pipes_dir" -S | grep -q '"chain_triggers":3,' || fail "chain_triggers attendu : 3"
+"$tadmor_bin" -p "$pipes_dir" -r "$chain_ko_id" 2>&1 | grep -q '"TASK_HAS_DEPENDENTS"' ||
+    fail "tâche amont supprimée avant ses dépendantes"
+
+echo "[e2e] historique paginé (-N, -C)"
+page="$("$tadmor_bin" -p "$pipes_dir" -x "$retry_task_id" -N 1)" || fail "première page de l'historique"
+echo "$page" | grep -q '"attempt":3,' || fail "la première page ne commence pas par la plus récente"
+cursor="$(echo "$page" | sed -n 's/.*"next":\([0-9][0-9]*\).*/\1/p')"
+[ -n "$cursor" ] && [ "$cursor" != 0 ] || fail "curseur absent de la première page"
+page="$("$tadmor_bin" -p "$pipes_dir" -x "$retry_task_id" -N 1 -C "$cursor")" || fail "page suivante de l'historique"
+echo "$page" | grep -q '"attempt":2,' || fail "la page suivante ne reprend pas au curseur"
+
+# Curseur repris après une compaction (history.max_entries=4) : ni répétition ni saut.
+compact_task_id="$(create_watched "$rundir/watch-compact" -O history.max_entries=4 /bin/true)"
+[ -n "$compact_task_id" ] || fail "création de la tâche history.max_entries"
+extra_task_ids="$extra_task_ids $compact_task_id"
+for run in 1 2 3; do
+    touch "$rundir/watch-compact/$run"
+    sleep 1.1
+done
+epochs="$("$tadmor_bin" -p "$pipes_dir" -x "$compact_task_id" | grep -o '"epoch":[0-9]*' | cut -d: -f2 | tr '\n' ' ')"
+set -- $epochs
+[ $# -eq 3 ] || fail "trois exécutions attendues avant compaction : $epochs"
+second_epoch="$2"
+page="$("$tadmor_bin" -p "$pipes_dir" -x "$compact_task_id" -N 1)"
+cursor="$(echo "$page" | sed -n 's/.*"next":\([0-9][0-9]*\).*/\1/p')"
+for run in 4 5; do
+    touch "$rundir/watch-compact/$run"
+    sleep 1.1
+done
+[ "$("$tadmor_bin" -p "$pipes_dir" -x "$compact_task_id" | grep -o '"epoch":' | wc -l)" -eq 4 ] ||
+    fail "history.max_entries=4 non appliqué"
+page="$("$tadmor_bin" -p "$pipes_dir" -x "$compact_task_id" -N 1 -C "$cursor")"
+echo "$page"
+echo "$page" | grep -q "\"epoch\":$second_epoch," || fail "page suivante décalée par la compaction"
+
+# Arrêt brutal : catalogue rejoué depuis son journal, historique intact.
+echo "[e2e] reprise après kill -9"
+kill -9 "$daemon_pid"
+wait "$daemon_pid" 2>/dev/null || true
+"$erraid_bin" -r "$rundir" &
+daemon_pid=$!
+sleep 1
+"$tadmor_bin" -p "$pipes_dir" -l | grep -q "\"task_id\":$retry_task_id," || fail "tâche $retry_task_id perdue par l'arrêt brutal"
+[ "$("$tadmor_bin" -p "$pipes_dir" -x "$retry_task_id" | grep -o '"attempt":' | wc -l)" -eq 3 ] ||
+    fail "historique de la tâche $retry_task_id perdu par l'arrêt brutal"
+# Bail d'identifiants : les numéros attribués avant l'arrêt ne reviennent pas.
+crash_task_id="$("$tadmor_bin" -p "$pipes_dir" -c -m "$minutes_mask" -H "$hours_mask" -w "$weekdays_mask" /bin/true | task_id_of)"
+[ -n "$crash_task_id" ] && [ "$crash_task_id" -gt "$retry_task_id" ] ||
+    fail "identifiant réattribué après l'arrêt brutal : ${crash_task_id:-aucun}"
+extra_task_ids="$extra_task_ids $crash_task_id"
+
 if [ -n "$sequence_task_id" ]; then
+    echo "[e2e] historique tâche séquentielle"
+    history_seq="$("$tadmor_bin" -p "$pipes_dir" -x "$sequence_task_id")" || fail "historique de la tâche $sequence_task_id"
+    echo "$history_seq"
+    # "first\nsecond\n" : les deux commandes ont tourné
+    echo "$history_seq" | grep -q '"status":0,"stdout_len":13,' || fail "la séquence n'a pas produit 'first' puis 'second'"
+    "$tadmor_bin" -p "$pipes_dir" -o "$sequence_task_id" | grep -q "second" || fail "stdout de la séquence sans 'second'"
+
     echo "[e2e] suppression tâche séquentielle"
     "$tadmor_bin" -p "$pipes_dir" -r "$sequence_task_id" || true
-
-    log_dir_sequence="$rundir/logs/$sequence_task_id"
-    history_seq="$log_dir_sequence/history.log"
-    if [ -f "$history_seq" ] && ! grep -q "second" "$history_seq"; then
-        echo "[e2e][ERREUR] history.log de la séquence ne contient pas 'second'" >&2
-        exit 1
-    fi
 fi
 
 if [ -n "$simple_task_id" ]; then
@@ -110,6 +454,36 @@ if [ -n "$simple_task_id" ]; then
     "$tadmor_bin" -p "$pipes_dir" -r "$simple_task_id" || true
 fi
 
+for task_id in $extra_task_ids; do
+    "$tadmor_bin" -p "$pipes_dir" -r "$task_id" || true
+done
+
 "$tadmor_bin" -p "$pipes_dir" -q
 
 wait "$daemon_pid" || true
+daemon_pid=""
+
+# Les suppressions sont faites par le fil de persistance, au plus tard à l'arrêt.
+if [ -n "$(find "$rundir/logs" -mindepth 1 -type d)" ]; then
+    fail "journaux ou répertoires de répartition restants après suppression des tâches"
+fi
+
+echo "[e2e] pré-armement (-a 60000)"
+prearm_history=""
+for _ in $(seq 70); do
+    prearm_history="$("$tadmor_bin" -p "$prearm_dir/pipes" -x "$prearm_task_id")" || fail "historique de la tâche pré-armée"
+    echo "$prearm_history" | grep -q '"outcome":"COMPLETED"' && break
+    sleep 1
+done
+echo "$prearm_history"
+echo "$prearm_history" | grep -q '"status":0,"stdout_len":6,' || fail "la tâche pré-armée n'a pas tourné à sa minute"
+prearm_stats="$("$tadmor_bin" -p "$prearm_dir/pipes" -S)"
+echo "$prearm_stats" | grep -q '"launches_prearmed":[1-9]' || fail "lancement sans le fils pré-armé"
+# Le lancement suivant est déjà armé : l'arrêt doit l'annuler, pas attendre le délai de grâce (5 s).
+echo "$prearm_stats" | grep -q '"runs_active":1,' || fail "aucun fils armé pour la minute suivante"
+shutdown_start_ns="$(date +%s%N)"
+"$tadmor_bin" -p "$prearm_dir/pipes" -q
+wait "$prearm_pid" || true
+prearm_pid=""
+shutdown_ms=$((($(date +%s%N) - shutdown_start_ns) / 1000000))
+[ "$shutdown_ms" -lt 2000 ] || fail "arrêt avec un fils armé en $shutdown_ms ms"
@@ -0,0 +1,111 @@
+#include "admission.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int read_small_file(const char *path, char *buffer, size_t buflen) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    size_t offset = 0;
+    while (offset + 1 < buflen) {
+        ssize_t n = read(fd, buffer + offset, buflen - offset - 1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd);
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        offset += (size_t)n;
+    }
+    close(fd);
+    buffer[offset] = '\0';
+    return 0;
+}
+
+/* Ligne attendue : « some avg10=1.23 avg60=... avg300=... total=... ». */
+static int read_psi_some_avg10(const char *path, double *out) {
+    char buffer[256];
+    if (read_small_file(path, buffer, sizeof(buffer)) != 0) {
+        return -1;
+    }
+    const char *line = strstr(buffer, "some ");
+    const char *field = (line != NULL) ? strstr(line, "avg10=") : NULL;
+    if (field == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    char *endptr = NULL;
+    double value = strtod(field + 6, &endptr);
+    if (endptr == field + 6) {
+        errno = EINVAL;
+        return -1;
+    }
+    *out = value;
+    return 0;
+}
+
+static int read_loadavg_percent(double *out) {
+    char buffer[128];
+    if (read_small_file("/proc/loadavg", buffer, sizeof(buffer)) != 0) {
+        return -1;
+    }
+    char *endptr = NULL;
+    double load = strtod(buffer, &endptr);
+    if (endptr == buffer) {
+        errno = EINVAL;
+        return -1;
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) {
+        cpus = 1;
+    }
+    *out = load * 100.0 / (double)cpus;
+    return 0;
+}
+
+int admission_sample(admission_pressure_t *pressure, int64_t now_ms) {
+    if (pressure == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (pressure->sampled_ms != 0 && now_ms - pressure->sampled_ms < ERRAID_PRESSURE_SAMPLE_MS) {
+        return 0;
+    }
+
+    admission_pressure_t sample;
+    memset(&sample, 0, sizeof(sample));
+    if (read_psi_some_avg10("/proc/pressure/cpu", &sample.cpu) == 0) {
+        sample.from_psi = true;
+        /* memory/io peuvent manquer selon la configuration du noyau. */
+        read_psi_some_avg10("/proc/pressure/memory", &sample.memory);
+        read_psi_some_avg10("/proc/pressure/io", &sample.io);
+    } else if (read_loadavg_percent(&sample.cpu) != 0) {
+        return -1;
+    }
+    sample.sampled_ms = now_ms;
+    *pressure = sample;
+    return 0;
+}
+
+double admission_level(const admission_pressure_t *pressure) {
+    if (pressure == NULL) {
+        return 0.0;
+    }
+    double level = pressure->cpu;
+    if (pressure->memory > level) {
+        level = pressure->memory;
+    }
+    if (pressure->io > level) {
+        level = pressure->io;
+    }
+    return level;
+}
@@ -1,10 +1,15 @@
+#define _DEFAULT_SOURCE
+
 #include "erraid.h"
 
 #include "executor.h"
 #include "notifier.h"
 #include "proto.h"
+#include "runlog.h"
 #include "storage.h"
+#include "taskopt.h"
 #include "utils.h"
+#include "watch.h"
 
 #include <ctype.h>
 #include <errno.h>
@@ -16,7 +21,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #ifndef ARRAY_SIZE
@@ -53,6 +60,8 @@ static void free_task_contents(task_t *task) {
         task->commands = NULL;
     }
     task->command_count = 0;
+    free(task->watch_path);
+    task->watch_path = NULL;
 }
 
 static void free_command_array(command_array_t *array) {
@@ -153,6 +162,9 @@ static int send_error_response(erraid_context_t *ctx, const char *code, const ch
 static int send_json_response(erraid_context_t *ctx, message_type_t type, const char *payload, size_t length);
 static int send_status_ok(erraid_context_t *ctx, message_type_t type);
 static int rebuild_plan(erraid_context_t *ctx);
+static void sync_watches(erraid_context_t *ctx);
+static void release_watch(erraid_context_t *ctx, int wd);
+static void drain_fd(int fd);
 static int json_extract_uint64(const char *json, const char *field, uint64_t *value);
 
 static void log_fd(int fd, const char *fmt, ...) {
@@ -440,6 +452,72 @@ schedule_parse_error:
     return -1;
 }
 
+/* Objet optionnel "options" : {"clé":"valeur",...}, chaque paire passée à taskopt_set. */
+static int parse_options_field(const char *payload, task_t *task) {
+    const char *value_ptr = NULL;
+    if (find_field_pointer(payload, "options", &value_ptr) != 0) {
+        if (errno == ENOENT) {
+            errno = 0;
+            return 0;
+        }
+        return -1;
+    }
+    if (strncmp(value_ptr, "null", 4) == 0) {
+        return 0;
+    }
+    if (*value_ptr != '{') {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const char *cursor = skip_ws(value_ptr + 1);
+    if (*cursor == '}') {
+        return 0;
+    }
+    for (size_t i = 0; i < ERRAID_MAX_TASK_OPTIONS; ++i) {
+        char *key = NULL;
+        char *value = NULL;
+        cursor = skip_ws(cursor);
+        if (parse_json_string_token(&cursor, &key) != 0) {
+            return -1;
+        }
+        cursor = skip_ws(cursor);
+        if (*cursor != ':') {
+            free(key);
+            errno = EINVAL;
+            return -1;
+        }
+        cursor = skip_ws(cursor + 1);
+        if (parse_json_string_token(&cursor, &value) != 0) {
+            free(key);
+            return -1;
+        }
+        int rc = taskopt_set(task, key, value);
+        if (rc != 0) {
+            log_fd(STDERR_FILENO, "[debug] option refusée %s=%s (errno=%d)\n", key, value, errno);
+        }
+        free(key);
+        free(value);
+        if (rc != 0) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        cursor = skip_ws(cursor);
+        if (*cursor == ',') {
+            ++cursor;
+            continue;
+        }
+        if (*cursor == '}') {
+            return 0;
+        }
+        errno = EINVAL;
+        return -1;
+    }
+    errno = E2BIG;
+    return -1;
+}
+
 static int parse_commands_field(const char *payload, task_type_t type, command_array_t *out_commands) {
     const char *value_ptr = NULL;
     if (find_field_pointer(payload, "commands", &value_ptr) != 0) {
@@ -482,6 +560,21 @@ static void wake_scheduler(erraid_context_t *ctx) {
     }
 }
 
+static size_t context_lower_bound(const erraid_context_t *ctx, uint64_t task_id) {
+    size_t low = 0;
+    size_t high = ctx->task_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (ctx->tasks[mid].task_id < task_id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/* Insère à sa place : les identifiants alloués étant croissants, c'est en pratique un ajout en fin. */
 static int context_add_task(erraid_context_t *ctx, task_t *task) {
     if (ctx == NULL || task == NULL) {
         errno = EINVAL;
@@ -492,7 +585,11 @@ static int context_add_task(erraid_context_t *ctx, task_t *task) {
         return -1;
     }
     ctx->tasks = tmp;
-    ctx->tasks[ctx->task_count] = *task;
+    size_t pos = context_lower_bound(ctx, task->task_id);
+    if (pos < ctx->task_count) {
+        memmove(&ctx->tasks[pos + 1], &ctx->tasks[pos], (ctx->task_count - pos) * sizeof(task_t));
+    }
+    ctx->tasks[pos] = *task;
     ctx->task_count += 1;
     memset(task, 0, sizeof(*task));
     return 0;
@@ -502,14 +599,87 @@ static ssize_t context_find_task_index(const erraid_context_t *ctx, uint64_t tas
     if (ctx == NULL) {
         return -1;
     }
-    for (size_t i = 0; i < ctx->task_count; ++i) {
-        if (ctx->tasks[i].task_id == task_id) {
-            return (ssize_t)i;
-        }
+    size_t pos = context_lower_bound(ctx, task_id);
+    if (pos < ctx->task_count && ctx->tasks[pos].task_id == task_id) {
+        return (ssize_t)pos;
     }
     return -1;
 }
 
+/* Emplacement d'état de la tâche, attribué à la première utilisation ; NULL sans fichier d'état. */
+static runstate_slot_t *task_state(erraid_context_t *ctx, task_t *task) {
+    if (ctx->runstate.map == NULL) {
+        return NULL;
+    }
+    if (task->state_slot == 0) {
+        uint32_t index = 0;
+        if (runstate_allocate(&ctx->runstate, task->task_id, &index) != 0) {
+            return NULL;
+        }
+        task->state_slot = index + 1;
+        /* Reprend la valeur du catalogue (tâches antérieures au fichier d'état). */
+        runstate_slot(&ctx->runstate, index)->last_run_epoch = task->last_run_epoch;
+    }
+    return runstate_slot(&ctx->runstate, task->state_slot - 1);
+}
+
+/* Rattache les emplacements aux tâches chargées ; ceux des tâches disparues sont libérés. */
+static void attach_runstate(erraid_context_t *ctx) {
+    for (uint32_t i = 0; i < ctx->runstate.capacity; ++i) {
+        runstate_slot_t *slot = runstate_slot(&ctx->runstate, i);
+        if (slot->task_id == 0) {
+            continue;
+        }
+        ssize_t index = context_find_task_index(ctx, slot->task_id);
+        if (index < 0 || ctx->tasks[index].state_slot != 0) {
+            runstate_release(&ctx->runstate, i);
+            continue;
+        }
+        task_t *task = &ctx->tasks[index];
+        task->state_slot = i + 1;
+        if (slot->last_run_epoch >= 0) {
+            task->last_run_epoch = slot->last_run_epoch;
+        }
+    }
+}
+
+/* Vrai si la chaîne des tâches amont partant de from_id atteint target_id (ou ne se termine pas). */
+static bool dependency_reaches(const erraid_context_t *ctx, uint64_t from_id, uint64_t target_id) {
+    uint64_t id = from_id;
+    for (size_t steps = 0; steps <= ctx->task_count; ++steps) {
+        if (id == target_id) {
+            return true;
+        }
+        ssize_t index = context_find_task_index(ctx, id);
+        if (index < 0) {
+            return false;
+        }
+        id = ctx->tasks[index].policy.after_task_id;
+        if (id == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Première entrée de l'index des dépendantes pour upstream_id, dependent_count s'il n'y en a pas. */
+static size_t first_dependent(const erraid_context_t *ctx, uint64_t upstream_id) {
+    size_t low = 0;
+    size_t high = ctx->dependent_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (ctx->dependents[mid].upstream_id < upstream_id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low < ctx->dependent_count && ctx->dependents[low].upstream_id != upstream_id) {
+        return ctx->dependent_count;
+    }
+    return low;
+}
+
 static int context_remove_task(erraid_context_t *ctx, size_t index) {
     if (ctx == NULL || index >= ctx->task_count) {
         errno = EINVAL;
@@ -536,6 +706,211 @@ static task_type_t task_type_from_message(message_type_t msg_type) {
     }
 }
 
+static void note_history_commit(erraid_context_t *ctx, uint64_t batch, int64_t latency_ns) {
+    uint64_t latency_us = (uint64_t)latency_ns / 1000;
+    ctx->stats.history_commits += 1;
+    ctx->stats.history_committed += batch;
+    ctx->stats.history_commit_us_total += latency_us;
+    if (latency_us > ctx->stats.history_commit_us_max) {
+        ctx->stats.history_commit_us_max = latency_us;
+    }
+    if (batch > ctx->stats.history_batch_max) {
+        ctx->stats.history_batch_max = batch;
+    }
+}
+
+/* Opérations traitées par le fil de persistance : tampons rendus à la réserve, validations comptées. */
+static void reap_persist(erraid_context_t *ctx) {
+    persist_op_t *op;
+    while ((op = persist_completed(&ctx->persist)) != NULL) {
+        if (op->rc != 0) {
+            log_fd(STDERR_FILENO,
+                   "erraid: écriture différée %d échouée pour la tâche %llu (%s)\n",
+                   (int)op->kind,
+                   (unsigned long long)op->task_id,
+                   strerror(op->error));
+        } else if (op->kind == PERSIST_OP_SYNC_LOGS) {
+            note_history_commit(ctx, op->value, op->latency_ns);
+        } else if (op->kind == PERSIST_OP_COMPACT && op->value > 0) {
+            ctx->stats.history_compactions += 1;
+            ctx->stats.history_compacted += op->value;
+        } else if ((op->kind == PERSIST_OP_HISTORY || op->kind == PERSIST_OP_HISTORY_ENTRY) &&
+                   ctx->paths.durability == STORAGE_DURABILITY_STRICT) {
+            note_history_commit(ctx, 1, op->latency_ns);
+        }
+        if (op->kind == PERSIST_OP_HISTORY) {
+            executor_result_free(&op->result);
+        } else if (op->kind == PERSIST_OP_CHECKPOINT) {
+            if (op->rc == 0 && catalog_checkpoint_done(&ctx->catalog, op->snapshot.length, op->value) != 0) {
+                log_fd(STDERR_FILENO, "erraid: journal du catalogue non vidé (%s)\n", strerror(errno));
+            }
+            free(op->snapshot.data);
+            ctx->checkpoint_pending = false;
+        }
+        persist_reclaim(&ctx->persist);
+    }
+}
+
+/* Bloque jusqu'à ce que `target` opérations aient été traitées (file pleine, lecture cohérente). */
+static void wait_persist(erraid_context_t *ctx, uint64_t target) {
+    if (persist_processed(&ctx->persist) < target) {
+        ctx->stats.persist_waits += 1;
+    }
+    while (persist_processed(&ctx->persist) < target) {
+        struct pollfd pfd = {.fd = ctx->wake_pipe[0], .events = POLLIN, .revents = 0};
+        if (poll(&pfd, 1, -1) > 0) {
+            drain_fd(ctx->wake_pipe[0]);
+        }
+    }
+    reap_persist(ctx);
+}
+
+/*
+ * Lecture sur disque des fichiers d'une tâche : ses écritures déjà soumises
+ * doivent être visibles, celles des autres tâches peuvent rester en file.
+ */
+static void flush_persist_task(erraid_context_t *ctx, uint64_t task_id) {
+    wait_persist(ctx, persist_pending_for_task(&ctx->persist, task_id));
+}
+
+/* Emplacement de la prochaine opération ; à publier avec persist_submit. */
+static persist_op_t *reserve_persist(erraid_context_t *ctx) {
+    persist_op_t *op = persist_reserve(&ctx->persist);
+    while (op == NULL) {
+        wait_persist(ctx, ctx->persist.reclaimed + 1);
+        op = persist_reserve(&ctx->persist);
+    }
+    return op;
+}
+
+/*
+ * Instantané du catalogue lorsque le journal est devenu plus gros que lui : la
+ * boucle n'en fait que l'encodage, le fil de persistance l'écrit et reap_persist
+ * vide le journal. Sans fil (export, import hors démon), tout est fait ici.
+ */
+static void maybe_checkpoint(erraid_context_t *ctx) {
+    if (!ctx->catalog_synced || ctx->checkpoint_pending || !catalog_should_checkpoint(&ctx->catalog)) {
+        return;
+    }
+    if (!ctx->persist.running) {
+        if (catalog_checkpoint(&ctx->catalog, ctx->tasks, ctx->task_count) != 0) {
+            log_fd(STDERR_FILENO, "erraid: point de contrôle du catalogue impossible (%s)\n", strerror(errno));
+        }
+        return;
+    }
+    catalog_buffer_t snapshot = {NULL, 0, 0};
+    if (catalog_encode_snapshot(ctx->tasks, ctx->task_count, &snapshot) != 0) {
+        log_fd(STDERR_FILENO, "erraid: point de contrôle du catalogue impossible (%s)\n", strerror(errno));
+        free(snapshot.data);
+        return;
+    }
+    persist_op_t *op = reserve_persist(ctx);
+    op->kind = PERSIST_OP_CHECKPOINT;
+    op->catalog = &ctx->catalog;
+    op->snapshot = snapshot;
+    op->value = ctx->catalog.wal_bytes;
+    persist_submit(&ctx->persist);
+    ctx->checkpoint_pending = true;
+}
+
+/* Bloc de journal horodaté : écrit par le fil de persistance, après les écritures déjà soumises. */
+static void submit_runlog_chunk(runlog_chunk_t *chunk, void *arg) {
+    erraid_context_t *ctx = arg;
+    persist_op_t *op = reserve_persist(ctx);
+    op->kind = PERSIST_OP_RUNLOG;
+    op->task_id = chunk->task_id;
+    op->runlog = chunk;
+    persist_submit(&ctx->persist);
+}
+
+/*
+ * Identifiants attribués en mémoire dans un bail [next_task_id, id_lease_end)
+ * dont seule la fin est écrite dans tasks/next_id : une écriture pour
+ * ERRAID_ID_LEASE créations au lieu d'une par création. Le bail suivant est
+ * demandé à mi-parcours, pour être sur disque bien avant d'être entamé ; au
+ * redémarrage, l'attribution reprend après le dernier bail (les identifiants
+ * inutilisés sont perdus, jamais réattribués).
+ */
+static void extend_id_lease(erraid_context_t *ctx) {
+    if (ctx->next_task_id + ERRAID_ID_LEASE / 2 < ctx->id_lease_end) {
+        return;
+    }
+    ctx->id_lease_end = ctx->next_task_id + ERRAID_ID_LEASE;
+    persist_op_t *op = reserve_persist(ctx);
+    op->kind = PERSIST_OP_RESERVE_IDS;
+    op->value = ctx->id_lease_end;
+    persist_submit(&ctx->persist);
+}
+
+/* Un syncfs, après toutes les écritures soumises depuis la validation précédente. */
+static void commit_history(erraid_context_t *ctx) {
+    erraid_group_commit_t *group = &ctx->group_commit;
+    group->due_ms = -1;
+    if (group->pending == 0) {
+        return;
+    }
+    persist_op_t *op = reserve_persist(ctx);
+    op->kind = PERSIST_OP_SYNC_LOGS;
+    op->value = group->pending;
+    persist_submit(&ctx->persist);
+    group->pending = 0;
+}
+
+/* Ajoute une exécution au lot ; la validation part au plus tard window_ms après la première. */
+static void queue_history_commit(erraid_context_t *ctx) {
+    erraid_group_commit_t *group = &ctx->group_commit;
+    if (ctx->paths.durability != STORAGE_DURABILITY_GROUP) {
+        return;
+    }
+    group->pending += 1;
+    if (group->pending >= group->max_runs) {
+        commit_history(ctx);
+        return;
+    }
+    if (group->due_ms < 0) {
+        int64_t now_ms = 0;
+        utils_now_epoch_ms(&now_ms);
+        group->due_ms = now_ms + group->window_ms;
+    }
+}
+
+/* Options history.* de la tâche, à défaut la rétention du démon. */
+static storage_retention_t task_retention(const erraid_context_t *ctx, const task_t *task) {
+    storage_retention_t retention = ctx->retention;
+    if (task->policy.history_max_age_seconds != 0) {
+        retention.max_age_seconds = task->policy.history_max_age_seconds;
+    }
+    if (task->policy.history_max_entries != 0) {
+        retention.max_entries = task->policy.history_max_entries;
+    }
+    return retention;
+}
+
+static void queue_compaction(erraid_context_t *ctx, task_t *task) {
+    storage_retention_t retention = task_retention(ctx, task);
+    if (retention.max_age_seconds == 0 && retention.max_entries == 0) {
+        return;
+    }
+    task->history_appends = 0;
+    persist_op_t *op = reserve_persist(ctx);
+    op->kind = PERSIST_OP_COMPACT;
+    op->task_id = task->task_id;
+    op->retention = retention;
+    persist_submit(&ctx->persist);
+}
+
+/* Le fichier dépasse max_entries d'au plus un huitième : une réécriture pour plusieurs ajouts. */
+static void note_history_append(erraid_context_t *ctx, task_t *task) {
+    uint32_t max_entries = task_retention(ctx, task).max_entries;
+    if (max_entries == 0) {
+        return;
+    }
+    task->history_appends += 1;
+    if (task->history_appends > max_entries / ERRAID_COMPACT_SLACK) {
+        queue_compaction(ctx, task);
+    }
+}
+
 static int handle_create_task(erraid_context_t *ctx, message_type_t msg_type, const char *payload) {
     task_type_t type = task_type_from_message(msg_type);
 
@@ -562,20 +937,35 @@ static int handle_create_task(erraid_context_t *ctx, message_type_t msg_type, co
     commands.commands = NULL;
     commands.count = 0;
 
-    if (storage_allocate_task_id(&ctx->paths, &new_task.task_id) != 0) {
+    if (parse_options_field(payload, &new_task) != 0) {
         free_task_contents(&new_task);
-        send_error_response(ctx, "PERSISTENCE_ERROR", "Allocation d'identifiant impossible");
+        send_error_response(ctx, "INVALID_REQUEST", "Options invalides");
         return -1;
     }
 
-    if (storage_write_task(&ctx->paths, &new_task) != 0) {
+    new_task.task_id = ctx->next_task_id++;
+    extend_id_lease(ctx);
+
+    /*
+     * Pas de cycle possible : une tâche n'est jamais modifiée et after= doit
+     * désigner une tâche existante, donc plus ancienne que la nouvelle.
+     */
+    uint64_t upstream_id = new_task.policy.after_task_id;
+    if (upstream_id != 0 && context_find_task_index(ctx, upstream_id) < 0) {
+        free_task_contents(&new_task);
+        send_error_response(ctx, "INVALID_REQUEST", "Tâche amont inconnue");
+        return -1;
+    }
+
+    if (catalog_put(&ctx->catalog, &new_task) != 0) {
         free_task_contents(&new_task);
         send_error_response(ctx, "PERSISTENCE_ERROR", "Écriture de la tâche impossible");
         return -1;
     }
 
+    uint64_t task_id = new_task.task_id;
     if (context_add_task(ctx, &new_task) != 0) {
-        storage_remove_task(&ctx->paths, new_task.task_id);
+        catalog_remove(&ctx->catalog, new_task.task_id);
         free_task_contents(&new_task);
         send_error_response(ctx, "MEMORY_ERROR", "Ajout en mémoire impossible");
         return -1;
@@ -588,13 +978,15 @@ static int handle_create_task(erraid_context_t *ctx, message_type_t msg_type, co
         send_error_response(ctx, "SCHEDULER_ERROR", "Reconstruction de plan impossible");
         return -1;
     }
+    sync_watches(ctx);
+    maybe_checkpoint(ctx);
 
     wake_scheduler(ctx);
 
     char payload_buf[128];
     size_t offset = 0;
     if (buffer_append(payload_buf, sizeof(payload_buf), &offset, "{\"status\":\"OK\",\"task_id\":%llu}",
-                      (unsigned long long)ctx->tasks[ctx->task_count - 1].task_id) != 0) {
+                      (unsigned long long)task_id) != 0) {
         send_error_response(ctx, "ENCODING_ERROR", "Construction de réponse impossible");
         return -1;
     }
@@ -618,17 +1010,44 @@ static int handle_remove_task(erraid_context_t *ctx, const char *payload) {
         send_error_response(ctx, "TASK_NOT_FOUND", "Tâche inconnue");
         return -1;
     }
+    /* Une tâche after= resterait sans amont : ses dépendantes sont supprimées avant elle. */
+    size_t dependent = first_dependent(ctx, task_id);
+    if (dependent < ctx->dependent_count) {
+        char message[96];
+        snprintf(message,
+                 sizeof(message),
+                 "Tâche amont de la tâche %llu, à supprimer d'abord",
+                 (unsigned long long)ctx->tasks[ctx->dependents[dependent].task_index].task_id);
+        send_error_response(ctx, "TASK_HAS_DEPENDENTS", message);
+        return -1;
+    }
 
-    if (storage_remove_task(&ctx->paths, task_id) != 0) {
+    if (catalog_remove(&ctx->catalog, task_id) != 0) {
         send_error_response(ctx, "PERSISTENCE_ERROR", "Suppression disque impossible");
         return -1;
     }
+    persist_op_t *op = reserve_persist(ctx);
+    op->kind = PERSIST_OP_REMOVE_LOGS;
+    op->task_id = task_id;
+    persist_submit(&ctx->persist);
+    storage_dirs_forget(&ctx->dirs, task_id);
 
+    int watch_wd = ctx->tasks[index].watch_wd;
+    if (ctx->tasks[index].state_slot != 0) {
+        runstate_release(&ctx->runstate, ctx->tasks[index].state_slot - 1);
+    }
     if (context_remove_task(ctx, (size_t)index) != 0) {
         erraid_reload_tasks(ctx);
         send_error_response(ctx, "MEMORY_ERROR", "Suppression mémoire impossible");
         return -1;
     }
+    release_watch(ctx, watch_wd);
+
+    for (size_t i = 0; i < ctx->run_count; ++i) {
+        if (ctx->runs[i].task_id == task_id) {
+            executor_signal(&ctx->runs[i], SIGKILL);
+        }
+    }
 
     if (rebuild_plan(ctx) != 0) {
         int saved_errno = errno;
@@ -637,6 +1056,7 @@ static int handle_remove_task(erraid_context_t *ctx, const char *payload) {
         send_error_response(ctx, "SCHEDULER_ERROR", "Reconstruction de plan impossible");
         return -1;
     }
+    maybe_checkpoint(ctx);
 
     wake_scheduler(ctx);
     return send_status_ok(ctx, MSG_RSP_REMOVE);
@@ -716,6 +1136,16 @@ static const char *task_type_to_string(task_type_t type) {
     }
 }
 
+static const char *run_outcome_to_string(task_run_outcome_t outcome) {
+    switch (outcome) {
+        case TASK_RUN_COMPLETED: return "COMPLETED";
+        case TASK_RUN_TIMEOUT: return "TIMEOUT";
+        case TASK_RUN_SKIPPED: return "SKIPPED";
+        case TASK_RUN_KILLED: return "KILLED";
+        default: return "UNKNOWN";
+    }
+}
+
 static int json_extract_uint64(const char *json, const char *key, uint64_t *out_value) {
     if (json == NULL || key == NULL || out_value == NULL) {
         errno = EINVAL;
@@ -871,133 +1301,552 @@ static int respond_list_tasks(erraid_context_t *ctx) {
     return send_json_response(ctx, MSG_RSP_LIST_TASKS, payload, offset);
 }
 
-static int respond_history(erraid_context_t *ctx, uint64_t task_id) {
-    task_run_entry_t *entries = NULL;
-    size_t entry_count = 0;
-    if (storage_load_history(&ctx->paths, task_id, &entries, &entry_count) != 0) {
+static int append_limits_hit(char *buffer, size_t buflen, size_t *offset, uint32_t limits_hit) {
+    static const uint32_t flags[] = {TASK_LIMIT_HIT_CPU, TASK_LIMIT_HIT_AS};
+    if (buffer_append(buffer, buflen, offset, ",\"limits_hit\":[")) {
+        return -1;
+    }
+    bool first = true;
+    for (size_t i = 0; i < ARRAY_SIZE(flags); ++i) {
+        if ((limits_hit & flags[i]) == 0) {
+            continue;
+        }
+        if (buffer_append(buffer, buflen, offset, "%s\"%s\"", first ? "" : ",", taskopt_limit_name(flags[i]))) {
+            return -1;
+        }
+        first = false;
+    }
+    return buffer_append(buffer, buflen, offset, "]");
+}
+
+static int append_history_entry(char *payload, size_t cap, size_t *offset, const task_run_entry_t *entry) {
+    const task_run_usage_t *usage = &entry->usage;
+    if (buffer_append(payload,
+                      cap,
+                      offset,
+                      "{\"epoch\":%lld,\"status\":%d,\"stdout_len\":%zu,\"stderr_len\":%zu,"
+                      "\"start_ns\":%lld,\"end_ns\":%lld,\"cpu_user_us\":%lld,\"cpu_sys_us\":%lld,"
+                      "\"max_rss_kb\":%lld,\"blocks_in\":%lld,\"blocks_out\":%lld,"
+                      "\"ctx_voluntary\":%lld,\"ctx_involuntary\":%lld",
+                      (long long)entry->epoch,
+                      entry->status,
+                      entry->stdout_len,
+                      entry->stderr_len,
+                      (long long)usage->start_ns,
+                      (long long)usage->end_ns,
+                      (long long)usage->cpu_user_us,
+                      (long long)usage->cpu_sys_us,
+                      (long long)usage->max_rss_kb,
+                      (long long)usage->blocks_in,
+                      (long long)usage->blocks_out,
+                      (long long)usage->ctx_voluntary,
+                      (long long)usage->ctx_involuntary) ||
+        append_limits_hit(payload, cap, offset, entry->limits_hit)) {
+        return -1;
+    }
+    return buffer_append(payload,
+                         cap,
+                         offset,
+                         ",\"outcome\":\"%s\",\"attempt\":%u,\"deferred_ms\":%lld,\"lag_us\":%lld,"
+                         "\"stdout_hash\":\"%016llx\",\"stderr_hash\":\"%016llx\"}",
+                         run_outcome_to_string(entry->outcome),
+                         (unsigned)entry->attempt,
+                         (long long)entry->deferred_ms,
+                         (long long)entry->lag_us,
+                         (unsigned long long)entry->stdout_hash,
+                         (unsigned long long)entry->stderr_hash);
+}
+
+/* Place réservée à la fin de la réponse LIST_HISTORY ("next"). */
+#define HISTORY_TRAILER_RESERVE 48
+
+static int append_rollup(char *payload, size_t cap, size_t *offset, const history_rollup_t *rollup) {
+    uint64_t avg_us = rollup->timed > 0 ? rollup->duration_us_total / rollup->timed : 0;
+    return buffer_append(payload,
+                         cap,
+                         offset,
+                         "{\"period_start\":%lld,\"period\":%u,\"runs\":%u,\"failures\":%u,\"skipped\":%u,"
+                         "\"duration_us_min\":%llu,\"duration_us_avg\":%llu,\"duration_us_max\":%llu,"
+                         "\"stdout_bytes\":%llu,\"stderr_bytes\":%llu}",
+                         (long long)rollup->period_start,
+                         (unsigned)rollup->period_seconds,
+                         (unsigned)rollup->runs,
+                         (unsigned)rollup->failures,
+                         (unsigned)rollup->skipped,
+                         (unsigned long long)rollup->duration_us_min,
+                         (unsigned long long)avg_us,
+                         (unsigned long long)rollup->duration_us_max,
+                         (unsigned long long)rollup->stdout_bytes,
+                         (unsigned long long)rollup->stderr_bytes);
+}
+
+/*
+ * Variante "rollups" de LIST_HISTORY : agrégats des exécutions compactées, du plus
+ * récent au plus ancien. "next" : début de la dernière période renvoyée.
+ */
+static int respond_rollups(erraid_context_t *ctx,
+                           uint64_t task_id,
+                           uint64_t limit,
+                           const int64_t *before,
+                           const int64_t *after,
+                           uint64_t cursor) {
+    flush_persist_task(ctx, task_id);
+    history_rollup_t *rollups = NULL;
+    size_t rollup_count = 0;
+    if (storage_load_rollups(&ctx->paths, task_id, &rollups, &rollup_count) != 0) {
         return -1;
     }
+    size_t end = rollup_count;
+    while (before != NULL && end > 0 && rollups[end - 1].period_start >= *before) {
+        --end;
+    }
+    /* Début de période et non indice : une compaction fusionne ou replie des agrégats. */
+    while (cursor != 0 && end > 0 && rollups[end - 1].period_start >= (int64_t)cursor) {
+        --end;
+    }
 
     char payload[ERRAID_PIPE_MESSAGE_LIMIT];
+    size_t cap = sizeof(payload) - HISTORY_TRAILER_RESERVE;
     size_t offset = 0;
-    if (buffer_append(payload, sizeof(payload), &offset, "{\"status\":\"OK\",\"history\":[")) {
-        free(entries);
+    if (buffer_append(payload, cap, &offset, "{\"status\":\"OK\",\"rollups\":[")) {
+        free(rollups);
         return -1;
     }
-
-    for (size_t i = 0; i < entry_count; ++i) {
-        if (i > 0) {
-            if (buffer_append(payload, sizeof(payload), &offset, ",")) {
-                free(entries);
-                return -1;
-            }
+    size_t index = end;
+    uint64_t count = 0;
+    while (index > 0 && (limit == 0 || count < limit)) {
+        if (after != NULL && rollups[index - 1].period_start <= *after) {
+            break;
         }
-        if (buffer_append(payload,
-                          sizeof(payload),
-                          &offset,
-                          "{\"epoch\":%lld,\"status\":%d,\"stdout_len\":%zu,\"stderr_len\":%zu}",
-                          (long long)entries[i].epoch,
-                          entries[i].status,
-                          entries[i].stdout_len,
-                          entries[i].stderr_len)) {
-            free(entries);
-            return -1;
+        size_t saved = offset;
+        if ((count > 0 && buffer_append(payload, cap, &offset, ",")) ||
+            append_rollup(payload, cap, &offset, &rollups[index - 1])) {
+            offset = saved;
+            break;
         }
+        --index;
+        ++count;
     }
+    uint64_t next = 0;
+    if (index > 0 && index < end && !(after != NULL && rollups[index - 1].period_start <= *after)) {
+        next = (uint64_t)rollups[index].period_start;
+    }
+    free(rollups);
 
-    if (buffer_append(payload, sizeof(payload), &offset, "]}")) {
-        free(entries);
+    if (buffer_append(payload, sizeof(payload), &offset, "],\"next\":%llu}", (unsigned long long)next)) {
         return -1;
     }
-
-    free(entries);
     return send_json_response(ctx, MSG_RSP_LIST_HISTORY, payload, offset);
 }
 
-static int respond_stdio(erraid_context_t *ctx, uint64_t task_id, bool stdout_request) {
-    void *stdout_buf = NULL;
-    size_t stdout_len = 0;
-    void *stderr_buf = NULL;
-    size_t stderr_len = 0;
+/*
+ * Page d'historique, de la plus récente à la plus ancienne exécution. Le fichier
+ * est parcouru depuis la fin : le coût dépend de la page, pas de la longueur de
+ * l'historique. "next" non nul : numéro d'exécution (base + indice) à repasser
+ * comme cursor pour la suite ; les exécutions compactées entre-temps sont omises.
+ */
+static int respond_history(erraid_context_t *ctx, const char *request) {
+    uint64_t task_id = 0;
+    if (json_extract_uint64(request, "task_id", &task_id) != 0) {
+        return -1;
+    }
+    uint64_t limit = 0;
+    json_extract_uint64(request, "limit", &limit);
+    uint64_t value = 0;
+    bool has_before = json_extract_uint64(request, "before_epoch", &value) == 0;
+    int64_t before = (int64_t)value;
+    bool has_after = json_extract_uint64(request, "after_epoch", &value) == 0;
+    int64_t after = (int64_t)value;
+    uint64_t cursor = 0;
+    json_extract_uint64(request, "cursor", &cursor);
+    uint64_t rollups = 0;
+    if (json_extract_uint64(request, "rollups", &rollups) == 0 && rollups != 0) {
+        return respond_rollups(ctx, task_id, limit, has_before ? &before : NULL, has_after ? &after : NULL, cursor);
+    }
+
+    flush_persist_task(ctx, task_id);
+    history_view_t view;
+    if (storage_open_history(&ctx->paths, task_id, &view) != 0) {
+        return -1;
+    }
+    size_t end = view.count;
+    if (has_before) {
+        end = history_lower_bound(&view, before);
+    }
+    /* Numéro absolu : une compaction entre deux pages ne décale pas la suite. */
+    if (cursor != 0) {
+        size_t resume = cursor > view.base ? (size_t)(cursor - view.base) : 0;
+        end = resume < end ? resume : end;
+    }
 
-    if (storage_load_last_stdio(&ctx->paths, task_id, &stdout_buf, &stdout_len, &stderr_buf, &stderr_len) != 0) {
-        if (stdout_buf != NULL) {
-            free(stdout_buf);
+    char payload[ERRAID_PIPE_MESSAGE_LIMIT];
+    size_t cap = sizeof(payload) - HISTORY_TRAILER_RESERVE;
+    size_t offset = 0;
+    if (buffer_append(payload, cap, &offset, "{\"status\":\"OK\",\"history\":[")) {
+        history_close(&view);
+        return -1;
+    }
+    size_t index = end;
+    uint64_t count = 0;
+    while (index > 0 && (limit == 0 || count < limit)) {
+        if (has_after && history_epoch_at(&view, index - 1) <= after) {
+            break;
         }
-        if (stderr_buf != NULL) {
-            free(stderr_buf);
+        task_run_entry_t entry;
+        history_get(&view, index - 1, &entry);
+        size_t saved = offset;
+        if ((count > 0 && buffer_append(payload, cap, &offset, ",")) ||
+            append_history_entry(payload, cap, &offset, &entry)) {
+            offset = saved;
+            break;
         }
+        --index;
+        ++count;
+    }
+    uint64_t next = 0;
+    if (index > 0 && !(has_after && history_epoch_at(&view, index - 1) <= after)) {
+        next = view.base + index;
+    }
+    history_close(&view);
+
+    if (buffer_append(payload, sizeof(payload), &offset, "],\"next\":%llu}", (unsigned long long)next)) {
         return -1;
     }
+    return send_json_response(ctx, MSG_RSP_LIST_HISTORY, payload, offset);
+}
 
-    const void *target_buf = stdout_request ? stdout_buf : stderr_buf;
-    size_t target_len = stdout_request ? stdout_len : stderr_len;
+/* Place réservée autour des données GET_STDOUT/GET_STDERR (epoch, offset, total, next). */
+#define STDIO_ENVELOPE_RESERVE 160
+#define STDIO_CHUNK_MAX (((ERRAID_PIPE_MESSAGE_LIMIT - STDIO_ENVELOPE_RESERVE) / 4) * 3)
 
-    size_t required = ((target_len + 2) / 3) * 4;
-    if (required + 64 >= ERRAID_PIPE_MESSAGE_LIMIT) {
-        free(stdout_buf);
-        free(stderr_buf);
-        errno = EMSGSIZE;
+/*
+ * Plage d'une sortie conservée : "epoch" ou "index" (0 : dernière exécution),
+ * "offset" et "length" facultatifs. Seul le flux demandé est lu, et seulement
+ * la plage renvoyée ; "next" non nul : offset de la suite.
+ */
+static int respond_stdio(erraid_context_t *ctx, const char *request, bool stdout_request) {
+    uint64_t task_id = 0;
+    if (json_extract_uint64(request, "task_id", &task_id) != 0) {
+        return -1;
+    }
+    storage_stdio_select_t select = {.by_epoch = false, .epoch = 0, .index = 0};
+    uint64_t value = 0;
+    if (json_extract_uint64(request, "epoch", &value) == 0) {
+        select.by_epoch = true;
+        select.epoch = (int64_t)value;
+    } else if (json_extract_uint64(request, "index", &value) == 0) {
+        if (value > ERRAID_STDIO_SNAPSHOT_COUNT) {
+            errno = ENOENT;
+            return -1;
+        }
+        select.index = (uint32_t)value;
+    }
+    uint64_t offset = 0;
+    json_extract_uint64(request, "offset", &offset);
+    uint64_t length = STDIO_CHUNK_MAX;
+    if (json_extract_uint64(request, "length", &value) == 0 && value > 0 && value < length) {
+        length = value;
+    }
+
+    unsigned char chunk[STDIO_CHUNK_MAX];
+    storage_stdio_range_t range;
+    flush_persist_task(ctx, task_id);
+    if (storage_read_stdio(&ctx->paths, task_id, stdout_request, &select, offset, chunk, (size_t)length, &range) != 0) {
         return -1;
     }
 
-    char payload[ERRAID_PIPE_MESSAGE_LIMIT];
-    size_t offset = 0;
     char encoded[ERRAID_PIPE_MESSAGE_LIMIT];
     size_t encoded_len = sizeof(encoded);
-    if (utils_base64_encode(target_buf, target_len, encoded, &encoded_len) != 0) {
-        free(stdout_buf);
-        free(stderr_buf);
+    if (utils_base64_encode(chunk, range.length, encoded, &encoded_len) != 0) {
         return -1;
     }
+    uint64_t end = range.offset + range.length;
+    uint64_t next = end < range.total ? end : 0;
 
+    char payload[ERRAID_PIPE_MESSAGE_LIMIT];
+    size_t offset_out = 0;
     if (buffer_append(payload,
                       sizeof(payload),
-                      &offset,
-                      "{\"status\":\"OK\",\"%s\":\"%s\"}",
+                      &offset_out,
+                      "{\"status\":\"OK\",\"%s\":\"%s\",\"epoch\":%lld,\"offset\":%llu,\"total\":%llu,\"next\":%llu}",
                       stdout_request ? "stdout" : "stderr",
-                      encoded)) {
-        free(stdout_buf);
-        free(stderr_buf);
+                      encoded,
+                      (long long)range.epoch,
+                      (unsigned long long)range.offset,
+                      (unsigned long long)range.total,
+                      (unsigned long long)next)) {
         return -1;
     }
-
-    free(stdout_buf);
-    free(stderr_buf);
     return send_json_response(ctx,
                               stdout_request ? MSG_RSP_GET_STDOUT : MSG_RSP_GET_STDERR,
                               payload,
-                              offset);
+                              offset_out);
 }
 
-static int ensure_plan_capacity(erraid_context_t *ctx, size_t capacity) {
-    if (capacity <= ctx->plan_capacity) {
-        return 0;
-    }
-    size_t new_capacity = ctx->plan_capacity == 0 ? 4 : ctx->plan_capacity;
-    while (new_capacity < capacity) {
-        new_capacity *= 2;
-    }
-    schedule_entry_t *tmp = realloc(ctx->plan, new_capacity * sizeof(schedule_entry_t));
-    if (tmp == NULL) {
-        errno = ENOMEM;
-        return -1;
+static int respond_stats(erraid_context_t *ctx) {
+    const erraid_stats_t *stats = &ctx->stats;
+    int64_t now_ms = 0;
+    if (utils_now_epoch_ms(&now_ms) == 0) {
+        admission_sample(&ctx->pressure, now_ms);
     }
-    ctx->plan = tmp;
-    ctx->plan_capacity = new_capacity;
+    char payload[1024];
+    size_t offset = 0;
+    if (buffer_append(payload,
+                      sizeof(payload),
+                      &offset,
+                      "{\"status\":\"OK\",\"stats\":{\"runs_started\":%llu,\"runs_completed\":%llu,"
+                      "\"runs_timed_out\":%llu,\"runs_killed\":%llu,\"firings_skipped\":%llu,"
+                      "\"firings_queued\":%llu,\"retries_scheduled\":%llu,\"firings_deferred\":%llu,"
+                      "\"deferrals_expired\":%llu,\"deferral_ms_total\":%llu,\"launches_prearmed\":%llu,"
+                      "\"launches_cold\":%llu,\"output_pool_hits\":%llu,\"output_pool_misses\":%llu,"
+                      "\"watch_events\":%llu,\"watch_triggers\":%llu,\"chain_triggers\":%llu,"
+                      "\"history_commits\":%llu,\"history_committed\":%llu,\"history_commit_us_total\":%llu,"
+                      "\"history_commit_us_max\":%llu,\"history_batch_max\":%llu,\"persist_waits\":%llu,"
+                      "\"persist_backlog\":%llu,\"history_compactions\":%llu,\"history_compacted\":%llu,"
+                      "\"startup_us\":%llu,\"runs_active\":%zu,"
+                      "\"runs_pending\":%zu,\"timers\":%zu,\"pressure\":%.2f,\"pressure_source\":\"%s\"}}",
+                      (unsigned long long)stats->runs_started,
+                      (unsigned long long)stats->runs_completed,
+                      (unsigned long long)stats->runs_timed_out,
+                      (unsigned long long)stats->runs_killed,
+                      (unsigned long long)stats->firings_skipped,
+                      (unsigned long long)stats->firings_queued,
+                      (unsigned long long)stats->retries_scheduled,
+                      (unsigned long long)stats->firings_deferred,
+                      (unsigned long long)stats->deferrals_expired,
+                      (unsigned long long)stats->deferral_ms_total,
+                      (unsigned long long)stats->launches_prearmed,
+                      (unsigned long long)stats->launches_cold,
+                      (unsigned long long)ctx->output_pool.hits,
+                      (unsigned long long)ctx->output_pool.misses,
+                      (unsigned long long)stats->watch_events,
+                      (unsigned long long)stats->watch_triggers,
+                      (unsigned long long)stats->chain_triggers,
+                      (unsigned long long)stats->history_commits,
+                      (unsigned long long)stats->history_committed,
+                      (unsigned long long)stats->history_commit_us_total,
+                      (unsigned long long)stats->history_commit_us_max,
+                      (unsigned long long)stats->history_batch_max,
+                      (unsigned long long)stats->persist_waits,
+                      (unsigned long long)(persist_submitted(&ctx->persist) - persist_processed(&ctx->persist)),
+                      (unsigned long long)stats->history_compactions,
+                      (unsigned long long)stats->history_compacted,
+                      (unsigned long long)stats->startup_us,
+                      ctx->run_count,
+                      ctx->pending_count,
+                      ctx->timers.count,
+                      admission_level(&ctx->pressure),
+                      ctx->pressure.from_psi ? "psi" : "loadavg")) {
+        return -1;
+    }
+    return send_json_response(ctx, MSG_RSP_STATS, payload, offset);
+}
+
+/* Place réservée à la fin de la réponse GET_RECORDS (start_ms, next). */
+#define RECORDS_TRAILER_RESERVE 96
+
+typedef struct {
+    char *payload;
+    size_t capacity;
+    size_t offset;
+    size_t count;
+    uint64_t next;  /* offset du premier enregistrement non renvoyé, 0 : fenêtre complète */
+} records_page_t;
+
+static int append_record_json(const runlog_record_t *record, const char *data, uint64_t offset, void *arg) {
+    records_page_t *page = (records_page_t *)arg;
+    char encoded[((RUNLOG_MAX_LINE + 2) / 3) * 4 + 1];
+    size_t encoded_len = sizeof(encoded);
+    if (utils_base64_encode(data, record->length, encoded, &encoded_len) != 0) {
+        page->next = offset;
+        return 1;
+    }
+    size_t limit = page->capacity - RECORDS_TRAILER_RESERVE;
+    size_t offset_before = page->offset;
+    if (buffer_append(page->payload,
+                      limit,
+                      &page->offset,
+                      "%s{\"t_us\":%lld,\"stream\":\"%s\",\"data\":\"%s\"}",
+                      page->count > 0 ? "," : "",
+                      (long long)(record->t_ns / 1000),
+                      record->stream == RUNLOG_STREAM_STDERR ? "stderr" : "stdout",
+                      encoded) != 0) {
+        page->offset = offset_before;
+        page->next = offset;
+        return 1;
+    }
+    page->count += 1;
     return 0;
 }
 
-static int rebuild_plan(erraid_context_t *ctx) {
-    if (ensure_plan_capacity(ctx, ctx->task_count) != 0) {
+static int respond_records(erraid_context_t *ctx, const char *request) {
+    uint64_t task_id = 0;
+    if (json_extract_uint64(request, "task_id", &task_id) != 0) {
         return -1;
     }
-    if (ctx->task_count == 0) {
-        ctx->plan_count = 0;
-        return 0;
+    /* Les blocs des exécutions en cours sont écrits par le fil de persistance. */
+    flush_persist_task(ctx, task_id);
+    char task_dir[PATH_MAX];
+    if (storage_task_log_dir(&ctx->paths, task_id, false, task_dir, sizeof(task_dir)) != 0) {
+        return -1;
     }
-
-    int rc = scheduler_compute_plan(ctx->tasks,
+    uint64_t value = 0;
+    int64_t epoch = 0;
+    uint32_t attempt = 1;
+    if (json_extract_uint64(request, "epoch", &value) == 0) {
+        epoch = (int64_t)value;
+        if (json_extract_uint64(request, "attempt", &value) == 0 && value > 0 && value <= UINT32_MAX) {
+            attempt = (uint32_t)value;
+        }
+    } else if (runlog_latest(task_dir, &epoch, &attempt) != 0) {
+        return -1;
+    }
+    int64_t from_ns = 0;
+    int64_t to_ns = INT64_MAX;
+    if (json_extract_uint64(request, "from_ms", &value) == 0) {
+        from_ns = (int64_t)value * 1000000;
+    }
+    if (json_extract_uint64(request, "to_ms", &value) == 0 && value < (uint64_t)(INT64_MAX / 1000000)) {
+        to_ns = (int64_t)value * 1000000 + 999999;
+    }
+    uint64_t cursor = 0;
+    json_extract_uint64(request, "cursor", &cursor);
+
+    char payload[ERRAID_PIPE_MESSAGE_LIMIT];
+    records_page_t page = {payload, sizeof(payload), 0, 0, 0};
+    if (buffer_append(payload,
+                      sizeof(payload),
+                      &page.offset,
+                      "{\"status\":\"OK\",\"epoch\":%lld,\"attempt\":%u,\"records\":[",
+                      (long long)epoch,
+                      (unsigned)attempt) != 0) {
+        return -1;
+    }
+    int64_t start_epoch_ns = 0;
+    if (runlog_read_window(task_dir,
+                           epoch,
+                           attempt,
+                           from_ns,
+                           to_ns,
+                           cursor,
+                           &start_epoch_ns,
+                           append_record_json,
+                           &page) != 0) {
+        return -1;
+    }
+    if (buffer_append(payload,
+                      sizeof(payload),
+                      &page.offset,
+                      "],\"start_ms\":%lld,\"next\":%llu}",
+                      (long long)(start_epoch_ns / 1000000),
+                      (unsigned long long)page.next) != 0) {
+        return -1;
+    }
+    return send_json_response(ctx, MSG_RSP_GET_RECORDS, payload, page.offset);
+}
+
+static int ensure_plan_capacity(erraid_context_t *ctx, size_t capacity) {
+    if (capacity <= ctx->plan_capacity) {
+        return 0;
+    }
+    size_t new_capacity = ctx->plan_capacity == 0 ? 4 : ctx->plan_capacity;
+    while (new_capacity < capacity) {
+        new_capacity *= 2;
+    }
+    schedule_entry_t *tmp = realloc(ctx->plan, new_capacity * sizeof(schedule_entry_t));
+    if (tmp == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    ctx->plan = tmp;
+    ctx->plan_capacity = new_capacity;
+    return 0;
+}
+
+static int push_timer(erraid_context_t *ctx,
+                      scheduler_timer_kind_t kind,
+                      uint64_t task_id,
+                      uint64_t cookie,
+                      int64_t due_ms) {
+    scheduler_timer_t timer;
+    timer.due_ms = due_ms;
+    timer.task_id = task_id;
+    timer.cookie = cookie;
+    timer.kind = kind;
+    return scheduler_queue_push(&ctx->timers, &timer);
+}
+
+/* Minuterie d'occurrence et, si activé, de pré-armement quelques instants avant. */
+static int push_entry_timers(erraid_context_t *ctx, size_t plan_index) {
+    const schedule_entry_t *entry = &ctx->plan[plan_index];
+    runstate_slot_t *slot = task_state(ctx, &ctx->tasks[entry->task_index]);
+    if (slot != NULL && slot->next_epoch != entry->next_epoch) {
+        slot->next_epoch = entry->next_epoch;
+        ctx->runstate.dirty = true;
+    }
+    if (entry->next_epoch < 0) {
+        return 0;
+    }
+    int64_t due_ms = entry->next_epoch * 1000;
+    if (push_timer(ctx, SCHED_TIMER_RUN, entry->task_id, plan_index, due_ms) != 0) {
+        return -1;
+    }
+    if (ctx->prearm_lead_ms > 0 &&
+        push_timer(ctx, SCHED_TIMER_PREARM, entry->task_id, plan_index, due_ms - ctx->prearm_lead_ms) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int compare_dependents(const void *lhs, const void *rhs) {
+    const erraid_dependent_t *a = lhs;
+    const erraid_dependent_t *b = rhs;
+    if (a->upstream_id != b->upstream_id) {
+        return a->upstream_id < b->upstream_id ? -1 : 1;
+    }
+    return a->task_index < b->task_index ? -1 : (a->task_index > b->task_index ? 1 : 0);
+}
+
+/* Index tâche amont -> tâches déclenchées : une recherche dichotomique suffit à la fin d'une exécution. */
+static int rebuild_dependents(erraid_context_t *ctx) {
+    ctx->dependent_count = 0;
+    for (size_t i = 0; i < ctx->task_count; ++i) {
+        if (ctx->tasks[i].policy.after_task_id == 0) {
+            continue;
+        }
+        if (ctx->dependent_count == ctx->dependent_capacity) {
+            size_t new_capacity = ctx->dependent_capacity == 0 ? 8 : ctx->dependent_capacity * 2;
+            erraid_dependent_t *tmp = realloc(ctx->dependents, new_capacity * sizeof(*tmp));
+            if (tmp == NULL) {
+                errno = ENOMEM;
+                return -1;
+            }
+            ctx->dependents = tmp;
+            ctx->dependent_capacity = new_capacity;
+        }
+        erraid_dependent_t *dependent = &ctx->dependents[ctx->dependent_count++];
+        dependent->upstream_id = ctx->tasks[i].policy.after_task_id;
+        dependent->task_index = i;
+    }
+    qsort(ctx->dependents, ctx->dependent_count, sizeof(erraid_dependent_t), compare_dependents);
+    return 0;
+}
+
+static int rebuild_plan(erraid_context_t *ctx) {
+    if (ensure_plan_capacity(ctx, ctx->task_count) != 0) {
+        return -1;
+    }
+    if (rebuild_dependents(ctx) != 0) {
+        return -1;
+    }
+    scheduler_queue_remove_kind(&ctx->timers, SCHED_TIMER_RUN);
+    scheduler_queue_remove_kind(&ctx->timers, SCHED_TIMER_PREARM);
+    if (ctx->task_count == 0) {
+        ctx->plan_count = 0;
+        return 0;
+    }
+
+    int rc = scheduler_compute_plan(ctx->tasks,
                                     ctx->task_count,
                                     time(NULL),
                                     ctx->plan,
@@ -1006,10 +1855,333 @@ static int rebuild_plan(erraid_context_t *ctx) {
         return -1;
     }
     ctx->plan_count = (size_t)rc;
+
+    for (size_t i = 0; i < ctx->plan_count; ++i) {
+        if (push_entry_timers(ctx, i) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static executor_run_t *find_run(erraid_context_t *ctx, uint64_t run_id) {
+    for (size_t i = 0; i < ctx->run_count; ++i) {
+        if (ctx->runs[i].run_id == run_id) {
+            return &ctx->runs[i];
+        }
+    }
+    return NULL;
+}
+
+static executor_run_t *find_run_by_pid(erraid_context_t *ctx, pid_t pid) {
+    for (size_t i = 0; i < ctx->run_count; ++i) {
+        if (ctx->runs[i].pid == pid) {
+            return &ctx->runs[i];
+        }
+    }
+    return NULL;
+}
+
+static int ensure_run_capacity(erraid_context_t *ctx, size_t capacity) {
+    if (capacity <= ctx->run_capacity) {
+        return 0;
+    }
+    size_t new_capacity = ctx->run_capacity == 0 ? 4 : ctx->run_capacity;
+    while (new_capacity < capacity) {
+        new_capacity *= 2;
+    }
+    executor_run_t *tmp = realloc(ctx->runs, new_capacity * sizeof(executor_run_t));
+    if (tmp == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    ctx->runs = tmp;
+    ctx->run_capacity = new_capacity;
     return 0;
 }
 
-static int run_task_instance(erraid_context_t *ctx, schedule_entry_t *entry, int64_t when) {
+static uint32_t run_grace_seconds(const erraid_context_t *ctx, uint64_t task_id) {
+    ssize_t index = context_find_task_index(ctx, task_id);
+    if (index < 0 || ctx->tasks[index].policy.grace_seconds == 0) {
+        return ERRAID_DEFAULT_TIMEOUT_GRACE;
+    }
+    return ctx->tasks[index].policy.grace_seconds;
+}
+
+/* SIGTERM au groupe, puis SIGKILL à l'échéance du délai de grâce. */
+static void terminate_run(erraid_context_t *ctx, executor_run_t *run, int64_t now_ms) {
+    run->stopping = true;
+    executor_signal(run, SIGTERM);
+    int64_t grace_ms = (int64_t)run_grace_seconds(ctx, run->task_id) * 1000;
+    if (push_timer(ctx, SCHED_TIMER_KILL, run->task_id, run->run_id, now_ms + grace_ms) != 0) {
+        executor_signal(run, SIGKILL);
+    }
+}
+
+static size_t count_active_runs(const erraid_context_t *ctx, uint64_t task_id) {
+    size_t count = 0;
+    for (size_t i = 0; i < ctx->run_count; ++i) {
+        if (ctx->runs[i].task_id == task_id && !ctx->runs[i].stopping && !ctx->runs[i].armed) {
+            count += 1;
+        }
+    }
+    return count;
+}
+
+static ssize_t find_pending(const erraid_context_t *ctx, uint64_t task_id) {
+    for (size_t i = 0; i < ctx->pending_count; ++i) {
+        if (ctx->pending[i].task_id == task_id) {
+            return (ssize_t)i;
+        }
+    }
+    return -1;
+}
+
+static int add_pending(erraid_context_t *ctx, uint64_t task_id, int64_t epoch, int64_t deadline_ms) {
+    if (ctx->pending_count >= ctx->pending_capacity) {
+        size_t new_capacity = ctx->pending_capacity == 0 ? 4 : ctx->pending_capacity * 2;
+        erraid_pending_run_t *tmp = realloc(ctx->pending, new_capacity * sizeof(erraid_pending_run_t));
+        if (tmp == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        ctx->pending = tmp;
+        ctx->pending_capacity = new_capacity;
+    }
+    ctx->pending[ctx->pending_count].task_id = task_id;
+    ctx->pending[ctx->pending_count].epoch = epoch;
+    ctx->pending[ctx->pending_count].deadline_ms = deadline_ms;
+    ctx->pending_count += 1;
+    return 0;
+}
+
+static void record_skipped(erraid_context_t *ctx, task_t *task, int64_t when) {
+    task_run_entry_t hist_entry;
+    memset(&hist_entry, 0, sizeof(hist_entry));
+    hist_entry.epoch = when;
+    hist_entry.status = -1;
+    hist_entry.outcome = TASK_RUN_SKIPPED;
+    persist_op_t *op = reserve_persist(ctx);
+    op->kind = PERSIST_OP_HISTORY_ENTRY;
+    op->task_id = task->task_id;
+    op->entry = hist_entry;
+    persist_submit(&ctx->persist);
+    queue_history_commit(ctx);
+    note_history_append(ctx, task);
+    ctx->stats.firings_skipped += 1;
+}
+
+/* Fils pré-armé pour l'occurrence de task_id prévue à deadline_ms. */
+static executor_run_t *find_armed_run(erraid_context_t *ctx, uint64_t task_id, int64_t deadline_ms) {
+    for (size_t i = 0; i < ctx->run_count; ++i) {
+        if (ctx->runs[i].task_id == task_id && ctx->runs[i].armed && !ctx->runs[i].discard &&
+            ctx->runs[i].deadline_ms == deadline_ms) {
+            return &ctx->runs[i];
+        }
+    }
+    return NULL;
+}
+
+static void cancel_armed_run(erraid_context_t *ctx, uint64_t task_id, int64_t deadline_ms) {
+    executor_run_t *run = find_armed_run(ctx, task_id, deadline_ms);
+    if (run != NULL) {
+        executor_cancel(run);
+    }
+}
+
+static void prearm_task(erraid_context_t *ctx, const scheduler_timer_t *timer) {
+    if (timer->cookie >= ctx->plan_count) {
+        return;
+    }
+    schedule_entry_t *entry = &ctx->plan[timer->cookie];
+    if (entry->task_id != timer->task_id || entry->next_epoch < 0 ||
+        entry->next_epoch * 1000 != timer->due_ms + ctx->prearm_lead_ms ||
+        entry->task_index >= ctx->task_count || find_armed_run(ctx, timer->task_id, entry->next_epoch * 1000) != NULL) {
+        return;
+    }
+    const task_t *task = &ctx->tasks[entry->task_index];
+    if (!task->schedule.enabled || task->command_count == 0 || ensure_run_capacity(ctx, ctx->run_count + 1) != 0) {
+        return;
+    }
+    if (executor_prepare(&ctx->runs[ctx->run_count], &ctx->output_pool, task, ++ctx->next_run_id) != 0) {
+        executor_run_free(&ctx->runs[ctx->run_count]);
+        return;
+    }
+    ctx->runs[ctx->run_count].deadline_ms = entry->next_epoch * 1000;
+    ctx->run_count += 1;
+}
+
+/*
+ * Lance l'occurrence when de task, prévue à deadline_ms, en reprenant le fils
+ * pré-armé pour cette même échéance s'il existe. Retourne l'exécution, NULL en cas d'échec.
+ */
+static executor_run_t *launch_run(erraid_context_t *ctx,
+                                  task_t *task,
+                                  int64_t when,
+                                  int64_t deadline_ms,
+                                  int64_t now_ms,
+                                  uint32_t attempt) {
+    executor_run_t *run = (attempt == 1) ? find_armed_run(ctx, task->task_id, deadline_ms) : NULL;
+    if (run != NULL && executor_release(run, when) != 0) {
+        executor_cancel(run);
+        run = NULL;
+    }
+    if (run != NULL) {
+        ctx->stats.launches_prearmed += 1;
+    } else {
+        if (ensure_run_capacity(ctx, ctx->run_count + 1) != 0) {
+            return NULL;
+        }
+        run = &ctx->runs[ctx->run_count];
+        if (executor_start(run, &ctx->output_pool, task, ++ctx->next_run_id, when) != 0) {
+            return NULL;
+        }
+        ctx->run_count += 1;
+        ctx->stats.launches_cold += 1;
+    }
+    run->attempt = attempt;
+    run->deadline_ms = deadline_ms;
+    if (task->policy.capture == TASK_CAPTURE_LINES &&
+        runlog_open(&run->records, task->task_id, when, attempt, run->result.usage.start_ns, submit_runlog_chunk, ctx) !=
+            0) {
+        log_fd(STDERR_FILENO, "erraid: journal horodaté indisponible pour %llu (%s)\n",
+               (unsigned long long)task->task_id, strerror(errno));
+    }
+    /* Une nouvelle occurrence planifiée remplace toute tentative encore programmée. */
+    if (attempt == 1) {
+        task->retry_token = 0;
+    }
+    ctx->stats.runs_started += 1;
+
+    if (task->policy.timeout_seconds > 0) {
+        int64_t due_ms = now_ms + (int64_t)task->policy.timeout_seconds * 1000;
+        if (push_timer(ctx, SCHED_TIMER_TIMEOUT, task->task_id, run->run_id, due_ms) != 0) {
+            return NULL;
+        }
+    }
+    return run;
+}
+
+static bool pressure_exceeded(erraid_context_t *ctx, const task_t *task, int64_t now_ms) {
+    if (task->policy.defer_pressure_percent == 0) {
+        return false;
+    }
+    /* Sans mesure disponible, l'occurrence est admise. */
+    if (admission_sample(&ctx->pressure, now_ms) != 0) {
+        return false;
+    }
+    return admission_level(&ctx->pressure) >= (double)task->policy.defer_pressure_percent;
+}
+
+static int64_t defer_limit_ms(const task_t *task) {
+    uint32_t max_seconds = task->policy.defer_max_seconds != 0 ? task->policy.defer_max_seconds
+                                                               : ERRAID_DEFAULT_DEFER_MAX;
+    return task->defer_since_ms + (int64_t)max_seconds * 1000;
+}
+
+static int push_admit_timer(erraid_context_t *ctx, const task_t *task, int64_t now_ms) {
+    int64_t due_ms = now_ms + ERRAID_ADMISSION_RECHECK_MS;
+    int64_t limit_ms = defer_limit_ms(task);
+    if (due_ms > limit_ms) {
+        due_ms = limit_ms;
+    }
+    return push_timer(ctx, SCHED_TIMER_ADMIT, task->task_id, task->defer_token, due_ms);
+}
+
+/* Contrôle d'admission : une tâche différable est reportée tant que la pression dépasse son seuil. */
+static int admit_run(erraid_context_t *ctx, task_t *task, int64_t when, int64_t deadline_ms, int64_t now_ms) {
+    if (!pressure_exceeded(ctx, task, now_ms)) {
+        return launch_run(ctx, task, when, deadline_ms, now_ms, 1) != NULL ? 0 : -1;
+    }
+    task->defer_token = ++ctx->next_token;
+    task->defer_epoch = when;
+    task->defer_deadline_ms = deadline_ms;
+    task->defer_since_ms = now_ms;
+    if (push_admit_timer(ctx, task, now_ms) != 0) {
+        task->defer_token = 0;
+        return launch_run(ctx, task, when, deadline_ms, now_ms, 1) != NULL ? 0 : -1;
+    }
+    ctx->stats.firings_deferred += 1;
+    return 0;
+}
+
+static void handle_admit_timer(erraid_context_t *ctx, const scheduler_timer_t *timer, int64_t now_ms) {
+    ssize_t index = context_find_task_index(ctx, timer->task_id);
+    if (index < 0 || ctx->tasks[index].defer_token != timer->cookie) {
+        return;
+    }
+    task_t *task = &ctx->tasks[index];
+    bool expired = now_ms >= defer_limit_ms(task);
+    if (!expired && pressure_exceeded(ctx, task, now_ms) && push_admit_timer(ctx, task, now_ms) == 0) {
+        return;
+    }
+
+    task->defer_token = 0;
+    int64_t deferred_ms = now_ms - task->defer_since_ms;
+    ctx->stats.deferral_ms_total += (uint64_t)deferred_ms;
+    if (expired) {
+        ctx->stats.deferrals_expired += 1;
+    }
+    executor_run_t *run = launch_run(ctx, task, task->defer_epoch, task->defer_deadline_ms, now_ms, 1);
+    if (run != NULL) {
+        run->deferred_ms = deferred_ms;
+    }
+}
+
+/*
+ * Occurrence d'une tâche, planifiée ou déclenchée : politique de chevauchement puis admission.
+ * deadline_ms est l'instant où elle était due, dont lag_us mesure l'écart.
+ */
+static int fire_task(erraid_context_t *ctx, task_t *task, int64_t when, int64_t deadline_ms, int64_t now_ms) {
+    if (task->command_count == 0) {
+        return 0;
+    }
+
+    /* Une occurrence précédente attend encore son admission. */
+    if (task->defer_token != 0) {
+        record_skipped(ctx, task, when);
+        return 0;
+    }
+
+    size_t active = count_active_runs(ctx, task->task_id);
+    if (active > 0) {
+        switch (task->policy.overlap) {
+            case TASK_OVERLAP_QUEUE:
+                /* Une seule occurrence en attente : les suivantes sont ignorées. */
+                if (find_pending(ctx, task->task_id) >= 0) {
+                    record_skipped(ctx, task, when);
+                    return 0;
+                }
+                if (add_pending(ctx, task->task_id, when, deadline_ms) != 0) {
+                    return -1;
+                }
+                ctx->stats.firings_queued += 1;
+                return 0;
+            case TASK_OVERLAP_SKIP:
+                record_skipped(ctx, task, when);
+                return 0;
+            case TASK_OVERLAP_CONCURRENT:
+                if (active >= task->policy.max_concurrent) {
+                    record_skipped(ctx, task, when);
+                    return 0;
+                }
+                break;
+            case TASK_OVERLAP_KILL:
+                for (size_t i = 0; i < ctx->run_count; ++i) {
+                    executor_run_t *run = &ctx->runs[i];
+                    if (run->task_id == task->task_id && !run->stopping && !run->armed) {
+                        run->outcome = TASK_RUN_KILLED;
+                        terminate_run(ctx, run, now_ms);
+                    }
+                }
+                break;
+        }
+    }
+
+    return admit_run(ctx, task, when, deadline_ms, now_ms);
+}
+
+static int start_task_run(erraid_context_t *ctx, schedule_entry_t *entry, int64_t now_ms) {
     if (entry->task_index >= ctx->task_count) {
         errno = EINVAL;
         return -1;
@@ -1020,69 +2192,390 @@ static int run_task_instance(erraid_context_t *ctx, schedule_entry_t *entry, int
         return 0;
     }
 
+    /* Échéance relevée avant le calcul de la suivante : un réveil tardif compte dans lag_us. */
+    int64_t deadline_ms = entry->next_epoch * 1000;
+    int64_t when = now_ms / 1000;
+    entry->next_epoch = scheduler_next_occurrence(&task->schedule, when);
+    push_entry_timers(ctx, (size_t)(entry - ctx->plan));
+
+    return fire_task(ctx, task, when, deadline_ms, now_ms);
+}
+
+static int64_t watch_debounce_ms(const task_t *task) {
+    return task->policy.watch_debounce_ms != 0 ? (int64_t)task->policy.watch_debounce_ms
+                                               : ERRAID_DEFAULT_WATCH_DEBOUNCE_MS;
+}
+
+static uint32_t watch_events_of(const task_t *task) {
+    return task->policy.watch_events != 0 ? task->policy.watch_events : TASK_WATCH_ALL;
+}
+
+/* Pose les surveillances manquantes ; un chemin absent est retenté à la prochaine modification des tâches. */
+static void sync_watches(erraid_context_t *ctx) {
+    if (ctx->watch_fd < 0) {
+        return;
+    }
+    for (size_t i = 0; i < ctx->task_count; ++i) {
+        task_t *task = &ctx->tasks[i];
+        if (task->watch_path == NULL || task->watch_wd > 0 || task->command_count == 0) {
+            continue;
+        }
+        int wd = watch_add(ctx->watch_fd, task->watch_path);
+        if (wd < 0) {
+            log_fd(STDERR_FILENO, "erraid: surveillance de %s impossible (%s)\n", task->watch_path, strerror(errno));
+            continue;
+        }
+        task->watch_wd = wd;
+    }
+}
+
+/* Retire la surveillance wd si plus aucune tâche ne l'utilise. */
+static void release_watch(erraid_context_t *ctx, int wd) {
+    if (wd <= 0) {
+        return;
+    }
+    for (size_t i = 0; i < ctx->task_count; ++i) {
+        if (ctx->tasks[i].watch_wd == wd) {
+            return;
+        }
+    }
+    watch_remove(ctx->watch_fd, wd);
+}
+
+/* Le premier événement d'un lot arme le minuteur ; les suivants ne font que repousser l'échéance. */
+static void note_watch_event(erraid_context_t *ctx, task_t *task, int64_t now_ms) {
+    ctx->stats.watch_events += 1;
+    task->watch_last_ms = now_ms;
+    if (task->watch_pending++ > 0) {
+        return;
+    }
+    task->watch_first_ms = now_ms;
+    task->watch_token = ++ctx->next_token;
+    push_timer(ctx, SCHED_TIMER_WATCH, task->task_id, task->watch_token, now_ms + watch_debounce_ms(task));
+}
+
+static void handle_watch_event(int wd, uint32_t events, void *arg) {
+    erraid_context_t *ctx = (erraid_context_t *)arg;
+    int64_t now_ms = 0;
+    utils_now_epoch_ms(&now_ms);
+    for (size_t i = 0; i < ctx->task_count; ++i) {
+        task_t *task = &ctx->tasks[i];
+        if (task->watch_wd <= 0 || (wd >= 0 && task->watch_wd != wd)) {
+            continue;
+        }
+        if (events == 0) {
+            /* Chemin supprimé : la surveillance sera reposée par sync_watches. */
+            task->watch_wd = 0;
+            continue;
+        }
+        if ((watch_events_of(task) & events) != 0) {
+            note_watch_event(ctx, task, now_ms);
+        }
+    }
+}
+
+/* Fin d'anti-rebond : un silence de watch.debounce, dans la limite de ERRAID_WATCH_BATCH_FACTOR fois ce délai. */
+static void handle_watch_timer(erraid_context_t *ctx, const scheduler_timer_t *timer, int64_t now_ms) {
+    ssize_t index = context_find_task_index(ctx, timer->task_id);
+    if (index < 0) {
+        return;
+    }
+    task_t *task = &ctx->tasks[index];
+    if (task->watch_token != timer->cookie || task->watch_pending == 0) {
+        return;
+    }
+    int64_t debounce_ms = watch_debounce_ms(task);
+    int64_t due_ms = task->watch_last_ms + debounce_ms;
+    int64_t limit_ms = task->watch_first_ms + debounce_ms * ERRAID_WATCH_BATCH_FACTOR;
+    if (due_ms > limit_ms) {
+        due_ms = limit_ms;
+    }
+    if (due_ms > now_ms) {
+        push_timer(ctx, SCHED_TIMER_WATCH, task->task_id, task->watch_token, due_ms);
+        return;
+    }
+    task->watch_pending = 0;
+    task->watch_token = 0;
+    ctx->stats.watch_triggers += 1;
+    fire_task(ctx, task, now_ms / 1000, due_ms, now_ms);
+}
+
+/* Délai exponentiel : retry.delay * 2^(n-1), plafonné par retry.cap, puis ± retry.jitter %. */
+static int64_t retry_delay_ms(const task_policy_t *policy, uint32_t retry_index) {
+    int64_t base_ms = (int64_t)(policy->retry_delay_seconds != 0 ? policy->retry_delay_seconds
+                                                                  : ERRAID_DEFAULT_RETRY_DELAY) * 1000;
+    int64_t cap_ms = (int64_t)(policy->retry_cap_seconds != 0 ? policy->retry_cap_seconds
+                                                               : ERRAID_DEFAULT_RETRY_CAP) * 1000;
+    int64_t delay_ms = base_ms;
+    for (uint32_t i = 1; i < retry_index && delay_ms < cap_ms; ++i) {
+        delay_ms *= 2;
+    }
+    if (delay_ms > cap_ms) {
+        delay_ms = cap_ms;
+    }
+    if (policy->retry_jitter_percent > 0) {
+        int64_t spread = delay_ms * (int64_t)policy->retry_jitter_percent / 100;
+        if (spread > 0) {
+            delay_ms += (int64_t)(random() % (2 * spread + 1)) - spread;
+        }
+    }
+    return delay_ms;
+}
+
+static void schedule_retry(erraid_context_t *ctx, task_t *task, uint32_t attempt) {
+    int64_t now_ms = 0;
+    if (utils_now_epoch_ms(&now_ms) != 0) {
+        return;
+    }
+    task->retry_token = ++ctx->next_token;
+    task->retry_attempt = attempt;
+    int64_t due_ms = now_ms + retry_delay_ms(&task->policy, attempt - 1);
+    if (push_timer(ctx, SCHED_TIMER_RETRY, task->task_id, task->retry_token, due_ms) != 0) {
+        task->retry_token = 0;
+        return;
+    }
+    ctx->stats.retries_scheduled += 1;
+}
+
+static bool after_matches(task_after_t after_on, bool succeeded) {
+    switch (after_on) {
+        case TASK_AFTER_SUCCESS: return succeeded;
+        case TASK_AFTER_FAILURE: return !succeeded;
+        case TASK_AFTER_ANY: return true;
+    }
+    return false;
+}
+
+/* Lance les tâches déclarant after=task_id dont le filtre after.on correspond au résultat. */
+static void trigger_dependents(erraid_context_t *ctx, uint64_t task_id, bool succeeded) {
+    size_t low = first_dependent(ctx, task_id);
+    if (low == ctx->dependent_count) {
+        return;
+    }
+
+    int64_t now_ms = 0;
+    utils_now_epoch_ms(&now_ms);
+    for (size_t i = low; i < ctx->dependent_count && ctx->dependents[i].upstream_id == task_id; ++i) {
+        task_t *dependent = &ctx->tasks[ctx->dependents[i].task_index];
+        if (!after_matches(dependent->policy.after_on, succeeded)) {
+            continue;
+        }
+        ctx->stats.chain_triggers += 1;
+        fire_task(ctx, dependent, now_ms / 1000, now_ms, now_ms);
+    }
+}
+
+static void update_run_stats(erraid_stats_t *stats, task_run_outcome_t outcome) {
+    stats->runs_completed += 1;
+    if (outcome == TASK_RUN_TIMEOUT) {
+        stats->runs_timed_out += 1;
+    } else if (outcome == TASK_RUN_KILLED) {
+        stats->runs_killed += 1;
+    }
+}
+
+static void complete_run(erraid_context_t *ctx, size_t run_index) {
+    executor_run_t *run = &ctx->runs[run_index];
+    uint64_t task_id = run->task_id;
+    int64_t when = run->epoch;
+    task_run_outcome_t outcome = run->outcome;
+    uint32_t attempt = run->attempt;
+    int64_t deferred_ms = run->deferred_ms;
+    int64_t deadline_ms = run->deadline_ms;
+    bool discarded = run->armed || run->discard;
+
     executor_result_t result;
-    memset(&result, 0, sizeof(result));
+    executor_finish(run, &result);
+    ctx->runs[run_index] = ctx->runs[ctx->run_count - 1];
+    ctx->run_count -= 1;
+    /* Pré-armement annulé ou fils disparu avant l'échéance. */
+    if (discarded) {
+        executor_result_free(&result);
+        return;
+    }
+    update_run_stats(&ctx->stats, outcome);
 
-    int exec_rc = executor_run_task(task, &result);
+    int64_t pending_epoch = -1;
+    int64_t pending_deadline_ms = 0;
+    ssize_t pending = find_pending(ctx, task_id);
+    if (pending >= 0) {
+        pending_epoch = ctx->pending[pending].epoch;
+        pending_deadline_ms = ctx->pending[pending].deadline_ms;
+        ctx->pending[pending] = ctx->pending[ctx->pending_count - 1];
+        ctx->pending_count -= 1;
+    }
+
+    /* Tâche supprimée pendant l'exécution : rien à enregistrer. */
+    ssize_t index = context_find_task_index(ctx, task_id);
+    if (index < 0) {
+        executor_result_free(&result);
+        return;
+    }
+    task_t *task = &ctx->tasks[index];
 
     task_run_entry_t hist_entry;
+    memset(&hist_entry, 0, sizeof(hist_entry));
     hist_entry.epoch = when;
-    hist_entry.status = (exec_rc == 0) ? result.status : -1;
+    hist_entry.status = result.status;
     hist_entry.stdout_len = result.stdout_len;
     hist_entry.stderr_len = result.stderr_len;
+    hist_entry.usage = result.usage;
+    hist_entry.limits_hit = result.limits_hit;
+    hist_entry.outcome = outcome;
+    hist_entry.attempt = attempt;
+    hist_entry.deferred_ms = deferred_ms;
+    if (result.exec_epoch_ns > 0) {
+        hist_entry.lag_us = result.exec_epoch_ns / 1000 - deadline_ms * 1000;
+    }
+
+    /* Les tampons de sortie suivent l'opération ; reap_persist les rend à la réserve. */
+    persist_op_t *op = reserve_persist(ctx);
+    op->kind = PERSIST_OP_HISTORY;
+    op->task_id = task->task_id;
+    op->entry = hist_entry;
+    op->result = result;
+    persist_submit(&ctx->persist);
+    queue_history_commit(ctx);
+    note_history_append(ctx, task);
+
+    /* Seul l'état d'exécution change : la définition dans le catalogue reste intacte. */
+    task->last_run_epoch = when;
+    runstate_slot_t *slot = task_state(ctx, task);
+    if (slot != NULL) {
+        slot->last_run_epoch = when;
+        slot->runs += 1;
+        if (hist_entry.status != 0) {
+            slot->failures += 1;
+        }
+        slot->last_status = hist_entry.status;
+        ctx->runstate.dirty = true;
+    }
 
-    const void *stdout_payload = result.stdout_buf;
-    size_t stdout_len = result.stdout_len;
-    const void *stderr_payload = result.stderr_buf;
-    size_t stderr_len = result.stderr_len;
-
-    if (exec_rc != 0) {
-        stdout_payload = NULL;
-        stdout_len = 0;
-        stderr_payload = NULL;
-        stderr_len = 0;
+    bool failed = (outcome == TASK_RUN_COMPLETED || outcome == TASK_RUN_TIMEOUT) && hist_entry.status != 0;
+    bool retrying = failed && !ctx->should_quit && attempt <= task->policy.retry_max;
+    if (retrying) {
+        schedule_retry(ctx, task, attempt + 1);
     }
 
-    storage_append_history(&ctx->paths,
-                           task->task_id,
-                           &hist_entry,
-                           stdout_payload,
-                           stdout_len,
-                           stderr_payload,
-                           stderr_len);
+    /* Les tâches dépendantes ne voient que le résultat final, après les nouvelles tentatives. */
+    if (!retrying && !ctx->should_quit) {
+        trigger_dependents(ctx, task_id, outcome == TASK_RUN_COMPLETED && hist_entry.status == 0);
+    }
 
-    if (result.stdout_truncated || result.stderr_truncated) {
-        const char *log_dir = ctx->logs_dir;
-        (void)log_dir; /* rotation future : stub */
+    if (pending_epoch >= 0 && !ctx->should_quit) {
+        int64_t now_ms = 0;
+        utils_now_epoch_ms(&now_ms);
+        /* L'occurrence mise en attente passe, comme les autres, par le contrôle d'admission. */
+        admit_run(ctx, task, pending_epoch, pending_deadline_ms, now_ms);
     }
+}
 
-    task->last_run_epoch = when;
-    storage_write_task(&ctx->paths, task);
+static void reap_children(erraid_context_t *ctx) {
+    for (;;) {
+        int status = 0;
+        struct rusage ru;
+        memset(&ru, 0, sizeof(ru));
+        pid_t pid = wait4(-1, &status, WNOHANG, &ru);
+        if (pid < 0 && errno == EINTR) {
+            continue;
+        }
+        if (pid <= 0) {
+            break;
+        }
+        executor_run_t *run = find_run_by_pid(ctx, pid);
+        if (run != NULL) {
+            executor_child_exited(run, status, &ru);
+        }
+    }
+}
 
-    executor_result_free(&result);
+static void advance_runs(erraid_context_t *ctx) {
+    size_t i = 0;
+    while (i < ctx->run_count) {
+        executor_run_t *run = &ctx->runs[i];
+        ssize_t index = context_find_task_index(ctx, run->task_id);
+        const task_t *task = (index >= 0) ? &ctx->tasks[index] : NULL;
+        if (executor_step(run, task) != 0) {
+            complete_run(ctx, i);
+            continue;
+        }
+        i += 1;
+    }
+}
 
-    entry->next_epoch = scheduler_next_occurrence(&task->schedule, when);
-    return 0;
+static void handle_run_timer(erraid_context_t *ctx, const scheduler_timer_t *timer, int64_t now_ms) {
+    executor_run_t *run = find_run(ctx, timer->cookie);
+    if (run == NULL) {
+        return;
+    }
+    if (timer->kind == SCHED_TIMER_TIMEOUT) {
+        run->outcome = TASK_RUN_TIMEOUT;
+        terminate_run(ctx, run, now_ms);
+    } else {
+        executor_signal(run, SIGKILL);
+    }
 }
 
-static int process_due_tasks(erraid_context_t *ctx) {
-    while (!ctx->should_quit) {
-        int64_t now;
-        if (utils_now_epoch(&now) != 0) {
-            return -1;
-        }
+static int process_due_timers(erraid_context_t *ctx) {
+    int64_t now_ms;
+    if (utils_now_epoch_ms(&now_ms) != 0) {
+        return -1;
+    }
 
-        bool executed = false;
-        for (size_t i = 0; i < ctx->plan_count; ++i) {
-            schedule_entry_t *entry = &ctx->plan[i];
-            if (entry->next_epoch >= 0 && entry->next_epoch <= now) {
-                executed = true;
-                run_task_instance(ctx, entry, now);
-            }
-        }
+    const scheduler_timer_t *top;
+    while ((top = scheduler_queue_peek(&ctx->timers)) != NULL && top->due_ms <= now_ms) {
+        scheduler_timer_t timer;
+        scheduler_queue_pop(&ctx->timers, &timer);
 
-        if (!executed) {
-            break;
+        switch (timer.kind) {
+            case SCHED_TIMER_RUN: {
+                if (ctx->should_quit || timer.cookie >= ctx->plan_count) {
+                    break;
+                }
+                schedule_entry_t *entry = &ctx->plan[timer.cookie];
+                /* Entrée périmée : plan reconstruit ou occurrence déjà traitée. */
+                if (entry->task_id != timer.task_id || entry->next_epoch < 0 ||
+                    entry->next_epoch * 1000 != timer.due_ms) {
+                    break;
+                }
+                start_task_run(ctx, entry, now_ms);
+                /* Occurrence ignorée, différée ou mise en attente : le fils pré-armé ne sert plus. */
+                cancel_armed_run(ctx, timer.task_id, timer.due_ms);
+                break;
+            }
+            case SCHED_TIMER_PREARM:
+                if (!ctx->should_quit) {
+                    prearm_task(ctx, &timer);
+                }
+                break;
+            case SCHED_TIMER_WATCH:
+                if (!ctx->should_quit) {
+                    handle_watch_timer(ctx, &timer, now_ms);
+                }
+                break;
+            case SCHED_TIMER_TIMEOUT:
+            case SCHED_TIMER_KILL:
+                handle_run_timer(ctx, &timer, now_ms);
+                break;
+            case SCHED_TIMER_ADMIT:
+                if (!ctx->should_quit) {
+                    handle_admit_timer(ctx, &timer, now_ms);
+                }
+                break;
+            case SCHED_TIMER_RETRY: {
+                ssize_t index = context_find_task_index(ctx, timer.task_id);
+                if (ctx->should_quit || index < 0 || ctx->tasks[index].retry_token != timer.cookie) {
+                    break;
+                }
+                task_t *task = &ctx->tasks[index];
+                task->retry_token = 0;
+                /* Une exécution plus récente est déjà en cours : elle gère ses propres tentatives. */
+                if (count_active_runs(ctx, task->task_id) > 0) {
+                    break;
+                }
+                launch_run(ctx, task, now_ms / 1000, timer.due_ms, now_ms, task->retry_attempt);
+                break;
+            }
         }
     }
     return 0;
@@ -1117,18 +2610,90 @@ static int process_requests(erraid_context_t *ctx) {
     return 0;
 }
 
-static int64_t next_deadline(const erraid_context_t *ctx) {
-    int64_t best = -1;
-    for (size_t i = 0; i < ctx->plan_count; ++i) {
-        int64_t ts = ctx->plan[i].next_epoch;
-        if (ts < 0) {
-            continue;
+/* Emplacements fixes de ctx->pollfds, suivis des flux des exécutions. */
+#define POLL_SLOT_REQUEST 0
+#define POLL_SLOT_WAKE 1
+#define POLL_SLOT_WATCH 2
+#define POLL_FIXED_SLOTS 3
+
+static ssize_t build_pollfds(erraid_context_t *ctx) {
+    size_t needed = POLL_FIXED_SLOTS + ctx->run_count * 2;
+    if (needed > ctx->pollfd_capacity) {
+        struct pollfd *tmp = realloc(ctx->pollfds, needed * sizeof(struct pollfd));
+        if (tmp == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        ctx->pollfds = tmp;
+        ctx->pollfd_capacity = needed;
+    }
+
+    size_t count = 0;
+    memset(ctx->pollfds, 0, needed * sizeof(struct pollfd));
+    ctx->pollfds[count].fd = ctx->request_fd;
+    ctx->pollfds[count++].events = POLLIN;
+    ctx->pollfds[count].fd = ctx->wake_pipe[0];
+    ctx->pollfds[count++].events = POLLIN;
+    ctx->pollfds[count].fd = ctx->watch_fd; /* -1 : ignoré par poll */
+    ctx->pollfds[count++].events = POLLIN;
+    for (size_t i = 0; i < ctx->run_count; ++i) {
+        const executor_run_t *run = &ctx->runs[i];
+        if (run->stdout_fd >= 0) {
+            ctx->pollfds[count].fd = run->stdout_fd;
+            ctx->pollfds[count++].events = POLLIN;
         }
-        if (best < 0 || ts < best) {
-            best = ts;
+        if (run->stderr_fd >= 0) {
+            ctx->pollfds[count].fd = run->stderr_fd;
+            ctx->pollfds[count++].events = POLLIN;
         }
     }
-    return best;
+    return (ssize_t)count;
+}
+
+static void dispatch_run_output(erraid_context_t *ctx) {
+    size_t slot = POLL_FIXED_SLOTS;
+    for (size_t i = 0; i < ctx->run_count; ++i) {
+        executor_run_t *run = &ctx->runs[i];
+        int fds[2] = {run->stdout_fd, run->stderr_fd};
+        for (size_t j = 0; j < ARRAY_SIZE(fds); ++j) {
+            if (fds[j] < 0) {
+                continue;
+            }
+            if (ctx->pollfds[slot].revents != 0) {
+                executor_read_output(run, fds[j]);
+            }
+            slot += 1;
+        }
+    }
+}
+
+static int poll_timeout_ms(const erraid_context_t *ctx) {
+    const scheduler_timer_t *top = scheduler_queue_peek(&ctx->timers);
+    int64_t due_ms = (top != NULL) ? top->due_ms : -1;
+    if (ctx->runstate.sync_due_ms >= 0 && (due_ms < 0 || ctx->runstate.sync_due_ms < due_ms)) {
+        due_ms = ctx->runstate.sync_due_ms;
+    }
+    if (ctx->group_commit.due_ms >= 0 && (due_ms < 0 || ctx->group_commit.due_ms < due_ms)) {
+        due_ms = ctx->group_commit.due_ms;
+    }
+    if (due_ms < 0 || ctx->compact_due_ms < due_ms) {
+        due_ms = ctx->compact_due_ms;
+    }
+    if (due_ms < 0) {
+        return -1;
+    }
+    int64_t now_ms;
+    if (utils_now_epoch_ms(&now_ms) != 0) {
+        return 0;
+    }
+    int64_t diff = due_ms - now_ms;
+    if (diff < 0) {
+        diff = 0;
+    }
+    if (diff > (int64_t)INT_MAX) {
+        diff = (int64_t)INT_MAX;
+    }
+    return (int)diff;
 }
 
 static int build_paths(erraid_context_t *ctx, const char *run_dir) {
@@ -1183,26 +2748,136 @@ static int build_paths(erraid_context_t *ctx, const char *run_dir) {
     return 0;
 }
 
-int erraid_init(erraid_context_t *ctx, const char *run_dir) {
-    if (ctx == NULL) {
-        errno = EINVAL;
-        return -1;
-    }
-
+/* Contexte vide, descripteurs à -1 : erraid_shutdown peut être appelé à tout moment. */
+static void reset_context(erraid_context_t *ctx) {
     memset(ctx, 0, sizeof(*ctx));
     ctx->request_fd = -1;
     ctx->reply_fd = -1;
     ctx->request_dummy_fd = -1;
     ctx->wake_pipe[0] = -1;
     ctx->wake_pipe[1] = -1;
+    ctx->watch_fd = -1;
+    ctx->catalog.wal_fd = -1;
+    ctx->catalog.dir_fd = -1;
+    ctx->runstate.fd = -1;
+    ctx->runstate.sync_due_ms = -1;
+    ctx->group_commit.due_ms = -1;
+    storage_dirs_init(&ctx->dirs);
+}
+
+/* Ajoute au catalogue les fichiers <ID>.task de dir ; une tâche de même identifiant est remplacée. */
+/*
+ * Fichiers .task de dir ajoutés au catalogue par un seul point de contrôle :
+ * un catalog_put par tâche coûterait un fdatasync chacune et laisserait un
+ * journal aussi gros qu'un instantané. Les tâches déjà cataloguées sont
+ * conservées, remplacées par le fichier importé de même identifiant.
+ */
+static int import_text_tasks(erraid_context_t *ctx, const char *dir, size_t *count_out) {
+    storage_paths_t source = ctx->paths;
+    source.tasks_dir = dir;
+    source.dirs = NULL;
+    task_t *tasks = NULL;
+    size_t count = 0;
+    task_t *existing = NULL;
+    size_t existing_count = 0;
+    if (storage_load_tasks(&source, &tasks, &count) != 0) {
+        return -1;
+    }
+    if (!ctx->catalog.fresh && catalog_load(&ctx->catalog, &existing, &existing_count) != 0) {
+        int saved_errno = errno;
+        storage_free_tasks(tasks, count);
+        errno = saved_errno;
+        return -1;
+    }
+
+    /* Fusion des deux tableaux triés par identifiant ; copies superficielles, libérées avec leurs sources. */
+    int rc = 0;
+    task_t *merged = (count + existing_count > 0) ? malloc((count + existing_count) * sizeof(task_t)) : NULL;
+    size_t merged_count = 0;
+    if (merged == NULL && count + existing_count > 0) {
+        rc = -1;
+    }
+    for (size_t i = 0, j = 0; rc == 0 && (i < count || j < existing_count);) {
+        if (j == existing_count || (i < count && tasks[i].task_id <= existing[j].task_id)) {
+            if (j < existing_count && existing[j].task_id == tasks[i].task_id) {
+                j += 1;
+            }
+            merged[merged_count++] = tasks[i++];
+        } else {
+            merged[merged_count++] = existing[j++];
+        }
+    }
+    if (rc == 0 && count > 0) {
+        rc = catalog_checkpoint(&ctx->catalog, merged, merged_count);
+    }
+    if (rc == 0 && count > 0) {
+        rc = storage_reserve_task_ids(&ctx->paths, tasks[count - 1].task_id + 1);
+    }
+    int saved_errno = errno;
+    free(merged);
+    storage_free_tasks(existing, existing_count);
+    storage_free_tasks(tasks, count);
+    errno = saved_errno;
+    if (rc == 0 && count_out != NULL) {
+        *count_out = count;
+    }
+    return rc;
+}
+
+/* Répertoires et catalogue ; au premier démarrage, les anciens fichiers .task sont importés. */
+static int open_catalog(erraid_context_t *ctx, const erraid_config_t *config) {
+    if (build_paths(ctx, config->run_dir) != 0) {
+        return -1;
+    }
+    if (storage_init_directories(&ctx->paths) != 0 || storage_load_layout(&ctx->paths) != 0 ||
+        storage_dirs_open(&ctx->dirs, &ctx->paths) != 0) {
+        return -1;
+    }
+    ctx->paths.dirs = &ctx->dirs;
+    if (catalog_open(&ctx->catalog, ctx->tasks_dir) != 0) {
+        return -1;
+    }
+    if (ctx->catalog.fresh && import_text_tasks(ctx, ctx->tasks_dir, NULL) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+void erraid_config_defaults(erraid_config_t *config) {
+    if (config == NULL) {
+        return;
+    }
+    memset(config, 0, sizeof(*config));
+    config->prearm_lead_ms = ERRAID_DEFAULT_PREARM_MS;
+    config->state_sync = RUNSTATE_SYNC_INTERVAL;
+    config->state_sync_ms = RUNSTATE_DEFAULT_SYNC_MS;
+    config->history_durability = STORAGE_DURABILITY_STRICT;
+    config->history_group_ms = ERRAID_DEFAULT_GROUP_MS;
+    config->history_group_runs = ERRAID_DEFAULT_GROUP_RUNS;
+}
 
-    if (build_paths(ctx, run_dir) != 0) {
+int erraid_init(erraid_context_t *ctx, const erraid_config_t *config) {
+    if (ctx == NULL || config == NULL) {
+        errno = EINVAL;
         return -1;
     }
 
-    if (storage_init_directories(&ctx->paths) != 0) {
+    int64_t started_ns = 0;
+    utils_now_monotonic_ns(&started_ns);
+    reset_context(ctx);
+
+    ctx->prearm_lead_ms = config->prearm_lead_ms;
+
+    if (open_catalog(ctx, config) != 0) {
+        return -1;
+    }
+    if (runstate_open(&ctx->runstate, ctx->state_dir, config->state_sync, config->state_sync_ms) != 0) {
         return -1;
     }
+    ctx->paths.durability = config->history_durability;
+    ctx->group_commit.window_ms = config->history_group_ms > 0 ? config->history_group_ms : ERRAID_DEFAULT_GROUP_MS;
+    ctx->group_commit.max_runs = config->history_group_runs > 0 ? config->history_group_runs : ERRAID_DEFAULT_GROUP_RUNS;
+    ctx->retention = config->history_retention;
 
     if (mkfifo(ctx->request_pipe_path, 0600) != 0) {
         if (errno != EEXIST) {
@@ -1242,10 +2917,38 @@ int erraid_init(erraid_context_t *ctx, const char *run_dir) {
         return -1;
     }
 
+    if (executor_pool_init(&ctx->output_pool, EXECUTOR_POOL_DEFAULT_BUFFERS) != 0) {
+        return -1;
+    }
+
+    if (storage_load_next_task_id(&ctx->paths, &ctx->next_task_id) != 0) {
+        return -1;
+    }
+    if (persist_start(&ctx->persist, &ctx->paths, ctx->wake_pipe[1]) != 0) {
+        return -1;
+    }
+
+    /* Sans inotify, les tâches watch.path ne sont simplement jamais déclenchées. */
+    ctx->watch_fd = watch_open();
+    if (ctx->watch_fd < 0) {
+        log_fd(STDERR_FILENO, "erraid: inotify indisponible (%s)\n", strerror(errno));
+    }
+
     if (erraid_reload_tasks(ctx) != 0) {
         return -1;
     }
+    /* Premier bail écrit avant toute création ; le fil de persistance n'a encore rien à faire. */
+    ctx->id_lease_end = ctx->next_task_id + ERRAID_ID_LEASE;
+    if (storage_reserve_task_ids(&ctx->paths, ctx->id_lease_end) != 0) {
+        return -1;
+    }
 
+    srandom((unsigned)time(NULL) ^ (unsigned)getpid());
+    int64_t ended_ns = started_ns;
+    utils_now_monotonic_ns(&ended_ns);
+    ctx->stats.startup_us = (uint64_t)(ended_ns - started_ns) / 1000;
+    log_fd(STDERR_FILENO, "erraid: %zu tâches chargées en %llu ms\n", ctx->task_count,
+           (unsigned long long)(ctx->stats.startup_us / 1000));
     return 0;
 }
 
@@ -1254,6 +2957,22 @@ void erraid_shutdown(erraid_context_t *ctx) {
         return;
     }
 
+    /* Les journaux horodatés encore ouverts se ferment par un dernier bloc, à soumettre avant l'arrêt du fil. */
+    if (ctx->persist.running) {
+        int64_t now_ns = 0;
+        utils_now_monotonic_ns(&now_ns);
+        for (size_t i = 0; i < ctx->run_count; ++i) {
+            runlog_close(ctx->runs[i].records, now_ns);
+            ctx->runs[i].records = NULL;
+        }
+    }
+    /* Le fil écrit dans wake_pipe : il est arrêté avant la fermeture du tube. */
+    commit_history(ctx);
+    persist_stop(&ctx->persist);
+    reap_persist(ctx);
+    ctx->paths.dirs = NULL;
+    storage_dirs_close(&ctx->dirs);
+
     if (ctx->request_fd >= 0) {
         close(ctx->request_fd);
         ctx->request_fd = -1;
@@ -1274,6 +2993,19 @@ void erraid_shutdown(erraid_context_t *ctx) {
         close(ctx->wake_pipe[1]);
         ctx->wake_pipe[1] = -1;
     }
+    if (ctx->watch_fd >= 0) {
+        close(ctx->watch_fd);
+        ctx->watch_fd = -1;
+    }
+
+    /* Le prochain démarrage n'a alors plus de journal à rejouer. */
+    if (ctx->catalog_synced && ctx->catalog.wal_records > 0 &&
+        catalog_checkpoint(&ctx->catalog, ctx->tasks, ctx->task_count) != 0) {
+        log_fd(STDERR_FILENO, "erraid: point de contrôle du catalogue impossible (%s)\n", strerror(errno));
+    }
+    catalog_close(&ctx->catalog);
+    ctx->catalog_synced = false;
+    runstate_close(&ctx->runstate);
 
     storage_free_tasks(ctx->tasks, ctx->task_count);
     ctx->tasks = NULL;
@@ -1283,6 +3015,31 @@ void erraid_shutdown(erraid_context_t *ctx) {
     ctx->plan = NULL;
     ctx->plan_capacity = 0;
     ctx->plan_count = 0;
+
+    free(ctx->dependents);
+    ctx->dependents = NULL;
+    ctx->dependent_count = 0;
+    ctx->dependent_capacity = 0;
+
+    scheduler_queue_free(&ctx->timers);
+
+    for (size_t i = 0; i < ctx->run_count; ++i) {
+        executor_run_free(&ctx->runs[i]);
+    }
+    free(ctx->runs);
+    ctx->runs = NULL;
+    ctx->run_count = 0;
+    ctx->run_capacity = 0;
+    executor_pool_destroy(&ctx->output_pool);
+
+    free(ctx->pollfds);
+    ctx->pollfds = NULL;
+    ctx->pollfd_capacity = 0;
+
+    free(ctx->pending);
+    ctx->pending = NULL;
+    ctx->pending_count = 0;
+    ctx->pending_capacity = 0;
 }
 
 int erraid_reload_tasks(erraid_context_t *ctx) {
@@ -1291,26 +3048,109 @@ int erraid_reload_tasks(erraid_context_t *ctx) {
         return -1;
     }
 
+    for (size_t i = 0; i < ctx->task_count; ++i) {
+        watch_remove(ctx->watch_fd, ctx->tasks[i].watch_wd);
+    }
     storage_free_tasks(ctx->tasks, ctx->task_count);
     ctx->tasks = NULL;
     ctx->task_count = 0;
+    ctx->catalog_synced = false;
 
     task_t *tasks = NULL;
     size_t count = 0;
-    if (storage_load_tasks(&ctx->paths, &tasks, &count) != 0) {
+    if (catalog_load(&ctx->catalog, &tasks, &count) != 0) {
         return -1;
     }
 
     ctx->tasks = tasks;
     ctx->task_count = count;
+    if (count > 0 && ctx->next_task_id <= tasks[count - 1].task_id) {
+        ctx->next_task_id = tasks[count - 1].task_id + 1;
+    }
+
+    /* Tâches importées depuis des fichiers texte : une dépendance cyclique est ignorée plutôt que de boucler. */
+    for (size_t i = 0; i < count; ++i) {
+        task_t *task = &tasks[i];
+        if (task->policy.after_task_id != 0 && dependency_reaches(ctx, task->policy.after_task_id, task->task_id)) {
+            log_fd(STDERR_FILENO, "erraid: dépendance cyclique ignorée pour la tâche %llu\n",
+                   (unsigned long long)task->task_id);
+            task->policy.after_task_id = 0;
+        }
+    }
+
+    ctx->catalog_synced = true;
+    attach_runstate(ctx);
 
     if (rebuild_plan(ctx) != 0) {
         return -1;
     }
+    sync_watches(ctx);
+    maybe_checkpoint(ctx);
 
     return 0;
 }
 
+int erraid_export_tasks(const erraid_config_t *config, const char *dir, size_t *count_out) {
+    if (config == NULL || dir == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    erraid_context_t ctx;
+    reset_context(&ctx);
+    int rc = -1;
+    if (open_catalog(&ctx, config) == 0 && erraid_reload_tasks(&ctx) == 0) {
+        storage_paths_t target = ctx.paths;
+        target.tasks_dir = dir;
+        target.dirs = NULL;
+        rc = 0;
+        for (size_t i = 0; i < ctx.task_count && rc == 0; ++i) {
+            rc = storage_write_task(&target, &ctx.tasks[i]);
+        }
+        if (rc == 0 && count_out != NULL) {
+            *count_out = ctx.task_count;
+        }
+    }
+    int saved_errno = errno;
+    erraid_shutdown(&ctx);
+    errno = saved_errno;
+    return rc;
+}
+
+int erraid_import_tasks(const erraid_config_t *config, const char *dir, size_t *count_out) {
+    if (config == NULL || dir == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    erraid_context_t ctx;
+    reset_context(&ctx);
+    int rc = -1;
+    if (open_catalog(&ctx, config) == 0 && import_text_tasks(&ctx, dir, count_out) == 0 &&
+        erraid_reload_tasks(&ctx) == 0) {
+        rc = 0;
+    }
+    int saved_errno = errno;
+    erraid_shutdown(&ctx);
+    errno = saved_errno;
+    return rc;
+}
+
+int erraid_migrate_layout(const erraid_config_t *config, size_t *count_out) {
+    if (config == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    erraid_context_t ctx;
+    reset_context(&ctx);
+    int rc = -1;
+    if (build_paths(&ctx, config->run_dir) == 0 && storage_init_directories(&ctx.paths) == 0) {
+        rc = storage_migrate_layout(&ctx.paths, count_out);
+    }
+    int saved_errno = errno;
+    erraid_shutdown(&ctx);
+    errno = saved_errno;
+    return rc;
+}
+
 int erraid_handle_message(erraid_context_t *ctx, const proto_message_t *request) {
     if (ctx == NULL || request == NULL) {
         errno = EINVAL;
@@ -1339,7 +3179,7 @@ int erraid_handle_message(erraid_context_t *ctx, const proto_message_t *request)
             if (json_extract_uint64(payload, "task_id", &task_id) != 0) {
                 return send_error_response(ctx, "INVALID_REQUEST", "task_id manquant");
             }
-            if (respond_history(ctx, task_id) != 0) {
+            if (respond_history(ctx, payload) != 0) {
                 return send_error_response(ctx, "HISTORY_FAILED", "Lecture de l'historique impossible");
             }
             return 0;
@@ -1349,7 +3189,10 @@ int erraid_handle_message(erraid_context_t *ctx, const proto_message_t *request)
             if (json_extract_uint64(payload, "task_id", &task_id) != 0) {
                 return send_error_response(ctx, "INVALID_REQUEST", "task_id manquant");
             }
-            if (respond_stdio(ctx, task_id, true) != 0) {
+            if (respond_stdio(ctx, payload, true) != 0) {
+                if (errno == ENOENT) {
+                    return send_error_response(ctx, "RUN_NOT_FOUND", "Sortie de cette exécution non conservée");
+                }
                 return send_error_response(ctx, "STDOUT_FAILED", "Impossible de charger stdout");
             }
             return 0;
@@ -1359,11 +3202,24 @@ int erraid_handle_message(erraid_context_t *ctx, const proto_message_t *request)
             if (json_extract_uint64(payload, "task_id", &task_id) != 0) {
                 return send_error_response(ctx, "INVALID_REQUEST", "task_id manquant");
             }
-            if (respond_stdio(ctx, task_id, false) != 0) {
+            if (respond_stdio(ctx, payload, false) != 0) {
+                if (errno == ENOENT) {
+                    return send_error_response(ctx, "RUN_NOT_FOUND", "Sortie de cette exécution non conservée");
+                }
                 return send_error_response(ctx, "STDERR_FAILED", "Impossible de charger stderr");
             }
             return 0;
         }
+        case MSG_REQ_STATS:
+            if (respond_stats(ctx) != 0) {
+                return send_error_response(ctx, "STATS_FAILED", "Impossible de lire les statistiques");
+            }
+            return 0;
+        case MSG_REQ_GET_RECORDS:
+            if (respond_records(ctx, payload) != 0) {
+                return send_error_response(ctx, "RECORDS_FAILED", "Journal horodaté introuvable");
+            }
+            return 0;
         case MSG_REQ_SHUTDOWN:
             ctx->should_quit = true;
             send_status_ok(ctx, MSG_RSP_SHUTDOWN);
@@ -1373,40 +3229,63 @@ int erraid_handle_message(erraid_context_t *ctx, const proto_message_t *request)
     }
 }
 
+/*
+ * Une validation par tour de boucle : en mode always, un seul msync pour toutes les
+ * modifications du tour ; le lot d'historique part à l'échéance de sa fenêtre.
+ */
+static void sync_pending_writes(erraid_context_t *ctx) {
+    int64_t now_ms = 0;
+    utils_now_epoch_ms(&now_ms);
+    if (ctx->group_commit.due_ms >= 0 && now_ms >= ctx->group_commit.due_ms) {
+        commit_history(ctx);
+    }
+    /* Rétention par âge : un passage périodique, le premier dès le démarrage. */
+    if (now_ms >= ctx->compact_due_ms) {
+        for (size_t i = 0; i < ctx->task_count; ++i) {
+            queue_compaction(ctx, &ctx->tasks[i]);
+        }
+        ctx->compact_due_ms = now_ms + ERRAID_COMPACT_INTERVAL_MS;
+    }
+    runstate_commit(&ctx->runstate, now_ms);
+    if (ctx->runstate.sync_due_ms >= 0 && now_ms >= ctx->runstate.sync_due_ms &&
+        runstate_sync(&ctx->runstate) != 0) {
+        log_fd(STDERR_FILENO, "erraid: synchronisation de l'état impossible (%s)\n", strerror(errno));
+    }
+}
+
 int erraid_schedule_loop(erraid_context_t *ctx) {
     if (ctx == NULL) {
         errno = EINVAL;
         return -1;
     }
 
-    struct pollfd fds[2];
-
-    while (!ctx->should_quit) {
-        int64_t now;
-        if (utils_now_epoch(&now) != 0) {
-            return -1;
-        }
+    bool draining = false;
 
-        int64_t deadline = next_deadline(ctx);
-        int timeout_ms = -1;
-        if (deadline >= 0) {
-            int64_t diff = deadline - now;
-            if (diff < 0) {
-                diff = 0;
-            }
-            if (diff > (int64_t)INT_MAX / 1000) {
-                diff = (int64_t)INT_MAX / 1000;
+    for (;;) {
+        /* À l'arrêt, les exécutions en cours sont terminées proprement et enregistrées. */
+        if (ctx->should_quit && !draining) {
+            int64_t now_ms = 0;
+            utils_now_epoch_ms(&now_ms);
+            for (size_t i = 0; i < ctx->run_count; ++i) {
+                /* Un fils pré-armé n'a encore rien exécuté : pas de délai de grâce. */
+                if (ctx->runs[i].armed) {
+                    executor_cancel(&ctx->runs[i]);
+                } else {
+                    terminate_run(ctx, &ctx->runs[i], now_ms);
+                }
             }
-            timeout_ms = (int)(diff * 1000);
+            draining = true;
+        }
+        if (draining && ctx->run_count == 0) {
+            break;
         }
 
-        memset(fds, 0, sizeof(fds));
-        fds[0].fd = ctx->request_fd;
-        fds[0].events = POLLIN;
-        fds[1].fd = ctx->wake_pipe[0];
-        fds[1].events = POLLIN;
+        ssize_t nfds = build_pollfds(ctx);
+        if (nfds < 0) {
+            return -1;
+        }
 
-        int rc = poll(fds, ARRAY_SIZE(fds), timeout_ms);
+        int rc = poll(ctx->pollfds, (nfds_t)nfds, poll_timeout_ms(ctx));
         if (rc < 0) {
             if (errno == EINTR) {
                 continue;
@@ -1415,19 +3294,23 @@ int erraid_schedule_loop(erraid_context_t *ctx) {
         }
 
         if (rc > 0) {
-            if (fds[1].revents & POLLIN) {
+            if (ctx->pollfds[POLL_SLOT_WAKE].revents & POLLIN) {
                 drain_fd(ctx->wake_pipe[0]);
+                reap_persist(ctx);
+            }
+            if (ctx->pollfds[POLL_SLOT_WATCH].revents & POLLIN) {
+                watch_read(ctx->watch_fd, handle_watch_event, ctx);
             }
-            if (fds[0].revents & POLLIN) {
+            dispatch_run_output(ctx);
+            if (!draining && (ctx->pollfds[POLL_SLOT_REQUEST].revents & POLLIN)) {
                 process_requests(ctx);
             }
         }
 
-        if (ctx->should_quit) {
-            break;
-        }
-
-        process_due_tasks(ctx);
+        process_due_timers(ctx);
+        reap_children(ctx);
+        advance_runs(ctx);
+        sync_pending_writes(ctx);
     }
 
     return 0;
@@ -1,11 +1,21 @@
+#define _DEFAULT_SOURCE
+
 #include "executor.h"
 
+#include "utils.h"
+
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #ifndef PIPE_READ
@@ -13,141 +23,321 @@
 #define PIPE_WRITE 1
 #endif
 
-static int append_buffer(char **buffer,
-                         size_t *length,
-                         size_t *capacity,
-                         const char *data,
-                         size_t data_len,
-                         size_t limit,
-                         bool *truncated) {
-    if (data == NULL || data_len == 0) {
+#ifndef IOPRIO_CLASS_SHIFT
+#define IOPRIO_CLASS_SHIFT 13
+#endif
+#ifndef IOPRIO_WHO_PROCESS
+#define IOPRIO_WHO_PROCESS 1
+#endif
+
+/* Un octet de plus pour le terminateur. */
+#define POOL_BUFFER_SIZE (ERRAID_MAX_STDIO_SNAPSHOT + 1)
+
+int executor_pool_init(executor_pool_t *pool, size_t count) {
+    if (pool == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(pool, 0, sizeof(*pool));
+    if (count == 0) {
         return 0;
     }
-
-    if (limit > 0 && *length >= limit) {
-        if (truncated != NULL) {
-            *truncated = true;
+    pool->free_buffers = calloc(count, sizeof(char *));
+    if (pool->free_buffers == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    pool->capacity = count;
+    for (size_t i = 0; i < count; ++i) {
+        char *buffer = malloc(POOL_BUFFER_SIZE);
+        if (buffer == NULL) {
+            executor_pool_destroy(pool);
+            errno = ENOMEM;
+            return -1;
         }
-        return 0;
+        pool->free_buffers[pool->free_count++] = buffer;
+    }
+    return 0;
+}
+
+void executor_pool_destroy(executor_pool_t *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < pool->free_count; ++i) {
+        free(pool->free_buffers[i]);
+    }
+    free(pool->free_buffers);
+    memset(pool, 0, sizeof(*pool));
+}
+
+static char *pool_borrow(executor_pool_t *pool) {
+    if (pool != NULL && pool->free_count > 0) {
+        pool->hits += 1;
+        return pool->free_buffers[--pool->free_count];
+    }
+    if (pool != NULL) {
+        pool->misses += 1;
     }
+    char *buffer = malloc(POOL_BUFFER_SIZE);
+    if (buffer == NULL) {
+        errno = ENOMEM;
+    }
+    return buffer;
+}
+
+static void pool_return(executor_pool_t *pool, char *buffer) {
+    if (buffer == NULL) {
+        return;
+    }
+    if (pool != NULL && pool->free_count < pool->capacity) {
+        pool->free_buffers[pool->free_count++] = buffer;
+        return;
+    }
+    free(buffer);
+}
+
+static int64_t timeval_to_us(const struct timeval *tv) {
+    return (int64_t)tv->tv_sec * 1000000LL + (int64_t)tv->tv_usec;
+}
+
+static void accumulate_usage(task_run_usage_t *usage, const struct rusage *ru) {
+    usage->cpu_user_us += timeval_to_us(&ru->ru_utime);
+    usage->cpu_sys_us += timeval_to_us(&ru->ru_stime);
+    if ((int64_t)ru->ru_maxrss > usage->max_rss_kb) {
+        usage->max_rss_kb = (int64_t)ru->ru_maxrss;
+    }
+    usage->blocks_in += (int64_t)ru->ru_inblock;
+    usage->blocks_out += (int64_t)ru->ru_oublock;
+    usage->ctx_voluntary += (int64_t)ru->ru_nvcsw;
+    usage->ctx_involuntary += (int64_t)ru->ru_nivcsw;
+}
 
-    size_t copy_len = data_len;
-    if (limit > 0 && *length + copy_len > limit) {
-        copy_len = limit - *length;
-        if (truncated != NULL) {
-            *truncated = true;
+/*
+ * Entre fork et exec, le démon ayant d'autres fils d'exécution, l'enfant se limite aux
+ * fonctions sûres pour les signaux : pas de snprintf, strerror ni getenv, seulement
+ * des copies dans des tampons fixes et write(2).
+ */
+static size_t child_append(char *buffer, size_t length, size_t capacity, const char *text) {
+    while (*text != '\0' && length < capacity) {
+        buffer[length++] = *text++;
+    }
+    return length;
+}
+
+static void child_fail(const char *what) {
+    int error = errno;
+    char message[160];
+    char digits[12];
+    size_t n = sizeof(digits);
+    unsigned value = error > 0 ? (unsigned)error : 0;
+    digits[--n] = '\0';
+    do {
+        digits[--n] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0 && n > 0);
+
+    size_t length = child_append(message, 0, sizeof(message) - 1, "erraid: ");
+    length = child_append(message, length, sizeof(message) - 1, what);
+    length = child_append(message, length, sizeof(message) - 1, ": errno ");
+    length = child_append(message, length, sizeof(message) - 1, &digits[n]);
+    message[length++] = '\n';
+    utils_write_all(STDERR_FILENO, message, length);
+    _exit(126);
+}
+
+/*
+ * Gestionnaires du démon rétablis par défaut : sans quoi SIGTERM ne ferait que
+ * réveiller un démon qui n'est pas là, et un fils en attente sur le tube de
+ * pré-armement (read relancé après EINTR) survivrait jusqu'au SIGKILL.
+ */
+static void child_reset_signals(void) {
+    static const int signals[] = {SIGTERM, SIGINT, SIGCHLD, SIGPIPE};
+    struct sigaction act;
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = SIG_DFL;
+    sigemptyset(&act.sa_mask);
+    for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); ++i) {
+        sigaction(signals[i], &act, NULL);
+    }
+}
+
+static void child_set_rlimit(int resource, uint64_t value, uint64_t hard_margin, const char *what) {
+    if (value == 0) {
+        return;
+    }
+    struct rlimit current;
+    if (getrlimit(resource, &current) != 0) {
+        child_fail(what);
+    }
+    struct rlimit limit;
+    limit.rlim_cur = (rlim_t)value;
+    limit.rlim_max = (rlim_t)(value + hard_margin);
+    if (current.rlim_max != RLIM_INFINITY && limit.rlim_max > current.rlim_max) {
+        limit.rlim_max = current.rlim_max;
+    }
+    if (limit.rlim_cur > limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+    }
+    if (setrlimit(resource, &limit) != 0) {
+        child_fail(what);
+    }
+}
+
+/* Exécuté dans le fils, stdout/stderr déjà redirigés : tout échec est visible dans last.stderr. */
+static void child_apply_limits(const task_limits_t *limits) {
+    if (limits == NULL) {
+        return;
+    }
+    child_set_rlimit(RLIMIT_AS, limits->as_bytes, 0, "setrlimit(RLIMIT_AS)");
+    /* Limite dure une seconde au-delà : SIGXCPU d'abord, SIGKILL ensuite. */
+    child_set_rlimit(RLIMIT_CPU, limits->cpu_seconds, 1, "setrlimit(RLIMIT_CPU)");
+    child_set_rlimit(RLIMIT_NOFILE, limits->nofile, 0, "setrlimit(RLIMIT_NOFILE)");
+    child_set_rlimit(RLIMIT_NPROC, limits->nproc, 0, "setrlimit(RLIMIT_NPROC)");
+
+    if (limits->nice != 0 && setpriority(PRIO_PROCESS, 0, limits->nice) != 0) {
+        child_fail("setpriority");
+    }
+    if (limits->ioprio_class != TASK_IOPRIO_NONE) {
+        int ioprio = ((int)limits->ioprio_class << IOPRIO_CLASS_SHIFT) | (int)limits->ioprio_level;
+        if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, ioprio) != 0) {
+            child_fail("ioprio_set");
         }
     }
-    if (copy_len == 0) {
+}
+
+/* Le noyau ne signale pas directement le dépassement : on le déduit de la terminaison. */
+static uint32_t detect_limits_hit(const task_limits_t *limits, int status, const struct rusage *ru) {
+    uint32_t hit = 0;
+    if (limits == NULL || !WIFSIGNALED(status)) {
         return 0;
     }
-
-    if (*capacity < *length + data_len + 1) {
-        size_t new_cap = (*capacity == 0) ? (data_len + 1) : *capacity;
-        while (new_cap < *length + copy_len + 1) {
-            new_cap *= 2;
+    int sig = WTERMSIG(status);
+    if (limits->cpu_seconds > 0) {
+        int64_t cpu_us = timeval_to_us(&ru->ru_utime) + timeval_to_us(&ru->ru_stime);
+        if (sig == SIGXCPU || (sig == SIGKILL && cpu_us >= (int64_t)limits->cpu_seconds * 1000000LL)) {
+            hit |= TASK_LIMIT_HIT_CPU;
         }
-        char *tmp = realloc(*buffer, new_cap);
-        if (tmp == NULL) {
-            errno = ENOMEM;
+    }
+    if (limits->as_bytes > 0 && (sig == SIGSEGV || sig == SIGBUS || sig == SIGABRT)) {
+        hit |= TASK_LIMIT_HIT_AS;
+    }
+    return hit;
+}
+
+static int set_pipe_flags(int fd, bool nonblock) {
+    if (fcntl(fd, F_SETFD, FD_CLOEXEC) != 0) {
+        return -1;
+    }
+    if (nonblock) {
+        int flags = fcntl(fd, F_GETFL);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
             return -1;
         }
-        *buffer = tmp;
-        *capacity = new_cap;
     }
-    memcpy(*buffer + *length, data, copy_len);
-    *length += copy_len;
-    (*buffer)[*length] = '\0';
     return 0;
 }
 
-static int read_fd_into_buffer(int fd, char **buffer, size_t *length, size_t limit, bool *truncated) {
-    size_t capacity = (*buffer != NULL) ? (*length + 1) : 0;
-    char temp[4096];
+static void close_pipe(int pipe_fds[2]) {
+    for (int i = 0; i < 2; ++i) {
+        if (pipe_fds[i] >= 0) {
+            close(pipe_fds[i]);
+            pipe_fds[i] = -1;
+        }
+    }
+}
+
+/*
+ * Lecture anticipée de l'exécutable : résolution de PATH comme execvp, puis POSIX_FADV_WILLNEED.
+ * search est la valeur de PATH lue par le parent avant fork, NULL si file contient un '/'.
+ */
+static void child_prefetch_executable(const char *file, const char *search) {
+    char path[PATH_MAX];
+    const char *candidate = file;
+    size_t file_len = strlen(file);
 
     for (;;) {
-        ssize_t n = read(fd, temp, sizeof(temp));
-        if (n < 0) {
-            if (errno == EINTR) {
-                continue;
+        if (search != NULL) {
+            const char *end = strchr(search, ':');
+            size_t dir_len = (end != NULL) ? (size_t)(end - search) : strlen(search);
+            const char *dir = dir_len > 0 ? search : ".";
+            if (dir_len == 0) {
+                dir_len = 1;
             }
-            return -1;
-        }
-        if (n == 0) {
-            break;
-        }
-        size_t copy_len = (size_t)n;
-        if (limit > 0) {
-            size_t remaining = (limit > *length) ? (limit - *length) : 0;
-            if (remaining < copy_len) {
-                copy_len = remaining;
+            if (dir_len + 1 + file_len >= sizeof(path)) {
+                return;
             }
+            memcpy(path, dir, dir_len);
+            path[dir_len] = '/';
+            memcpy(path + dir_len + 1, file, file_len + 1);
+            candidate = path;
+            search = (end != NULL) ? end + 1 : NULL;
         }
-
-        if (append_buffer(buffer,
-                          length,
-                          &capacity,
-                          temp,
-                          copy_len,
-                          limit,
-                          truncated) != 0) {
-            return -1;
-        }
-        if (limit > 0 && *length >= limit) {
-            if (truncated != NULL && !*truncated) {
-                *truncated = true;
-            }
+        int fd = open(candidate, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            close(fd);
+            return;
         }
-    }
-
-    if (*buffer == NULL) {
-        *buffer = calloc(1, 1);
-        if (*buffer == NULL) {
-            errno = ENOMEM;
-            return -1;
+        if (search == NULL) {
+            return;
         }
-        *length = 0;
-        capacity = 1;
     }
-
-    return 0;
 }
 
-static int run_single_command(const command_t *command,
-                              int *status_out,
-                              char **stdout_buf,
-                              size_t *stdout_len,
-                              bool *stdout_truncated,
-                              char **stderr_buf,
-                              size_t *stderr_len,
-                              bool *stderr_truncated) {
+/*
+ * Les extrémités côté démon sont non bloquantes et aucune n'est héritée par les autres tâches.
+ * Avec gate, le fils reste bloqué sur le tube jusqu'à executor_release() ; un EOF l'annule.
+ */
+static int spawn_command(executor_run_t *run, const command_t *command, bool gate) {
     int stdout_pipe[2] = {-1, -1};
     int stderr_pipe[2] = {-1, -1};
+    int gate_pipe[2] = {-1, -1};
+    int exec_pipe[2] = {-1, -1};
 
     if (command == NULL || command->argv == NULL || command->argc == 0) {
         errno = EINVAL;
         return -1;
     }
 
+    bool first = (run->command_index == 0);
     if (pipe(stdout_pipe) != 0) {
         return -1;
     }
-    if (pipe(stderr_pipe) != 0) {
-        close(stdout_pipe[PIPE_READ]);
-        close(stdout_pipe[PIPE_WRITE]);
+    if (pipe(stderr_pipe) != 0 || (gate && pipe(gate_pipe) != 0) || (first && pipe(exec_pipe) != 0)) {
+        close_pipe(stdout_pipe);
+        close_pipe(stderr_pipe);
+        close_pipe(gate_pipe);
         return -1;
     }
+    if (set_pipe_flags(stdout_pipe[PIPE_READ], true) != 0 || set_pipe_flags(stdout_pipe[PIPE_WRITE], false) != 0 ||
+        set_pipe_flags(stderr_pipe[PIPE_READ], true) != 0 || set_pipe_flags(stderr_pipe[PIPE_WRITE], false) != 0 ||
+        (gate && (set_pipe_flags(gate_pipe[PIPE_READ], false) != 0 || set_pipe_flags(gate_pipe[PIPE_WRITE], false) != 0)) ||
+        (first && (set_pipe_flags(exec_pipe[PIPE_READ], true) != 0 || set_pipe_flags(exec_pipe[PIPE_WRITE], false) != 0))) {
+        close_pipe(stdout_pipe);
+        close_pipe(stderr_pipe);
+        close_pipe(gate_pipe);
+        close_pipe(exec_pipe);
+        return -1;
+    }
+
+    /* Lu avant fork : getenv n'est pas sûr dans l'enfant d'un processus multi-fil. */
+    const char *search = (gate && strchr(command->argv[0], '/') == NULL) ? getenv("PATH") : NULL;
 
     pid_t pid = fork();
     if (pid < 0) {
-        close(stdout_pipe[PIPE_READ]);
-        close(stdout_pipe[PIPE_WRITE]);
-        close(stderr_pipe[PIPE_READ]);
-        close(stderr_pipe[PIPE_WRITE]);
+        close_pipe(stdout_pipe);
+        close_pipe(stderr_pipe);
+        close_pipe(gate_pipe);
+        close_pipe(exec_pipe);
         return -1;
     }
 
     if (pid == 0) {
+        child_reset_signals();
+        /* Nouveau groupe : SIGTERM/SIGKILL atteignent aussi les descendants. */
+        setpgid(0, 0);
+
         if (dup2(stdout_pipe[PIPE_WRITE], STDOUT_FILENO) < 0) {
             _exit(127);
         }
@@ -160,163 +350,332 @@ static int run_single_command(const command_t *command,
         close(stderr_pipe[PIPE_READ]);
         close(stderr_pipe[PIPE_WRITE]);
 
+        child_apply_limits(&run->limits);
+
+        if (gate) {
+            close(gate_pipe[PIPE_WRITE]);
+            child_prefetch_executable(command->argv[0], search);
+            char byte;
+            ssize_t n;
+            do {
+                n = read(gate_pipe[PIPE_READ], &byte, 1);
+            } while (n < 0 && errno == EINTR);
+            if (n != 1) {
+                _exit(0);
+            }
+            close(gate_pipe[PIPE_READ]);
+        }
+
+        if (first) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            int64_t exec_ns = (int64_t)ts.tv_sec * 1000000000LL + (int64_t)ts.tv_nsec;
+            utils_write_all(exec_pipe[PIPE_WRITE], &exec_ns, sizeof(exec_ns));
+        }
+
         execvp(command->argv[0], command->argv);
         _exit(127);
     }
 
+    /* Doublé côté parent pour qu'un signal envoyé juste après fork() atteigne le bon groupe. */
+    if (setpgid(pid, pid) != 0 && errno != EACCES && errno != ESRCH) {
+        kill(pid, SIGKILL);
+    }
+
     close(stdout_pipe[PIPE_WRITE]);
     close(stderr_pipe[PIPE_WRITE]);
+    if (gate) {
+        close(gate_pipe[PIPE_READ]);
+        run->gate_fd = gate_pipe[PIPE_WRITE];
+    }
+    if (first) {
+        close(exec_pipe[PIPE_WRITE]);
+        run->exec_fd = exec_pipe[PIPE_READ];
+    }
 
-    char *out_buf = NULL;
-    char *err_buf = NULL;
-    size_t out_len = 0;
-    size_t err_len = 0;
-    bool out_truncated = false;
-    bool err_truncated = false;
+    run->pid = pid;
+    run->pgid = pid;
+    run->stdout_fd = stdout_pipe[PIPE_READ];
+    run->stderr_fd = stderr_pipe[PIPE_READ];
+    return 0;
+}
 
-    int rc = 0;
-    if (read_fd_into_buffer(stdout_pipe[PIPE_READ], &out_buf, &out_len, ERRAID_MAX_STDIO_SNAPSHOT, &out_truncated) != 0) {
-        rc = -1;
+static void init_run(executor_run_t *run,
+                     executor_pool_t *pool,
+                     const task_t *task,
+                     uint64_t run_id,
+                     int64_t epoch) {
+    memset(run, 0, sizeof(*run));
+    run->result.pool = pool;
+    run->run_id = run_id;
+    run->task_id = task->task_id;
+    run->epoch = epoch;
+    run->pid = -1;
+    run->pgid = -1;
+    run->stdout_fd = -1;
+    run->stderr_fd = -1;
+    run->gate_fd = -1;
+    run->exec_fd = -1;
+    run->limits = task->limits;
+}
+
+int executor_start(executor_run_t *run, executor_pool_t *pool, const task_t *task, uint64_t run_id, int64_t epoch) {
+    if (run == NULL || task == NULL || task->command_count == 0 || task->commands == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    init_run(run, pool, task, run_id, epoch);
+    utils_now_monotonic_ns(&run->result.usage.start_ns);
+
+    /* Un échec de lancement n'est pas une erreur du démon : il est enregistré avec le statut -1. */
+    if (spawn_command(run, &task->commands[0], false) != 0) {
+        run->failed = true;
     }
-    close(stdout_pipe[PIPE_READ]);
+    return 0;
+}
 
-    if (rc == 0 &&
-        read_fd_into_buffer(stderr_pipe[PIPE_READ], &err_buf, &err_len, ERRAID_MAX_STDIO_SNAPSHOT, &err_truncated) != 0) {
-        rc = -1;
+int executor_prepare(executor_run_t *run, executor_pool_t *pool, const task_t *task, uint64_t run_id) {
+    if (run == NULL || task == NULL || task->command_count == 0 || task->commands == NULL) {
+        errno = EINVAL;
+        return -1;
     }
-    close(stderr_pipe[PIPE_READ]);
 
-    int status = 0;
-    if (waitpid(pid, &status, 0) < 0) {
-        rc = -1;
+    init_run(run, pool, task, run_id, -1);
+    run->armed = true;
+    if (spawn_command(run, &task->commands[0], true) != 0) {
+        return -1;
     }
+    return 0;
+}
 
-    if (rc != 0) {
-        free(out_buf);
-        free(err_buf);
+int executor_release(executor_run_t *run, int64_t epoch) {
+    if (run == NULL || !run->armed || run->gate_fd < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    /* Fils disparu avant l'échéance : le démon se rabat sur un lancement classique. */
+    if (run->pid <= 0) {
+        errno = ESRCH;
+        return -1;
+    }
+    const uint8_t byte = 1;
+    if (utils_write_all(run->gate_fd, &byte, sizeof(byte)) != 0) {
         return -1;
     }
+    close(run->gate_fd);
+    run->gate_fd = -1;
+    run->armed = false;
+    run->epoch = epoch;
+    utils_now_monotonic_ns(&run->result.usage.start_ns);
+    return 0;
+}
 
-    *stdout_buf = out_buf;
-    *stderr_buf = err_buf;
-    *stdout_len = out_len;
-    *stderr_len = err_len;
-    if (stdout_truncated != NULL) {
-        *stdout_truncated = out_truncated;
+void executor_cancel(executor_run_t *run) {
+    if (run == NULL) {
+        return;
     }
-    if (stderr_truncated != NULL) {
-        *stderr_truncated = err_truncated;
+    run->discard = true;
+    if (run->gate_fd >= 0) {
+        close(run->gate_fd);
+        run->gate_fd = -1;
     }
+    /* Un autre fils pré-armé peut détenir une copie du tube : l'EOF seul ne suffit pas. */
+    executor_signal(run, SIGKILL);
+}
 
-    if (status_out != NULL) {
-        if (WIFEXITED(status)) {
-            *status_out = WEXITSTATUS(status);
-        } else if (WIFSIGNALED(status)) {
-            *status_out = 128 + WTERMSIG(status);
-        } else {
-            *status_out = status;
+int executor_read_output(executor_run_t *run, int fd) {
+    if (run == NULL || fd < 0 || (fd != run->stdout_fd && fd != run->stderr_fd)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    bool is_stdout = (fd == run->stdout_fd);
+    char **buffer = is_stdout ? &run->result.stdout_buf : &run->result.stderr_buf;
+    size_t *length = is_stdout ? &run->result.stdout_len : &run->result.stderr_len;
+    bool *truncated = is_stdout ? &run->result.stdout_truncated : &run->result.stderr_truncated;
+    runlog_stream_t stream = is_stdout ? RUNLOG_STREAM_STDOUT : RUNLOG_STREAM_STDERR;
+    char drain[4096];
+
+    for (;;) {
+        /* Une fois le tampon emprunté on y lit directement ; au-delà de la limite on vide le tube. */
+        char *target = drain;
+        size_t room = sizeof(drain);
+        if (*buffer != NULL && *length < ERRAID_MAX_STDIO_SNAPSHOT) {
+            target = *buffer + *length;
+            room = ERRAID_MAX_STDIO_SNAPSHOT - *length;
+        }
+        ssize_t n = read(fd, target, room);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (run->records != NULL) {
+                    runlog_flush(run->records);
+                }
+                return 0;
+            }
+            break;
         }
+        if (n == 0) {
+            break;
+        }
+        if (run->records != NULL) {
+            int64_t now_ns = 0;
+            utils_now_monotonic_ns(&now_ns);
+            /* Un journal en échec est abandonné ; la capture classique continue. */
+            if (runlog_append(run->records, stream, now_ns, target, (size_t)n) != 0) {
+                runlog_close(run->records, now_ns);
+                run->records = NULL;
+            }
+        }
+        if (target != drain) {
+            *length += (size_t)n;
+            (*buffer)[*length] = '\0';
+            continue;
+        }
+        if (*buffer == NULL) {
+            /* Premier octet du flux : seul ce premier bloc est recopié. */
+            *buffer = pool_borrow(run->result.pool);
+            if (*buffer == NULL) {
+                return -1;
+            }
+            size_t copy_len = (size_t)n < ERRAID_MAX_STDIO_SNAPSHOT ? (size_t)n : ERRAID_MAX_STDIO_SNAPSHOT;
+            memcpy(*buffer, drain, copy_len);
+            *length = copy_len;
+            (*buffer)[*length] = '\0';
+            if (copy_len < (size_t)n) {
+                *truncated = true;
+            }
+            continue;
+        }
+        *truncated = true;
     }
 
+    close(fd);
+    if (is_stdout) {
+        run->stdout_fd = -1;
+    } else {
+        run->stderr_fd = -1;
+    }
     return 0;
 }
 
-int executor_run_task(const task_t *task, executor_result_t *result) {
-    if (task == NULL || result == NULL) {
+void executor_child_exited(executor_run_t *run, int wait_status, const struct rusage *ru) {
+    if (run == NULL || ru == NULL) {
+        return;
+    }
+    accumulate_usage(&run->result.usage, ru);
+    run->result.limits_hit |= detect_limits_hit(&run->limits, wait_status, ru);
+
+    if (WIFEXITED(wait_status)) {
+        run->result.status = WEXITSTATUS(wait_status);
+    } else if (WIFSIGNALED(wait_status)) {
+        run->result.status = 128 + WTERMSIG(wait_status);
+    } else {
+        run->result.status = wait_status;
+    }
+    run->pid = -1;
+}
+
+int executor_step(executor_run_t *run, const task_t *task) {
+    if (run == NULL) {
         errno = EINVAL;
         return -1;
     }
-
-    memset(result, 0, sizeof(*result));
-
-    if (task->command_count == 0 || task->commands == NULL) {
-        result->status = 0;
+    if (run->pid > 0 || run->stdout_fd >= 0 || run->stderr_fd >= 0) {
         return 0;
     }
 
-    char *stdout_buf = NULL;
-    size_t stdout_len = 0;
-    size_t stdout_cap = 0;
-    char *stderr_buf = NULL;
-    size_t stderr_len = 0;
-    size_t stderr_cap = 0;
-    bool stdout_truncated = false;
-    bool stderr_truncated = false;
-
-    for (size_t i = 0; i < task->command_count; ++i) {
-        char *cmd_out = NULL;
-        char *cmd_err = NULL;
-        size_t cmd_out_len = 0;
-        size_t cmd_err_len = 0;
-        int status = 0;
-
-        if (run_single_command(&task->commands[i],
-                               &status,
-                               &cmd_out,
-                               &cmd_out_len,
-                               &stdout_truncated,
-                               &cmd_err,
-                               &cmd_err_len,
-                               &stderr_truncated) != 0) {
-            free(cmd_out);
-            free(cmd_err);
-            free(stdout_buf);
-            free(stderr_buf);
-            return -1;
+    if (!run->armed && !run->failed && !run->stopping && task != NULL && task->type == TASK_TYPE_SEQUENCE &&
+        run->command_index + 1 < task->command_count) {
+        run->command_index += 1;
+        if (spawn_command(run, &task->commands[run->command_index], false) == 0) {
+            return 0;
         }
+        run->failed = true;
+    }
 
-        if (append_buffer(&stdout_buf,
-                          &stdout_len,
-                          &stdout_cap,
-                          cmd_out,
-                          cmd_out_len,
-                          ERRAID_MAX_STDIO_SNAPSHOT,
-                          &stdout_truncated) != 0) {
-            free(cmd_out);
-            free(cmd_err);
-            free(stdout_buf);
-            free(stderr_buf);
-            return -1;
-        }
-        if (append_buffer(&stderr_buf,
-                          &stderr_len,
-                          &stderr_cap,
-                          cmd_err,
-                          cmd_err_len,
-                          ERRAID_MAX_STDIO_SNAPSHOT,
-                          &stderr_truncated) != 0) {
-            free(cmd_out);
-            free(cmd_err);
-            free(stdout_buf);
-            free(stderr_buf);
-            return -1;
-        }
+    utils_now_monotonic_ns(&run->result.usage.end_ns);
+    return 1;
+}
 
-        free(cmd_out);
-        free(cmd_err);
-        result->status = status;
+int executor_signal(executor_run_t *run, int signo) {
+    if (run == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (run->pgid <= 0) {
+        return 0;
+    }
+    if (killpg(run->pgid, signo) != 0 && errno != ESRCH) {
+        return -1;
+    }
+    return 0;
+}
 
-        if (task->type == TASK_TYPE_SIMPLE) {
-            break;
+void executor_finish(executor_run_t *run, executor_result_t *result) {
+    if (run == NULL || result == NULL) {
+        return;
+    }
+    if (run->failed) {
+        run->result.status = -1;
+    }
+    if (run->exec_fd >= 0) {
+        int64_t exec_ns = 0;
+        ssize_t n;
+        do {
+            n = read(run->exec_fd, &exec_ns, sizeof(exec_ns));
+        } while (n < 0 && errno == EINTR);
+        if (n == (ssize_t)sizeof(exec_ns)) {
+            run->result.exec_epoch_ns = exec_ns;
         }
     }
+    if (run->records != NULL) {
+        runlog_close(run->records, run->result.usage.end_ns);
+        run->records = NULL;
+    }
+    *result = run->result;
+    memset(&run->result, 0, sizeof(run->result));
+    executor_run_free(run);
+}
 
-    result->stdout_buf = stdout_buf;
-    result->stderr_buf = stderr_buf;
-    result->stdout_len = stdout_len;
-    result->stderr_len = stderr_len;
-    result->stdout_truncated = stdout_truncated;
-    result->stderr_truncated = stderr_truncated;
-
-    return 0;
+void executor_run_free(executor_run_t *run) {
+    if (run == NULL) {
+        return;
+    }
+    if (run->stdout_fd >= 0) {
+        close(run->stdout_fd);
+        run->stdout_fd = -1;
+    }
+    if (run->stderr_fd >= 0) {
+        close(run->stderr_fd);
+        run->stderr_fd = -1;
+    }
+    if (run->gate_fd >= 0) {
+        close(run->gate_fd);
+        run->gate_fd = -1;
+    }
+    if (run->exec_fd >= 0) {
+        close(run->exec_fd);
+        run->exec_fd = -1;
+    }
+    if (run->records != NULL) {
+        int64_t now_ns = 0;
+        utils_now_monotonic_ns(&now_ns);
+        runlog_close(run->records, now_ns);
+        run->records = NULL;
+    }
+    executor_result_free(&run->result);
 }
 
 void executor_result_free(executor_result_t *result) {
     if (result == NULL) {
         return;
     }
-    free(result->stdout_buf);
-    free(result->stderr_buf);
+    pool_return(result->pool, result->stdout_buf);
+    pool_return(result->pool, result->stderr_buf);
     result->stdout_buf = NULL;
     result->stderr_buf = NULL;
     result->stdout_len = 0;
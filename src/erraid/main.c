@@ -1,7 +1,9 @@
 #include "erraid.h"
+#include "taskopt.h"
 
 #include <errno.h>
 #include <getopt.h>
+#include <stdbool.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -25,17 +27,131 @@ static void log_fd(int fd, const char *fmt, ...) {
 }
 
 static void usage(const char *progname) {
-    log_fd(STDERR_FILENO, "Usage : %s [-r RUNDIR]\n", progname);
+    log_fd(STDERR_FILENO, "Usage : %s [-r RUNDIR] [-a MS] [-y MODE] [-d MODE] [-k AGE:N] [-X DIR | -I DIR | -M]\n", progname);
+    log_fd(STDERR_FILENO, "  -a MS   avance du pré-armement des lancements (défaut %d, 0 : désactivé)\n",
+           ERRAID_DEFAULT_PREARM_MS);
+    log_fd(STDERR_FILENO, "  -y MODE synchronisation de state/runstate.bin : always, none ou MS (défaut %d)\n",
+           RUNSTATE_DEFAULT_SYNC_MS);
+    log_fd(STDERR_FILENO,
+           "  -d MODE durabilité de l'historique : strict (défaut), async ou MS[:N] (validation groupée,\n"
+           "          au plus tard MS ms ou N exécutions après la première écriture ; défauts %d et %d)\n",
+           ERRAID_DEFAULT_GROUP_MS,
+           ERRAID_DEFAULT_GROUP_RUNS);
+    log_fd(STDERR_FILENO,
+           "  -k AGE:N rétention par défaut de l'historique : exécutions de plus de AGE (secondes,\n"
+           "          suffixe m, h ou d) ou au-delà des N plus récentes agrégées dans rollup.bin\n");
+    log_fd(STDERR_FILENO, "  -X DIR  exporter le catalogue en fichiers <ID>.task dans DIR, puis quitter\n");
+    log_fd(STDERR_FILENO, "  -I DIR  importer les fichiers <ID>.task de DIR dans le catalogue, puis quitter\n");
+    log_fd(STDERR_FILENO, "  -M      répartir logs/<ID>/ en logs/<AA>/<BB>/<ID>/, puis quitter\n");
+}
+
+/* strict | async | MS[:N] */
+static int parse_durability(const char *arg, erraid_config_t *config) {
+    if (strcmp(arg, "strict") == 0) {
+        config->history_durability = STORAGE_DURABILITY_STRICT;
+        return 0;
+    }
+    if (strcmp(arg, "async") == 0) {
+        config->history_durability = STORAGE_DURABILITY_ASYNC;
+        return 0;
+    }
+    char window[32];
+    const char *colon = strchr(arg, ':');
+    size_t len = colon != NULL ? (size_t)(colon - arg) : strlen(arg);
+    if (len == 0 || len >= sizeof(window)) {
+        return -1;
+    }
+    memcpy(window, arg, len);
+    window[len] = '\0';
+    int64_t window_ms = 0;
+    if (utils_parse_int64(window, &window_ms) != 0 || window_ms <= 0 || window_ms > 60000) {
+        return -1;
+    }
+    uint64_t runs = ERRAID_DEFAULT_GROUP_RUNS;
+    if (colon != NULL && (utils_parse_uint64(colon + 1, &runs) != 0 || runs == 0 || runs > UINT32_MAX)) {
+        return -1;
+    }
+    config->history_durability = STORAGE_DURABILITY_GROUP;
+    config->history_group_ms = window_ms;
+    config->history_group_runs = (uint32_t)runs;
+    return 0;
+}
+
+/* AGE:N, AGE ou :N ; partie absente : sans limite. */
+static int parse_retention(const char *arg, erraid_config_t *config) {
+    storage_retention_t retention = {0, 0};
+    char age[32];
+    const char *colon = strchr(arg, ':');
+    size_t len = colon != NULL ? (size_t)(colon - arg) : strlen(arg);
+    if (len >= sizeof(age)) {
+        return -1;
+    }
+    memcpy(age, arg, len);
+    age[len] = '\0';
+    if (len > 0 && taskopt_parse_age(age, &retention.max_age_seconds) != 0) {
+        return -1;
+    }
+    uint64_t entries = 0;
+    if (colon != NULL && colon[1] != '\0' && (utils_parse_uint64(colon + 1, &entries) != 0 || entries > UINT32_MAX)) {
+        return -1;
+    }
+    retention.max_entries = (uint32_t)entries;
+    config->history_retention = retention;
+    return 0;
 }
 
 int main(int argc, char **argv) {
-    const char *run_dir = NULL;
+    erraid_config_t config;
+    erraid_config_defaults(&config);
 
+    const char *export_dir = NULL;
+    const char *import_dir = NULL;
+    bool migrate = false;
     int opt;
-    while ((opt = getopt(argc, argv, "hr:")) != -1) {
+    while ((opt = getopt(argc, argv, "hr:a:y:d:k:X:I:M")) != -1) {
         switch (opt) {
             case 'r':
-                run_dir = optarg;
+                config.run_dir = optarg;
+                break;
+            case 'a':
+                if (utils_parse_int64(optarg, &config.prearm_lead_ms) != 0 || config.prearm_lead_ms < 0 ||
+                    config.prearm_lead_ms > 60000) {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'y':
+                if (strcmp(optarg, "always") == 0) {
+                    config.state_sync = RUNSTATE_SYNC_ALWAYS;
+                } else if (strcmp(optarg, "none") == 0) {
+                    config.state_sync = RUNSTATE_SYNC_NONE;
+                } else if (utils_parse_int64(optarg, &config.state_sync_ms) == 0 && config.state_sync_ms > 0) {
+                    config.state_sync = RUNSTATE_SYNC_INTERVAL;
+                } else {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'd':
+                if (parse_durability(optarg, &config) != 0) {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'k':
+                if (parse_retention(optarg, &config) != 0) {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'X':
+                export_dir = optarg;
+                break;
+            case 'I':
+                import_dir = optarg;
+                break;
+            case 'M':
+                migrate = true;
                 break;
             case 'h':
                 usage(argv[0]);
@@ -46,8 +162,31 @@ int main(int argc, char **argv) {
         }
     }
 
+    /* Hors ligne : le démon ne doit pas tourner sur le même répertoire. */
+    if (migrate) {
+        size_t count = 0;
+        if (erraid_migrate_layout(&config, &count) != 0) {
+            log_fd(STDERR_FILENO, "erraid: migration échouée (%s)\n", strerror(errno));
+            return EXIT_FAILURE;
+        }
+        log_fd(STDOUT_FILENO, "%zu répertoire(s) de journaux déplacé(s)\n", count);
+        return EXIT_SUCCESS;
+    }
+    if (export_dir != NULL || import_dir != NULL) {
+        size_t count = 0;
+        int rc = (export_dir != NULL) ? erraid_export_tasks(&config, export_dir, &count)
+                                      : erraid_import_tasks(&config, import_dir, &count);
+        if (rc != 0) {
+            log_fd(STDERR_FILENO, "erraid: %s échoué (%s)\n", export_dir != NULL ? "export" : "import",
+                   strerror(errno));
+            return EXIT_FAILURE;
+        }
+        log_fd(STDOUT_FILENO, "%zu tâche(s) %s\n", count, export_dir != NULL ? "exportée(s)" : "importée(s)");
+        return EXIT_SUCCESS;
+    }
+
     erraid_context_t ctx;
-    if (erraid_init(&ctx, run_dir) != 0) {
+    if (erraid_init(&ctx, &config) != 0) {
         log_fd(STDERR_FILENO, "erraid: initialisation échouée (%s)\n", strerror(errno));
         return EXIT_FAILURE;
     }
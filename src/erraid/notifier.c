@@ -9,6 +9,7 @@ static erraid_context_t *g_ctx = NULL;
 static struct sigaction g_old_int;
 static struct sigaction g_old_term;
 static struct sigaction g_old_pipe;
+static struct sigaction g_old_chld;
 static int g_installed = 0;
 
 static void wake_daemon(void) {
@@ -16,9 +17,11 @@ static void wake_daemon(void) {
         return;
     }
     if (g_ctx->wake_pipe[1] >= 0) {
+        int saved_errno = errno;
         const uint8_t byte = 0xFF;
         ssize_t rc = write(g_ctx->wake_pipe[1], &byte, sizeof(byte));
         (void)rc;
+        errno = saved_errno;
     }
 }
 
@@ -35,6 +38,12 @@ static void handle_pipe(int signo) {
     wake_daemon();
 }
 
+/* La récolte elle-même se fait dans la boucle principale. */
+static void handle_child(int signo) {
+    (void)signo;
+    wake_daemon();
+}
+
 int notifier_install(erraid_context_t *ctx) {
     if (ctx == NULL) {
         errno = EINVAL;
@@ -64,6 +73,17 @@ int notifier_install(erraid_context_t *ctx) {
         return -1;
     }
 
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = handle_child;
+    act.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&act.sa_mask);
+    if (sigaction(SIGCHLD, &act, &g_old_chld) != 0) {
+        sigaction(SIGINT, &g_old_int, NULL);
+        sigaction(SIGTERM, &g_old_term, NULL);
+        sigaction(SIGPIPE, &g_old_pipe, NULL);
+        return -1;
+    }
+
     g_installed = 1;
     return 0;
 }
@@ -76,6 +96,7 @@ void notifier_uninstall(void) {
     sigaction(SIGINT, &g_old_int, NULL);
     sigaction(SIGTERM, &g_old_term, NULL);
     sigaction(SIGPIPE, &g_old_pipe, NULL);
+    sigaction(SIGCHLD, &g_old_chld, NULL);
     g_ctx = NULL;
     g_installed = 0;
 }
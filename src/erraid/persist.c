@@ -0,0 +1,190 @@
+#include "persist.h"
+
+#include "utils.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PERSIST_MASK (PERSIST_QUEUE_CAPACITY - 1)
+
+_Static_assert((PERSIST_QUEUE_CAPACITY & PERSIST_MASK) == 0, "PERSIST_QUEUE_CAPACITY doit être une puissance de deux");
+
+static void execute(const storage_paths_t *paths, persist_op_t *op) {
+    int64_t started_ns = 0;
+    utils_now_monotonic_ns(&started_ns);
+    switch (op->kind) {
+        case PERSIST_OP_HISTORY:
+            op->rc = storage_append_history(paths,
+                                            op->task_id,
+                                            &op->entry,
+                                            op->result.stdout_buf,
+                                            op->result.stdout_len,
+                                            op->result.stderr_buf,
+                                            op->result.stderr_len);
+            break;
+        case PERSIST_OP_HISTORY_ENTRY:
+            op->rc = storage_append_history_entry(paths, op->task_id, &op->entry);
+            break;
+        case PERSIST_OP_REMOVE_LOGS:
+            op->rc = storage_remove_task_logs(paths, op->task_id);
+            break;
+        case PERSIST_OP_RESERVE_IDS:
+            op->rc = storage_reserve_task_ids(paths, op->value);
+            break;
+        case PERSIST_OP_SYNC_LOGS:
+            op->rc = storage_sync_logs(paths);
+            break;
+        case PERSIST_OP_COMPACT: {
+            size_t dropped = 0;
+            op->rc = storage_compact_history(paths, op->task_id, &op->retention, &dropped);
+            op->value = dropped;
+            break;
+        }
+        case PERSIST_OP_CHECKPOINT:
+            op->rc = catalog_write_snapshot(op->catalog, &op->snapshot);
+            break;
+        case PERSIST_OP_RUNLOG: {
+            char task_dir[PATH_MAX];
+            const char *dir = NULL;
+            if (op->runlog->first &&
+                storage_task_log_dir(paths, op->task_id, true, task_dir, sizeof(task_dir)) == 0) {
+                dir = task_dir;
+            }
+            op->rc = runlog_write_chunk(op->runlog, dir);
+            op->runlog = NULL;
+            break;
+        }
+        default:
+            op->rc = -1;
+            errno = EINVAL;
+            break;
+    }
+    op->error = op->rc != 0 ? errno : 0;
+    int64_t ended_ns = started_ns;
+    utils_now_monotonic_ns(&ended_ns);
+    op->latency_ns = ended_ns - started_ns;
+}
+
+static void *worker_main(void *arg) {
+    persist_queue_t *queue = arg;
+    /* Répertoires ouverts propres au fil : le cache de la boucle ne lui est jamais partagé. */
+    storage_dirs_t dirs;
+    bool have_dirs = storage_dirs_open(&dirs, queue->paths) == 0;
+    for (;;) {
+        while (sem_wait(&queue->ready) != 0 && errno == EINTR) {
+        }
+        uint64_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        uint64_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        if (head == tail) {
+            if (atomic_load_explicit(&queue->stopping, memory_order_acquire)) {
+                break;
+            }
+            continue;
+        }
+        storage_paths_t paths = *queue->paths;
+        paths.dirs = have_dirs ? &dirs : NULL;
+        /* Tout ce qui est disponible est traité avant un seul réveil de la boucle. */
+        for (; head != tail; ++head) {
+            execute(&paths, &queue->slots[head & PERSIST_MASK]);
+            atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+        }
+        char byte = 'p';
+        if (write(queue->wake_fd, &byte, 1) < 0) {
+            /* Tube plein : la boucle a déjà un réveil en attente. */
+        }
+    }
+    storage_dirs_close(&dirs);
+    return NULL;
+}
+
+int persist_start(persist_queue_t *queue, const storage_paths_t *paths, int wake_fd) {
+    if (queue == NULL || paths == NULL || wake_fd < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->stopping, false);
+    queue->reclaimed = 0;
+    queue->paths = paths;
+    queue->wake_fd = wake_fd;
+    if (sem_init(&queue->ready, 0, 0) != 0) {
+        return -1;
+    }
+
+    /* Les signaux restent traités par le fil principal. */
+    sigset_t all;
+    sigset_t previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    int rc = pthread_create(&queue->thread, NULL, worker_main, queue);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (rc != 0) {
+        sem_destroy(&queue->ready);
+        errno = rc;
+        return -1;
+    }
+    queue->running = true;
+    return 0;
+}
+
+persist_op_t *persist_reserve(persist_queue_t *queue) {
+    uint64_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    if (tail - queue->reclaimed >= PERSIST_QUEUE_CAPACITY) {
+        return NULL;
+    }
+    persist_op_t *op = &queue->slots[tail & PERSIST_MASK];
+    memset(op, 0, sizeof(*op));
+    return op;
+}
+
+void persist_submit(persist_queue_t *queue) {
+    uint64_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    sem_post(&queue->ready);
+}
+
+persist_op_t *persist_completed(persist_queue_t *queue) {
+    uint64_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (queue->reclaimed == head) {
+        return NULL;
+    }
+    return &queue->slots[queue->reclaimed & PERSIST_MASK];
+}
+
+void persist_reclaim(persist_queue_t *queue) {
+    queue->reclaimed += 1;
+}
+
+uint64_t persist_submitted(const persist_queue_t *queue) {
+    return atomic_load_explicit(&queue->tail, memory_order_relaxed);
+}
+
+uint64_t persist_processed(const persist_queue_t *queue) {
+    return atomic_load_explicit(&queue->head, memory_order_acquire);
+}
+
+uint64_t persist_pending_for_task(const persist_queue_t *queue, uint64_t task_id) {
+    uint64_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    uint64_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    /* task_id n'est jamais modifié par le fil : lecture sans course. */
+    for (uint64_t seq = tail; seq > head; --seq) {
+        if (queue->slots[(seq - 1) & PERSIST_MASK].task_id == task_id) {
+            return seq;
+        }
+    }
+    return head;
+}
+
+void persist_stop(persist_queue_t *queue) {
+    if (queue == NULL || !queue->running) {
+        return;
+    }
+    atomic_store_explicit(&queue->stopping, true, memory_order_release);
+    sem_post(&queue->ready);
+    pthread_join(queue->thread, NULL);
+    sem_destroy(&queue->ready);
+    queue->running = false;
+}
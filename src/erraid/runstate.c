@@ -0,0 +1,215 @@
+#define _DEFAULT_SOURCE
+#include "runstate.h"
+
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+static size_t file_length(uint32_t capacity) {
+    return sizeof(runstate_header_t) + (size_t)capacity * sizeof(runstate_slot_t);
+}
+
+static runstate_header_t *header_of(runstate_t *state) {
+    return (runstate_header_t *)state->map;
+}
+
+static int map_file(runstate_t *state, uint32_t capacity) {
+    size_t length = file_length(capacity);
+    void *map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, state->fd, 0);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    state->map = map;
+    state->map_length = length;
+    state->capacity = capacity;
+    return 0;
+}
+
+static bool header_valid(const runstate_header_t *header, off_t size) {
+    return memcmp(header->magic, RUNSTATE_MAGIC, 4) == 0 && header->version == RUNSTATE_VERSION &&
+           header->slot_size == sizeof(runstate_slot_t) && header->capacity > 0 &&
+           (off_t)file_length(header->capacity) == size;
+}
+
+/* Fichier absent ou illisible : l'état se reconstruit au fil des exécutions, on repart de zéro. */
+static int initialize_file(runstate_t *state) {
+    if (ftruncate(state->fd, 0) != 0 || ftruncate(state->fd, (off_t)file_length(RUNSTATE_INITIAL_SLOTS)) != 0) {
+        return -1;
+    }
+    if (map_file(state, RUNSTATE_INITIAL_SLOTS) != 0) {
+        return -1;
+    }
+    runstate_header_t *header = header_of(state);
+    memcpy(header->magic, RUNSTATE_MAGIC, 4);
+    header->version = RUNSTATE_VERSION;
+    header->slot_size = sizeof(runstate_slot_t);
+    header->capacity = RUNSTATE_INITIAL_SLOTS;
+    state->dirty = true;
+    return 0;
+}
+
+int runstate_open(runstate_t *state, const char *state_dir, runstate_sync_t sync, int64_t sync_interval_ms) {
+    if (state == NULL || state_dir == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(state, 0, sizeof(*state));
+    state->fd = -1;
+    state->sync = sync;
+    state->sync_interval_ms = sync_interval_ms > 0 ? sync_interval_ms : RUNSTATE_DEFAULT_SYNC_MS;
+    state->sync_due_ms = -1;
+
+    char path[PATH_MAX];
+    if (utils_join_path(state_dir, RUNSTATE_FILE_NAME, path, sizeof(path)) != 0) {
+        return -1;
+    }
+    state->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (state->fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(state->fd, &st) != 0) {
+        runstate_close(state);
+        return -1;
+    }
+    runstate_header_t header;
+    ssize_t n = (st.st_size >= (off_t)sizeof(header)) ? pread(state->fd, &header, sizeof(header), 0) : 0;
+    int rc = (n == (ssize_t)sizeof(header) && header_valid(&header, st.st_size)) ? map_file(state, header.capacity)
+                                                                                 : initialize_file(state);
+    if (rc != 0) {
+        runstate_close(state);
+        return -1;
+    }
+    return 0;
+}
+
+runstate_slot_t *runstate_slot(runstate_t *state, uint32_t index) {
+    if (state == NULL || state->map == NULL || index >= state->capacity) {
+        return NULL;
+    }
+    runstate_slot_t *slots = (runstate_slot_t *)((char *)state->map + sizeof(runstate_header_t));
+    return &slots[index];
+}
+
+/* Double la capacité : nouvelle projection, les anciens pointeurs deviennent invalides. */
+static int grow(runstate_t *state) {
+    uint32_t old_capacity = state->capacity;
+    if (old_capacity > UINT32_MAX / 2) {
+        errno = ENOSPC;
+        return -1;
+    }
+    uint32_t new_capacity = old_capacity * 2;
+    if (ftruncate(state->fd, (off_t)file_length(new_capacity)) != 0) {
+        return -1;
+    }
+    munmap(state->map, state->map_length);
+    state->map = NULL;
+    if (map_file(state, new_capacity) != 0) {
+        int saved_errno = errno;
+        if (map_file(state, old_capacity) != 0) {
+            state->capacity = 0;
+        }
+        errno = saved_errno;
+        return -1;
+    }
+    header_of(state)->capacity = new_capacity;
+    state->dirty = true;
+    return 0;
+}
+
+int runstate_allocate(runstate_t *state, uint64_t task_id, uint32_t *index_out) {
+    if (state == NULL || state->map == NULL || task_id == 0 || index_out == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    uint32_t index = state->free_hint;
+    while (index < state->capacity && runstate_slot(state, index)->task_id != 0) {
+        ++index;
+    }
+    if (index == state->capacity && grow(state) != 0) {
+        return -1;
+    }
+    runstate_slot_t *slot = runstate_slot(state, index);
+    memset(slot, 0, sizeof(*slot));
+    slot->task_id = task_id;
+    slot->last_run_epoch = -1;
+    slot->next_epoch = -1;
+    state->free_hint = index + 1;
+    state->dirty = true;
+    *index_out = index;
+    return 0;
+}
+
+void runstate_release(runstate_t *state, uint32_t index) {
+    runstate_slot_t *slot = runstate_slot(state, index);
+    if (slot == NULL) {
+        return;
+    }
+    memset(slot, 0, sizeof(*slot));
+    if (index < state->free_hint) {
+        state->free_hint = index;
+    }
+    state->dirty = true;
+}
+
+void runstate_commit(runstate_t *state, int64_t now_ms) {
+    if (state == NULL || !state->dirty) {
+        return;
+    }
+    switch (state->sync) {
+        case RUNSTATE_SYNC_ALWAYS:
+            runstate_sync(state);
+            break;
+        case RUNSTATE_SYNC_INTERVAL:
+            if (state->sync_due_ms < 0) {
+                state->sync_due_ms = now_ms + state->sync_interval_ms;
+            }
+            break;
+        case RUNSTATE_SYNC_NONE:
+            state->dirty = false;
+            break;
+    }
+}
+
+int runstate_sync(runstate_t *state) {
+    if (state == NULL || state->map == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    state->sync_due_ms = -1;
+    if (!state->dirty) {
+        return 0;
+    }
+    state->dirty = false;
+    return msync(state->map, state->map_length, MS_SYNC);
+}
+
+void runstate_close(runstate_t *state) {
+    if (state == NULL) {
+        return;
+    }
+    if (state->map != NULL) {
+        if (state->sync != RUNSTATE_SYNC_NONE) {
+            runstate_sync(state);
+        }
+        munmap(state->map, state->map_length);
+        state->map = NULL;
+    }
+    if (state->fd >= 0) {
+        close(state->fd);
+        state->fd = -1;
+    }
+    state->capacity = 0;
+}
@@ -0,0 +1,82 @@
+#include "watch.h"
+
+#include "common.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#define WATCH_MASK (IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO)
+
+int watch_open(void) {
+    return inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+}
+
+int watch_add(int fd, const char *path) {
+    if (fd < 0 || path == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    /* Masque identique pour toutes les tâches : le filtrage par tâche est fait par l'appelant. */
+    return inotify_add_watch(fd, path, WATCH_MASK);
+}
+
+void watch_remove(int fd, int wd) {
+    if (fd >= 0 && wd > 0) {
+        inotify_rm_watch(fd, wd);
+    }
+}
+
+static uint32_t task_events_from_mask(uint32_t mask) {
+    uint32_t events = 0;
+    if (mask & IN_CREATE) {
+        events |= TASK_WATCH_CREATE;
+    }
+    if (mask & IN_CLOSE_WRITE) {
+        events |= TASK_WATCH_CLOSE_WRITE;
+    }
+    if (mask & IN_MOVED_TO) {
+        events |= TASK_WATCH_MOVED_TO;
+    }
+    return events;
+}
+
+int watch_read(int fd, watch_event_fn callback, void *arg) {
+    if (fd < 0 || callback == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    _Alignas(struct inotify_event) char buffer[4096];
+
+    for (;;) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            return -1;
+        }
+        if (n == 0) {
+            return 0;
+        }
+        size_t offset = 0;
+        while (offset + sizeof(struct inotify_event) <= (size_t)n) {
+            const struct inotify_event *event = (const struct inotify_event *)(buffer + offset);
+            if (event->mask & IN_Q_OVERFLOW) {
+                callback(-1, TASK_WATCH_ALL, arg);
+            } else if (event->mask & IN_IGNORED) {
+                callback(event->wd, 0, arg);
+            } else {
+                uint32_t events = task_events_from_mask(event->mask);
+                if (events != 0) {
+                    callback(event->wd, events, arg);
+                }
+            }
+            offset += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
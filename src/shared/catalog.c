@@ -0,0 +1,659 @@
+#include "catalog.h"
+
+#include "storage.h"
+#include "taskopt.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define CATALOG_MAX_ARGS 4096 /* garde-fou contre un encodage corrompu */
+
+typedef struct {
+    task_t *tasks;
+    size_t count;
+    size_t capacity;
+} task_array_t;
+
+typedef struct {
+    const unsigned char *data;
+    size_t length;
+    size_t offset;
+} catalog_reader_t;
+
+static int buffer_reserve(catalog_buffer_t *buffer, size_t extra) {
+    if (buffer->length + extra <= buffer->capacity) {
+        return 0;
+    }
+    size_t new_capacity = buffer->capacity == 0 ? 4096 : buffer->capacity;
+    while (new_capacity < buffer->length + extra) {
+        new_capacity *= 2;
+    }
+    unsigned char *tmp = realloc(buffer->data, new_capacity);
+    if (tmp == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    buffer->data = tmp;
+    buffer->capacity = new_capacity;
+    return 0;
+}
+
+static int buffer_put(catalog_buffer_t *buffer, const void *data, size_t length) {
+    if (buffer_reserve(buffer, length) != 0) {
+        return -1;
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return 0;
+}
+
+static int buffer_put_u32(catalog_buffer_t *buffer, uint32_t value) {
+    return buffer_put(buffer, &value, sizeof(value));
+}
+
+static int buffer_put_u64(catalog_buffer_t *buffer, uint64_t value) {
+    return buffer_put(buffer, &value, sizeof(value));
+}
+
+static int buffer_put_bytes(catalog_buffer_t *buffer, const char *data, size_t length) {
+    if (length > UINT32_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+    if (buffer_put_u32(buffer, (uint32_t)length) != 0) {
+        return -1;
+    }
+    return buffer_put(buffer, data, length);
+}
+
+/*
+ * Encodage d'une tâche : identifiant, type, masques, dernière exécution, commandes
+ * (argc puis chaque argument préfixé de sa longueur) et options au format texte de
+ * taskopt_format, pour que les nouvelles options n'imposent pas de changer de version.
+ */
+static int encode_task(catalog_buffer_t *buffer, const task_t *task) {
+    if (buffer_put_u64(buffer, task->task_id) != 0 ||
+        buffer_put_u32(buffer, (uint32_t)task->type) != 0 ||
+        buffer_put_u64(buffer, task->schedule.minute_mask) != 0 ||
+        buffer_put_u32(buffer, task->schedule.hour_mask) != 0 ||
+        buffer_put_u32(buffer, task->schedule.weekday_mask) != 0 ||
+        buffer_put_u64(buffer, (uint64_t)task->last_run_epoch) != 0 ||
+        buffer_put_u32(buffer, (uint32_t)task->command_count) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < task->command_count; ++i) {
+        const command_t *command = &task->commands[i];
+        if (buffer_put_u32(buffer, (uint32_t)command->argc) != 0) {
+            return -1;
+        }
+        for (size_t j = 0; j < command->argc; ++j) {
+            if (buffer_put_bytes(buffer, command->argv[j], strlen(command->argv[j])) != 0) {
+                return -1;
+            }
+        }
+    }
+    char options[1024 + PATH_MAX];
+    size_t options_len = 0;
+    if (taskopt_format(task, options, sizeof(options), &options_len) != 0) {
+        return -1;
+    }
+    return buffer_put_bytes(buffer, options, options_len);
+}
+
+static int reader_get(catalog_reader_t *reader, void *out, size_t length) {
+    if (reader->length - reader->offset < length) {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy(out, reader->data + reader->offset, length);
+    reader->offset += length;
+    return 0;
+}
+
+/* Chaîne préfixée de sa longueur, copiée et terminée par '\0'. */
+static int reader_get_string(catalog_reader_t *reader, char **out) {
+    uint32_t length = 0;
+    if (reader_get(reader, &length, sizeof(length)) != 0 || reader->length - reader->offset < length) {
+        errno = EINVAL;
+        return -1;
+    }
+    char *copy = malloc((size_t)length + 1);
+    if (copy == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(copy, reader->data + reader->offset, length);
+    copy[length] = '\0';
+    reader->offset += length;
+    *out = copy;
+    return 0;
+}
+
+static int decode_options(task_t *task, char *options) {
+    char *line = options;
+    while (*line != '\0') {
+        char *newline = strchr(line, '\n');
+        if (newline != NULL) {
+            *newline = '\0';
+        }
+        /* Comme pour les fichiers texte : les clés inconnues sont ignorées. */
+        if (*line != '\0' && taskopt_set_line(task, line) != 0 && errno != ENOENT) {
+            return -1;
+        }
+        if (newline == NULL) {
+            break;
+        }
+        line = newline + 1;
+    }
+    return 0;
+}
+
+static int decode_task(const unsigned char *data, size_t length, task_t *task) {
+    memset(task, 0, sizeof(*task));
+    catalog_reader_t reader = {.data = data, .length = length, .offset = 0};
+
+    uint32_t type = 0;
+    uint32_t weekday_mask = 0;
+    uint64_t last_run = 0;
+    uint32_t command_count = 0;
+    if (reader_get(&reader, &task->task_id, sizeof(task->task_id)) != 0 ||
+        reader_get(&reader, &type, sizeof(type)) != 0 ||
+        reader_get(&reader, &task->schedule.minute_mask, sizeof(task->schedule.minute_mask)) != 0 ||
+        reader_get(&reader, &task->schedule.hour_mask, sizeof(task->schedule.hour_mask)) != 0 ||
+        reader_get(&reader, &weekday_mask, sizeof(weekday_mask)) != 0 ||
+        reader_get(&reader, &last_run, sizeof(last_run)) != 0 ||
+        reader_get(&reader, &command_count, sizeof(command_count)) != 0) {
+        return -1;
+    }
+    if (type > TASK_TYPE_ABSTRACT || command_count > length) {
+        errno = EINVAL;
+        return -1;
+    }
+    task->type = (task_type_t)type;
+    task->schedule.weekday_mask = (uint8_t)weekday_mask;
+    task->schedule.enabled = (task->type != TASK_TYPE_ABSTRACT);
+    task->last_run_epoch = (int64_t)last_run;
+
+    if (command_count > 0) {
+        task->commands = calloc(command_count, sizeof(command_t));
+        if (task->commands == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        task->command_count = command_count;
+    }
+    for (uint32_t i = 0; i < command_count; ++i) {
+        command_t *command = &task->commands[i];
+        uint32_t argc = 0;
+        if (reader_get(&reader, &argc, sizeof(argc)) != 0 || argc > CATALOG_MAX_ARGS) {
+            goto fail;
+        }
+        command->argv = calloc((size_t)argc + 1, sizeof(char *));
+        if (command->argv == NULL) {
+            errno = ENOMEM;
+            goto fail;
+        }
+        for (uint32_t j = 0; j < argc; ++j) {
+            if (reader_get_string(&reader, &command->argv[j]) != 0) {
+                goto fail;
+            }
+            command->argc = j + 1;
+        }
+    }
+
+    char *options = NULL;
+    if (reader_get_string(&reader, &options) != 0) {
+        goto fail;
+    }
+    int rc = decode_options(task, options);
+    free(options);
+    if (rc != 0 || reader.offset != reader.length) {
+        goto fail;
+    }
+    return 0;
+
+fail:
+    if (errno != ENOMEM) {
+        errno = EINVAL;
+    }
+    storage_free_task(task);
+    return -1;
+}
+
+static size_t array_lower_bound(const task_array_t *array, uint64_t task_id) {
+    size_t low = 0;
+    size_t high = array->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (array->tasks[mid].task_id < task_id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/* Prend possession de task ; les identifiants croissants sont ajoutés en fin sans décalage. */
+static int array_put(task_array_t *array, task_t *task) {
+    size_t pos = array_lower_bound(array, task->task_id);
+    if (pos < array->count && array->tasks[pos].task_id == task->task_id) {
+        storage_free_task(&array->tasks[pos]);
+        array->tasks[pos] = *task;
+        return 0;
+    }
+    if (array->count == array->capacity) {
+        size_t new_capacity = array->capacity == 0 ? 16 : array->capacity * 2;
+        task_t *tmp = realloc(array->tasks, new_capacity * sizeof(task_t));
+        if (tmp == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        array->tasks = tmp;
+        array->capacity = new_capacity;
+    }
+    if (pos < array->count) {
+        memmove(&array->tasks[pos + 1], &array->tasks[pos], (array->count - pos) * sizeof(task_t));
+    }
+    array->tasks[pos] = *task;
+    array->count += 1;
+    return 0;
+}
+
+static void array_remove(task_array_t *array, uint64_t task_id) {
+    size_t pos = array_lower_bound(array, task_id);
+    if (pos == array->count || array->tasks[pos].task_id != task_id) {
+        return;
+    }
+    storage_free_task(&array->tasks[pos]);
+    memmove(&array->tasks[pos], &array->tasks[pos + 1], (array->count - pos - 1) * sizeof(task_t));
+    array->count -= 1;
+}
+
+static int read_whole_fd(int fd, unsigned char **data_out, size_t *length_out) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return -1;
+    }
+    size_t length = (size_t)st.st_size;
+    unsigned char *data = malloc(length > 0 ? length : 1);
+    if (data == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    size_t offset = 0;
+    while (offset < length) {
+        ssize_t n = pread(fd, data + offset, length - offset, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            free(data);
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        offset += (size_t)n;
+    }
+    *data_out = data;
+    *length_out = offset;
+    return 0;
+}
+
+static int load_snapshot(catalog_t *catalog, task_array_t *array) {
+    int fd = open(catalog->snapshot_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    unsigned char *data = NULL;
+    size_t length = 0;
+    int rc = read_whole_fd(fd, &data, &length);
+    close(fd);
+    if (rc != 0) {
+        return -1;
+    }
+
+    catalog_snapshot_header_t header;
+    if (length < sizeof(header)) {
+        free(data);
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy(&header, data, sizeof(header));
+    const unsigned char *body = data + sizeof(header);
+    size_t body_length = length - sizeof(header);
+    /* Contrairement au journal, un instantané abîmé n'est pas ignoré : les tâches seraient perdues. */
+    if (memcmp(header.magic, CATALOG_MAGIC, 4) != 0 || header.version != CATALOG_VERSION ||
+        header.body_length != body_length || utils_crc32(0, body, body_length) != header.body_crc) {
+        free(data);
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t offset = 0;
+    for (uint64_t i = 0; i < header.task_count; ++i) {
+        uint32_t task_length = 0;
+        if (body_length - offset < sizeof(task_length)) {
+            free(data);
+            errno = EINVAL;
+            return -1;
+        }
+        memcpy(&task_length, body + offset, sizeof(task_length));
+        offset += sizeof(task_length);
+        task_t task;
+        if (body_length - offset < task_length || decode_task(body + offset, task_length, &task) != 0) {
+            free(data);
+            errno = EINVAL;
+            return -1;
+        }
+        offset += task_length;
+        if (array_put(array, &task) != 0) {
+            storage_free_task(&task);
+            free(data);
+            return -1;
+        }
+    }
+    catalog->snapshot_bytes = length;
+    free(data);
+    return 0;
+}
+
+static uint32_t record_crc(const catalog_wal_record_t *record, const unsigned char *payload) {
+    uint32_t crc = utils_crc32(0, &record->task_id, sizeof(*record) - offsetof(catalog_wal_record_t, task_id));
+    return utils_crc32(crc, payload, record->length);
+}
+
+/* Rejoue le journal jusqu'au premier enregistrement incomplet ou invalide, puis tronque. */
+static int replay_wal(catalog_t *catalog, task_array_t *array) {
+    unsigned char *data = NULL;
+    size_t length = 0;
+    if (read_whole_fd(catalog->wal_fd, &data, &length) != 0) {
+        return -1;
+    }
+
+    size_t offset = 0;
+    uint64_t records = 0;
+    while (length - offset >= sizeof(catalog_wal_record_t)) {
+        catalog_wal_record_t record;
+        memcpy(&record, data + offset, sizeof(record));
+        const unsigned char *payload = data + offset + sizeof(record);
+        if (length - offset - sizeof(record) < record.length || record_crc(&record, payload) != record.crc) {
+            break;
+        }
+        if (record.op == CATALOG_OP_PUT) {
+            task_t task;
+            if (decode_task(payload, record.length, &task) != 0) {
+                if (errno == ENOMEM) {
+                    free(data);
+                    return -1;
+                }
+                break;
+            }
+            if (task.task_id != record.task_id) {
+                storage_free_task(&task);
+                break;
+            }
+            if (array_put(array, &task) != 0) {
+                storage_free_task(&task);
+                free(data);
+                return -1;
+            }
+        } else if (record.op == CATALOG_OP_REMOVE) {
+            array_remove(array, record.task_id);
+        } else {
+            break;
+        }
+        offset += sizeof(record) + record.length;
+        records += 1;
+    }
+    free(data);
+
+    if (offset < length && ftruncate(catalog->wal_fd, (off_t)offset) != 0) {
+        return -1;
+    }
+    catalog->wal_bytes = offset;
+    catalog->wal_records = records;
+    return 0;
+}
+
+int catalog_open(catalog_t *catalog, const char *tasks_dir) {
+    if (catalog == NULL || tasks_dir == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(catalog, 0, sizeof(*catalog));
+    catalog->wal_fd = -1;
+    catalog->dir_fd = -1;
+    if (utils_join_path(tasks_dir, CATALOG_SNAPSHOT_NAME, catalog->snapshot_path, sizeof(catalog->snapshot_path)) != 0 ||
+        utils_join_path(tasks_dir, CATALOG_WAL_NAME, catalog->wal_path, sizeof(catalog->wal_path)) != 0) {
+        return -1;
+    }
+    struct stat st;
+    catalog->fresh = stat(catalog->snapshot_path, &st) != 0 && errno == ENOENT &&
+                     stat(catalog->wal_path, &st) != 0 && errno == ENOENT;
+    catalog->dir_fd = open(tasks_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (catalog->dir_fd < 0) {
+        return -1;
+    }
+    catalog->wal_fd = open(catalog->wal_path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (catalog->wal_fd < 0) {
+        return -1;
+    }
+    /* Journal tout juste créé : son entrée de répertoire doit survivre à ses enregistrements. */
+    if (catalog->fresh && fsync(catalog->dir_fd) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int catalog_load(catalog_t *catalog, task_t **tasks_out, size_t *count_out) {
+    if (catalog == NULL || catalog->wal_fd < 0 || tasks_out == NULL || count_out == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    task_array_t array = {.tasks = NULL, .count = 0, .capacity = 0};
+    if (load_snapshot(catalog, &array) != 0 || replay_wal(catalog, &array) != 0) {
+        int saved_errno = errno;
+        storage_free_tasks(array.tasks, array.count);
+        errno = saved_errno;
+        return -1;
+    }
+    *tasks_out = array.tasks;
+    *count_out = array.count;
+    return 0;
+}
+
+static int append_record(catalog_t *catalog, catalog_op_t op, const task_t *task, uint64_t task_id) {
+    catalog_buffer_t *buffer = &catalog->scratch;
+    buffer->length = 0;
+    if (buffer_reserve(buffer, sizeof(catalog_wal_record_t)) != 0) {
+        return -1;
+    }
+    buffer->length = sizeof(catalog_wal_record_t);
+    if (task != NULL && encode_task(buffer, task) != 0) {
+        return -1;
+    }
+
+    catalog_wal_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.length = (uint32_t)(buffer->length - sizeof(record));
+    record.task_id = task_id;
+    record.op = (uint32_t)op;
+    record.crc = record_crc(&record, buffer->data + sizeof(record));
+    memcpy(buffer->data, &record, sizeof(record));
+
+    /* Écriture partielle : on revient à la fin du dernier enregistrement complet. */
+    if (utils_write_all(catalog->wal_fd, buffer->data, buffer->length) != 0 || fdatasync(catalog->wal_fd) != 0) {
+        int saved_errno = errno;
+        /* En cas d'échec, le prochain chargement tronquera l'enregistrement incomplet. */
+        int rc = ftruncate(catalog->wal_fd, (off_t)catalog->wal_bytes);
+        (void)rc;
+        errno = saved_errno;
+        return -1;
+    }
+    catalog->wal_bytes += buffer->length;
+    catalog->wal_records += 1;
+    return 0;
+}
+
+int catalog_put(catalog_t *catalog, const task_t *task) {
+    if (catalog == NULL || catalog->wal_fd < 0 || task == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    return append_record(catalog, CATALOG_OP_PUT, task, task->task_id);
+}
+
+int catalog_remove(catalog_t *catalog, uint64_t task_id) {
+    if (catalog == NULL || catalog->wal_fd < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return append_record(catalog, CATALOG_OP_REMOVE, NULL, task_id);
+}
+
+bool catalog_should_checkpoint(const catalog_t *catalog) {
+    return catalog != NULL && catalog->wal_bytes >= CATALOG_CHECKPOINT_BYTES &&
+           catalog->wal_bytes >= catalog->snapshot_bytes;
+}
+
+static int write_snapshot(const catalog_t *catalog, const catalog_buffer_t *buffer) {
+    char tmp_path[PATH_MAX];
+    int n = snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", catalog->snapshot_path);
+    if (n < 0 || (size_t)n >= sizeof(tmp_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    if (utils_write_all(fd, buffer->data, buffer->length) != 0 || fsync(fd) != 0) {
+        int saved_errno = errno;
+        close(fd);
+        unlink(tmp_path);
+        errno = saved_errno;
+        return -1;
+    }
+    if (close(fd) != 0 || rename(tmp_path, catalog->snapshot_path) != 0) {
+        int saved_errno = errno;
+        unlink(tmp_path);
+        errno = saved_errno;
+        return -1;
+    }
+    /*
+     * Le rename doit être durable avant la troncature du journal : sinon, après une
+     * coupure, l'ancien instantané et un journal vide perdraient les dernières modifications.
+     */
+    return fsync(catalog->dir_fd);
+}
+
+static int encode_snapshot(catalog_buffer_t *buffer, const task_t *tasks, size_t count) {
+    catalog_snapshot_header_t header;
+    memset(&header, 0, sizeof(header));
+    buffer->length = 0;
+    if (buffer_reserve(buffer, sizeof(header)) != 0) {
+        return -1;
+    }
+    buffer->length = sizeof(header);
+    for (size_t i = 0; i < count; ++i) {
+        /* Longueur réservée puis complétée une fois la tâche encodée. */
+        size_t length_offset = buffer->length;
+        if (buffer_put_u32(buffer, 0) != 0 || encode_task(buffer, &tasks[i]) != 0) {
+            return -1;
+        }
+        uint32_t task_length = (uint32_t)(buffer->length - length_offset - sizeof(uint32_t));
+        memcpy(buffer->data + length_offset, &task_length, sizeof(task_length));
+    }
+
+    memcpy(header.magic, CATALOG_MAGIC, 4);
+    header.version = CATALOG_VERSION;
+    header.task_count = count;
+    header.body_length = buffer->length - sizeof(header);
+    header.body_crc = utils_crc32(0, buffer->data + sizeof(header), header.body_length);
+    memcpy(buffer->data, &header, sizeof(header));
+    return 0;
+}
+
+int catalog_checkpoint(catalog_t *catalog, const task_t *tasks, size_t count) {
+    if (catalog == NULL || catalog->wal_fd < 0 || (count > 0 && tasks == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+    catalog_buffer_t *buffer = &catalog->scratch;
+    if (encode_snapshot(buffer, tasks, count) != 0 || write_snapshot(catalog, buffer) != 0) {
+        return -1;
+    }
+    catalog->snapshot_bytes = buffer->length;
+    if (ftruncate(catalog->wal_fd, 0) != 0 || fdatasync(catalog->wal_fd) != 0) {
+        return -1;
+    }
+    catalog->wal_bytes = 0;
+    catalog->wal_records = 0;
+    return 0;
+}
+
+int catalog_encode_snapshot(const task_t *tasks, size_t count, catalog_buffer_t *out) {
+    if (out == NULL || (count > 0 && tasks == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+    return encode_snapshot(out, tasks, count);
+}
+
+int catalog_write_snapshot(const catalog_t *catalog, const catalog_buffer_t *snapshot) {
+    if (catalog == NULL || catalog->dir_fd < 0 || snapshot == NULL || snapshot->length == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return write_snapshot(catalog, snapshot);
+}
+
+int catalog_checkpoint_done(catalog_t *catalog, size_t snapshot_bytes, uint64_t covered_wal_bytes) {
+    if (catalog == NULL || catalog->wal_fd < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    catalog->snapshot_bytes = snapshot_bytes;
+    /* Enregistrements ajoutés depuis l'encodage : le journal attend le prochain point de contrôle. */
+    if (catalog->wal_bytes != covered_wal_bytes) {
+        return 0;
+    }
+    /*
+     * Pas de fdatasync : si la troncature est perdue, les enregistrements
+     * rejoués sont déjà dans l'instantané et les rejouer est sans effet ; le
+     * prochain ajout, lui, est suivi d'un fdatasync qui couvre la taille.
+     */
+    if (ftruncate(catalog->wal_fd, 0) != 0) {
+        return -1;
+    }
+    catalog->wal_bytes = 0;
+    catalog->wal_records = 0;
+    return 0;
+}
+
+void catalog_close(catalog_t *catalog) {
+    if (catalog == NULL) {
+        return;
+    }
+    if (catalog->wal_fd >= 0) {
+        close(catalog->wal_fd);
+        catalog->wal_fd = -1;
+    }
+    if (catalog->dir_fd >= 0) {
+        close(catalog->dir_fd);
+        catalog->dir_fd = -1;
+    }
+    free(catalog->scratch.data);
+    catalog->scratch.data = NULL;
+    catalog->scratch.length = 0;
+    catalog->scratch.capacity = 0;
+}
@@ -0,0 +1,581 @@
+#include "history.h"
+
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+static void fill_header(history_header_t *header) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, HISTORY_MAGIC, 4);
+    header->version = HISTORY_VERSION;
+    header->record_size = sizeof(history_record_t);
+}
+
+_Static_assert(offsetof(history_record_t, stdout_hash) == HISTORY_RECORD_V1_SIZE,
+               "la version 2 doit prolonger l'enregistrement de la version 1");
+
+/* Taille d'enregistrement annoncée par un en-tête valide, 0 sinon. */
+static size_t header_record_size(const history_header_t *header) {
+    if (memcmp(header->magic, HISTORY_MAGIC, 4) != 0) {
+        return 0;
+    }
+    if (header->version == HISTORY_VERSION && header->record_size == sizeof(history_record_t)) {
+        return sizeof(history_record_t);
+    }
+    if (header->version == 1 && header->record_size == HISTORY_RECORD_V1_SIZE) {
+        return HISTORY_RECORD_V1_SIZE;
+    }
+    return 0;
+}
+
+static void encode_record(const task_run_entry_t *entry, history_record_t *record) {
+    memset(record, 0, sizeof(*record));
+    record->epoch = entry->epoch;
+    record->status = entry->status;
+    record->attempt = entry->attempt == 0 ? 1 : entry->attempt;
+    record->stdout_len = entry->stdout_len;
+    record->stderr_len = entry->stderr_len;
+    record->start_ns = entry->usage.start_ns;
+    record->end_ns = entry->usage.end_ns;
+    record->cpu_user_us = entry->usage.cpu_user_us;
+    record->cpu_sys_us = entry->usage.cpu_sys_us;
+    record->max_rss_kb = entry->usage.max_rss_kb;
+    record->blocks_in = entry->usage.blocks_in;
+    record->blocks_out = entry->usage.blocks_out;
+    record->ctx_voluntary = entry->usage.ctx_voluntary;
+    record->ctx_involuntary = entry->usage.ctx_involuntary;
+    record->limits_hit = entry->limits_hit;
+    record->outcome = (uint32_t)entry->outcome;
+    record->deferred_ms = entry->deferred_ms;
+    record->lag_us = entry->lag_us;
+    record->stdout_hash = entry->stdout_hash;
+    record->stderr_hash = entry->stderr_hash;
+}
+
+static const unsigned char *record_at(const history_view_t *view, size_t index) {
+    return view->map + sizeof(history_header_t) + index * view->record_size;
+}
+
+/* Enregistrement i complété en version courante (empreintes nulles pour la version 1). */
+static void read_record(const history_view_t *view, size_t index, history_record_t *record) {
+    memset(record, 0, sizeof(*record));
+    memcpy(record, record_at(view, index), view->record_size);
+}
+
+static int rewrite_tail(int dir_fd, const char *name, const history_view_t *view, size_t first, uint64_t generation);
+
+/* Réécrit un historique de version 1 dans la version courante, en conservant sa génération et sa base. */
+static int upgrade_history(int dir_fd, const char *name, uint64_t generation) {
+    history_view_t view;
+    if (history_open(&view, dir_fd, name) != 0) {
+        return -1;
+    }
+    int rc = rewrite_tail(dir_fd, name, &view, 0, generation);
+    history_close(&view);
+    return rc;
+}
+
+int history_append(int dir_fd, const char *name, const task_run_entry_t *entry, bool sync) {
+    if (name == NULL || entry == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    int fd = openat(dir_fd, name, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    off_t offset = st.st_size;
+    if (offset < (off_t)sizeof(history_header_t)) {
+        history_header_t header;
+        fill_header(&header);
+        if (ftruncate(fd, 0) != 0 || pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+            close(fd);
+            return -1;
+        }
+        offset = sizeof(header);
+    } else {
+        history_header_t header;
+        if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+            close(fd);
+            errno = EIO;
+            return -1;
+        }
+        size_t record_size = header_record_size(&header);
+        if (record_size == 0) {
+            close(fd);
+            errno = EINVAL;
+            return -1;
+        }
+        if (record_size != sizeof(history_record_t)) {
+            close(fd);
+            if (upgrade_history(dir_fd, name, header.generation) != 0) {
+                return -1;
+            }
+            return history_append(dir_fd, name, entry, sync);
+        }
+        /* Enregistrement incomplet laissé par un arrêt brutal : écrasé. */
+        offset -= (offset - (off_t)sizeof(history_header_t)) % (off_t)sizeof(history_record_t);
+    }
+
+    history_record_t record;
+    encode_record(entry, &record);
+    if (pwrite(fd, &record, sizeof(record), offset) != (ssize_t)sizeof(record)) {
+        close(fd);
+        return -1;
+    }
+    if (sync && fsync(fd) != 0) {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+/* Remplacement atomique : écriture dans <name>.tmp, puis commit_replacement. */
+static int open_replacement(int dir_fd, const char *name, char *tmp_name, size_t tmp_len) {
+    int n = snprintf(tmp_name, tmp_len, "%s.tmp", name);
+    if (n < 0 || (size_t)n >= tmp_len) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return openat(dir_fd, tmp_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+}
+
+/*
+ * fsync puis rename si rc vaut 0 ; sinon le fichier temporaire est supprimé. Ferme fd.
+ * Le répertoire est synchronisé après le rename : la compaction enchaîne deux remplacements
+ * dont l'ordre doit survivre à une coupure.
+ */
+static int commit_replacement(int fd, int dir_fd, const char *tmp_name, const char *name, int rc) {
+    if (rc == 0) {
+        rc = fsync(fd);
+    }
+    int saved_errno = errno;
+    close(fd);
+    if (rc != 0 || renameat(dir_fd, tmp_name, dir_fd, name) != 0) {
+        saved_errno = rc != 0 ? saved_errno : errno;
+        unlinkat(dir_fd, tmp_name, 0);
+        errno = saved_errno;
+        return -1;
+    }
+    return fsync(dir_fd);
+}
+
+int history_write_all(int dir_fd, const char *name, const task_run_entry_t *entries, size_t count) {
+    if (name == NULL || (entries == NULL && count > 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+    char tmp_name[PATH_MAX];
+    int fd = open_replacement(dir_fd, name, tmp_name, sizeof(tmp_name));
+    if (fd < 0) {
+        return -1;
+    }
+    history_header_t header;
+    fill_header(&header);
+    int rc = utils_write_all(fd, &header, sizeof(header));
+    for (size_t i = 0; rc == 0 && i < count; ++i) {
+        history_record_t record;
+        encode_record(&entries[i], &record);
+        rc = utils_write_all(fd, &record, sizeof(record));
+    }
+    return commit_replacement(fd, dir_fd, tmp_name, name, rc);
+}
+
+int history_open(history_view_t *view, int dir_fd, const char *name) {
+    if (view == NULL || name == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(view, 0, sizeof(*view));
+    view->fd = openat(dir_fd, name, O_RDONLY | O_CLOEXEC);
+    if (view->fd < 0) {
+        if (errno == ENOENT) {
+            errno = 0;
+            return 0;
+        }
+        return -1;
+    }
+    struct stat st;
+    if (fstat(view->fd, &st) != 0) {
+        history_close(view);
+        return -1;
+    }
+    if (st.st_size <= (off_t)sizeof(history_header_t)) {
+        return 0;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, view->fd, 0);
+    if (map == MAP_FAILED) {
+        history_close(view);
+        return -1;
+    }
+    view->map = map;
+    view->map_length = (size_t)st.st_size;
+    view->record_size = header_record_size((const history_header_t *)view->map);
+    if (view->record_size == 0) {
+        history_close(view);
+        errno = EINVAL;
+        return -1;
+    }
+    view->count = (view->map_length - sizeof(history_header_t)) / view->record_size;
+    view->base = ((const history_header_t *)view->map)->dropped;
+    return 0;
+}
+
+void history_get(const history_view_t *view, size_t index, task_run_entry_t *entry) {
+    memset(entry, 0, sizeof(*entry));
+    if (view == NULL || index >= view->count) {
+        return;
+    }
+    history_record_t record;
+    read_record(view, index, &record);
+    entry->epoch = record.epoch;
+    entry->status = record.status;
+    entry->attempt = record.attempt;
+    entry->stdout_len = (size_t)record.stdout_len;
+    entry->stderr_len = (size_t)record.stderr_len;
+    entry->usage.start_ns = record.start_ns;
+    entry->usage.end_ns = record.end_ns;
+    entry->usage.cpu_user_us = record.cpu_user_us;
+    entry->usage.cpu_sys_us = record.cpu_sys_us;
+    entry->usage.max_rss_kb = record.max_rss_kb;
+    entry->usage.blocks_in = record.blocks_in;
+    entry->usage.blocks_out = record.blocks_out;
+    entry->usage.ctx_voluntary = record.ctx_voluntary;
+    entry->usage.ctx_involuntary = record.ctx_involuntary;
+    entry->limits_hit = record.limits_hit;
+    entry->outcome = (task_run_outcome_t)record.outcome;
+    entry->deferred_ms = record.deferred_ms;
+    entry->lag_us = record.lag_us;
+    entry->stdout_hash = record.stdout_hash;
+    entry->stderr_hash = record.stderr_hash;
+}
+
+int64_t history_epoch_at(const history_view_t *view, size_t index) {
+    int64_t epoch;
+    memcpy(&epoch, record_at(view, index), sizeof(epoch));
+    return epoch;
+}
+
+size_t history_lower_bound(const history_view_t *view, int64_t epoch) {
+    size_t low = 0;
+    size_t high = view != NULL ? view->count : 0;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (history_epoch_at(view, mid) < epoch) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+void history_close(history_view_t *view) {
+    if (view == NULL) {
+        return;
+    }
+    if (view->map != NULL) {
+        munmap((void *)view->map, view->map_length);
+        view->map = NULL;
+    }
+    if (view->fd >= 0) {
+        close(view->fd);
+    }
+    view->fd = -1;
+    view->map_length = 0;
+    view->record_size = 0;
+    view->count = 0;
+}
+
+/* Fichier absent : aucun agrégat, génération 0. */
+static int read_rollups(int dir_fd,
+                        const char *rollup_name,
+                        history_header_t *header,
+                        history_rollup_t **rollups_out,
+                        size_t *count_out) {
+    memset(header, 0, sizeof(*header));
+    *rollups_out = NULL;
+    *count_out = 0;
+    int fd = openat(dir_fd, rollup_name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            errno = 0;
+            return 0;
+        }
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (pread(fd, header, sizeof(*header), 0) != (ssize_t)sizeof(*header) ||
+        memcmp(header->magic, HISTORY_ROLLUP_MAGIC, 4) != 0 || header->version != HISTORY_ROLLUP_VERSION ||
+        header->record_size != sizeof(history_rollup_t)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    size_t count = ((size_t)st.st_size - sizeof(*header)) / sizeof(history_rollup_t);
+    history_rollup_t *rollups = NULL;
+    if (count > 0) {
+        rollups = malloc(count * sizeof(history_rollup_t));
+        if (rollups == NULL) {
+            close(fd);
+            return -1;
+        }
+        size_t length = count * sizeof(history_rollup_t);
+        if (pread(fd, rollups, length, sizeof(*header)) != (ssize_t)length) {
+            free(rollups);
+            close(fd);
+            errno = EIO;
+            return -1;
+        }
+    }
+    close(fd);
+    *rollups_out = rollups;
+    *count_out = count;
+    return 0;
+}
+
+int history_load_rollups(int dir_fd, const char *rollup_name, history_rollup_t **rollups_out, size_t *count_out) {
+    if (rollup_name == NULL || rollups_out == NULL || count_out == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    history_header_t header;
+    return read_rollups(dir_fd, rollup_name, &header, rollups_out, count_out);
+}
+
+static int64_t period_floor(int64_t epoch, uint32_t period_seconds) {
+    int64_t rem = epoch % (int64_t)period_seconds;
+    if (rem < 0) {
+        rem += period_seconds;
+    }
+    return epoch - rem;
+}
+
+/* Horaire pour les HISTORY_ROLLUP_HOURLY_SPAN dernières secondes, quotidien avant. */
+static void assign_period(history_rollup_t *rollup, int64_t epoch, int64_t now_epoch) {
+    uint32_t period_seconds =
+        epoch >= now_epoch - HISTORY_ROLLUP_HOURLY_SPAN ? HISTORY_ROLLUP_HOUR : HISTORY_ROLLUP_DAY;
+    rollup->period_seconds = period_seconds;
+    rollup->period_start = period_floor(epoch, period_seconds);
+}
+
+static void rollup_from_record(const history_record_t *record, int64_t now_epoch, history_rollup_t *rollup) {
+    memset(rollup, 0, sizeof(*rollup));
+    assign_period(rollup, record->epoch, now_epoch);
+    rollup->runs = 1;
+    if (record->outcome == TASK_RUN_SKIPPED) {
+        rollup->skipped = 1;
+    } else if (record->status != 0) {
+        rollup->failures = 1;
+    }
+    if (record->start_ns > 0 && record->end_ns >= record->start_ns) {
+        uint64_t duration_us = (uint64_t)(record->end_ns - record->start_ns) / 1000;
+        rollup->timed = 1;
+        rollup->duration_us_total = duration_us;
+        rollup->duration_us_min = duration_us;
+        rollup->duration_us_max = duration_us;
+    }
+    rollup->stdout_bytes = record->stdout_len;
+    rollup->stderr_bytes = record->stderr_len;
+}
+
+static void merge_rollup(history_rollup_t *into, const history_rollup_t *from) {
+    if (from->timed > 0) {
+        if (into->timed == 0 || from->duration_us_min < into->duration_us_min) {
+            into->duration_us_min = from->duration_us_min;
+        }
+        if (from->duration_us_max > into->duration_us_max) {
+            into->duration_us_max = from->duration_us_max;
+        }
+    }
+    into->runs += from->runs;
+    into->failures += from->failures;
+    into->skipped += from->skipped;
+    into->timed += from->timed;
+    into->duration_us_total += from->duration_us_total;
+    into->stdout_bytes += from->stdout_bytes;
+    into->stderr_bytes += from->stderr_bytes;
+}
+
+static int rollup_compare(const void *a, const void *b) {
+    const history_rollup_t *lhs = a;
+    const history_rollup_t *rhs = b;
+    if (lhs->period_start != rhs->period_start) {
+        return lhs->period_start < rhs->period_start ? -1 : 1;
+    }
+    if (lhs->period_seconds != rhs->period_seconds) {
+        return lhs->period_seconds < rhs->period_seconds ? -1 : 1;
+    }
+    return 0;
+}
+
+/* Tri par période puis fusion des agrégats de même période ; renvoie le nouveau nombre. */
+static size_t normalize_rollups(history_rollup_t *rollups, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    qsort(rollups, count, sizeof(history_rollup_t), rollup_compare);
+    size_t out = 0;
+    for (size_t i = 1; i < count; ++i) {
+        if (rollup_compare(&rollups[out], &rollups[i]) == 0) {
+            merge_rollup(&rollups[out], &rollups[i]);
+        } else {
+            rollups[++out] = rollups[i];
+        }
+    }
+    return out + 1;
+}
+
+static int write_rollups(int dir_fd,
+                         const char *rollup_name,
+                         uint64_t generation,
+                         uint64_t dropped,
+                         const history_rollup_t *rollups,
+                         size_t count) {
+    char tmp_name[PATH_MAX];
+    int fd = open_replacement(dir_fd, rollup_name, tmp_name, sizeof(tmp_name));
+    if (fd < 0) {
+        return -1;
+    }
+    history_header_t header;
+    fill_header(&header);
+    memcpy(header.magic, HISTORY_ROLLUP_MAGIC, 4);
+    header.version = HISTORY_ROLLUP_VERSION;
+    header.record_size = sizeof(history_rollup_t);
+    header.generation = generation;
+    header.dropped = dropped;
+    int rc = utils_write_all(fd, &header, sizeof(header));
+    if (rc == 0 && count > 0) {
+        rc = utils_write_all(fd, rollups, count * sizeof(history_rollup_t));
+    }
+    return commit_replacement(fd, dir_fd, tmp_name, rollup_name, rc);
+}
+
+/*
+ * Nouveau history.bin en version courante : enregistrements [first, count) de la vue,
+ * sous la génération donnée, base avancée de first. Copie directe, sauf vue de
+ * version 1 convertie enregistrement par enregistrement.
+ */
+static int rewrite_tail(int dir_fd, const char *name, const history_view_t *view, size_t first, uint64_t generation) {
+    char tmp_name[PATH_MAX];
+    int fd = open_replacement(dir_fd, name, tmp_name, sizeof(tmp_name));
+    if (fd < 0) {
+        return -1;
+    }
+    history_header_t header;
+    fill_header(&header);
+    header.generation = generation;
+    header.dropped = view->base + first;
+    int rc = utils_write_all(fd, &header, sizeof(header));
+    if (rc == 0 && first < view->count && view->record_size == sizeof(history_record_t)) {
+        rc = utils_write_all(fd, record_at(view, first), (view->count - first) * sizeof(history_record_t));
+    }
+    for (size_t i = first; rc == 0 && i < view->count && view->record_size != sizeof(history_record_t); ++i) {
+        history_record_t record;
+        read_record(view, i, &record);
+        rc = utils_write_all(fd, &record, sizeof(record));
+    }
+    return commit_replacement(fd, dir_fd, tmp_name, name, rc);
+}
+
+int history_compact(int dir_fd,
+                    const char *name,
+                    const char *rollup_name,
+                    int64_t cutoff_epoch,
+                    size_t max_entries,
+                    int64_t now_epoch,
+                    size_t *dropped_out) {
+    if (name == NULL || rollup_name == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (dropped_out != NULL) {
+        *dropped_out = 0;
+    }
+    history_view_t view;
+    if (history_open(&view, dir_fd, name) != 0) {
+        return -1;
+    }
+    if (view.count == 0) {
+        history_close(&view);
+        return 0;
+    }
+    uint64_t generation = ((const history_header_t *)view.map)->generation;
+    history_header_t rollup_header;
+    history_rollup_t *rollups = NULL;
+    size_t rollup_count = 0;
+    if (read_rollups(dir_fd, rollup_name, &rollup_header, &rollups, &rollup_count) != 0) {
+        history_close(&view);
+        return -1;
+    }
+
+    size_t drop;
+    int rc = 0;
+    if (rollup_header.generation == generation + 1) {
+        /* Compaction interrompue après l'écriture des agrégats : ils couvrent déjà ces enregistrements. */
+        drop = rollup_header.dropped < view.count ? (size_t)rollup_header.dropped : view.count;
+    } else {
+        drop = history_lower_bound(&view, cutoff_epoch);
+        if (max_entries > 0 && view.count - drop > max_entries) {
+            drop = view.count - max_entries;
+        }
+        if (drop == 0) {
+            free(rollups);
+            history_close(&view);
+            return 0;
+        }
+        history_rollup_t *grown = realloc(rollups, (rollup_count + drop) * sizeof(history_rollup_t));
+        if (grown == NULL) {
+            free(rollups);
+            history_close(&view);
+            return -1;
+        }
+        rollups = grown;
+        for (size_t i = 0; i < rollup_count; ++i) {
+            if (rollups[i].period_seconds == HISTORY_ROLLUP_HOUR) {
+                assign_period(&rollups[i], rollups[i].period_start, now_epoch);
+            }
+        }
+        for (size_t i = 0; i < drop; ++i) {
+            history_record_t record;
+            read_record(&view, i, &record);
+            rollup_from_record(&record, now_epoch, &rollups[rollup_count + i]);
+        }
+        rollup_count = normalize_rollups(rollups, rollup_count + drop);
+        rc = write_rollups(dir_fd, rollup_name, generation + 1, drop, rollups, rollup_count);
+    }
+    free(rollups);
+    if (rc == 0) {
+        rc = rewrite_tail(dir_fd, name, &view, drop, generation + 1);
+    }
+    history_close(&view);
+    if (rc == 0 && dropped_out != NULL) {
+        *dropped_out = drop;
+    }
+    return rc;
+}
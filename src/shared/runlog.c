@@ -0,0 +1,574 @@
+#include "runlog.h"
+
+#include "utils.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+typedef struct {
+    int64_t epoch;
+    uint32_t attempt;
+} runlog_run_t;
+
+static int records_dir(const char *task_dir, char *buffer, size_t buflen) {
+    return utils_join_path(task_dir, "records", buffer, buflen);
+}
+
+static int record_paths(const char *dir,
+                        int64_t epoch,
+                        uint32_t attempt,
+                        char *log_path,
+                        char *index_path,
+                        size_t buflen) {
+    char name[64];
+    int n = snprintf(name, sizeof(name), "%" PRId64 "-%" PRIu32 ".rec", epoch, attempt);
+    if (n < 0 || (size_t)n >= sizeof(name)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if (utils_join_path(dir, name, log_path, buflen) != 0) {
+        return -1;
+    }
+    memcpy(name + n - 3, "idx", 3);
+    return utils_join_path(dir, name, index_path, buflen);
+}
+
+static int parse_run_name(const char *name, runlog_run_t *run) {
+    char *end = NULL;
+    errno = 0;
+    long long epoch = strtoll(name, &end, 10);
+    if (errno != 0 || end == name || *end != '-') {
+        return -1;
+    }
+    const char *attempt_str = end + 1;
+    unsigned long attempt = strtoul(attempt_str, &end, 10);
+    if (end == attempt_str || strcmp(end, ".rec") != 0 || attempt > UINT32_MAX) {
+        return -1;
+    }
+    run->epoch = (int64_t)epoch;
+    run->attempt = (uint32_t)attempt;
+    return 0;
+}
+
+static int run_compare(const void *a, const void *b) {
+    const runlog_run_t *ra = (const runlog_run_t *)a;
+    const runlog_run_t *rb = (const runlog_run_t *)b;
+    if (ra->epoch != rb->epoch) {
+        return (ra->epoch < rb->epoch) ? -1 : 1;
+    }
+    if (ra->attempt != rb->attempt) {
+        return (ra->attempt < rb->attempt) ? -1 : 1;
+    }
+    return 0;
+}
+
+/* Liste les exécutions journalisées, triées de la plus ancienne à la plus récente. */
+static int list_runs(const char *dir, runlog_run_t **runs_out, size_t *count_out) {
+    *runs_out = NULL;
+    *count_out = 0;
+    DIR *handle = opendir(dir);
+    if (handle == NULL) {
+        return -1;
+    }
+
+    runlog_run_t *runs = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    struct dirent *de;
+    while ((de = readdir(handle)) != NULL) {
+        runlog_run_t run;
+        if (parse_run_name(de->d_name, &run) != 0) {
+            continue;
+        }
+        if (count >= capacity) {
+            size_t new_cap = (capacity == 0) ? 16 : capacity * 2;
+            runlog_run_t *tmp = realloc(runs, new_cap * sizeof(runlog_run_t));
+            if (tmp == NULL) {
+                closedir(handle);
+                free(runs);
+                errno = ENOMEM;
+                return -1;
+            }
+            runs = tmp;
+            capacity = new_cap;
+        }
+        runs[count++] = run;
+    }
+    closedir(handle);
+
+    if (count > 1) {
+        qsort(runs, count, sizeof(runlog_run_t), run_compare);
+    }
+    *runs_out = runs;
+    *count_out = count;
+    return 0;
+}
+
+static void unlink_run(const char *dir, const runlog_run_t *run) {
+    char log_path[PATH_MAX];
+    char index_path[PATH_MAX];
+    if (record_paths(dir, run->epoch, run->attempt, log_path, index_path, sizeof(log_path)) == 0) {
+        unlink(log_path);
+        unlink(index_path);
+    }
+}
+
+/* Garde RUNLOG_RUNS_KEPT - 1 journaux pour laisser la place au nouveau. */
+static void prune_runs(const char *dir) {
+    runlog_run_t *runs = NULL;
+    size_t count = 0;
+    if (list_runs(dir, &runs, &count) != 0) {
+        return;
+    }
+    for (size_t i = 0; i + RUNLOG_RUNS_KEPT <= count; ++i) {
+        unlink_run(dir, &runs[i]);
+    }
+    free(runs);
+}
+
+static int ensure_dir(const char *path) {
+    if (mkdir(path, 0700) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    return 0;
+}
+
+static runlog_chunk_t *new_chunk(const runlog_chunk_t *previous) {
+    runlog_chunk_t *chunk = malloc(sizeof(*chunk));
+    if (chunk == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset(chunk, 0, offsetof(runlog_chunk_t, index));
+    if (previous != NULL) {
+        chunk->files = previous->files;
+        chunk->task_id = previous->task_id;
+        chunk->epoch = previous->epoch;
+        chunk->attempt = previous->attempt;
+    }
+    return chunk;
+}
+
+/* Le bloc suivant est alloué avant de confier l'actuel : writer->chunk n'est jamais NULL. */
+static int submit_chunk(runlog_writer_t *writer) {
+    runlog_chunk_t *next = new_chunk(writer->chunk);
+    if (next == NULL) {
+        return -1;
+    }
+    writer->submit(writer->chunk, writer->submit_arg);
+    writer->chunk = next;
+    return 0;
+}
+
+int runlog_open(runlog_writer_t **out,
+                uint64_t task_id,
+                int64_t epoch,
+                uint32_t attempt,
+                int64_t start_mono_ns,
+                runlog_submit_fn submit,
+                void *submit_arg) {
+    if (out == NULL || submit == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    *out = NULL;
+
+    runlog_writer_t *writer = malloc(sizeof(*writer));
+    if (writer == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memset(writer, 0, offsetof(runlog_writer_t, partial));
+    writer->submit = submit;
+    writer->submit_arg = submit_arg;
+    writer->start_ns = start_mono_ns;
+    writer->chunk = new_chunk(NULL);
+    runlog_files_t *files = malloc(sizeof(*files));
+    if (writer->chunk == NULL || files == NULL) {
+        free(writer->chunk);
+        free(files);
+        free(writer);
+        errno = ENOMEM;
+        return -1;
+    }
+    files->fd = -1;
+    files->index_fd = -1;
+    runlog_chunk_t *chunk = writer->chunk;
+    chunk->files = files;
+    chunk->task_id = task_id;
+    chunk->epoch = epoch;
+    chunk->attempt = attempt;
+    chunk->first = true;
+
+    struct timespec mono;
+    struct timespec real;
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &real);
+    int64_t mono_ns = (int64_t)mono.tv_sec * 1000000000LL + mono.tv_nsec;
+    int64_t real_ns = (int64_t)real.tv_sec * 1000000000LL + real.tv_nsec;
+
+    runlog_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RUNLOG_MAGIC, sizeof(header.magic));
+    header.version = RUNLOG_VERSION;
+    header.start_mono_ns = start_mono_ns;
+    header.start_epoch_ns = real_ns - (mono_ns - start_mono_ns);
+    memcpy(chunk->data, &header, sizeof(header));
+    chunk->length = sizeof(header);
+    writer->offset = sizeof(header);
+    writer->next_index_offset = sizeof(header);
+
+    /* Sans bloc suivant, les fichiers ne seraient jamais fermés : rien n'est soumis. */
+    if (submit_chunk(writer) != 0) {
+        free(writer->chunk);
+        free(files);
+        free(writer);
+        return -1;
+    }
+    *out = writer;
+    return 0;
+}
+
+int runlog_flush(runlog_writer_t *writer) {
+    if (writer == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (writer->chunk->length == 0) {
+        return 0;
+    }
+    return submit_chunk(writer);
+}
+
+static int emit_record(runlog_writer_t *writer, runlog_stream_t stream, int64_t t_ns, const char *data, size_t length) {
+    runlog_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.t_ns = t_ns;
+    record.length = (uint32_t)length;
+    record.stream = (uint8_t)stream;
+
+    if (writer->chunk->length + sizeof(record) + length > sizeof(writer->chunk->data) && submit_chunk(writer) != 0) {
+        return -1;
+    }
+    runlog_chunk_t *chunk = writer->chunk;
+    /* Une entrée tous les RUNLOG_INDEX_STRIDE octets : la capacité de chunk->index suffit. */
+    if (writer->offset >= writer->next_index_offset) {
+        chunk->index[chunk->index_count++] = (runlog_index_entry_t){t_ns, writer->offset};
+        writer->next_index_offset = writer->offset + RUNLOG_INDEX_STRIDE;
+    }
+    memcpy(chunk->data + chunk->length, &record, sizeof(record));
+    memcpy(chunk->data + chunk->length + sizeof(record), data, length);
+    chunk->length += sizeof(record) + length;
+    writer->offset += sizeof(record) + length;
+    return 0;
+}
+
+int runlog_append(runlog_writer_t *writer, runlog_stream_t stream, int64_t now_ns, const char *data, size_t length) {
+    if (writer == NULL || (stream != RUNLOG_STREAM_STDOUT && stream != RUNLOG_STREAM_STDERR)) {
+        errno = EINVAL;
+        return -1;
+    }
+    int64_t t_ns = now_ns - writer->start_ns;
+    char *partial = writer->partial[stream - 1];
+    size_t *partial_len = &writer->partial_len[stream - 1];
+
+    while (length > 0) {
+        size_t room = RUNLOG_MAX_LINE - *partial_len;
+        size_t span = length < room ? length : room;
+        const char *newline = memchr(data, '\n', span);
+        size_t take = (newline != NULL) ? (size_t)(newline - data) + 1 : span;
+
+        if (*partial_len == 0 && newline != NULL) {
+            /* Ligne complète dans le bloc lu : pas de copie intermédiaire. */
+            if (emit_record(writer, stream, t_ns, data, take) != 0) {
+                return -1;
+            }
+        } else {
+            memcpy(partial + *partial_len, data, take);
+            *partial_len += take;
+            if (newline != NULL || *partial_len == RUNLOG_MAX_LINE) {
+                if (emit_record(writer, stream, t_ns, partial, *partial_len) != 0) {
+                    return -1;
+                }
+                *partial_len = 0;
+            }
+        }
+        data += take;
+        length -= take;
+    }
+    return 0;
+}
+
+int runlog_close(runlog_writer_t *writer, int64_t now_ns) {
+    if (writer == NULL) {
+        return 0;
+    }
+    int rc = 0;
+    for (int i = 0; i < 2; ++i) {
+        if (writer->partial_len[i] > 0 &&
+            emit_record(writer, (runlog_stream_t)(i + 1), now_ns - writer->start_ns, writer->partial[i],
+                        writer->partial_len[i]) != 0) {
+            rc = -1;
+        }
+    }
+    /* Toujours soumis, même après un échec : c'est lui qui ferme les fichiers. */
+    writer->chunk->last = true;
+    writer->submit(writer->chunk, writer->submit_arg);
+    free(writer);
+    return rc;
+}
+
+static int open_files(runlog_files_t *files, const runlog_chunk_t *chunk, const char *task_dir) {
+    char dir[PATH_MAX];
+    if (records_dir(task_dir, dir, sizeof(dir)) != 0) {
+        return -1;
+    }
+    if (ensure_dir(dir) != 0) {
+        return -1;
+    }
+    prune_runs(dir);
+
+    char log_path[PATH_MAX];
+    char index_path[PATH_MAX];
+    if (record_paths(dir, chunk->epoch, chunk->attempt, log_path, index_path, sizeof(log_path)) != 0) {
+        return -1;
+    }
+    files->fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (files->fd < 0) {
+        return -1;
+    }
+    files->index_fd = open(index_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (files->index_fd < 0) {
+        int saved = errno;
+        close(files->fd);
+        files->fd = -1;
+        unlink(log_path);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+int runlog_write_chunk(runlog_chunk_t *chunk, const char *task_dir) {
+    if (chunk == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    runlog_files_t *files = chunk->files;
+    int rc = 0;
+    if (chunk->first && (task_dir == NULL || open_files(files, chunk, task_dir) != 0)) {
+        rc = -1;
+    } else if (files->fd >= 0) {
+        /* Le journal avant l'index : une entrée ne désigne jamais des octets absents. */
+        if (utils_write_all(files->fd, chunk->data, chunk->length) != 0 ||
+            utils_write_all(files->index_fd, chunk->index, chunk->index_count * sizeof(runlog_index_entry_t)) != 0) {
+            rc = -1;
+        }
+    }
+    int saved = errno;
+    /* Échec signalé une fois : les blocs suivants trouvent fd < 0 et sont ignorés. */
+    if ((rc != 0 || chunk->last) && files->fd >= 0) {
+        close(files->fd);
+        close(files->index_fd);
+        files->fd = -1;
+        files->index_fd = -1;
+    }
+    if (chunk->last) {
+        free(files);
+    }
+    free(chunk);
+    errno = saved;
+    return rc;
+}
+
+int runlog_latest(const char *task_dir, int64_t *epoch_out, uint32_t *attempt_out) {
+    if (task_dir == NULL || epoch_out == NULL || attempt_out == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    char dir[PATH_MAX];
+    if (records_dir(task_dir, dir, sizeof(dir)) != 0) {
+        return -1;
+    }
+    runlog_run_t *runs = NULL;
+    size_t count = 0;
+    if (list_runs(dir, &runs, &count) != 0) {
+        return -1;
+    }
+    if (count == 0) {
+        free(runs);
+        errno = ENOENT;
+        return -1;
+    }
+    *epoch_out = runs[count - 1].epoch;
+    *attempt_out = runs[count - 1].attempt;
+    free(runs);
+    return 0;
+}
+
+static int read_at(int fd, void *buffer, size_t length, uint64_t offset, size_t *read_out) {
+    size_t total = 0;
+    while (total < length) {
+        ssize_t n = pread(fd, (char *)buffer + total, length - total, (off_t)(offset + total));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        total += (size_t)n;
+    }
+    *read_out = total;
+    return 0;
+}
+
+/* Offset de la dernière entrée d'index strictement antérieure à from_ns. */
+static uint64_t index_lookup(const char *index_path, int64_t from_ns) {
+    uint64_t start = sizeof(runlog_header_t);
+    int fd = open(index_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return start;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return start;
+    }
+    size_t low = 0;
+    size_t high = (size_t)st.st_size / sizeof(runlog_index_entry_t);
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        runlog_index_entry_t entry;
+        size_t got = 0;
+        if (read_at(fd, &entry, sizeof(entry), (uint64_t)mid * sizeof(entry), &got) != 0 || got != sizeof(entry)) {
+            break;
+        }
+        if (entry.t_ns < from_ns) {
+            start = entry.offset;
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    close(fd);
+    return start;
+}
+
+int runlog_read_window(const char *task_dir,
+                       int64_t epoch,
+                       uint32_t attempt,
+                       int64_t from_ns,
+                       int64_t to_ns,
+                       uint64_t cursor,
+                       int64_t *start_epoch_ns,
+                       runlog_visit_fn visit,
+                       void *arg) {
+    if (task_dir == NULL || visit == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    char dir[PATH_MAX];
+    char log_path[PATH_MAX];
+    char index_path[PATH_MAX];
+    if (records_dir(task_dir, dir, sizeof(dir)) != 0 ||
+        record_paths(dir, epoch, attempt, log_path, index_path, sizeof(log_path)) != 0) {
+        return -1;
+    }
+
+    int fd = open(log_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    runlog_header_t header;
+    size_t got = 0;
+    if (read_at(fd, &header, sizeof(header), 0, &got) != 0 || got != sizeof(header) ||
+        memcmp(header.magic, RUNLOG_MAGIC, sizeof(header.magic)) != 0 || header.version != RUNLOG_VERSION) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    if (start_epoch_ns != NULL) {
+        *start_epoch_ns = header.start_epoch_ns;
+    }
+
+    uint64_t offset = (cursor >= sizeof(header)) ? cursor : index_lookup(index_path, from_ns);
+
+    /* Lecture par blocs ; un enregistrement coupé en fin de bloc est relu au bloc suivant. */
+    char block[RUNLOG_WRITE_BUFFER];
+    size_t block_len = 0;
+    size_t pos = 0;
+    uint64_t block_offset = offset;
+    bool at_eof = false;
+    for (;;) {
+        if (!at_eof && block_len - pos < sizeof(runlog_record_t) + RUNLOG_MAX_LINE) {
+            block_offset += pos;
+            if (read_at(fd, block, sizeof(block), block_offset, &block_len) != 0) {
+                close(fd);
+                return -1;
+            }
+            pos = 0;
+            at_eof = (block_len < sizeof(block));
+        }
+        if (block_len - pos < sizeof(runlog_record_t)) {
+            break;
+        }
+        runlog_record_t record;
+        memcpy(&record, block + pos, sizeof(record));
+        if (record.length > RUNLOG_MAX_LINE) {
+            close(fd);
+            errno = EINVAL;
+            return -1;
+        }
+        if (block_len - pos < sizeof(record) + record.length) {
+            break; /* enregistrement en cours d'écriture */
+        }
+        if (record.t_ns > to_ns) {
+            break;
+        }
+        if (record.t_ns >= from_ns &&
+            visit(&record, block + pos + sizeof(record), block_offset + pos, arg) != 0) {
+            break;
+        }
+        pos += sizeof(record) + record.length;
+    }
+
+    close(fd);
+    return 0;
+}
+
+int runlog_remove_task(const char *task_dir) {
+    char dir[PATH_MAX];
+    if (records_dir(task_dir, dir, sizeof(dir)) != 0) {
+        return -1;
+    }
+    runlog_run_t *runs = NULL;
+    size_t count = 0;
+    if (list_runs(dir, &runs, &count) != 0) {
+        return (errno == ENOENT) ? 0 : -1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        unlink_run(dir, &runs[i]);
+    }
+    free(runs);
+    rmdir(dir);
+    return 0;
+}
@@ -3,6 +3,7 @@
 #include "utils.h"
 
 #include <errno.h>
+#include <stdlib.h>
 #include <time.h>
 
 static bool is_minute_allowed(const schedule_t *schedule, int minute) {
@@ -34,6 +35,10 @@ int64_t scheduler_next_occurrence(const schedule_t *schedule, int64_t from_epoch
     if (!schedule->enabled) {
         return -1;
     }
+    /* Masque vide (tâche déclenchée uniquement par événement) : aucune occurrence. */
+    if (schedule->minute_mask == 0 || schedule->hour_mask == 0 || schedule->weekday_mask == 0) {
+        return -1;
+    }
 
     if (from_epoch < 0) {
         from_epoch = 0;
@@ -86,3 +91,109 @@ int scheduler_compute_plan(const task_t *tasks,
 
     return (int)task_count;
 }
+
+static void queue_swap(scheduler_timer_t *a, scheduler_timer_t *b) {
+    scheduler_timer_t tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+static void queue_sift_up(scheduler_queue_t *queue, size_t index) {
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (queue->items[parent].due_ms <= queue->items[index].due_ms) {
+            break;
+        }
+        queue_swap(&queue->items[parent], &queue->items[index]);
+        index = parent;
+    }
+}
+
+static void queue_sift_down(scheduler_queue_t *queue, size_t index) {
+    for (;;) {
+        size_t left = index * 2 + 1;
+        size_t right = left + 1;
+        size_t smallest = index;
+        if (left < queue->count && queue->items[left].due_ms < queue->items[smallest].due_ms) {
+            smallest = left;
+        }
+        if (right < queue->count && queue->items[right].due_ms < queue->items[smallest].due_ms) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            return;
+        }
+        queue_swap(&queue->items[smallest], &queue->items[index]);
+        index = smallest;
+    }
+}
+
+int scheduler_queue_push(scheduler_queue_t *queue, const scheduler_timer_t *timer) {
+    if (queue == NULL || timer == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (queue->count >= queue->capacity) {
+        size_t new_capacity = (queue->capacity == 0) ? 16 : queue->capacity * 2;
+        scheduler_timer_t *tmp = realloc(queue->items, new_capacity * sizeof(scheduler_timer_t));
+        if (tmp == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        queue->items = tmp;
+        queue->capacity = new_capacity;
+    }
+    queue->items[queue->count] = *timer;
+    queue_sift_up(queue, queue->count);
+    queue->count += 1;
+    return 0;
+}
+
+const scheduler_timer_t *scheduler_queue_peek(const scheduler_queue_t *queue) {
+    if (queue == NULL || queue->count == 0) {
+        return NULL;
+    }
+    return &queue->items[0];
+}
+
+int scheduler_queue_pop(scheduler_queue_t *queue, scheduler_timer_t *out) {
+    if (queue == NULL || queue->count == 0) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (out != NULL) {
+        *out = queue->items[0];
+    }
+    queue->count -= 1;
+    if (queue->count > 0) {
+        queue->items[0] = queue->items[queue->count];
+        queue_sift_down(queue, 0);
+    }
+    return 0;
+}
+
+void scheduler_queue_remove_kind(scheduler_queue_t *queue, scheduler_timer_kind_t kind) {
+    if (queue == NULL) {
+        return;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < queue->count; ++i) {
+        if (queue->items[i].kind != kind) {
+            queue->items[kept++] = queue->items[i];
+        }
+    }
+    queue->count = kept;
+    for (size_t i = queue->count / 2; i-- > 0;) {
+        queue_sift_down(queue, i);
+    }
+}
+
+void scheduler_queue_free(scheduler_queue_t *queue) {
+    if (queue == NULL) {
+        return;
+    }
+    free(queue->items);
+    queue->items = NULL;
+    queue->count = 0;
+    queue->capacity = 0;
+}
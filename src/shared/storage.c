@@ -1,5 +1,9 @@
+#define _GNU_SOURCE
 #include "storage.h"
 
+#include "history.h"
+#include "runlog.h"
+#include "taskopt.h"
 #include "utils.h"
 
 #include <ctype.h>
@@ -8,6 +12,8 @@
 #include <fcntl.h>
 #include <limits.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -21,9 +27,10 @@
 #define PATH_MAX 4096
 #endif
 
-static int ensure_directory(const char *path, mode_t mode) {
+/* Répertoire name de dir_fd (AT_FDCWD : chemin), créé s'il n'existe pas. */
+static int ensure_directory_at(int dir_fd, const char *name, mode_t mode) {
     struct stat st;
-    if (stat(path, &st) == 0) {
+    if (fstatat(dir_fd, name, &st, 0) == 0) {
         if (S_ISDIR(st.st_mode)) {
             return 0;
         }
@@ -35,25 +42,141 @@ static int ensure_directory(const char *path, mode_t mode) {
         return -1;
     }
 
-    if (mkdir(path, mode) != 0) {
+    if (mkdirat(dir_fd, name, mode) != 0) {
         return -1;
     }
     return 0;
 }
 
+static int ensure_directory(const char *path, mode_t mode) {
+    return ensure_directory_at(AT_FDCWD, path, mode);
+}
+
+static int open_directory_at(int dir_fd, const char *name) {
+    return openat(dir_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+static int sync_directory_at(int dir_fd, const char *name) {
+    int fd = open_directory_at(dir_fd, name);
+    if (fd < 0) {
+        return -1;
+    }
+    int rc = fsync(fd);
+    int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return rc;
+}
+
+/* Parcours de name : nouveau descripteur, la position de lecture de dir_fd n'est pas partagée. */
+static DIR *opendir_at(int dir_fd, const char *name) {
+    int fd = open_directory_at(dir_fd, name);
+    if (fd < 0) {
+        return NULL;
+    }
+    DIR *dir = fdopendir(fd);
+    if (dir == NULL) {
+        int saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+    }
+    return dir;
+}
+
+/*
+ * Anciennes sorties : ERRAID_STDIO_SNAPSHOT_COUNT emplacements fixes par flux,
+ * last.<ext>.<k>, et un manifeste logs/<ID>/snapshots.bin qui indique quelle
+ * exécution occupe chaque emplacement. La rotation renomme last.<ext> sur
+ * l'emplacement le plus ancien (rename remplace l'occupant) et réécrit le
+ * manifeste : un nombre constant d'appels système, quel que soit le contenu du
+ * répertoire.
+ *
+ * Le contenu est stocké une seule fois dans logs/<ID>/blobs/<EMPREINTE>
+ * (utils_hash64 en hexadécimal) ; last.<ext> et les emplacements en sont des
+ * liens physiques. Une sortie identique à une sortie conservée ne coûte qu'un
+ * lien. Le manifeste compte les références de chaque blob, supprimé quand la
+ * dernière disparaît. Sortie vide, ou lien impossible : fichier ordinaire, empreinte 0.
+ */
+#define SNAPSHOT_MANIFEST_NAME "snapshots.bin"
+#define SNAPSHOT_MANIFEST_MAGIC "ERRS"
+#define SNAPSHOT_MANIFEST_VERSION 2
+#define SNAPSHOT_BLOB_DIR "blobs"
+#define SNAPSHOT_BLOB_CAPACITY (2 * (ERRAID_STDIO_SNAPSHOT_COUNT + 1)) /* un blob au plus par fichier conservé */
+
+typedef struct {
+    int64_t epoch;   /* exécution ayant produit le fichier */
+    uint64_t length; /* 0 : emplacement vide */
+    uint64_t hash;   /* blob dont le fichier est un lien, 0 : fichier ordinaire */
+} snapshot_slot_t;
+
+typedef struct {
+    snapshot_slot_t current; /* last.<ext> */
+    snapshot_slot_t slots[ERRAID_STDIO_SNAPSHOT_COUNT];
+    uint32_t next;           /* prochain emplacement remplacé */
+    uint32_t reserved;
+} snapshot_stream_t;
+
+typedef struct {
+    uint64_t hash; /* 0 : entrée libre */
+    uint64_t length;
+    uint32_t refs; /* fichiers conservés liés au blob */
+    uint32_t reserved;
+} snapshot_blob_t;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t reserved;
+    snapshot_stream_t streams[2]; /* stdout, stderr */
+    snapshot_blob_t blobs[SNAPSHOT_BLOB_CAPACITY];
+} snapshot_manifest_t;
+
+/* Version 1 : mêmes emplacements, sans empreintes ni blobs ; convertie à la première écriture. */
 typedef struct {
-    char *name;
     int64_t epoch;
-    unsigned counter;
-} snapshot_entry_t;
+    uint64_t length;
+} snapshot_slot_v1_t;
+
+typedef struct {
+    snapshot_slot_v1_t current;
+    snapshot_slot_v1_t slots[ERRAID_STDIO_SNAPSHOT_COUNT];
+    uint32_t next;
+    uint32_t reserved;
+} snapshot_stream_v1_t;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t reserved;
+    snapshot_stream_v1_t streams[2];
+} snapshot_manifest_v1_t;
 
-static int build_snapshot_name(char *buffer, size_t size, int64_t epoch, unsigned counter, const char *ext) {
-    if (counter == 0) {
-        return snprintf(buffer, size, "snapshot-%lld.%s", (long long)epoch, ext) >= (int)size ? -1 : 0;
+static const char *const snapshot_exts[2] = {"stdout", "stderr"};
+
+/* Noms relatifs au répertoire de journaux de la tâche. */
+#define SNAPSHOT_NAME_MAX 48
+
+static int snapshot_base_name(size_t stream, char *name, size_t name_len) {
+    int n = snprintf(name, name_len, "last.%s", snapshot_exts[stream]);
+    if (n < 0 || (size_t)n >= name_len) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return 0;
+}
+
+static int snapshot_slot_name(size_t stream, uint32_t slot, char *name, size_t name_len) {
+    int n = snprintf(name, name_len, "last.%s.%u", snapshot_exts[stream], (unsigned)slot);
+    if (n < 0 || (size_t)n >= name_len) {
+        errno = ENAMETOOLONG;
+        return -1;
     }
-    return snprintf(buffer, size, "snapshot-%lld-%u.%s", (long long)epoch, counter, ext) >= (int)size ? -1 : 0;
+    return 0;
 }
 
+/* Nom des anciennes sorties : snapshot-<EPOCH>[-<N>].<ext>, avant le manifeste. */
 static int parse_snapshot_filename(const char *name, const char *ext, int64_t *epoch_out, unsigned *counter_out) {
     if (strncmp(name, "snapshot-", 9) != 0) {
         return -1;
@@ -96,51 +219,61 @@ static int parse_snapshot_filename(const char *name, const char *ext, int64_t *e
     return 0;
 }
 
-static int snapshot_compare_desc(const void *a, const void *b) {
-    const snapshot_entry_t *sa = (const snapshot_entry_t *)a;
-    const snapshot_entry_t *sb = (const snapshot_entry_t *)b;
+typedef struct {
+    char name[64];
+    int64_t epoch;
+    unsigned counter;
+} legacy_snapshot_t;
+
+static int legacy_compare_desc(const void *a, const void *b) {
+    const legacy_snapshot_t *sa = a;
+    const legacy_snapshot_t *sb = b;
     if (sa->epoch != sb->epoch) {
         return (sb->epoch > sa->epoch) ? 1 : -1;
     }
     if (sa->counter != sb->counter) {
-        return (int)sb->counter - (int)sa->counter;
+        return sb->counter > sa->counter ? 1 : -1;
     }
-    return strcmp(sa->name, sb->name);
+    return 0;
 }
 
-static int prune_snapshots(const char *log_dir, const char *ext) {
-    DIR *dir = opendir(log_dir);
-    if (dir == NULL) {
-        if (errno == ENOENT) {
-            errno = 0;
-            return 0;
-        }
+/*
+ * Création du manifeste : les anciennes sorties snapshot-<EPOCH>.<ext> les plus
+ * récentes sont déplacées dans les emplacements, les autres supprimées, et
+ * last.<ext> est mesuré. Ne s'exécute qu'une fois par répertoire.
+ */
+static int migrate_snapshots(int dir_fd, size_t stream, snapshot_stream_t *state) {
+    const char *ext = snapshot_exts[stream];
+    char name[SNAPSHOT_NAME_MAX];
+    if (snapshot_base_name(stream, name, sizeof(name)) != 0) {
         return -1;
     }
+    struct stat st;
+    if (fstatat(dir_fd, name, &st, 0) == 0) {
+        state->current.length = (uint64_t)st.st_size;
+        state->current.epoch = (int64_t)st.st_mtime;
+    }
 
-    snapshot_entry_t *entries = NULL;
+    DIR *dir = opendir_at(dir_fd, ".");
+    if (dir == NULL) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    legacy_snapshot_t *entries = NULL;
     size_t count = 0;
     size_t capacity = 0;
-
     struct dirent *de;
     while ((de = readdir(dir)) != NULL) {
-        if (de->d_name[0] == '.') {
-            continue;
-        }
         int64_t epoch = 0;
         unsigned counter = 0;
-        if (parse_snapshot_filename(de->d_name, ext, &epoch, &counter) != 0) {
+        if (parse_snapshot_filename(de->d_name, ext, &epoch, &counter) != 0 ||
+            strlen(de->d_name) >= sizeof(entries[0].name)) {
             continue;
         }
-
         if (count >= capacity) {
             size_t new_cap = (capacity == 0) ? 8 : (capacity * 2);
-            snapshot_entry_t *tmp = realloc(entries, new_cap * sizeof(snapshot_entry_t));
+            legacy_snapshot_t *tmp = realloc(entries, new_cap * sizeof(legacy_snapshot_t));
             if (tmp == NULL) {
                 closedir(dir);
-                for (size_t i = 0; i < count; ++i) {
-                    free(entries[i].name);
-                }
                 free(entries);
                 errno = ENOMEM;
                 return -1;
@@ -148,101 +281,385 @@ static int prune_snapshots(const char *log_dir, const char *ext) {
             capacity = new_cap;
             entries = tmp;
         }
-
-        entries[count].name = strdup(de->d_name);
-        if (entries[count].name == NULL) {
-            closedir(dir);
-            for (size_t i = 0; i < count; ++i) {
-                free(entries[i].name);
-            }
-            free(entries);
-            errno = ENOMEM;
-            return -1;
-        }
+        strcpy(entries[count].name, de->d_name);
         entries[count].epoch = epoch;
         entries[count].counter = counter;
         ++count;
     }
     closedir(dir);
+    if (count > 0) {
+        qsort(entries, count, sizeof(legacy_snapshot_t), legacy_compare_desc);
+    }
 
-    if (count <= ERRAID_STDIO_SNAPSHOT_COUNT) {
-        for (size_t i = 0; i < count; ++i) {
-            free(entries[i].name);
+    /* La plus récente occupe l'emplacement précédant next, comme après une rotation. */
+    size_t kept = count < ERRAID_STDIO_SNAPSHOT_COUNT ? count : ERRAID_STDIO_SNAPSHOT_COUNT;
+    for (size_t i = 0; i < count; ++i) {
+        const char *legacy_name = entries[i].name;
+        if (i >= kept) {
+            unlinkat(dir_fd, legacy_name, 0);
+            continue;
         }
-        free(entries);
-        return 0;
+        uint32_t slot = (uint32_t)(kept - 1 - i);
+        char slot_name[SNAPSHOT_NAME_MAX];
+        if (fstatat(dir_fd, legacy_name, &st, 0) != 0 || snapshot_slot_name(stream, slot, slot_name, sizeof(slot_name)) != 0 ||
+            renameat(dir_fd, legacy_name, dir_fd, slot_name) != 0) {
+            unlinkat(dir_fd, legacy_name, 0);
+            continue;
+        }
+        state->slots[slot].epoch = entries[i].epoch;
+        state->slots[slot].length = (uint64_t)st.st_size;
     }
+    state->next = (uint32_t)(kept % ERRAID_STDIO_SNAPSHOT_COUNT);
+    free(entries);
+    return 0;
+}
 
-    qsort(entries, count, sizeof(snapshot_entry_t), snapshot_compare_desc);
+static bool snapshot_manifest_valid(const snapshot_manifest_t *manifest) {
+    return memcmp(manifest->magic, SNAPSHOT_MANIFEST_MAGIC, 4) == 0 && manifest->version == SNAPSHOT_MANIFEST_VERSION &&
+           manifest->slot_count == ERRAID_STDIO_SNAPSHOT_COUNT && manifest->streams[0].next < ERRAID_STDIO_SNAPSHOT_COUNT &&
+           manifest->streams[1].next < ERRAID_STDIO_SNAPSHOT_COUNT;
+}
+
+static bool snapshot_manifest_v1_valid(const snapshot_manifest_v1_t *manifest) {
+    return memcmp(manifest->magic, SNAPSHOT_MANIFEST_MAGIC, 4) == 0 && manifest->version == 1 &&
+           manifest->slot_count == ERRAID_STDIO_SNAPSHOT_COUNT && manifest->streams[0].next < ERRAID_STDIO_SNAPSHOT_COUNT &&
+           manifest->streams[1].next < ERRAID_STDIO_SNAPSHOT_COUNT;
+}
 
-    for (size_t i = ERRAID_STDIO_SNAPSHOT_COUNT; i < count; ++i) {
-        char path[PATH_MAX];
-        if (utils_join_path(log_dir, entries[i].name, path, sizeof(path)) == 0) {
-            unlink(path);
+static void convert_manifest_v1(const snapshot_manifest_v1_t *old, snapshot_manifest_t *manifest) {
+    for (size_t stream = 0; stream < 2; ++stream) {
+        const snapshot_stream_v1_t *from = &old->streams[stream];
+        snapshot_stream_t *to = &manifest->streams[stream];
+        to->current.epoch = from->current.epoch;
+        to->current.length = from->current.length;
+        for (size_t slot = 0; slot < ERRAID_STDIO_SNAPSHOT_COUNT; ++slot) {
+            to->slots[slot].epoch = from->slots[slot].epoch;
+            to->slots[slot].length = from->slots[slot].length;
         }
-        free(entries[i].name);
+        to->next = from->next;
     }
+}
 
-    for (size_t i = 0; i < ERRAID_STDIO_SNAPSHOT_COUNT && i < count; ++i) {
-        free(entries[i].name);
+static int snapshot_blob_name(uint64_t hash, const char *suffix, char *name, size_t name_len) {
+    int n = snprintf(name, name_len, SNAPSHOT_BLOB_DIR "/%016llx%s", (unsigned long long)hash, suffix);
+    if (n < 0 || (size_t)n >= name_len) {
+        errno = ENAMETOOLONG;
+        return -1;
     }
-    free(entries);
     return 0;
 }
 
-static int rotate_stdio_snapshot(const char *log_dir,
-                                 const char *base_filename,
-                                 const char *ext,
-                                 int64_t epoch) {
-    char base_path[PATH_MAX];
-    if (utils_join_path(log_dir, base_filename, base_path, sizeof(base_path)) != 0) {
-        return -1;
+static snapshot_blob_t *find_blob(snapshot_manifest_t *manifest, uint64_t hash) {
+    for (size_t i = 0; i < SNAPSHOT_BLOB_CAPACITY; ++i) {
+        if (manifest->blobs[i].hash == hash && manifest->blobs[i].refs > 0) {
+            return &manifest->blobs[i];
+        }
     }
+    return NULL;
+}
 
-    struct stat st;
-    if (stat(base_path, &st) != 0) {
-        if (errno == ENOENT) {
-            errno = 0;
-            return 0;
+static snapshot_blob_t *free_blob_entry(snapshot_manifest_t *manifest) {
+    for (size_t i = 0; i < SNAPSHOT_BLOB_CAPACITY; ++i) {
+        if (manifest->blobs[i].refs == 0) {
+            memset(&manifest->blobs[i], 0, sizeof(manifest->blobs[i]));
+            return &manifest->blobs[i];
         }
+    }
+    return NULL;
+}
+
+/* Retire une référence ; le blob est supprimé avec la dernière. */
+static void release_blob(int dir_fd, snapshot_manifest_t *manifest, uint64_t hash) {
+    if (hash == 0) {
+        return;
+    }
+    snapshot_blob_t *blob = find_blob(manifest, hash);
+    if (blob == NULL || --blob->refs > 0) {
+        return;
+    }
+    char name[SNAPSHOT_NAME_MAX];
+    if (snapshot_blob_name(hash, "", name, sizeof(name)) == 0) {
+        unlinkat(dir_fd, name, 0);
+    }
+    memset(blob, 0, sizeof(*blob));
+}
+
+/* Remplace name par un lien vers le blob (lien temporaire puis rename). */
+static int link_blob(int dir_fd, uint64_t hash, const char *name) {
+    char blob_name[SNAPSHOT_NAME_MAX];
+    char tmp_name[SNAPSHOT_NAME_MAX];
+    if (snapshot_blob_name(hash, "", blob_name, sizeof(blob_name)) != 0) {
         return -1;
     }
-    if (st.st_size == 0) {
-        return 0;
+    int n = snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", name);
+    if (n < 0 || (size_t)n >= sizeof(tmp_name)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    unlinkat(dir_fd, tmp_name, 0);
+    if (linkat(dir_fd, blob_name, dir_fd, tmp_name, 0) != 0) {
+        return -1;
     }
+    if (renameat(dir_fd, tmp_name, dir_fd, name) != 0) {
+        int saved_errno = errno;
+        unlinkat(dir_fd, tmp_name, 0);
+        errno = saved_errno;
+        return -1;
+    }
+    return 0;
+}
 
-    char snapshot_name[64];
-    char snapshot_path[PATH_MAX];
-    unsigned counter = 0;
-    while (counter < 1000) {
-        if (build_snapshot_name(snapshot_name, sizeof(snapshot_name), epoch, counter, ext) != 0) {
-            return -1;
+/*
+ * L'empreinte (FNV-1a 64 bits) ne prouve pas l'égalité : le contenu du blob est
+ * comparé octet par octet avant tout partage.
+ */
+static bool blob_matches(int dir_fd, uint64_t hash, const void *buffer, size_t length) {
+    char name[SNAPSHOT_NAME_MAX];
+    if (snapshot_blob_name(hash, "", name, sizeof(name)) != 0) {
+        return false;
+    }
+    int fd = openat(dir_fd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const char *expected = buffer;
+    char chunk[4096];
+    size_t offset = 0;
+    bool same = true;
+    while (same && offset < length) {
+        size_t want = length - offset < sizeof(chunk) ? length - offset : sizeof(chunk);
+        ssize_t n = pread(fd, chunk, want, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
         }
-        if (utils_join_path(log_dir, snapshot_name, snapshot_path, sizeof(snapshot_path)) != 0) {
-            return -1;
+        same = n == (ssize_t)want && memcmp(chunk, expected + offset, want) == 0;
+        offset += want;
+    }
+    close(fd);
+    return same;
+}
+
+/*
+ * Référence sur le blob du contenu, créé s'il n'existe pas. NULL si le contenu ne
+ * peut pas être partagé (empreinte déjà prise par un autre contenu, table pleine,
+ * écriture impossible) : l'appelant écrit alors un fichier ordinaire.
+ */
+static snapshot_blob_t *acquire_blob(int dir_fd,
+                                     snapshot_manifest_t *manifest,
+                                     uint64_t hash,
+                                     const void *buffer,
+                                     size_t length,
+                                     bool sync) {
+    snapshot_blob_t *blob = find_blob(manifest, hash);
+    if (blob != NULL) {
+        if (blob->length != length || !blob_matches(dir_fd, hash, buffer, length)) {
+            return NULL;
         }
-        if (access(snapshot_path, F_OK) != 0) {
-            if (rename(base_path, snapshot_path) != 0) {
-                return -1;
+        blob->refs += 1;
+        return blob;
+    }
+    blob = free_blob_entry(manifest);
+    char blob_name[SNAPSHOT_NAME_MAX];
+    char tmp_name[SNAPSHOT_NAME_MAX];
+    if (blob == NULL || ensure_directory_at(dir_fd, SNAPSHOT_BLOB_DIR, 0700) != 0 ||
+        snapshot_blob_name(hash, "", blob_name, sizeof(blob_name)) != 0 ||
+        snapshot_blob_name(hash, ".tmp", tmp_name, sizeof(tmp_name)) != 0) {
+        return NULL;
+    }
+    int fd = openat(dir_fd, tmp_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return NULL;
+    }
+    int rc = utils_write_all(fd, buffer, length);
+    if (rc == 0 && sync) {
+        rc = fsync(fd);
+    }
+    close(fd);
+    if (rc != 0 || renameat(dir_fd, tmp_name, dir_fd, blob_name) != 0) {
+        unlinkat(dir_fd, tmp_name, 0);
+        return NULL;
+    }
+    /* Le blob doit exister sur disque avant tout lien qui le désigne. */
+    if (sync && sync_directory_at(dir_fd, SNAPSHOT_BLOB_DIR) != 0) {
+        unlinkat(dir_fd, blob_name, 0);
+        return NULL;
+    }
+    blob->hash = hash;
+    blob->length = length;
+    blob->refs = 1;
+    return blob;
+}
+
+static int read_file_alloc(int dir_fd, const char *name, char **buffer_out, size_t *length_out);
+
+/*
+ * Fichier conservé sans empreinte (anciennes sorties, manifeste de version 1) :
+ * rattaché au blob de même contenu s'il existe, sinon devient lui-même le blob.
+ */
+static void adopt_snapshot(int dir_fd, snapshot_manifest_t *manifest, const char *name, snapshot_slot_t *entry) {
+    char *buffer = NULL;
+    size_t length = 0;
+    if (read_file_alloc(dir_fd, name, &buffer, &length) != 0) {
+        return;
+    }
+    uint64_t hash = length > 0 ? utils_hash64(buffer, length) : 0;
+    entry->length = length;
+    snapshot_blob_t *blob = hash != 0 ? find_blob(manifest, hash) : NULL;
+    bool same = blob != NULL && blob->length == length && blob_matches(dir_fd, hash, buffer, length);
+    free(buffer);
+    if (hash == 0) {
+        return;
+    }
+    if (blob != NULL) {
+        if (same && link_blob(dir_fd, hash, name) == 0) {
+            blob->refs += 1;
+            entry->hash = hash;
+        }
+        return;
+    }
+    blob = free_blob_entry(manifest);
+    char blob_name[SNAPSHOT_NAME_MAX];
+    if (blob == NULL || ensure_directory_at(dir_fd, SNAPSHOT_BLOB_DIR, 0700) != 0 ||
+        snapshot_blob_name(hash, "", blob_name, sizeof(blob_name)) != 0) {
+        return;
+    }
+    unlinkat(dir_fd, blob_name, 0); /* blob orphelin d'un manifeste perdu */
+    if (linkat(dir_fd, name, dir_fd, blob_name, 0) != 0) {
+        return;
+    }
+    blob->hash = hash;
+    blob->length = length;
+    blob->refs = 1;
+    entry->hash = hash;
+}
+
+static void adopt_snapshots(int dir_fd, snapshot_manifest_t *manifest) {
+    for (size_t stream = 0; stream < 2; ++stream) {
+        snapshot_stream_t *state = &manifest->streams[stream];
+        char name[SNAPSHOT_NAME_MAX];
+        if (state->current.length > 0 && snapshot_base_name(stream, name, sizeof(name)) == 0) {
+            adopt_snapshot(dir_fd, manifest, name, &state->current);
+        }
+        for (uint32_t slot = 0; slot < ERRAID_STDIO_SNAPSHOT_COUNT; ++slot) {
+            if (state->slots[slot].length > 0 && snapshot_slot_name(stream, slot, name, sizeof(name)) == 0) {
+                adopt_snapshot(dir_fd, manifest, name, &state->slots[slot]);
             }
-            break;
         }
-        ++counter;
     }
+}
 
-    if (counter >= 1000) {
-        /* fallback: delete oldest if rename impossible */
-        unlink(base_path);
+/* Ouvre logs/<ID>/snapshots.bin et le lit ; version 1 : convertie, absent ou illisible : reconstruit. */
+static int open_snapshot_manifest(int dir_fd, snapshot_manifest_t *manifest) {
+    int fd = openat(dir_fd, SNAPSHOT_MANIFEST_NAME, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t n = pread(fd, manifest, sizeof(*manifest), 0);
+    if (n == (ssize_t)sizeof(*manifest) && snapshot_manifest_valid(manifest)) {
+        return fd;
+    }
+    snapshot_manifest_v1_t old;
+    bool v1 = n >= (ssize_t)sizeof(old) && (memcpy(&old, manifest, sizeof(old)), snapshot_manifest_v1_valid(&old));
+    memset(manifest, 0, sizeof(*manifest));
+    memcpy(manifest->magic, SNAPSHOT_MANIFEST_MAGIC, 4);
+    manifest->version = SNAPSHOT_MANIFEST_VERSION;
+    manifest->slot_count = ERRAID_STDIO_SNAPSHOT_COUNT;
+    if (v1) {
+        convert_manifest_v1(&old, manifest);
+    } else {
+        for (size_t stream = 0; stream < 2; ++stream) {
+            if (migrate_snapshots(dir_fd, stream, &manifest->streams[stream]) != 0) {
+                close(fd);
+                return -1;
+            }
+        }
+    }
+    adopt_snapshots(dir_fd, manifest);
+    /* Conversion unique : liens et blobs créés rendus durables avant le nouveau manifeste. */
+    if (sync_directory_at(dir_fd, SNAPSHOT_BLOB_DIR) != 0 && errno != ENOENT) {
+        close(fd);
+        return -1;
     }
+    if (fsync(dir_fd) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
 
-    if (prune_snapshots(log_dir, ext) != 0) {
+/* last.<ext> non vide passe dans l'emplacement le plus ancien ; le manifeste est mis à jour en mémoire. */
+static int rotate_stdio_snapshot(int dir_fd, snapshot_manifest_t *manifest, size_t stream) {
+    snapshot_stream_t *state = &manifest->streams[stream];
+    if (state->current.length == 0) {
+        return 0;
+    }
+    char base_name[SNAPSHOT_NAME_MAX];
+    char slot_name[SNAPSHOT_NAME_MAX];
+    if (snapshot_base_name(stream, base_name, sizeof(base_name)) != 0 ||
+        snapshot_slot_name(stream, state->next, slot_name, sizeof(slot_name)) != 0) {
         return -1;
     }
+    if (renameat(dir_fd, base_name, dir_fd, slot_name) != 0) {
+        if (errno != ENOENT) {
+            return -1;
+        }
+        errno = 0;
+        release_blob(dir_fd, manifest, state->current.hash);
+    } else {
+        /* L'occupant remplacé perd son nom, et sa référence. */
+        release_blob(dir_fd, manifest, state->slots[state->next].hash);
+        state->slots[state->next] = state->current;
+        state->next = (state->next + 1) % ERRAID_STDIO_SNAPSHOT_COUNT;
+    }
+    memset(&state->current, 0, sizeof(state->current));
     return 0;
 }
 
-static int read_file_alloc(const char *path, char **buffer_out, size_t *length_out) {
-    int fd = open(path, O_RDONLY);
+/* Nouveau last.<ext> : lien vers le blob du contenu, ou fichier ordinaire. hash_out : empreinte du contenu. */
+static int store_stdio_snapshot(int dir_fd,
+                                snapshot_manifest_t *manifest,
+                                size_t stream,
+                                int64_t epoch,
+                                const void *buffer,
+                                size_t length,
+                                bool sync,
+                                uint64_t *hash_out) {
+    char name[SNAPSHOT_NAME_MAX];
+    if (snapshot_base_name(stream, name, sizeof(name)) != 0) {
+        return -1;
+    }
+    snapshot_slot_t *current = &manifest->streams[stream].current;
+    uint64_t hash = length > 0 ? utils_hash64(buffer, length) : 0;
+    *hash_out = hash;
+    current->epoch = epoch;
+    current->length = length;
+    current->hash = 0;
+    if (hash != 0 && acquire_blob(dir_fd, manifest, hash, buffer, length, sync) != NULL) {
+        if (link_blob(dir_fd, hash, name) == 0) {
+            current->hash = hash;
+            return 0;
+        }
+        release_blob(dir_fd, manifest, hash);
+    }
+
+    /* Jamais d'écriture à travers un lien : le blob serait modifié pour tous ses noms. */
+    unlinkat(dir_fd, name, 0);
+    int fd = openat(dir_fd, name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    int rc = length > 0 ? utils_write_all(fd, buffer, length) : 0;
+    if (rc == 0 && sync) {
+        rc = fsync(fd);
+    }
+    int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return rc;
+}
+
+static int read_file_alloc(int dir_fd, const char *name, char **buffer_out, size_t *length_out) {
+    int fd = openat(dir_fd, name, O_RDONLY | O_CLOEXEC);
     if (fd < 0) {
         return -1;
     }
@@ -463,7 +880,8 @@ static int parse_command_line(const char *line, command_t *command) {
         return -1;
     }
     char *element = NULL;
-    while (1) {
+    bool closed = false;
+    while (!closed) {
         while (*p && isspace((unsigned char)*p)) {
             ++p;
         }
@@ -485,6 +903,7 @@ static int parse_command_line(const char *line, command_t *command) {
             ++p;
         } else if (*p == ']') {
             ++p;
+            closed = true;
         } else {
             goto error_element;
         }
@@ -545,6 +964,8 @@ static void free_task(task_t *task) {
         free(task->commands);
         task->commands = NULL;
     }
+    free(task->watch_path);
+    task->watch_path = NULL;
 }
 
 static int parse_task_file(const char *buffer, task_t *task) {
@@ -661,6 +1082,19 @@ static int parse_task_file(const char *buffer, task_t *task) {
         return -1;
     }
 
+    /* Lignes optionnelles « clé=valeur » ; les clés inconnues sont ignorées. */
+    while (index < line_count) {
+        const char *option = lines[index++];
+        if (*option == '\0') {
+            continue;
+        }
+        if (taskopt_set_line(task, option) != 0 && errno != ENOENT) {
+            free(content);
+            free_task(task);
+            return -1;
+        }
+    }
+
     task->schedule.enabled = (task->type != TASK_TYPE_ABSTRACT);
 
     free(content);
@@ -753,120 +1187,614 @@ int storage_init_directories(const storage_paths_t *paths) {
     return 0;
 }
 
-int storage_load_tasks(const storage_paths_t *paths, task_t **tasks_out, size_t *count_out) {
-    if (paths == NULL || tasks_out == NULL || count_out == NULL) {
-        errno = EINVAL;
-        return -1;
+/* Nom d'un répertoire de journaux de l'arborescence plate : identifiant décimal. */
+static bool parse_task_dir_name(const char *name, uint64_t *task_id_out) {
+    if (name[0] < '1' || name[0] > '9') {
+        return false;
+    }
+    for (const char *p = name; *p != '\0'; ++p) {
+        if (!isdigit((unsigned char)*p)) {
+            return false;
+        }
     }
+    return utils_parse_uint64(name, task_id_out) == 0;
+}
 
-    DIR *dir = opendir(paths->tasks_dir);
-    if (dir == NULL) {
+/* Mélange de l'identifiant (finaliseur de MurmurHash3) : des identifiants consécutifs se dispersent. */
+static uint64_t shard_hash(uint64_t task_id) {
+    uint64_t hash = task_id;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/* Chemin relatif à logs/ : <ID>, ou <AA>/<BB>/<ID> en arborescence répartie. */
+static int task_dir_relative(const storage_paths_t *paths, uint64_t task_id, char *buffer, size_t buflen) {
+    int n;
+    if (paths->layout != STORAGE_LAYOUT_SHARDED) {
+        n = snprintf(buffer, buflen, "%llu", (unsigned long long)task_id);
+    } else {
+        uint64_t hash = shard_hash(task_id);
+        n = snprintf(buffer, buflen, "%02x/%02x/%llu", (unsigned)(hash >> 56), (unsigned)((hash >> 48) & 0xffu),
+                     (unsigned long long)task_id);
+    }
+    if (n < 0 || (size_t)n >= buflen) {
+        errno = ENAMETOOLONG;
         return -1;
     }
+    return 0;
+}
 
-    task_t *tasks = NULL;
-    size_t capacity = 0;
-    size_t count = 0;
-
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL) {
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
-        }
-        if (strcmp(entry->d_name, "next_id") == 0) {
-            continue;
-        }
-        if (!has_suffix(entry->d_name, ".task")) {
-            continue;
+static int open_task_dir(int logs_fd, const char *relative, bool create) {
+    int fd = open_directory_at(logs_fd, relative);
+    if (fd >= 0 || !create || errno != ENOENT) {
+        return fd;
+    }
+    if (mkdirat(logs_fd, relative, 0700) != 0 && errno != EEXIST) {
+        if (errno != ENOENT) {
+            return -1;
         }
-
-        if (count >= capacity) {
-            size_t new_cap = (capacity == 0) ? 4 : (capacity * 2);
-            task_t *tmp = realloc(tasks, new_cap * sizeof(task_t));
-            if (tmp == NULL) {
-                closedir(dir);
-                storage_free_tasks(tasks, count);
-                errno = ENOMEM;
+        /* Premier répertoire de cette répartition : les niveaux intermédiaires sont créés. */
+        char prefix[64];
+        for (const char *slash = strchr(relative, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+            size_t len = (size_t)(slash - relative);
+            memcpy(prefix, relative, len);
+            prefix[len] = '\0';
+            if (mkdirat(logs_fd, prefix, 0700) != 0 && errno != EEXIST) {
                 return -1;
             }
-            capacity = new_cap;
-            tasks = tmp;
-        }
-
-        memset(&tasks[count], 0, sizeof(task_t));
-
-        char path[PATH_MAX];
-        if (utils_join_path(paths->tasks_dir, entry->d_name, path, sizeof(path)) != 0) {
-            closedir(dir);
-            storage_free_tasks(tasks, count);
-            return -1;
-        }
-
-        char *file_buffer = NULL;
-        if (read_file_alloc(path, &file_buffer, NULL) != 0) {
-            closedir(dir);
-            storage_free_tasks(tasks, count);
-            return -1;
         }
-
-        if (parse_task_file(file_buffer, &tasks[count]) != 0) {
-            free(file_buffer);
-            closedir(dir);
-            storage_free_tasks(tasks, count);
+        if (mkdirat(logs_fd, relative, 0700) != 0 && errno != EEXIST) {
             return -1;
         }
-        free(file_buffer);
-        ++count;
     }
-    closedir(dir);
-
-    *tasks_out = tasks;
-    *count_out = count;
-    return 0;
+    return open_directory_at(logs_fd, relative);
 }
 
-static int write_task_file(const storage_paths_t *paths, const task_t *task, const char *final_path) {
-    (void)paths;
-    char tmp_path[PATH_MAX];
-    int n = snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", final_path);
-    if (n < 0 || (size_t)n >= sizeof(tmp_path)) {
-        errno = ENAMETOOLONG;
-        return -1;
+void storage_dirs_init(storage_dirs_t *dirs) {
+    if (dirs == NULL) {
+        return;
     }
+    memset(dirs, 0, sizeof(*dirs));
+    dirs->tasks_fd = -1;
+    dirs->logs_fd = -1;
+    for (size_t i = 0; i < STORAGE_DIR_CACHE_SIZE; ++i) {
+        dirs->entries[i].fd = -1;
+    }
+}
 
-    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
-    if (fd < 0) {
+int storage_dirs_open(storage_dirs_t *dirs, const storage_paths_t *paths) {
+    storage_dirs_init(dirs);
+    if (dirs == NULL || paths == NULL || paths->tasks_dir == NULL || paths->logs_dir == NULL) {
+        errno = EINVAL;
         return -1;
     }
-
-    char line[128];
-    n = snprintf(line, sizeof(line), "%llu\n", (unsigned long long)task->task_id);
-    if (n < 0 || (size_t)n >= sizeof(line) || write_all_fd(fd, line, (size_t)n) != 0) {
-        close(fd);
-        unlink(tmp_path);
+    dirs->tasks_fd = open_directory_at(AT_FDCWD, paths->tasks_dir);
+    dirs->logs_fd = dirs->tasks_fd >= 0 ? open_directory_at(AT_FDCWD, paths->logs_dir) : -1;
+    if (dirs->logs_fd < 0) {
+        int saved_errno = errno;
+        storage_dirs_close(dirs);
+        errno = saved_errno;
         return -1;
     }
+    return 0;
+}
 
-    const char *type_str = (task->type == TASK_TYPE_SIMPLE)
-                               ? "SIMPLE"
+void storage_dirs_close(storage_dirs_t *dirs) {
+    if (dirs == NULL) {
+        return;
+    }
+    if (dirs->tasks_fd >= 0) {
+        close(dirs->tasks_fd);
+    }
+    if (dirs->logs_fd >= 0) {
+        close(dirs->logs_fd);
+    }
+    for (size_t i = 0; i < STORAGE_DIR_CACHE_SIZE; ++i) {
+        if (dirs->entries[i].fd >= 0) {
+            close(dirs->entries[i].fd);
+        }
+    }
+    storage_dirs_init(dirs);
+}
+
+/* Répertoire ouvert : entrée d'un storage_dirs_t, ou descripteur propre à l'appel. */
+typedef struct {
+    int fd;
+    bool cached;
+} dir_handle_t;
+
+static void dir_handle_release(dir_handle_t *handle) {
+    if (!handle->cached && handle->fd >= 0) {
+        int saved_errno = errno;
+        close(handle->fd);
+        errno = saved_errno;
+    }
+    handle->fd = -1;
+}
+
+static int tasks_dir_acquire(const storage_paths_t *paths, dir_handle_t *handle) {
+    handle->cached = paths->dirs != NULL && paths->dirs->tasks_fd >= 0;
+    handle->fd = handle->cached ? paths->dirs->tasks_fd : open_directory_at(AT_FDCWD, paths->tasks_dir);
+    return handle->fd >= 0 ? 0 : -1;
+}
+
+static storage_dir_entry_t *dir_cache_find(storage_dirs_t *dirs, uint64_t task_id) {
+    for (size_t i = 0; i < STORAGE_DIR_CACHE_SIZE; ++i) {
+        storage_dir_entry_t *entry = &dirs->entries[i];
+        if (entry->fd >= 0 && entry->task_id == task_id) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void dir_cache_evict(storage_dir_entry_t *entry) {
+    close(entry->fd);
+    entry->fd = -1;
+    entry->task_id = 0;
+}
+
+void storage_dirs_forget(storage_dirs_t *dirs, uint64_t task_id) {
+    if (dirs == NULL) {
+        return;
+    }
+    storage_dir_entry_t *entry = dir_cache_find(dirs, task_id);
+    if (entry != NULL) {
+        dir_cache_evict(entry);
+    }
+}
+
+/* Entrée libre, sinon la moins récemment utilisée, fermée. */
+static storage_dir_entry_t *dir_cache_slot(storage_dirs_t *dirs) {
+    storage_dir_entry_t *oldest = &dirs->entries[0];
+    for (size_t i = 0; i < STORAGE_DIR_CACHE_SIZE; ++i) {
+        storage_dir_entry_t *entry = &dirs->entries[i];
+        if (entry->fd < 0) {
+            return entry;
+        }
+        if (entry->last_used < oldest->last_used) {
+            oldest = entry;
+        }
+    }
+    dir_cache_evict(oldest);
+    return oldest;
+}
+
+/* Répertoire de journaux de la tâche ; create : créé avec ses parents. ENOENT s'il n'existe pas. */
+static int task_dir_acquire(const storage_paths_t *paths, uint64_t task_id, bool create, dir_handle_t *handle) {
+    handle->fd = -1;
+    handle->cached = false;
+    char relative[64];
+    if (task_dir_relative(paths, task_id, relative, sizeof(relative)) != 0) {
+        return -1;
+    }
+    storage_dirs_t *dirs = paths->dirs;
+    if (dirs == NULL || dirs->logs_fd < 0) {
+        int logs_fd = open_directory_at(AT_FDCWD, paths->logs_dir);
+        if (logs_fd < 0) {
+            return -1;
+        }
+        handle->fd = open_task_dir(logs_fd, relative, create);
+        int saved_errno = errno;
+        close(logs_fd);
+        errno = saved_errno;
+        return handle->fd >= 0 ? 0 : -1;
+    }
+
+    storage_dir_entry_t *entry = dir_cache_find(dirs, task_id);
+    if (entry != NULL) {
+        /* Supprimé depuis (autre fil, autre processus) : le descripteur ne désigne plus rien. */
+        struct stat st;
+        if (fstat(entry->fd, &st) == 0 && st.st_nlink > 0) {
+            entry->last_used = ++dirs->clock;
+            handle->fd = entry->fd;
+            handle->cached = true;
+            return 0;
+        }
+        dir_cache_evict(entry);
+    }
+    int fd = open_task_dir(dirs->logs_fd, relative, create);
+    if (fd < 0) {
+        return -1;
+    }
+    entry = dir_cache_slot(dirs);
+    entry->task_id = task_id;
+    entry->fd = fd;
+    entry->last_used = ++dirs->clock;
+    handle->fd = fd;
+    handle->cached = true;
+    return 0;
+}
+
+int storage_task_log_dir(const storage_paths_t *paths, uint64_t task_id, bool create, char *buffer, size_t buflen) {
+    if (paths == NULL || paths->logs_dir == NULL || buffer == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    char relative[64];
+    if (task_dir_relative(paths, task_id, relative, sizeof(relative)) != 0 ||
+        utils_join_path(paths->logs_dir, relative, buffer, buflen) != 0) {
+        return -1;
+    }
+    if (create) {
+        dir_handle_t handle;
+        if (task_dir_acquire(paths, task_id, true, &handle) != 0) {
+            return -1;
+        }
+        dir_handle_release(&handle);
+    }
+    return 0;
+}
+
+/* Après suppression de <AA>/<BB>/<ID> sous logs_fd : retire <BB> puis <AA> s'ils sont vides. */
+static void remove_empty_shards(int logs_fd, const char *relative) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s", relative);
+    for (int level = 0; level < 2; ++level) {
+        char *slash = strrchr(path, '/');
+        if (slash == NULL) {
+            return;
+        }
+        *slash = '\0';
+        if (unlinkat(logs_fd, path, AT_REMOVEDIR) != 0) {
+            return;
+        }
+    }
+}
+
+static int write_layout_marker(const char *logs_dir) {
+    char path[PATH_MAX];
+    char tmp_path[PATH_MAX];
+    if (utils_join_path(logs_dir, STORAGE_LAYOUT_FILE, path, sizeof(path)) != 0 ||
+        utils_join_path(logs_dir, STORAGE_LAYOUT_FILE ".tmp", tmp_path, sizeof(tmp_path)) != 0) {
+        return -1;
+    }
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    int rc = write_line_fd(fd, "sharded");
+    if (rc == 0) {
+        rc = fsync(fd);
+    }
+    close(fd);
+    if (rc != 0 || rename(tmp_path, path) != 0) {
+        int saved_errno = errno;
+        unlink(tmp_path);
+        errno = saved_errno;
+        return -1;
+    }
+    return 0;
+}
+
+static bool layout_marker_present(const char *logs_dir) {
+    char path[PATH_MAX];
+    char content[16] = {0};
+    if (utils_join_path(logs_dir, STORAGE_LAYOUT_FILE, path, sizeof(path)) != 0) {
+        return false;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t n = read(fd, content, sizeof(content) - 1);
+    close(fd);
+    return n > 0 && strncmp(content, "sharded", 7) == 0;
+}
+
+static int layout_pending_dir(const storage_paths_t *paths, char *buffer, size_t buflen) {
+    int n = snprintf(buffer, buflen, "%s%s", paths->logs_dir, STORAGE_LAYOUT_PENDING_SUFFIX);
+    if (n < 0 || (size_t)n >= buflen) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return 0;
+}
+
+int storage_load_layout(storage_paths_t *paths) {
+    if (paths == NULL || paths->logs_dir == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    char pending[PATH_MAX];
+    struct stat st;
+    if (layout_pending_dir(paths, pending, sizeof(pending)) != 0) {
+        return -1;
+    }
+    if (stat(pending, &st) == 0) {
+        return storage_migrate_layout(paths, NULL);
+    }
+    paths->layout = layout_marker_present(paths->logs_dir) ? STORAGE_LAYOUT_SHARDED : STORAGE_LAYOUT_FLAT;
+    return 0;
+}
+
+/*
+ * logs/ est d'abord renommé en logs.flat puis recréé avec logs/layout : un
+ * répertoire logs.flat signale une migration à reprendre, sans ambiguïté entre
+ * un identifiant à deux chiffres et un niveau de répartition.
+ */
+int storage_migrate_layout(storage_paths_t *paths, size_t *moved_out) {
+    if (paths == NULL || paths->logs_dir == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (moved_out != NULL) {
+        *moved_out = 0;
+    }
+    char pending[PATH_MAX];
+    struct stat st;
+    if (layout_pending_dir(paths, pending, sizeof(pending)) != 0) {
+        return -1;
+    }
+    if (stat(pending, &st) != 0) {
+        if (errno != ENOENT) {
+            return -1;
+        }
+        if (layout_marker_present(paths->logs_dir)) {
+            paths->layout = STORAGE_LAYOUT_SHARDED;
+            return 0;
+        }
+        if (rename(paths->logs_dir, pending) != 0) {
+            return -1;
+        }
+    }
+    if (ensure_directory(paths->logs_dir, 0700) != 0 ||
+        (!layout_marker_present(paths->logs_dir) && write_layout_marker(paths->logs_dir) != 0)) {
+        return -1;
+    }
+    paths->layout = STORAGE_LAYOUT_SHARDED;
+
+    DIR *dir = opendir(pending);
+    if (dir == NULL) {
+        return -1;
+    }
+    size_t moved = 0;
+    int rc = 0;
+    struct dirent *de;
+    while (rc == 0 && (de = readdir(dir)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+            continue;
+        }
+        char from[PATH_MAX];
+        char to[PATH_MAX];
+        uint64_t task_id = 0;
+        if (utils_join_path(pending, de->d_name, from, sizeof(from)) != 0) {
+            rc = -1;
+        } else if (parse_task_dir_name(de->d_name, &task_id)) {
+            /* Création des niveaux intermédiaires, puis le répertoire créé est remplacé. */
+            rc = storage_task_log_dir(paths, task_id, true, to, sizeof(to));
+            if (rc == 0 && rmdir(to) == 0) {
+                rc = rename(from, to);
+            }
+            moved += rc == 0;
+        } else if (strcmp(de->d_name, STORAGE_LAYOUT_FILE) != 0) {
+            rc = utils_join_path(paths->logs_dir, de->d_name, to, sizeof(to));
+            if (rc == 0) {
+                rc = rename(from, to);
+            }
+        } else {
+            rc = unlink(from);
+        }
+    }
+    int saved_errno = errno;
+    closedir(dir);
+    if (rc == 0) {
+        rc = rmdir(pending);
+        saved_errno = errno;
+    }
+    if (moved_out != NULL) {
+        *moved_out = moved;
+    }
+    errno = saved_errno;
+    return rc;
+}
+
+/*
+ * Chargement des fichiers .task : le répertoire est parcouru une fois, puis les
+ * fichiers sont lus et analysés par au plus STORAGE_LOAD_THREADS fils (dont
+ * l'appelant), chacun prenant le fichier suivant d'un compteur partagé. Sur un
+ * disque réseau, les lectures se recouvrent au lieu de s'enchaîner. Les tâches
+ * sont ensuite triées par identifiant.
+ */
+#define STORAGE_LOAD_THREADS 8
+#define STORAGE_LOAD_PER_THREAD 32 /* fichiers par fil supplémentaire, en deçà un fil ne rapporte rien */
+
+typedef struct {
+    int dir_fd;
+    char **names;
+    task_t *tasks;
+    int *errors; /* errno par fichier, 0 : chargé */
+    size_t count;
+    atomic_size_t next;
+} task_load_t;
+
+static void *load_task_files(void *arg) {
+    task_load_t *load = arg;
+    for (;;) {
+        size_t i = atomic_fetch_add_explicit(&load->next, 1, memory_order_relaxed);
+        if (i >= load->count) {
+            break;
+        }
+        char *buffer = NULL;
+        errno = 0;
+        if (read_file_alloc(load->dir_fd, load->names[i], &buffer, NULL) != 0 ||
+            parse_task_file(buffer, &load->tasks[i]) != 0) {
+            load->errors[i] = errno != 0 ? errno : EINVAL;
+        }
+        free(buffer);
+    }
+    return NULL;
+}
+
+static int task_id_compare(const void *a, const void *b) {
+    const task_t *ta = a;
+    const task_t *tb = b;
+    if (ta->task_id != tb->task_id) {
+        return ta->task_id < tb->task_id ? -1 : 1;
+    }
+    return 0;
+}
+
+/* Noms des fichiers <ID>.task de dir, à libérer avec free_names. */
+static int list_task_files(DIR *dir, char ***names_out, size_t *count_out) {
+    char **names = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!has_suffix(entry->d_name, ".task")) {
+            continue;
+        }
+        if (count >= capacity) {
+            size_t new_cap = (capacity == 0) ? 64 : (capacity * 2);
+            char **tmp = realloc(names, new_cap * sizeof(char *));
+            if (tmp == NULL) {
+                break;
+            }
+            capacity = new_cap;
+            names = tmp;
+        }
+        names[count] = strdup(entry->d_name);
+        if (names[count] == NULL) {
+            break;
+        }
+        ++count;
+    }
+    if (entry != NULL) {
+        for (size_t i = 0; i < count; ++i) {
+            free(names[i]);
+        }
+        free(names);
+        errno = ENOMEM;
+        return -1;
+    }
+    *names_out = names;
+    *count_out = count;
+    return 0;
+}
+
+int storage_load_tasks(const storage_paths_t *paths, task_t **tasks_out, size_t *count_out) {
+    if (paths == NULL || tasks_out == NULL || count_out == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    dir_handle_t tasks_dir;
+    if (tasks_dir_acquire(paths, &tasks_dir) != 0) {
+        return -1;
+    }
+    DIR *dir = opendir_at(tasks_dir.fd, ".");
+    dir_handle_release(&tasks_dir);
+    if (dir == NULL) {
+        return -1;
+    }
+
+    task_load_t load;
+    memset(&load, 0, sizeof(load));
+    load.dir_fd = dirfd(dir);
+    if (list_task_files(dir, &load.names, &load.count) != 0) {
+        closedir(dir);
+        return -1;
+    }
+    atomic_init(&load.next, 0);
+    if (load.count > 0) {
+        load.tasks = calloc(load.count, sizeof(task_t));
+        load.errors = calloc(load.count, sizeof(int));
+    }
+    int rc = 0;
+    if (load.count > 0 && (load.tasks == NULL || load.errors == NULL)) {
+        errno = ENOMEM;
+        rc = -1;
+    }
+
+    if (rc == 0 && load.count > 0) {
+        size_t extra = (load.count - 1) / STORAGE_LOAD_PER_THREAD;
+        if (extra > STORAGE_LOAD_THREADS - 1) {
+            extra = STORAGE_LOAD_THREADS - 1;
+        }
+        /* Un fil qui ne démarre pas laisse simplement sa part aux autres. */
+        pthread_t threads[STORAGE_LOAD_THREADS - 1];
+        size_t started = 0;
+        while (started < extra && pthread_create(&threads[started], NULL, load_task_files, &load) == 0) {
+            ++started;
+        }
+        load_task_files(&load);
+        for (size_t i = 0; i < started; ++i) {
+            pthread_join(threads[i], NULL);
+        }
+        for (size_t i = 0; i < load.count && rc == 0; ++i) {
+            if (load.errors[i] != 0) {
+                errno = load.errors[i];
+                rc = -1;
+            }
+        }
+    }
+    int saved_errno = errno;
+    closedir(dir);
+    for (size_t i = 0; i < load.count; ++i) {
+        free(load.names[i]);
+    }
+    free(load.names);
+    free(load.errors);
+    if (rc != 0) {
+        storage_free_tasks(load.tasks, load.count);
+        errno = saved_errno;
+        return -1;
+    }
+
+    if (load.count > 1) {
+        qsort(load.tasks, load.count, sizeof(task_t), task_id_compare);
+    }
+    *tasks_out = load.tasks;
+    *count_out = load.count;
+    return 0;
+}
+
+static int write_task_file(int dir_fd, const task_t *task, const char *final_name) {
+    char tmp_name[128];
+    int n = snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", final_name);
+    if (n < 0 || (size_t)n >= sizeof(tmp_name)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    int fd = openat(dir_fd, tmp_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+
+    char line[128];
+    n = snprintf(line, sizeof(line), "%llu\n", (unsigned long long)task->task_id);
+    if (n < 0 || (size_t)n >= sizeof(line) || write_all_fd(fd, line, (size_t)n) != 0) {
+        close(fd);
+        unlinkat(dir_fd, tmp_name, 0);
+        return -1;
+    }
+
+    const char *type_str = (task->type == TASK_TYPE_SIMPLE)
+                               ? "SIMPLE"
                                : (task->type == TASK_TYPE_SEQUENCE) ? "SEQUENCE" : "ABSTRACT";
     if (write_line_fd(fd, type_str) != 0 || write_line_fd(fd, "\n") != 0) {
         close(fd);
-        unlink(tmp_path);
+        unlinkat(dir_fd, tmp_name, 0);
         return -1;
     }
 
     n = snprintf(line, sizeof(line), "%zu\n", task->command_count);
     if (n < 0 || (size_t)n >= sizeof(line) || write_all_fd(fd, line, (size_t)n) != 0) {
         close(fd);
-        unlink(tmp_path);
+        unlinkat(dir_fd, tmp_name, 0);
         return -1;
     }
 
     for (size_t i = 0; i < task->command_count; ++i) {
         if (write_command_line_fd(fd, &task->commands[i]) != 0) {
             close(fd);
-            unlink(tmp_path);
+            unlinkat(dir_fd, tmp_name, 0);
             return -1;
         }
     }
@@ -874,44 +1802,53 @@ static int write_task_file(const storage_paths_t *paths, const task_t *task, con
     n = snprintf(line, sizeof(line), "%015llX\n", (unsigned long long)task->schedule.minute_mask);
     if (n < 0 || (size_t)n >= sizeof(line) || write_all_fd(fd, line, (size_t)n) != 0) {
         close(fd);
-        unlink(tmp_path);
+        unlinkat(dir_fd, tmp_name, 0);
         return -1;
     }
     n = snprintf(line, sizeof(line), "%06X\n", task->schedule.hour_mask & 0xFFFFFFu);
     if (n < 0 || (size_t)n >= sizeof(line) || write_all_fd(fd, line, (size_t)n) != 0) {
         close(fd);
-        unlink(tmp_path);
+        unlinkat(dir_fd, tmp_name, 0);
         return -1;
     }
     n = snprintf(line, sizeof(line), "%02X\n", task->schedule.weekday_mask & 0x7Fu);
     if (n < 0 || (size_t)n >= sizeof(line) || write_all_fd(fd, line, (size_t)n) != 0) {
         close(fd);
-        unlink(tmp_path);
+        unlinkat(dir_fd, tmp_name, 0);
         return -1;
     }
     if (write_line_fd(fd, "0\n") != 0) {
         close(fd);
-        unlink(tmp_path);
+        unlinkat(dir_fd, tmp_name, 0);
         return -1;
     }
     n = snprintf(line, sizeof(line), "%lld\n", (long long)task->last_run_epoch);
     if (n < 0 || (size_t)n >= sizeof(line) || write_all_fd(fd, line, (size_t)n) != 0) {
         close(fd);
-        unlink(tmp_path);
+        unlinkat(dir_fd, tmp_name, 0);
+        return -1;
+    }
+
+    char options[1024 + PATH_MAX];
+    size_t options_len = 0;
+    if (taskopt_format(task, options, sizeof(options), &options_len) != 0 ||
+        write_all_fd(fd, options, options_len) != 0) {
+        close(fd);
+        unlinkat(dir_fd, tmp_name, 0);
         return -1;
     }
 
     if (fsync(fd) != 0) {
         close(fd);
-        unlink(tmp_path);
+        unlinkat(dir_fd, tmp_name, 0);
         return -1;
     }
     if (close(fd) != 0) {
-        unlink(tmp_path);
+        unlinkat(dir_fd, tmp_name, 0);
         return -1;
     }
-    if (rename(tmp_path, final_path) != 0) {
-        unlink(tmp_path);
+    if (renameat(dir_fd, tmp_name, dir_fd, final_name) != 0) {
+        unlinkat(dir_fd, tmp_name, 0);
         return -1;
     }
     return 0;
@@ -928,11 +1865,13 @@ int storage_write_task(const storage_paths_t *paths, const task_t *task) {
         errno = ENAMETOOLONG;
         return -1;
     }
-    char final_path[PATH_MAX];
-    if (utils_join_path(paths->tasks_dir, filename, final_path, sizeof(final_path)) != 0) {
+    dir_handle_t tasks_dir;
+    if (tasks_dir_acquire(paths, &tasks_dir) != 0) {
         return -1;
     }
-    return write_task_file(paths, task, final_path);
+    int rc = write_task_file(tasks_dir.fd, task, filename);
+    dir_handle_release(&tasks_dir);
+    return rc;
 }
 
 int storage_remove_task(const storage_paths_t *paths, uint64_t task_id) {
@@ -946,151 +1885,206 @@ int storage_remove_task(const storage_paths_t *paths, uint64_t task_id) {
         errno = ENAMETOOLONG;
         return -1;
     }
-    char task_path[PATH_MAX];
-    if (utils_join_path(paths->tasks_dir, filename, task_path, sizeof(task_path)) != 0) {
+    dir_handle_t tasks_dir;
+    if (tasks_dir_acquire(paths, &tasks_dir) != 0) {
         return -1;
     }
-    if (unlink(task_path) != 0) {
+    int rc = unlinkat(tasks_dir.fd, filename, 0);
+    dir_handle_release(&tasks_dir);
+    if (rc != 0) {
         return -1;
     }
+    return storage_remove_task_logs(paths, task_id);
+}
 
-    char idbuf[32];
-    n = snprintf(idbuf, sizeof(idbuf), "%llu", (unsigned long long)task_id);
-    if (n < 0 || (size_t)n >= sizeof(idbuf)) {
+int storage_remove_task_logs(const storage_paths_t *paths, uint64_t task_id) {
+    if (paths == NULL) {
+        errno = EINVAL;
         return -1;
     }
-
     char log_dir[PATH_MAX];
-    if (utils_join_path(paths->logs_dir, idbuf, log_dir, sizeof(log_dir)) != 0) {
+    char relative[64];
+    if (storage_task_log_dir(paths, task_id, false, log_dir, sizeof(log_dir)) != 0 ||
+        task_dir_relative(paths, task_id, relative, sizeof(relative)) != 0) {
         return -1;
     }
-    char history_path[PATH_MAX];
-    if (utils_join_path(log_dir, "history.log", history_path, sizeof(history_path)) != 0) {
-        return -1;
+    dir_handle_t dir;
+    if (task_dir_acquire(paths, task_id, false, &dir) != 0) {
+        return errno == ENOENT ? 0 : -1;
     }
-    char stdout_path[PATH_MAX];
-    if (utils_join_path(log_dir, "last.stdout", stdout_path, sizeof(stdout_path)) != 0) {
-        return -1;
+
+    for (size_t stream = 0; stream < 2; ++stream) {
+        char name[SNAPSHOT_NAME_MAX];
+        if (snapshot_base_name(stream, name, sizeof(name)) == 0) {
+            unlinkat(dir.fd, name, 0);
+        }
+        for (uint32_t slot = 0; slot < ERRAID_STDIO_SNAPSHOT_COUNT; ++slot) {
+            if (snapshot_slot_name(stream, slot, name, sizeof(name)) == 0) {
+                unlinkat(dir.fd, name, 0);
+            }
+        }
     }
-    char stderr_path[PATH_MAX];
-    if (utils_join_path(log_dir, "last.stderr", stderr_path, sizeof(stderr_path)) != 0) {
-        return -1;
+
+    DIR *blobs = opendir_at(dir.fd, SNAPSHOT_BLOB_DIR);
+    if (blobs != NULL) {
+        struct dirent *de;
+        while ((de = readdir(blobs)) != NULL) {
+            if (de->d_name[0] != '.') {
+                unlinkat(dirfd(blobs), de->d_name, 0);
+            }
+        }
+        closedir(blobs);
+        unlinkat(dir.fd, SNAPSHOT_BLOB_DIR, AT_REMOVEDIR);
     }
 
-    unlink(history_path);
-    unlink(stdout_path);
-    unlink(stderr_path);
-    rmdir(log_dir);
+    unlinkat(dir.fd, SNAPSHOT_MANIFEST_NAME, 0);
+    unlinkat(dir.fd, HISTORY_FILE_NAME, 0);
+    unlinkat(dir.fd, HISTORY_TEXT_NAME, 0);
+    unlinkat(dir.fd, HISTORY_ROLLUP_NAME, 0);
+    runlog_remove_task(log_dir);
+
+    /* Le répertoire disparaît : son entrée de cache aussi, avant le rmdir. */
+    if (dir.cached) {
+        storage_dirs_forget(paths->dirs, task_id);
+    } else {
+        dir_handle_release(&dir);
+    }
+    int logs_fd = paths->dirs != NULL && paths->dirs->logs_fd >= 0 ? paths->dirs->logs_fd : AT_FDCWD;
+    const char *name = logs_fd == AT_FDCWD ? log_dir : relative;
+    if (unlinkat(logs_fd, name, AT_REMOVEDIR) == 0 && paths->layout == STORAGE_LAYOUT_SHARDED) {
+        remove_empty_shards(logs_fd, name);
+    }
 
     return 0;
 }
 
-int storage_append_history(const storage_paths_t *paths,
-                           uint64_t task_id,
-                           const task_run_entry_t *entry,
-                           const void *stdout_buf,
-                           size_t stdout_len,
-                           const void *stderr_buf,
-                           size_t stderr_len) {
-    if (paths == NULL || entry == NULL) {
-        errno = EINVAL;
-        return -1;
-    }
+static int convert_text_history(int dir_fd);
 
-    char idbuf[32];
-    int n = snprintf(idbuf, sizeof(idbuf), "%llu", (unsigned long long)task_id);
-    if (n < 0 || (size_t)n >= sizeof(idbuf)) {
-        errno = ENAMETOOLONG;
+static int append_history_record(int dir_fd,
+                                 bool sync,
+                                 const task_run_entry_t *entry,
+                                 size_t stdout_len,
+                                 size_t stderr_len) {
+    if (convert_text_history(dir_fd) != 0) {
         return -1;
     }
+    task_run_entry_t record = *entry;
+    record.stdout_len = stdout_len;
+    record.stderr_len = stderr_len;
+    return history_append(dir_fd, HISTORY_FILE_NAME, &record, sync);
+}
 
-    char log_dir[PATH_MAX];
-    if (utils_join_path(paths->logs_dir, idbuf, log_dir, sizeof(log_dir)) != 0) {
+static int append_history_at(int dir_fd,
+                             bool sync,
+                             const task_run_entry_t *entry,
+                             const void *stdout_buf,
+                             size_t stdout_len,
+                             const void *stderr_buf,
+                             size_t stderr_len) {
+    snapshot_manifest_t manifest;
+    int manifest_fd = open_snapshot_manifest(dir_fd, &manifest);
+    if (manifest_fd < 0) {
+        return -1;
+    }
+    if (rotate_stdio_snapshot(dir_fd, &manifest, 0) != 0 || rotate_stdio_snapshot(dir_fd, &manifest, 1) != 0) {
+        close(manifest_fd);
+        return -1;
+    }
+
+    task_run_entry_t record = *entry;
+    record.stdout_len = stdout_buf != NULL ? stdout_len : 0;
+    record.stderr_len = stderr_buf != NULL ? stderr_len : 0;
+    if (store_stdio_snapshot(dir_fd, &manifest, 0, entry->epoch, stdout_buf, record.stdout_len, sync,
+                             &record.stdout_hash) != 0 ||
+        store_stdio_snapshot(dir_fd, &manifest, 1, entry->epoch, stderr_buf, record.stderr_len, sync,
+                             &record.stderr_hash) != 0) {
+        int saved_errno = errno;
+        if (pwrite(manifest_fd, &manifest, sizeof(manifest), 0) < 0) {
+            /* Rotation et références déjà appliquées sur disque : manifeste enregistré au mieux. */
+        }
+        close(manifest_fd);
+        errno = saved_errno;
         return -1;
     }
-    if (ensure_directory(log_dir, 0700) != 0) {
+    /* Rotation et liens (rename dans le répertoire de la tâche) durables avant le manifeste qui les décrit. */
+    if ((sync && fsync(dir_fd) != 0) ||
+        pwrite(manifest_fd, &manifest, sizeof(manifest), 0) != (ssize_t)sizeof(manifest) ||
+        (sync && fsync(manifest_fd) != 0)) {
+        close(manifest_fd);
         return -1;
     }
+    close(manifest_fd);
 
-    if (rotate_stdio_snapshot(log_dir, "last.stdout", "stdout", entry->epoch) != 0) {
-        return -1;
-    }
-    if (rotate_stdio_snapshot(log_dir, "last.stderr", "stderr", entry->epoch) != 0) {
-        return -1;
-    }
+    return append_history_record(dir_fd, sync, &record, stdout_len, stderr_len);
+}
 
-    char stdout_path[PATH_MAX];
-    if (utils_join_path(log_dir, "last.stdout", stdout_path, sizeof(stdout_path)) != 0) {
-        return -1;
-    }
-    char stderr_path[PATH_MAX];
-    if (utils_join_path(log_dir, "last.stderr", stderr_path, sizeof(stderr_path)) != 0) {
+int storage_append_history(const storage_paths_t *paths,
+                           uint64_t task_id,
+                           const task_run_entry_t *entry,
+                           const void *stdout_buf,
+                           size_t stdout_len,
+                           const void *stderr_buf,
+                           size_t stderr_len) {
+    if (paths == NULL || entry == NULL) {
+        errno = EINVAL;
         return -1;
     }
 
-    int fd_out = open(stdout_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
-    if (fd_out < 0) {
-        return -1;
-    }
-    if (stdout_len > 0 && stdout_buf != NULL) {
-        if (write_all_fd(fd_out, (const char *)stdout_buf, stdout_len) != 0) {
-            close(fd_out);
-            return -1;
-        }
-    }
-    if (fsync(fd_out) != 0) {
-        close(fd_out);
+    dir_handle_t dir;
+    if (task_dir_acquire(paths, task_id, true, &dir) != 0) {
         return -1;
     }
-    close(fd_out);
+    int rc = append_history_at(dir.fd,
+                               paths->durability == STORAGE_DURABILITY_STRICT,
+                               entry,
+                               stdout_buf,
+                               stdout_len,
+                               stderr_buf,
+                               stderr_len);
+    dir_handle_release(&dir);
+    return rc;
+}
 
-    int fd_err = open(stderr_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
-    if (fd_err < 0) {
-        return -1;
-    }
-    if (stderr_len > 0 && stderr_buf != NULL) {
-        if (write_all_fd(fd_err, (const char *)stderr_buf, stderr_len) != 0) {
-            close(fd_err);
-            return -1;
-        }
-    }
-    if (fsync(fd_err) != 0) {
-        close(fd_err);
+int storage_append_history_entry(const storage_paths_t *paths, uint64_t task_id, const task_run_entry_t *entry) {
+    if (paths == NULL || entry == NULL) {
+        errno = EINVAL;
         return -1;
     }
-    close(fd_err);
 
-    char history_path[PATH_MAX];
-    if (utils_join_path(log_dir, "history.log", history_path, sizeof(history_path)) != 0) {
+    dir_handle_t dir;
+    if (task_dir_acquire(paths, task_id, true, &dir) != 0) {
         return -1;
     }
+    int rc = append_history_record(dir.fd,
+                                   paths->durability == STORAGE_DURABILITY_STRICT,
+                                   entry,
+                                   entry->stdout_len,
+                                   entry->stderr_len);
+    dir_handle_release(&dir);
+    return rc;
+}
 
-    int fd_hist = open(history_path, O_WRONLY | O_CREAT | O_APPEND, 0600);
-    if (fd_hist < 0) {
+int storage_sync_logs(const storage_paths_t *paths) {
+    if (paths == NULL || paths->logs_dir == NULL) {
+        errno = EINVAL;
         return -1;
     }
-    char line[128];
-    n = snprintf(line,
-                 sizeof(line),
-                 "%lld %d %zu %zu\n",
-                 (long long)entry->epoch,
-                 (int)entry->status,
-                 stdout_len,
-                 stderr_len);
-    if (n < 0 || (size_t)n >= sizeof(line) || write_all_fd(fd_hist, line, (size_t)n) != 0) {
-        close(fd_hist);
-        return -1;
+    if (paths->dirs != NULL && paths->dirs->logs_fd >= 0) {
+        return syncfs(paths->dirs->logs_fd);
     }
-    if (fsync(fd_hist) != 0) {
-        close(fd_hist);
+    int fd = open_directory_at(AT_FDCWD, paths->logs_dir);
+    if (fd < 0) {
         return -1;
     }
-    close(fd_hist);
-
-    return 0;
+    int rc = syncfs(fd);
+    int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return rc;
 }
 
 static int parse_history_entry(const char *line, task_run_entry_t *entry) {
+    memset(entry, 0, sizeof(*entry));
     char *dup = strdup(line);
     if (dup == NULL) {
         errno = ENOMEM;
@@ -1144,39 +2138,84 @@ static int parse_history_entry(const char *line, task_run_entry_t *entry) {
     }
     entry->stderr_len = (size_t)stderr_len;
 
-    free(dup);
-    return 0;
-}
+    /* Champs de consommation : absents des journaux antérieurs, laissés à zéro. */
+    int64_t *usage_fields[] = {
+        &entry->usage.start_ns,
+        &entry->usage.end_ns,
+        &entry->usage.cpu_user_us,
+        &entry->usage.cpu_sys_us,
+        &entry->usage.max_rss_kb,
+        &entry->usage.blocks_in,
+        &entry->usage.blocks_out,
+        &entry->usage.ctx_voluntary,
+        &entry->usage.ctx_involuntary,
+    };
+    for (size_t i = 0; i < sizeof(usage_fields) / sizeof(usage_fields[0]); ++i) {
+        token = strtok(NULL, " ");
+        if (token == NULL) {
+            break;
+        }
+        if (parse_int64(token, usage_fields[i]) != 0) {
+            free(dup);
+            return -1;
+        }
+    }
 
-int storage_load_history(const storage_paths_t *paths,
-                         uint64_t task_id,
-                         task_run_entry_t **entries_out,
-                         size_t *entry_count_out) {
-    if (paths == NULL || entries_out == NULL || entry_count_out == NULL) {
-        errno = EINVAL;
-        return -1;
+    token = strtok(NULL, " ");
+    if (token != NULL) {
+        uint64_t limits_hit = 0;
+        if (parse_uint64(token, &limits_hit) != 0) {
+            free(dup);
+            return -1;
+        }
+        entry->limits_hit = (uint32_t)limits_hit;
     }
 
-    char idbuf[32];
-    int n = snprintf(idbuf, sizeof(idbuf), "%llu", (unsigned long long)task_id);
-    if (n < 0 || (size_t)n >= sizeof(idbuf)) {
-        errno = ENAMETOOLONG;
-        return -1;
+    token = strtok(NULL, " ");
+    if (token != NULL) {
+        uint64_t outcome = 0;
+        if (parse_uint64(token, &outcome) != 0) {
+            free(dup);
+            return -1;
+        }
+        entry->outcome = (task_run_outcome_t)outcome;
     }
 
-    char history_path[PATH_MAX];
-    if (utils_join_path3(paths->logs_dir, idbuf, "history.log", history_path, sizeof(history_path)) != 0) {
+    entry->attempt = 1;
+    token = strtok(NULL, " ");
+    if (token != NULL) {
+        uint64_t attempt = 0;
+        if (parse_uint64(token, &attempt) != 0) {
+            free(dup);
+            return -1;
+        }
+        entry->attempt = (uint32_t)attempt;
+    }
+
+    token = strtok(NULL, " ");
+    if (token != NULL) {
+        int64_t deferred_ms = 0;
+        if (parse_int64(token, &deferred_ms) != 0) {
+            free(dup);
+            return -1;
+        }
+        entry->deferred_ms = deferred_ms;
+    }
+
+    token = strtok(NULL, " ");
+    if (token != NULL && parse_int64(token, &entry->lag_us) != 0) {
+        free(dup);
         return -1;
     }
 
+    free(dup);
+    return 0;
+}
+
+/* Ancien format texte history.log, une ligne par exécution. */
+static int load_text_history(int dir_fd, task_run_entry_t **entries_out, size_t *entry_count_out) {
     char *buffer = NULL;
-    if (read_file_alloc(history_path, &buffer, NULL) != 0) {
-        if (errno == ENOENT) {
-            *entries_out = NULL;
-            *entry_count_out = 0;
-            errno = 0;
-            return 0;
-        }
+    if (read_file_alloc(dir_fd, HISTORY_TEXT_NAME, &buffer, NULL) != 0) {
         return -1;
     }
 
@@ -1227,112 +2266,259 @@ int storage_load_history(const storage_paths_t *paths,
     return 0;
 }
 
-static int read_stdio_file(const char *path, void **buffer_out, size_t *length_out) {
-    int fd = open(path, O_RDONLY);
-    if (fd < 0) {
-        if (errno == ENOENT) {
-            *buffer_out = NULL;
-            *length_out = 0;
-            errno = 0;
-            return 0;
-        }
+/* Convertit history.log en history.bin s'il n'existe pas encore de fichier binaire. */
+static int convert_text_history(int dir_fd) {
+    if (faccessat(dir_fd, HISTORY_FILE_NAME, F_OK, 0) == 0 || faccessat(dir_fd, HISTORY_TEXT_NAME, F_OK, 0) != 0) {
+        errno = 0;
+        return 0;
+    }
+    task_run_entry_t *entries = NULL;
+    size_t count = 0;
+    if (load_text_history(dir_fd, &entries, &count) != 0) {
         return -1;
     }
-    struct stat st;
-    if (fstat(fd, &st) != 0) {
-        close(fd);
+    int rc = history_write_all(dir_fd, HISTORY_FILE_NAME, entries, count);
+    free(entries);
+    if (rc != 0) {
         return -1;
     }
-    size_t size = (size_t)st.st_size;
-    void *buffer = NULL;
-    if (size > 0) {
-        buffer = malloc(size);
-        if (buffer == NULL) {
-            close(fd);
-            errno = ENOMEM;
-            return -1;
-        }
-        size_t total = 0;
-        while (total < size) {
-            ssize_t n = read(fd, (char *)buffer + total, size - total);
-            if (n < 0) {
-                if (errno == EINTR) {
-                    continue;
-                }
-                free(buffer);
-                close(fd);
-                return -1;
-            }
-            if (n == 0) {
-                break;
-            }
-            total += (size_t)n;
-        }
-        if (total != size) {
-            free(buffer);
-            close(fd);
-            errno = EIO;
+    unlinkat(dir_fd, HISTORY_TEXT_NAME, 0);
+    return 0;
+}
+
+
+int storage_open_history(const storage_paths_t *paths, uint64_t task_id, history_view_t *view) {
+    if (paths == NULL || view == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    dir_handle_t dir;
+    if (task_dir_acquire(paths, task_id, false, &dir) != 0) {
+        if (errno != ENOENT) {
             return -1;
         }
+        /* Aucune exécution encore : vue vide, comme pour un fichier absent. */
+        memset(view, 0, sizeof(*view));
+        view->fd = -1;
+        errno = 0;
+        return 0;
     }
-    close(fd);
-    *buffer_out = buffer;
-    *length_out = size;
-    return 0;
+    int rc = convert_text_history(dir.fd);
+    if (rc == 0) {
+        rc = history_open(view, dir.fd, HISTORY_FILE_NAME);
+    }
+    dir_handle_release(&dir);
+    return rc;
 }
 
-int storage_load_last_stdio(const storage_paths_t *paths,
+int storage_compact_history(const storage_paths_t *paths,
                             uint64_t task_id,
-                            void **stdout_buf,
-                            size_t *stdout_len,
-                            void **stderr_buf,
-                            size_t *stderr_len) {
-    if (paths == NULL || stdout_buf == NULL || stderr_buf == NULL || stdout_len == NULL ||
-        stderr_len == NULL) {
+                            const storage_retention_t *retention,
+                            size_t *dropped_out) {
+    if (paths == NULL || retention == NULL) {
         errno = EINVAL;
         return -1;
     }
-
-    char idbuf[32];
-    int n = snprintf(idbuf, sizeof(idbuf), "%llu", (unsigned long long)task_id);
-    if (n < 0 || (size_t)n >= sizeof(idbuf)) {
-        errno = ENAMETOOLONG;
+    if (dropped_out != NULL) {
+        *dropped_out = 0;
+    }
+    int64_t now_epoch = 0;
+    if (utils_now_epoch(&now_epoch) != 0) {
         return -1;
     }
+    dir_handle_t dir;
+    if (task_dir_acquire(paths, task_id, false, &dir) != 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    int64_t cutoff = retention->max_age_seconds > 0 ? now_epoch - (int64_t)retention->max_age_seconds : INT64_MIN;
+    int rc = convert_text_history(dir.fd);
+    if (rc == 0) {
+        rc = history_compact(dir.fd, HISTORY_FILE_NAME, HISTORY_ROLLUP_NAME, cutoff, retention->max_entries,
+                             now_epoch, dropped_out);
+    }
+    dir_handle_release(&dir);
+    return rc;
+}
 
-    char stdout_path[PATH_MAX];
-    if (utils_join_path3(paths->logs_dir, idbuf, "last.stdout", stdout_path, sizeof(stdout_path)) != 0) {
+int storage_load_rollups(const storage_paths_t *paths,
+                         uint64_t task_id,
+                         history_rollup_t **rollups_out,
+                         size_t *count_out) {
+    if (paths == NULL || rollups_out == NULL || count_out == NULL) {
+        errno = EINVAL;
         return -1;
     }
-    char stderr_path[PATH_MAX];
-    if (utils_join_path3(paths->logs_dir, idbuf, "last.stderr", stderr_path, sizeof(stderr_path)) != 0) {
-        return -1;
+    dir_handle_t dir;
+    if (task_dir_acquire(paths, task_id, false, &dir) != 0) {
+        if (errno != ENOENT) {
+            return -1;
+        }
+        *rollups_out = NULL;
+        *count_out = 0;
+        errno = 0;
+        return 0;
     }
+    int rc = history_load_rollups(dir.fd, HISTORY_ROLLUP_NAME, rollups_out, count_out);
+    dir_handle_release(&dir);
+    return rc;
+}
 
-    if (read_stdio_file(stdout_path, stdout_buf, stdout_len) != 0) {
+int storage_load_history(const storage_paths_t *paths,
+                         uint64_t task_id,
+                         task_run_entry_t **entries_out,
+                         size_t *entry_count_out) {
+    if (paths == NULL || entries_out == NULL || entry_count_out == NULL) {
+        errno = EINVAL;
         return -1;
     }
-    if (read_stdio_file(stderr_path, stderr_buf, stderr_len) != 0) {
-        if (*stdout_buf != NULL) {
-            free(*stdout_buf);
-            *stdout_buf = NULL;
-        }
+    history_view_t view;
+    if (storage_open_history(paths, task_id, &view) != 0) {
         return -1;
     }
+    task_run_entry_t *entries = NULL;
+    if (view.count > 0) {
+        entries = malloc(view.count * sizeof(task_run_entry_t));
+        if (entries == NULL) {
+            history_close(&view);
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < view.count; ++i) {
+        history_get(&view, i, &entries[i]);
+    }
+    *entries_out = entries;
+    *entry_count_out = view.count;
+    history_close(&view);
     return 0;
 }
 
-int storage_allocate_task_id(const storage_paths_t *paths, uint64_t *task_id_out) {
-    if (paths == NULL || task_id_out == NULL) {
+/* Manifeste en lecture seule ; absent ou invalide : false, last.<flux> reste lisible. */
+static bool load_snapshot_manifest(int dir_fd, snapshot_manifest_t *manifest) {
+    memset(manifest, 0, sizeof(*manifest));
+    int fd = openat(dir_fd, SNAPSHOT_MANIFEST_NAME, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t n = pread(fd, manifest, sizeof(*manifest), 0);
+    close(fd);
+    if (n == (ssize_t)sizeof(*manifest) && snapshot_manifest_valid(manifest)) {
+        return true;
+    }
+    memset(manifest, 0, sizeof(*manifest));
+    return false;
+}
+
+/* Nom et epoch de la sortie demandée ; ENOENT si elle n'est pas conservée. */
+static int locate_stdio(int dir_fd,
+                        size_t stream,
+                        const storage_stdio_select_t *select,
+                        char *name,
+                        size_t name_len,
+                        int64_t *epoch_out) {
+    snapshot_manifest_t manifest;
+    bool known = load_snapshot_manifest(dir_fd, &manifest);
+    const snapshot_stream_t *state = &manifest.streams[stream];
+
+    if (!select->by_epoch && select->index == 0) {
+        *epoch_out = state->current.epoch;
+        return snapshot_base_name(stream, name, name_len);
+    }
+    if (!known) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (select->by_epoch && state->current.epoch == select->epoch) {
+        *epoch_out = state->current.epoch;
+        return snapshot_base_name(stream, name, name_len);
+    }
+    /* Emplacements du plus récent au plus ancien : next - 1, next - 2... */
+    for (uint32_t k = 1; k <= ERRAID_STDIO_SNAPSHOT_COUNT; ++k) {
+        uint32_t slot = (state->next + ERRAID_STDIO_SNAPSHOT_COUNT - k) % ERRAID_STDIO_SNAPSHOT_COUNT;
+        const snapshot_slot_t *entry = &state->slots[slot];
+        if (entry->length == 0) {
+            break;
+        }
+        if (select->by_epoch ? entry->epoch == select->epoch : k == select->index) {
+            *epoch_out = entry->epoch;
+            return snapshot_slot_name(stream, slot, name, name_len);
+        }
+    }
+    errno = ENOENT;
+    return -1;
+}
+
+int storage_read_stdio(const storage_paths_t *paths,
+                       uint64_t task_id,
+                       bool stdout_stream,
+                       const storage_stdio_select_t *select,
+                       uint64_t offset,
+                       void *buffer,
+                       size_t capacity,
+                       storage_stdio_range_t *range) {
+    if (paths == NULL || select == NULL || range == NULL || (buffer == NULL && capacity > 0)) {
         errno = EINVAL;
         return -1;
     }
-    char id_path[PATH_MAX];
-    if (utils_join_path(paths->tasks_dir, "next_id", id_path, sizeof(id_path)) != 0) {
+    memset(range, 0, sizeof(*range));
+    range->offset = offset;
+
+    bool latest = !select->by_epoch && select->index == 0;
+    dir_handle_t dir;
+    int fd = -1;
+    if (task_dir_acquire(paths, task_id, false, &dir) == 0) {
+        char name[SNAPSHOT_NAME_MAX];
+        if (locate_stdio(dir.fd, stdout_stream ? 0 : 1, select, name, sizeof(name), &range->epoch) == 0) {
+            fd = openat(dir.fd, name, O_RDONLY | O_CLOEXEC);
+        }
+        dir_handle_release(&dir);
+    }
+    if (fd < 0) {
+        if (errno == ENOENT && latest) {
+            /* Aucune exécution encore : sortie vide. */
+            errno = 0;
+            return 0;
+        }
         return -1;
     }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    range->total = (uint64_t)st.st_size;
+    size_t wanted = 0;
+    if (offset < range->total) {
+        uint64_t remaining = range->total - offset;
+        wanted = remaining < capacity ? (size_t)remaining : capacity;
+    }
+    size_t done = 0;
+    while (done < wanted) {
+        ssize_t n = pread(fd, (char *)buffer + done, wanted - done, (off_t)(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd);
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        done += (size_t)n;
+    }
+    close(fd);
+    range->length = done;
+    return 0;
+}
 
-    int fd = open(id_path, O_RDWR | O_CREAT, 0600);
+static int open_next_id(const storage_paths_t *paths, uint64_t *next_id_out) {
+    dir_handle_t tasks_dir;
+    if (tasks_dir_acquire(paths, &tasks_dir) != 0) {
+        return -1;
+    }
+    int fd = openat(tasks_dir.fd, "next_id", O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    dir_handle_release(&tasks_dir);
     if (fd < 0) {
         return -1;
     }
@@ -1352,10 +2538,13 @@ int storage_allocate_task_id(const storage_paths_t *paths, uint64_t *task_id_out
             return -1;
         }
     }
+    *next_id_out = next_id;
+    return fd;
+}
 
-    uint64_t allocated = next_id;
-    ++next_id;
-
+/* Réécrit next_id puis ferme fd. */
+static int store_next_id(int fd, uint64_t next_id) {
+    char buffer[64];
     if (lseek(fd, 0, SEEK_SET) < 0 || ftruncate(fd, 0) != 0) {
         close(fd);
         return -1;
@@ -1370,11 +2559,64 @@ int storage_allocate_task_id(const storage_paths_t *paths, uint64_t *task_id_out
         return -1;
     }
     close(fd);
+    return 0;
+}
+
+int storage_allocate_task_id(const storage_paths_t *paths, uint64_t *task_id_out) {
+    if (paths == NULL || task_id_out == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    uint64_t next_id = 1;
+    int fd = open_next_id(paths, &next_id);
+    if (fd < 0) {
+        return -1;
+    }
+    if (store_next_id(fd, next_id + 1) != 0) {
+        return -1;
+    }
+    *task_id_out = next_id;
+    return 0;
+}
 
-    *task_id_out = allocated;
+int storage_load_next_task_id(const storage_paths_t *paths, uint64_t *next_id_out) {
+    if (paths == NULL || next_id_out == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    uint64_t next_id = 1;
+    int fd = open_next_id(paths, &next_id);
+    if (fd < 0) {
+        return -1;
+    }
+    close(fd);
+    *next_id_out = next_id;
     return 0;
 }
 
+int storage_reserve_task_ids(const storage_paths_t *paths, uint64_t next_id) {
+    if (paths == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    uint64_t current = 1;
+    int fd = open_next_id(paths, &current);
+    if (fd < 0) {
+        return -1;
+    }
+    if (current >= next_id) {
+        close(fd);
+        return 0;
+    }
+    return store_next_id(fd, next_id);
+}
+
+void storage_free_task(task_t *task) {
+    if (task != NULL) {
+        free_task(task);
+    }
+}
+
 void storage_free_tasks(task_t *tasks, size_t count) {
     if (tasks == NULL) {
         return;
@@ -0,0 +1,659 @@
+#include "taskopt.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+typedef struct {
+    const char *key;
+    int (*parse)(task_t *task, const char *value);
+    int (*format)(const task_t *task, char *buffer, size_t buflen);
+} taskopt_descriptor_t;
+
+static int parse_unsigned(const char *value, uint64_t *out) {
+    if (value == NULL || *value == '\0' || *value == '-') {
+        errno = EINVAL;
+        return -1;
+    }
+    char *endptr = NULL;
+    errno = 0;
+    unsigned long long parsed = strtoull(value, &endptr, 10);
+    if (errno != 0 || endptr == value || *endptr != '\0') {
+        if (errno == 0) {
+            errno = EINVAL;
+        }
+        return -1;
+    }
+    *out = (uint64_t)parsed;
+    return 0;
+}
+
+/* Accepte un suffixe binaire optionnel : K, M, G ou T. */
+static int parse_size(const char *value, uint64_t *out) {
+    if (value == NULL || *value == '\0' || *value == '-') {
+        errno = EINVAL;
+        return -1;
+    }
+    char *endptr = NULL;
+    errno = 0;
+    unsigned long long parsed = strtoull(value, &endptr, 10);
+    if (errno != 0 || endptr == value) {
+        if (errno == 0) {
+            errno = EINVAL;
+        }
+        return -1;
+    }
+    unsigned shift = 0;
+    switch (*endptr) {
+        case '\0': break;
+        case 'K': case 'k': shift = 10; ++endptr; break;
+        case 'M': case 'm': shift = 20; ++endptr; break;
+        case 'G': case 'g': shift = 30; ++endptr; break;
+        case 'T': case 't': shift = 40; ++endptr; break;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+    if (*endptr != '\0' || (shift > 0 && parsed > (UINT64_MAX >> shift))) {
+        errno = EINVAL;
+        return -1;
+    }
+    *out = (uint64_t)parsed << shift;
+    return 0;
+}
+
+static int format_unsigned(uint64_t value, char *buffer, size_t buflen) {
+    if (value == 0) {
+        return 0;
+    }
+    int n = snprintf(buffer, buflen, "%llu", (unsigned long long)value);
+    if (n < 0 || (size_t)n >= buflen) {
+        errno = ENOSPC;
+        return -1;
+    }
+    return n;
+}
+
+static int parse_limit_as(task_t *task, const char *value) {
+    return parse_size(value, &task->limits.as_bytes);
+}
+
+static int format_limit_as(const task_t *task, char *buffer, size_t buflen) {
+    return format_unsigned(task->limits.as_bytes, buffer, buflen);
+}
+
+static int parse_limit_cpu(task_t *task, const char *value) {
+    return parse_unsigned(value, &task->limits.cpu_seconds);
+}
+
+static int format_limit_cpu(const task_t *task, char *buffer, size_t buflen) {
+    return format_unsigned(task->limits.cpu_seconds, buffer, buflen);
+}
+
+static int parse_limit_nofile(task_t *task, const char *value) {
+    return parse_unsigned(value, &task->limits.nofile);
+}
+
+static int format_limit_nofile(const task_t *task, char *buffer, size_t buflen) {
+    return format_unsigned(task->limits.nofile, buffer, buflen);
+}
+
+static int parse_limit_nproc(task_t *task, const char *value) {
+    return parse_unsigned(value, &task->limits.nproc);
+}
+
+static int format_limit_nproc(const task_t *task, char *buffer, size_t buflen) {
+    return format_unsigned(task->limits.nproc, buffer, buflen);
+}
+
+static int parse_nice(task_t *task, const char *value) {
+    char *endptr = NULL;
+    errno = 0;
+    long parsed = strtol(value, &endptr, 10);
+    if (errno != 0 || endptr == value || *endptr != '\0' || parsed < -20 || parsed > 19) {
+        errno = EINVAL;
+        return -1;
+    }
+    task->limits.nice = (int32_t)parsed;
+    return 0;
+}
+
+static int format_nice(const task_t *task, char *buffer, size_t buflen) {
+    if (task->limits.nice == 0) {
+        return 0;
+    }
+    int n = snprintf(buffer, buflen, "%d", (int)task->limits.nice);
+    if (n < 0 || (size_t)n >= buflen) {
+        errno = ENOSPC;
+        return -1;
+    }
+    return n;
+}
+
+static const char *const ioprio_class_names[] = {"none", "rt", "be", "idle"};
+
+/* Format : CLASSE[:NIVEAU], CLASSE parmi rt, be, idle ; NIVEAU de 0 à 7. */
+static int parse_ioprio(task_t *task, const char *value) {
+    const char *colon = strchr(value, ':');
+    size_t class_len = (colon != NULL) ? (size_t)(colon - value) : strlen(value);
+
+    task_ioprio_class_t ioprio_class = TASK_IOPRIO_NONE;
+    bool found = false;
+    for (size_t i = 0; i < sizeof(ioprio_class_names) / sizeof(ioprio_class_names[0]); ++i) {
+        if (strlen(ioprio_class_names[i]) == class_len && strncmp(value, ioprio_class_names[i], class_len) == 0) {
+            ioprio_class = (task_ioprio_class_t)i;
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    uint64_t level = 4;
+    if (colon != NULL) {
+        if (parse_unsigned(colon + 1, &level) != 0 || level > 7) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    if (ioprio_class == TASK_IOPRIO_IDLE || ioprio_class == TASK_IOPRIO_NONE) {
+        level = 0;
+    }
+    task->limits.ioprio_class = ioprio_class;
+    task->limits.ioprio_level = (uint8_t)level;
+    return 0;
+}
+
+static int format_ioprio(const task_t *task, char *buffer, size_t buflen) {
+    int n;
+    switch (task->limits.ioprio_class) {
+        case TASK_IOPRIO_NONE:
+            return 0;
+        case TASK_IOPRIO_IDLE:
+            n = snprintf(buffer, buflen, "idle");
+            break;
+        default:
+            n = snprintf(buffer,
+                         buflen,
+                         "%s:%u",
+                         ioprio_class_names[task->limits.ioprio_class],
+                         (unsigned)task->limits.ioprio_level);
+            break;
+    }
+    if (n < 0 || (size_t)n >= buflen) {
+        errno = ENOSPC;
+        return -1;
+    }
+    return n;
+}
+
+static int parse_seconds(const char *value, uint32_t *out) {
+    uint64_t parsed = 0;
+    if (parse_unsigned(value, &parsed) != 0 || parsed > UINT32_MAX / 1000) {
+        errno = EINVAL;
+        return -1;
+    }
+    *out = (uint32_t)parsed;
+    return 0;
+}
+
+static int parse_timeout(task_t *task, const char *value) {
+    return parse_seconds(value, &task->policy.timeout_seconds);
+}
+
+static int format_timeout(const task_t *task, char *buffer, size_t buflen) {
+    return format_unsigned(task->policy.timeout_seconds, buffer, buflen);
+}
+
+static int parse_timeout_grace(task_t *task, const char *value) {
+    return parse_seconds(value, &task->policy.grace_seconds);
+}
+
+static int format_timeout_grace(const task_t *task, char *buffer, size_t buflen) {
+    return format_unsigned(task->policy.grace_seconds, buffer, buflen);
+}
+
+/* Format : queue, skip, kill ou concurrent:N (N >= 1). */
+static int parse_overlap(task_t *task, const char *value) {
+    if (strcmp(value, "queue") == 0) {
+        task->policy.overlap = TASK_OVERLAP_QUEUE;
+    } else if (strcmp(value, "skip") == 0) {
+        task->policy.overlap = TASK_OVERLAP_SKIP;
+    } else if (strcmp(value, "kill") == 0) {
+        task->policy.overlap = TASK_OVERLAP_KILL;
+    } else if (strncmp(value, "concurrent:", 11) == 0) {
+        uint64_t max = 0;
+        if (parse_unsigned(value + 11, &max) != 0 || max == 0 || max > UINT32_MAX) {
+            errno = EINVAL;
+            return -1;
+        }
+        task->policy.overlap = TASK_OVERLAP_CONCURRENT;
+        task->policy.max_concurrent = (uint32_t)max;
+        return 0;
+    } else {
+        errno = EINVAL;
+        return -1;
+    }
+    task->policy.max_concurrent = 0;
+    return 0;
+}
+
+static int format_overlap(const task_t *task, char *buffer, size_t buflen) {
+    int n;
+    switch (task->policy.overlap) {
+        case TASK_OVERLAP_QUEUE:
+            return 0;
+        case TASK_OVERLAP_SKIP:
+            n = snprintf(buffer, buflen, "skip");
+            break;
+        case TASK_OVERLAP_KILL:
+            n = snprintf(buffer, buflen, "kill");
+            break;
+        case TASK_OVERLAP_CONCURRENT:
+            n = snprintf(buffer, buflen, "concurrent:%u", (unsigned)task->policy.max_concurrent);
+            break;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+    if (n < 0 || (size_t)n >= buflen) {
+        errno = ENOSPC;
+        return -1;
+    }
+    return n;
+}
+
+static int parse_retry_max(task_t *task, const char *value) {
+    uint64_t parsed = 0;
+    if (parse_unsigned(value, &parsed) != 0 || parsed > 1000) {
+        errno = EINVAL;
+        return -1;
+    }
+    task->policy.retry_max = (uint32_t)parsed;
+    return 0;
+}
+
+static int format_retry_max(const task_t *task, char *buffer, size_t buflen) {
+    return format_unsigned(task->policy.retry_max, buffer, buflen);
+}
+
+static int parse_retry_delay(task_t *task, const char *value) {
+    return parse_seconds(value, &task->policy.retry_delay_seconds);
+}
+
+static int format_retry_delay(const task_t *task, char *buffer, size_t buflen) {
+    return format_unsigned(task->policy.retry_delay_seconds, buffer, buflen);
+}
+
+static int parse_retry_cap(task_t *task, const char *value) {
+    return parse_seconds(value, &task->policy.retry_cap_seconds);
+}
+
+static int format_retry_cap(const task_t *task, char *buffer, size_t buflen) {
+    return format_unsigned(task->policy.retry_cap_seconds, buffer, buflen);
+}
+
+static int parse_retry_jitter(task_t *task, const char *value) {
+    uint64_t parsed = 0;
+    if (parse_unsigned(value, &parsed) != 0 || parsed > 100) {
+        errno = EINVAL;
+        return -1;
+    }
+    task->policy.retry_jitter_percent = (uint32_t)parsed;
+    return 0;
+}
+
+static int format_retry_jitter(const task_t *task, char *buffer, size_t buflen) {
+    return format_unsigned(task->policy.retry_jitter_percent, buffer, buflen);
+}
+
+static int parse_defer_pressure(task_t *task, const char *value) {
+    uint64_t parsed = 0;
+    if (parse_unsigned(value, &parsed) != 0 || parsed > 100) {
+        errno = EINVAL;
+        return -1;
+    }
+    task->policy.defer_pressure_percent = (uint32_t)parsed;
+    return 0;
+}
+
+static int format_defer_pressure(const task_t *task, char *buffer, size_t buflen) {
+    return format_unsigned(task->policy.defer_pressure_percent, buffer, buflen);
+}
+
+static int parse_defer_max(task_t *task, const char *value) {
+    return parse_seconds(value, &task->policy.defer_max_seconds);
+}
+
+static int format_defer_max(const task_t *task, char *buffer, size_t buflen) {
+    return format_unsigned(task->policy.defer_max_seconds, buffer, buflen);
+}
+
+int taskopt_parse_age(const char *value, uint32_t *seconds_out) {
+    if (value == NULL || seconds_out == NULL || *value == '\0' || *value == '-') {
+        errno = EINVAL;
+        return -1;
+    }
+    char *endptr = NULL;
+    errno = 0;
+    unsigned long long parsed = strtoull(value, &endptr, 10);
+    if (errno != 0 || endptr == value) {
+        errno = EINVAL;
+        return -1;
+    }
+    unsigned long long unit = 1;
+    switch (*endptr) {
+        case '\0': break;
+        case 's': ++endptr; break;
+        case 'm': unit = 60; ++endptr; break;
+        case 'h': unit = 3600; ++endptr; break;
+        case 'd': unit = 86400; ++endptr; break;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+    if (*endptr != '\0' || parsed > UINT32_MAX / unit) {
+        errno = EINVAL;
+        return -1;
+    }
+    *seconds_out = (uint32_t)(parsed * unit);
+    return 0;
+}
+
+static int parse_history_max_age(task_t *task, const char *value) {
+    return taskopt_parse_age(value, &task->policy.history_max_age_seconds);
+}
+
+static int format_history_max_age(const task_t *task, char *buffer, size_t buflen) {
+    return format_unsigned(task->policy.history_max_age_seconds, buffer, buflen);
+}
+
+static int parse_history_max_entries(task_t *task, const char *value) {
+    uint64_t parsed = 0;
+    if (parse_unsigned(value, &parsed) != 0 || parsed > UINT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    task->policy.history_max_entries = (uint32_t)parsed;
+    return 0;
+}
+
+static int format_history_max_entries(const task_t *task, char *buffer, size_t buflen) {
+    return format_unsigned(task->policy.history_max_entries, buffer, buflen);
+}
+
+/* Format : blob (défaut) ou lines. */
+static int parse_capture(task_t *task, const char *value) {
+    if (strcmp(value, "blob") == 0) {
+        task->policy.capture = TASK_CAPTURE_BLOB;
+    } else if (strcmp(value, "lines") == 0) {
+        task->policy.capture = TASK_CAPTURE_LINES;
+    } else {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+static int format_capture(const task_t *task, char *buffer, size_t buflen) {
+    if (task->policy.capture != TASK_CAPTURE_LINES) {
+        return 0;
+    }
+    int n = snprintf(buffer, buflen, "lines");
+    if (n < 0 || (size_t)n >= buflen) {
+        errno = ENOSPC;
+        return -1;
+    }
+    return n;
+}
+
+/* Chemin absolu, sans retour à la ligne (une option par ligne dans le fichier .task). */
+static int parse_watch_path(task_t *task, const char *value) {
+    if (value[0] != '/' || strchr(value, '\n') != NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    char *copy = strdup(value);
+    if (copy == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    free(task->watch_path);
+    task->watch_path = copy;
+    return 0;
+}
+
+static int format_watch_path(const task_t *task, char *buffer, size_t buflen) {
+    if (task->watch_path == NULL) {
+        return 0;
+    }
+    int n = snprintf(buffer, buflen, "%s", task->watch_path);
+    if (n < 0 || (size_t)n >= buflen) {
+        errno = ENOSPC;
+        return -1;
+    }
+    return n;
+}
+
+static const struct {
+    const char *name;
+    uint32_t flag;
+} watch_event_names[] = {
+    {"create", TASK_WATCH_CREATE},
+    {"close_write", TASK_WATCH_CLOSE_WRITE},
+    {"moved_to", TASK_WATCH_MOVED_TO},
+};
+
+/* Format : liste séparée par des virgules parmi create, close_write, moved_to. */
+static int parse_watch_events(task_t *task, const char *value) {
+    uint32_t events = 0;
+    const char *cursor = value;
+    while (*cursor != '\0') {
+        size_t len = strcspn(cursor, ",");
+        bool found = false;
+        for (size_t i = 0; i < sizeof(watch_event_names) / sizeof(watch_event_names[0]); ++i) {
+            if (strlen(watch_event_names[i].name) == len && strncmp(cursor, watch_event_names[i].name, len) == 0) {
+                events |= watch_event_names[i].flag;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            errno = EINVAL;
+            return -1;
+        }
+        cursor += len;
+        if (*cursor == ',') {
+            ++cursor;
+        }
+    }
+    if (events == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    task->policy.watch_events = (events == TASK_WATCH_ALL) ? 0 : events;
+    return 0;
+}
+
+static int format_watch_events(const task_t *task, char *buffer, size_t buflen) {
+    size_t offset = 0;
+    for (size_t i = 0; i < sizeof(watch_event_names) / sizeof(watch_event_names[0]); ++i) {
+        if ((task->policy.watch_events & watch_event_names[i].flag) == 0) {
+            continue;
+        }
+        int n = snprintf(buffer + offset, buflen - offset, "%s%s", offset > 0 ? "," : "", watch_event_names[i].name);
+        if (n < 0 || (size_t)n >= buflen - offset) {
+            errno = ENOSPC;
+            return -1;
+        }
+        offset += (size_t)n;
+    }
+    return (int)offset;
+}
+
+/* En millisecondes, au plus une heure. */
+static int parse_watch_debounce(task_t *task, const char *value) {
+    uint64_t parsed = 0;
+    if (parse_unsigned(value, &parsed) != 0 || parsed > 3600000) {
+        errno = EINVAL;
+        return -1;
+    }
+    task->policy.watch_debounce_ms = (uint32_t)parsed;
+    return 0;
+}
+
+static int format_watch_debounce(const task_t *task, char *buffer, size_t buflen) {
+    return format_unsigned(task->policy.watch_debounce_ms, buffer, buflen);
+}
+
+static int parse_after(task_t *task, const char *value) {
+    uint64_t parsed = 0;
+    if (parse_unsigned(value, &parsed) != 0 || parsed == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    task->policy.after_task_id = parsed;
+    return 0;
+}
+
+static int format_after(const task_t *task, char *buffer, size_t buflen) {
+    return format_unsigned(task->policy.after_task_id, buffer, buflen);
+}
+
+/* Format : success (défaut), failure ou any. */
+static int parse_after_on(task_t *task, const char *value) {
+    if (strcmp(value, "success") == 0) {
+        task->policy.after_on = TASK_AFTER_SUCCESS;
+    } else if (strcmp(value, "failure") == 0) {
+        task->policy.after_on = TASK_AFTER_FAILURE;
+    } else if (strcmp(value, "any") == 0) {
+        task->policy.after_on = TASK_AFTER_ANY;
+    } else {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+static int format_after_on(const task_t *task, char *buffer, size_t buflen) {
+    const char *name = NULL;
+    switch (task->policy.after_on) {
+        case TASK_AFTER_SUCCESS: return 0;
+        case TASK_AFTER_FAILURE: name = "failure"; break;
+        case TASK_AFTER_ANY: name = "any"; break;
+    }
+    if (name == NULL) {
+        return 0;
+    }
+    int n = snprintf(buffer, buflen, "%s", name);
+    if (n < 0 || (size_t)n >= buflen) {
+        errno = ENOSPC;
+        return -1;
+    }
+    return n;
+}
+
+static const taskopt_descriptor_t descriptors[] = {
+    {"limit.as", parse_limit_as, format_limit_as},
+    {"limit.cpu", parse_limit_cpu, format_limit_cpu},
+    {"limit.nofile", parse_limit_nofile, format_limit_nofile},
+    {"limit.nproc", parse_limit_nproc, format_limit_nproc},
+    {"nice", parse_nice, format_nice},
+    {"ioprio", parse_ioprio, format_ioprio},
+    {"timeout", parse_timeout, format_timeout},
+    {"timeout.grace", parse_timeout_grace, format_timeout_grace},
+    {"overlap", parse_overlap, format_overlap},
+    {"retry.max", parse_retry_max, format_retry_max},
+    {"retry.delay", parse_retry_delay, format_retry_delay},
+    {"retry.cap", parse_retry_cap, format_retry_cap},
+    {"retry.jitter", parse_retry_jitter, format_retry_jitter},
+    {"defer.pressure", parse_defer_pressure, format_defer_pressure},
+    {"defer.max", parse_defer_max, format_defer_max},
+    {"capture", parse_capture, format_capture},
+    {"history.max_age", parse_history_max_age, format_history_max_age},
+    {"history.max_entries", parse_history_max_entries, format_history_max_entries},
+    {"watch.path", parse_watch_path, format_watch_path},
+    {"watch.events", parse_watch_events, format_watch_events},
+    {"watch.debounce", parse_watch_debounce, format_watch_debounce},
+    {"after", parse_after, format_after},
+    {"after.on", parse_after_on, format_after_on},
+};
+
+int taskopt_set(task_t *task, const char *key, const char *value) {
+    if (task == NULL || key == NULL || value == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (size_t i = 0; i < sizeof(descriptors) / sizeof(descriptors[0]); ++i) {
+        if (strcmp(descriptors[i].key, key) == 0) {
+            return descriptors[i].parse(task, value);
+        }
+    }
+    errno = ENOENT;
+    return -1;
+}
+
+int taskopt_set_line(task_t *task, const char *line) {
+    if (task == NULL || line == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    const char *eq = strchr(line, '=');
+    if (eq == NULL || eq == line) {
+        errno = EINVAL;
+        return -1;
+    }
+    char key[64];
+    size_t key_len = (size_t)(eq - line);
+    if (key_len >= sizeof(key)) {
+        errno = ENOENT;
+        return -1;
+    }
+    memcpy(key, line, key_len);
+    key[key_len] = '\0';
+    return taskopt_set(task, key, eq + 1);
+}
+
+int taskopt_format(const task_t *task, char *buffer, size_t buflen, size_t *length_out) {
+    if (task == NULL || buffer == NULL || buflen == 0 || length_out == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t offset = 0;
+    buffer[0] = '\0';
+    for (size_t i = 0; i < sizeof(descriptors) / sizeof(descriptors[0]); ++i) {
+        char value[PATH_MAX]; /* watch.path est la valeur la plus longue */
+        int n = descriptors[i].format(task, value, sizeof(value));
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            continue;
+        }
+        int written = snprintf(buffer + offset, buflen - offset, "%s=%s\n", descriptors[i].key, value);
+        if (written < 0 || (size_t)written >= buflen - offset) {
+            errno = ENOSPC;
+            return -1;
+        }
+        offset += (size_t)written;
+    }
+    *length_out = offset;
+    return 0;
+}
+
+const char *taskopt_limit_name(uint32_t limit_flag) {
+    switch (limit_flag) {
+        case TASK_LIMIT_HIT_CPU: return "cpu";
+        case TASK_LIMIT_HIT_AS: return "as";
+        default: return "unknown";
+    }
+}
@@ -273,3 +273,57 @@ int utils_now_epoch(int64_t *out_epoch) {
     *out_epoch = (int64_t)ts.tv_sec;
     return 0;
 }
+
+int utils_now_epoch_ms(int64_t *out_ms) {
+    if (out_ms == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct timespec ts;
+    if (clock_gettime(CLOCK_REALTIME, &ts) != 0) {
+        return -1;
+    }
+    *out_ms = (int64_t)ts.tv_sec * 1000LL + (int64_t)ts.tv_nsec / 1000000LL;
+    return 0;
+}
+
+int utils_now_monotonic_ns(int64_t *out_ns) {
+    if (out_ns == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return -1;
+    }
+    *out_ns = (int64_t)ts.tv_sec * 1000000000LL + (int64_t)ts.tv_nsec;
+    return 0;
+}
+
+/* CRC-32 (polynôme réfléchi 0xEDB88320), table de 16 entrées : deux pas par octet. */
+uint32_t utils_crc32(uint32_t crc, const void *data, size_t length) {
+    static const uint32_t table[16] = {
+        0x00000000u, 0x1DB71064u, 0x3B6E20C8u, 0x26D930ACu, 0x76DC4190u, 0x6B6B51F4u, 0x4DB26158u, 0x5005713Cu,
+        0xEDB88320u, 0xF00F9344u, 0xD6D6A3E8u, 0xCB61B38Cu, 0x9B64C2B0u, 0x86D3D2D4u, 0xA00AE278u, 0xBDBDF21Cu,
+    };
+    const unsigned char *bytes = (const unsigned char *)data;
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i) {
+        crc ^= bytes[i];
+        crc = (crc >> 4) ^ table[crc & 0x0Fu];
+        crc = (crc >> 4) ^ table[crc & 0x0Fu];
+    }
+    return ~crc;
+}
+
+uint64_t utils_hash64(const void *data, size_t length) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
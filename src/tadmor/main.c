@@ -31,17 +31,33 @@ static void usage(const char *progname) {
     static const char help_tail[] =
         "  -l                 Lister les tâches\n"
         "  -q                 Demander l'arrêt du démon\n"
+        "  -S                 Afficher les statistiques du démon\n"
         "  -c                 Créer une tâche simple\n"
         "  -s                 Créer une tâche séquentielle\n"
         "  -n                 Créer une tâche abstraite\n"
         "  -r TASKID          Supprimer une tâche\n"
-        "  -x TASKID          Afficher l'historique d'une tâche\n"
-        "  -o TASKID          Afficher le dernier stdout\n"
-        "  -e TASKID          Afficher le dernier stderr\n"
+        "  -x TASKID          Afficher l'historique d'une tâche, de la plus récente à la plus ancienne\n"
+        "  -N LIMIT           Nombre maximal d'exécutions renvoyées par -x, d'octets par -o/-e\n"
+        "  -B EPOCH           Exécutions antérieures à EPOCH (-x)\n"
+        "  -F EPOCH           Exécutions postérieures à EPOCH (-x)\n"
+        "  -R                 Agrégats horaires/quotidiens des exécutions compactées (-x)\n"
+        "  -o TASKID          Afficher le dernier stdout (une page, suite avec -C)\n"
+        "  -e TASKID          Afficher le dernier stderr (une page, suite avec -C)\n"
+        "  -I INDEX           Sortie précédente de rang INDEX (1 à 5) avec -o/-e\n"
+        "  -L TASKID          Afficher le journal horodaté d'une exécution (capture=lines)\n"
+        "  -E EPOCH           Exécution à consulter avec -L, -o ou -e (défaut : la plus récente)\n"
+        "  -A ATTEMPT         Tentative de l'exécution (défaut 1)\n"
+        "  -W FROM:TO         Fenêtre en millisecondes depuis le lancement (bornes facultatives)\n"
+        "  -C CURSOR          Reprendre à la valeur \"next\" d'une réponse précédente (-L, -x, -o, -e)\n"
         "  -p DIR             Répertoire des pipes\n"
         "  -m MASK            Masque des minutes (hexadécimal, 15 caractères)\n"
         "  -H MASK            Masque des heures (hexadécimal, 6 caractères)\n"
         "  -w MASK            Masque des jours (hexadécimal, 2 caractères)\n"
+        "  -O CLÉ=VALEUR      Option de tâche (limit.as, limit.cpu, limit.nofile, limit.nproc, nice, ioprio,\n"
+        "                     timeout, timeout.grace, overlap, retry.max, retry.delay,\n"
+        "                     retry.cap, retry.jitter, defer.pressure, defer.max, capture,\n"
+        "                     history.max_age, history.max_entries,\n"
+        "                     watch.path, watch.events, watch.debounce, after, after.on)\n"
         "  [commande ...]     Commande(s) et arguments, séparées par '--' pour les séquences\n";
     log_fd(STDERR_FILENO, "Usage : %s [options]\n", progname);
     utils_write_all(STDERR_FILENO, help_tail, sizeof(help_tail) - 1);
@@ -232,6 +248,34 @@ static int build_commands_array(const tadmor_options_t *opts, char *buffer, size
     return 0;
 }
 
+static int build_options_object(const tadmor_options_t *opts, char *buffer, size_t cap, size_t *offset) {
+    if (buffer_append(buffer, cap, offset, "\"options\":{") != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < opts->task_option_count; ++i) {
+        const char *option = opts->task_options[i];
+        const char *eq = strchr(option, '=');
+        char key[64];
+        size_t key_len = (size_t)(eq - option);
+        if (key_len >= sizeof(key)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        memcpy(key, option, key_len);
+        key[key_len] = '\0';
+
+        if (i > 0 && buffer_append(buffer, cap, offset, ",") != 0) {
+            return -1;
+        }
+        if (json_escape_string(key, buffer, cap, offset) != 0 ||
+            buffer_append(buffer, cap, offset, ":") != 0 ||
+            json_escape_string(eq + 1, buffer, cap, offset) != 0) {
+            return -1;
+        }
+    }
+    return buffer_append(buffer, cap, offset, "}");
+}
+
 static int build_schedule_object(const tadmor_options_t *opts, char *buffer, size_t cap, size_t *offset) {
     if (!opts->has_schedule) {
         return buffer_append(buffer, cap, offset, "\"schedule\":null");
@@ -273,6 +317,11 @@ static int build_request_payload(const tadmor_options_t *opts,
         if (buffer_append(payload, payload_cap, &offset, "{}") != 0) {
             return -1;
         }
+    } else if (opts->opt_stats) {
+        *out_type = MSG_REQ_STATS;
+        if (buffer_append(payload, payload_cap, &offset, "{}") != 0) {
+            return -1;
+        }
     } else if (opts->opt_remove) {
         *out_type = MSG_REQ_REMOVE;
         if (buffer_append(payload,
@@ -284,35 +333,106 @@ static int build_request_payload(const tadmor_options_t *opts,
         }
     } else if (opts->opt_history) {
         *out_type = MSG_REQ_LIST_HISTORY;
-        if (buffer_append(payload,
+        if (buffer_append(payload, payload_cap, &offset, "{\"task_id\":%llu", (unsigned long long)opts->task_id) != 0) {
+            return -1;
+        }
+        if (opts->history_limit != 0 &&
+            buffer_append(payload, payload_cap, &offset, ",\"limit\":%llu", (unsigned long long)opts->history_limit) != 0) {
+            return -1;
+        }
+        if (opts->has_history_before &&
+            buffer_append(payload,
                           payload_cap,
                           &offset,
-                          "{\"task_id\":%llu}",
-                          (unsigned long long)opts->task_id) != 0) {
+                          ",\"before_epoch\":%llu",
+                          (unsigned long long)opts->history_before) != 0) {
             return -1;
         }
-    } else if (opts->opt_stdout) {
-        *out_type = MSG_REQ_GET_STDOUT;
-        if (buffer_append(payload,
+        if (opts->has_history_after &&
+            buffer_append(payload,
                           payload_cap,
                           &offset,
-                          "{\"task_id\":%llu}",
-                          (unsigned long long)opts->task_id) != 0) {
+                          ",\"after_epoch\":%llu",
+                          (unsigned long long)opts->history_after) != 0) {
             return -1;
         }
-    } else if (opts->opt_stderr) {
-        *out_type = MSG_REQ_GET_STDERR;
-        if (buffer_append(payload,
+        if (opts->records_cursor != 0 &&
+            buffer_append(payload, payload_cap, &offset, ",\"cursor\":%llu", (unsigned long long)opts->records_cursor) !=
+                0) {
+            return -1;
+        }
+        if (opts->history_rollups && buffer_append(payload, payload_cap, &offset, ",\"rollups\":1") != 0) {
+            return -1;
+        }
+        if (buffer_append(payload, payload_cap, &offset, "}") != 0) {
+            return -1;
+        }
+    } else if (opts->opt_stdout || opts->opt_stderr) {
+        *out_type = opts->opt_stdout ? MSG_REQ_GET_STDOUT : MSG_REQ_GET_STDERR;
+        if (buffer_append(payload, payload_cap, &offset, "{\"task_id\":%llu", (unsigned long long)opts->task_id) != 0) {
+            return -1;
+        }
+        if (opts->has_records_epoch &&
+            buffer_append(payload, payload_cap, &offset, ",\"epoch\":%llu", (unsigned long long)opts->records_epoch) != 0) {
+            return -1;
+        }
+        if (opts->has_stdio_index &&
+            buffer_append(payload, payload_cap, &offset, ",\"index\":%llu", (unsigned long long)opts->stdio_index) != 0) {
+            return -1;
+        }
+        if (opts->records_cursor != 0 &&
+            buffer_append(payload, payload_cap, &offset, ",\"offset\":%llu", (unsigned long long)opts->records_cursor) !=
+                0) {
+            return -1;
+        }
+        if (opts->history_limit != 0 &&
+            buffer_append(payload, payload_cap, &offset, ",\"length\":%llu", (unsigned long long)opts->history_limit) != 0) {
+            return -1;
+        }
+        if (buffer_append(payload, payload_cap, &offset, "}") != 0) {
+            return -1;
+        }
+    } else if (opts->opt_records) {
+        *out_type = MSG_REQ_GET_RECORDS;
+        if (buffer_append(payload, payload_cap, &offset, "{\"task_id\":%llu", (unsigned long long)opts->task_id) != 0) {
+            return -1;
+        }
+        if (opts->has_records_epoch &&
+            buffer_append(payload,
                           payload_cap,
                           &offset,
-                          "{\"task_id\":%llu}",
-                          (unsigned long long)opts->task_id) != 0) {
+                          ",\"epoch\":%llu,\"attempt\":%llu",
+                          (unsigned long long)opts->records_epoch,
+                          (unsigned long long)(opts->has_records_attempt ? opts->records_attempt : 1)) != 0) {
+            return -1;
+        }
+        if (opts->has_records_from &&
+            buffer_append(payload, payload_cap, &offset, ",\"from_ms\":%llu", (unsigned long long)opts->records_from_ms) !=
+                0) {
+            return -1;
+        }
+        if (opts->has_records_to &&
+            buffer_append(payload, payload_cap, &offset, ",\"to_ms\":%llu", (unsigned long long)opts->records_to_ms) != 0) {
+            return -1;
+        }
+        if (opts->records_cursor != 0 &&
+            buffer_append(payload, payload_cap, &offset, ",\"cursor\":%llu", (unsigned long long)opts->records_cursor) !=
+                0) {
+            return -1;
+        }
+        if (buffer_append(payload, payload_cap, &offset, "}") != 0) {
             return -1;
         }
     } else if (opts->opt_create_simple || opts->opt_create_sequence || opts->opt_create_abstract) {
         if (buffer_append(payload, payload_cap, &offset, "{") != 0) {
             return -1;
         }
+        if (opts->task_option_count > 0) {
+            if (build_options_object(opts, payload, payload_cap, &offset) != 0 ||
+                buffer_append(payload, payload_cap, &offset, ",") != 0) {
+                return -1;
+            }
+        }
         if (build_commands_array(opts, payload, payload_cap, &offset) != 0) {
             return -1;
         }
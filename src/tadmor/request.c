@@ -142,36 +142,36 @@ static int decode_base64_field(const char *json, const char *field, int fd) {
         log_fd(STDERR_FILENO, "Champ %s absent\n", field);
         return -1;
     }
+    /* field se termine par le guillemet ouvrant : la valeur commence juste après. */
     ptr += strlen(field);
-    while (*ptr && *ptr != '"') {
-        ++ptr;
-    }
-    if (*ptr != '"') {
-        log_fd(STDERR_FILENO, "Champ %s mal formé\n", field);
-        return -1;
-    }
-    ++ptr;
     const char *end = strchr(ptr, '"');
     if (end == NULL) {
         log_fd(STDERR_FILENO, "Champ %s mal formé\n", field);
         return -1;
     }
 
+    /* D'autres champs suivent la valeur : elle est copiée pour être terminée par un NUL. */
     size_t encoded_len = (size_t)(end - ptr);
+    char *encoded = malloc(encoded_len + 1);
     size_t decoded_len = encoded_len;
-    char *decoded = malloc(decoded_len);
-    if (decoded == NULL) {
+    char *decoded = malloc(decoded_len + 1);
+    if (encoded == NULL || decoded == NULL) {
         perror("malloc");
+        free(encoded);
+        free(decoded);
         return -1;
     }
-    if (utils_base64_decode(ptr, decoded, &decoded_len) != 0) {
+    memcpy(encoded, ptr, encoded_len);
+    encoded[encoded_len] = '\0';
+    int rc = utils_base64_decode(encoded, decoded, &decoded_len);
+    if (rc != 0) {
         perror("base64");
-        free(decoded);
-        return -1;
+    } else {
+        utils_write_all(fd, decoded, decoded_len);
     }
-    utils_write_all(fd, decoded, decoded_len);
+    free(encoded);
     free(decoded);
-    return 0;
+    return rc;
 }
 
 int tadmor_handle_reply(const tadmor_options_t *opts, const proto_message_t *rsp) {
@@ -208,26 +208,101 @@ int tadmor_parse_args(int argc, char **argv, tadmor_options_t *opts) {
     opterr = 0;
 
     int opt;
-    while ((opt = getopt(argc, argv, "lqcsnr:x:o:e:p:m:H:w:")) != -1) {
+    while ((opt = getopt(argc, argv, "lqScsnRr:x:o:e:L:E:A:W:C:N:B:F:I:p:m:H:w:O:")) != -1) {
         switch (opt) {
             case 'l': opts->opt_list = true; break;
             case 'q': opts->opt_shutdown = true; break;
+            case 'S': opts->opt_stats = true; break;
             case 'c': opts->opt_create_simple = true; break;
             case 's': opts->opt_create_sequence = true; break;
             case 'n': opts->opt_create_abstract = true; break;
+            case 'R': opts->history_rollups = true; break;
             case 'r':
             case 'x':
             case 'o':
             case 'e':
+            case 'L':
                 opts->opt_remove |= (opt == 'r');
                 opts->opt_history |= (opt == 'x');
                 opts->opt_stdout |= (opt == 'o');
                 opts->opt_stderr |= (opt == 'e');
+                opts->opt_records |= (opt == 'L');
                 if (utils_parse_uint64(optarg, &opts->task_id) != 0) {
                     return -1;
                 }
                 break;
+            case 'E':
+                if (utils_parse_uint64(optarg, &opts->records_epoch) != 0) {
+                    return -1;
+                }
+                opts->has_records_epoch = true;
+                break;
+            case 'A':
+                if (utils_parse_uint64(optarg, &opts->records_attempt) != 0 || opts->records_attempt == 0) {
+                    errno = EINVAL;
+                    return -1;
+                }
+                opts->has_records_attempt = true;
+                break;
+            case 'W': {
+                /* FROM:TO en millisecondes, l'une des bornes peut être omise. */
+                char *colon = strchr(optarg, ':');
+                if (colon == NULL) {
+                    errno = EINVAL;
+                    return -1;
+                }
+                *colon = '\0';
+                if (optarg[0] != '\0') {
+                    if (utils_parse_uint64(optarg, &opts->records_from_ms) != 0) {
+                        return -1;
+                    }
+                    opts->has_records_from = true;
+                }
+                if (colon[1] != '\0') {
+                    if (utils_parse_uint64(colon + 1, &opts->records_to_ms) != 0) {
+                        return -1;
+                    }
+                    opts->has_records_to = true;
+                }
+                break;
+            }
+            case 'C':
+                if (utils_parse_uint64(optarg, &opts->records_cursor) != 0) {
+                    return -1;
+                }
+                break;
+            case 'N':
+                if (utils_parse_uint64(optarg, &opts->history_limit) != 0 || opts->history_limit == 0) {
+                    errno = EINVAL;
+                    return -1;
+                }
+                break;
+            case 'B':
+            case 'F':
+                if (utils_parse_uint64(optarg, opt == 'B' ? &opts->history_before : &opts->history_after) != 0) {
+                    return -1;
+                }
+                opts->has_history_before |= (opt == 'B');
+                opts->has_history_after |= (opt == 'F');
+                break;
+            case 'I':
+                if (utils_parse_uint64(optarg, &opts->stdio_index) != 0) {
+                    return -1;
+                }
+                opts->has_stdio_index = true;
+                break;
             case 'p': opts->pipes_dir_arg = optarg; break;
+            case 'O':
+                if (strchr(optarg, '=') == NULL || optarg[0] == '=') {
+                    errno = EINVAL;
+                    return -1;
+                }
+                if (opts->task_option_count >= ERRAID_MAX_TASK_OPTIONS) {
+                    errno = E2BIG;
+                    return -1;
+                }
+                opts->task_options[opts->task_option_count++] = optarg;
+                break;
             case 'm':
                 if (strlen(optarg) != 15) {
                     errno = EINVAL;
@@ -260,6 +335,7 @@ int tadmor_parse_args(int argc, char **argv, tadmor_options_t *opts) {
     int operations = 0;
     operations += opts->opt_list;
     operations += opts->opt_shutdown;
+    operations += opts->opt_stats;
     operations += opts->opt_create_simple;
     operations += opts->opt_create_sequence;
     operations += opts->opt_create_abstract;
@@ -267,11 +343,33 @@ int tadmor_parse_args(int argc, char **argv, tadmor_options_t *opts) {
     operations += opts->opt_history;
     operations += opts->opt_stdout;
     operations += opts->opt_stderr;
+    operations += opts->opt_records;
 
     if (operations != 1) {
         errno = EINVAL;
         return -1;
     }
+    /* -E, -C et -N s'appliquent aussi à -o/-e : exécution, offset et nombre d'octets. */
+    bool stdio = opts->opt_stdout || opts->opt_stderr;
+    if (!opts->opt_records &&
+        (opts->has_records_attempt || opts->has_records_from || opts->has_records_to ||
+         (opts->has_records_epoch && !stdio) || (opts->records_cursor != 0 && !opts->opt_history && !stdio))) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!opts->opt_history && ((opts->history_limit != 0 && !stdio) || opts->has_history_before ||
+                               opts->has_history_after || opts->history_rollups)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (opts->has_stdio_index && (!stdio || opts->has_records_epoch)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (opts->has_records_attempt && !opts->has_records_epoch) {
+        errno = EINVAL;
+        return -1;
+    }
 
     if (opts->opt_create_simple || opts->opt_create_sequence || opts->opt_create_abstract) {
         size_t cmd_count = 0;
@@ -387,7 +485,7 @@ int tadmor_parse_args(int argc, char **argv, tadmor_options_t *opts) {
         return 0;
     }
 
-    if (optind < argc) {
+    if (optind < argc || opts->task_option_count > 0) {
         errno = EINVAL;
         return -1;
     }
@@ -0,0 +1,493 @@
+/*
+ * Reprises des formats sur disque, hors du démon : chaque cas construit ou
+ * abîme les fichiers comme le ferait un arrêt brutal, puis vérifie ce qu'en
+ * relit le code de stockage.
+ *
+ * Usage : storage_formats [-d DIR]   (défaut : /tmp/erraid-tests), code 0 si tout passe.
+ */
+#include "catalog.h"
+#include "history.h"
+#include "storage.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+static int failures;
+
+#define CHECK(cond)                                                                      \
+    do {                                                                                 \
+        if (!(cond)) {                                                                   \
+            fprintf(stderr, "%s:%d: échec : %s (%s)\n", __FILE__, __LINE__, #cond, strerror(errno)); \
+            failures += 1;                                                               \
+            return;                                                                      \
+        }                                                                                \
+    } while (0)
+
+static const char *base_dir = "/tmp/erraid-tests";
+
+/* Répertoire vide propre au cas name. */
+static int case_dir(const char *name, char *buffer, size_t buflen) {
+    char command[PATH_MAX + 16];
+    if (utils_join_path(base_dir, name, buffer, buflen) != 0) {
+        return -1;
+    }
+    snprintf(command, sizeof(command), "rm -rf '%s'", buffer);
+    if (system(command) != 0 || (mkdir(base_dir, 0700) != 0 && errno != EEXIST) || mkdir(buffer, 0700) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static off_t file_size(const char *dir, const char *name) {
+    char path[PATH_MAX];
+    struct stat st;
+    if (utils_join_path(dir, name, path, sizeof(path)) != 0 || stat(path, &st) != 0) {
+        return -1;
+    }
+    return st.st_size;
+}
+
+
+/* Tâche simple « /bin/echo <id> », allouée comme celles du catalogue. */
+static int make_task(uint64_t task_id, task_t *task) {
+    memset(task, 0, sizeof(*task));
+    task->task_id = task_id;
+    task->type = TASK_TYPE_SIMPLE;
+    task->schedule.minute_mask = 1;
+    task->schedule.hour_mask = 1;
+    task->schedule.weekday_mask = 1;
+    task->schedule.enabled = true;
+    task->last_run_epoch = -1;
+    task->commands = calloc(1, sizeof(command_t));
+    if (task->commands == NULL) {
+        return -1;
+    }
+    task->command_count = 1;
+    task->commands[0].argc = 2;
+    task->commands[0].argv = calloc(3, sizeof(char *));
+    char id[24];
+    snprintf(id, sizeof(id), "%llu", (unsigned long long)task_id);
+    if (task->commands[0].argv == NULL || (task->commands[0].argv[0] = strdup("/bin/echo")) == NULL ||
+        (task->commands[0].argv[1] = strdup(id)) == NULL) {
+        return -1;
+    }
+    return 0;
+}
+
+static int put_task(catalog_t *catalog, uint64_t task_id) {
+    task_t task;
+    int rc = make_task(task_id, &task);
+    if (rc == 0) {
+        rc = catalog_put(catalog, &task);
+    }
+    storage_free_task(&task);
+    return rc;
+}
+
+/* Identifiants chargés depuis le catalogue de dir, dans l'ordre ; -1 en cas d'erreur. */
+static int load_ids(const char *dir, uint64_t *ids, size_t capacity, size_t *count_out) {
+    catalog_t catalog;
+    task_t *tasks = NULL;
+    size_t count = 0;
+    int rc = catalog_open(&catalog, dir);
+    if (rc == 0) {
+        rc = catalog_load(&catalog, &tasks, &count);
+    }
+    catalog_close(&catalog);
+    if (rc != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < count && i < capacity; ++i) {
+        ids[i] = tasks[i].task_id;
+    }
+    storage_free_tasks(tasks, count);
+    *count_out = count;
+    return 0;
+}
+
+static int truncate_file(const char *dir, const char *name, off_t length) {
+    char path[PATH_MAX];
+    return utils_join_path(dir, name, path, sizeof(path)) == 0 ? truncate(path, length) : -1;
+}
+
+static int flip_byte(const char *dir, const char *name, off_t offset) {
+    char path[PATH_MAX];
+    if (utils_join_path(dir, name, path, sizeof(path)) != 0) {
+        return -1;
+    }
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    unsigned char byte = 0;
+    int rc = (fd >= 0 && pread(fd, &byte, 1, offset) == 1) ? 0 : -1;
+    byte ^= 0xFF;
+    if (rc == 0 && pwrite(fd, &byte, 1, offset) != 1) {
+        rc = -1;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return rc;
+}
+
+static void test_catalog_wal(void) {
+    char dir[PATH_MAX];
+    CHECK(case_dir("catalog", dir, sizeof(dir)) == 0);
+    catalog_t catalog;
+    CHECK(catalog_open(&catalog, dir) == 0);
+    CHECK(catalog.fresh);
+    CHECK(put_task(&catalog, 1) == 0 && put_task(&catalog, 2) == 0);
+    off_t two_records = file_size(dir, CATALOG_WAL_NAME);
+    CHECK(put_task(&catalog, 3) == 0);
+    catalog_close(&catalog);
+    off_t three_records = file_size(dir, CATALOG_WAL_NAME);
+
+    /* Fin incomplète : l'enregistrement est ignoré et le journal tronqué à la frontière. */
+    uint64_t ids[8];
+    size_t count = 0;
+    CHECK(truncate_file(dir, CATALOG_WAL_NAME, three_records - 5) == 0);
+    CHECK(load_ids(dir, ids, 8, &count) == 0);
+    CHECK(count == 2 && ids[0] == 1 && ids[1] == 2);
+    CHECK(file_size(dir, CATALOG_WAL_NAME) == two_records);
+
+    /* Le journal reste utilisable après la troncature. */
+    CHECK(catalog_open(&catalog, dir) == 0);
+    CHECK(put_task(&catalog, 3) == 0);
+    catalog_close(&catalog);
+    CHECK(load_ids(dir, ids, 8, &count) == 0);
+    CHECK(count == 3 && ids[2] == 3);
+
+    /* CRC faux sur le dernier enregistrement : même traitement qu'une fin incomplète. */
+    CHECK(flip_byte(dir, CATALOG_WAL_NAME, file_size(dir, CATALOG_WAL_NAME) - 1) == 0);
+    CHECK(load_ids(dir, ids, 8, &count) == 0);
+    CHECK(count == 2 && ids[1] == 2);
+
+    /* Point de contrôle : instantané seul, puis une suppression rejouée par-dessus. */
+    task_t tasks[2];
+    CHECK(make_task(1, &tasks[0]) == 0 && make_task(2, &tasks[1]) == 0);
+    CHECK(catalog_open(&catalog, dir) == 0);
+    int rc = catalog_checkpoint(&catalog, tasks, 2);
+    storage_free_task(&tasks[0]);
+    storage_free_task(&tasks[1]);
+    CHECK(rc == 0);
+    CHECK(file_size(dir, CATALOG_WAL_NAME) == 0);
+    CHECK(catalog_remove(&catalog, 1) == 0);
+    catalog_close(&catalog);
+    CHECK(load_ids(dir, ids, 8, &count) == 0);
+    CHECK(count == 1 && ids[0] == 2);
+}
+
+static task_run_entry_t run_entry(int64_t epoch) {
+    task_run_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.epoch = epoch;
+    entry.attempt = 1;
+    entry.outcome = TASK_RUN_COMPLETED;
+    entry.usage.start_ns = 1000;
+    entry.usage.end_ns = 2000;
+    return entry;
+}
+
+static void test_history_search(void) {
+    char dir[PATH_MAX];
+    CHECK(case_dir("history", dir, sizeof(dir)) == 0);
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    CHECK(dir_fd >= 0);
+    for (int64_t epoch = 10; epoch <= 1000; epoch += 10) {
+        task_run_entry_t entry = run_entry(epoch);
+        CHECK(history_append(dir_fd, HISTORY_FILE_NAME, &entry, false) == 0);
+    }
+    history_view_t view;
+    CHECK(history_open(&view, dir_fd, HISTORY_FILE_NAME) == 0);
+    size_t count = view.count;
+    size_t first = history_lower_bound(&view, 0);
+    size_t between = history_lower_bound(&view, 15);
+    size_t exact = history_lower_bound(&view, 500);
+    size_t last = history_lower_bound(&view, 1000);
+    size_t after = history_lower_bound(&view, 1001);
+    history_close(&view);
+    CHECK(count == 100);
+    CHECK(first == 0 && between == 1 && exact == 49 && last == 99 && after == 100);
+
+    /* Enregistrement incomplet en fin de fichier : ignoré, puis écrasé par l'ajout suivant. */
+    off_t size = file_size(dir, HISTORY_FILE_NAME);
+    CHECK(truncate_file(dir, HISTORY_FILE_NAME, size + 50) == 0);
+    CHECK(history_open(&view, dir_fd, HISTORY_FILE_NAME) == 0);
+    count = view.count;
+    history_close(&view);
+    CHECK(count == 100);
+    task_run_entry_t entry = run_entry(1010);
+    CHECK(history_append(dir_fd, HISTORY_FILE_NAME, &entry, false) == 0);
+    CHECK(file_size(dir, HISTORY_FILE_NAME) == size + (off_t)sizeof(history_record_t));
+    CHECK(history_open(&view, dir_fd, HISTORY_FILE_NAME) == 0);
+    count = view.count;
+    int64_t newest = history_epoch_at(&view, view.count - 1);
+    history_close(&view);
+    close(dir_fd);
+    CHECK(count == 101 && newest == 1010);
+}
+
+static void test_history_upgrade(void) {
+    char dir[PATH_MAX];
+    CHECK(case_dir("upgrade", dir, sizeof(dir)) == 0);
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    CHECK(dir_fd >= 0);
+
+    /* Version 1 : enregistrements de 128 octets, sans empreintes, génération 3. */
+    history_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, HISTORY_MAGIC, 4);
+    header.version = 1;
+    header.record_size = HISTORY_RECORD_V1_SIZE;
+    header.generation = 3;
+    int fd = openat(dir_fd, HISTORY_FILE_NAME, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    CHECK(fd >= 0);
+    bool written = write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header);
+    for (int64_t epoch = 100; epoch <= 200 && written; epoch += 100) {
+        history_record_t record;
+        memset(&record, 0, sizeof(record));
+        record.epoch = epoch;
+        record.status = 7;
+        record.attempt = 1;
+        written = write(fd, &record, HISTORY_RECORD_V1_SIZE) == HISTORY_RECORD_V1_SIZE;
+    }
+    close(fd);
+    CHECK(written);
+
+    history_view_t view;
+    task_run_entry_t old;
+    CHECK(history_open(&view, dir_fd, HISTORY_FILE_NAME) == 0);
+    size_t record_size = view.record_size;
+    size_t count = view.count;
+    if (count > 1) {
+        history_get(&view, 1, &old);
+    }
+    history_close(&view);
+    CHECK(record_size == HISTORY_RECORD_V1_SIZE && count == 2);
+    CHECK(old.epoch == 200 && old.status == 7 && old.stdout_hash == 0);
+
+    /* Premier ajout : conversion en version courante, génération et enregistrements conservés. */
+    task_run_entry_t entry = run_entry(300);
+    entry.stdout_hash = 0x1234;
+    CHECK(history_append(dir_fd, HISTORY_FILE_NAME, &entry, false) == 0);
+    fd = openat(dir_fd, HISTORY_FILE_NAME, O_RDONLY | O_CLOEXEC);
+    CHECK(fd >= 0);
+    bool read_ok = pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+    close(fd);
+    CHECK(read_ok);
+    CHECK(header.version == HISTORY_VERSION && header.record_size == sizeof(history_record_t));
+    CHECK(header.generation == 3);
+    task_run_entry_t first;
+    task_run_entry_t added;
+    CHECK(history_open(&view, dir_fd, HISTORY_FILE_NAME) == 0);
+    count = view.count;
+    if (count == 3) {
+        history_get(&view, 0, &first);
+        history_get(&view, 2, &added);
+    }
+    history_close(&view);
+    close(dir_fd);
+    CHECK(count == 3);
+    CHECK(first.epoch == 100 && first.status == 7 && added.epoch == 300 && added.stdout_hash == 0x1234);
+}
+
+static int copy_file(const char *dir, const char *from, const char *to) {
+    char from_path[PATH_MAX];
+    char to_path[PATH_MAX];
+    char buffer[8192];
+    if (utils_join_path(dir, from, from_path, sizeof(from_path)) != 0 ||
+        utils_join_path(dir, to, to_path, sizeof(to_path)) != 0) {
+        return -1;
+    }
+    int in = open(from_path, O_RDONLY | O_CLOEXEC);
+    int out = open(to_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    int rc = (in >= 0 && out >= 0) ? 0 : -1;
+    ssize_t n;
+    while (rc == 0 && (n = read(in, buffer, sizeof(buffer))) > 0) {
+        rc = utils_write_all(out, buffer, (size_t)n);
+    }
+    if (in >= 0) {
+        close(in);
+    }
+    if (out >= 0) {
+        close(out);
+    }
+    return rc;
+}
+
+static uint64_t rollup_runs(int dir_fd) {
+    history_rollup_t *rollups = NULL;
+    size_t count = 0;
+    uint64_t runs = 0;
+    if (history_load_rollups(dir_fd, HISTORY_ROLLUP_NAME, &rollups, &count) == 0) {
+        for (size_t i = 0; i < count; ++i) {
+            runs += rollups[i].runs;
+        }
+    }
+    free(rollups);
+    return runs;
+}
+
+static void test_compaction_recovery(void) {
+    char dir[PATH_MAX];
+    CHECK(case_dir("compaction", dir, sizeof(dir)) == 0);
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    CHECK(dir_fd >= 0);
+    const int64_t now = 1700000000;
+    for (int64_t i = 0; i < 10; ++i) {
+        task_run_entry_t entry = run_entry(now - 3600 + i * 60);
+        CHECK(history_append(dir_fd, HISTORY_FILE_NAME, &entry, false) == 0);
+    }
+    CHECK(copy_file(dir, HISTORY_FILE_NAME, "history.before") == 0);
+
+    size_t dropped = 0;
+    CHECK(history_compact(dir_fd, HISTORY_FILE_NAME, HISTORY_ROLLUP_NAME, 0, 4, now, &dropped) == 0);
+    CHECK(dropped == 6 && rollup_runs(dir_fd) == 6);
+
+    /* Arrêt entre les deux remplacements : rollup.bin à jour, history.bin encore complet. */
+    CHECK(renameat(dir_fd, "history.before", dir_fd, HISTORY_FILE_NAME) == 0);
+    CHECK(history_compact(dir_fd, HISTORY_FILE_NAME, HISTORY_ROLLUP_NAME, 0, 4, now, &dropped) == 0);
+    CHECK(dropped == 6);
+    CHECK(rollup_runs(dir_fd) == 6);
+    history_view_t view;
+    CHECK(history_open(&view, dir_fd, HISTORY_FILE_NAME) == 0);
+    size_t count = view.count;
+    int64_t oldest = count > 0 ? history_epoch_at(&view, 0) : 0;
+    history_close(&view);
+    CHECK(count == 4 && oldest == now - 3600 + 6 * 60);
+
+    /* Compaction terminée : rien de plus à retirer ni à agréger. */
+    CHECK(history_compact(dir_fd, HISTORY_FILE_NAME, HISTORY_ROLLUP_NAME, 0, 4, now, &dropped) == 0);
+    uint64_t runs = rollup_runs(dir_fd);
+    close(dir_fd);
+    CHECK(dropped == 0 && runs == 6);
+}
+
+static bool path_exists(const char *dir, const char *name) {
+    char path[PATH_MAX];
+    struct stat st;
+    return utils_join_path(dir, name, path, sizeof(path)) == 0 && stat(path, &st) == 0;
+}
+
+static bool task_log_present(const storage_paths_t *paths, uint64_t task_id) {
+    char dir[PATH_MAX];
+    struct stat st;
+    return storage_task_log_dir(paths, task_id, false, dir, sizeof(dir)) == 0 && stat(dir, &st) == 0 &&
+           path_exists(dir, "marker");
+}
+
+static void test_layout_resume(void) {
+    char root[PATH_MAX];
+    char logs[PATH_MAX];
+    char pending[PATH_MAX];
+    CHECK(case_dir("layout", root, sizeof(root)) == 0);
+    CHECK(utils_join_path(root, "logs", logs, sizeof(logs)) == 0 && mkdir(logs, 0700) == 0);
+    CHECK(utils_join_path(root, "logs.flat", pending, sizeof(pending)) == 0);
+    static const uint64_t ids[] = {1, 42, 300};
+    for (size_t i = 0; i < 3; ++i) {
+        char name[24];
+        char path[PATH_MAX];
+        snprintf(name, sizeof(name), "%llu", (unsigned long long)ids[i]);
+        CHECK(utils_join_path(logs, name, path, sizeof(path)) == 0 && mkdir(path, 0700) == 0);
+        int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        CHECK(fd >= 0);
+        int marker = openat(fd, "marker", O_WRONLY | O_CREAT | O_CLOEXEC, 0600);
+        close(fd);
+        CHECK(marker >= 0);
+        close(marker);
+    }
+
+    storage_paths_t paths;
+    memset(&paths, 0, sizeof(paths));
+    paths.root_dir = root;
+    paths.tasks_dir = root;
+    paths.logs_dir = logs;
+    CHECK(storage_load_layout(&paths) == 0 && paths.layout == STORAGE_LAYOUT_FLAT);
+
+    /* Migration interrompue après le premier déplacement : logs.flat/ reste, logs/ est partiel. */
+    CHECK(rename(logs, pending) == 0 && mkdir(logs, 0700) == 0);
+    paths.layout = STORAGE_LAYOUT_SHARDED;
+    char from[PATH_MAX];
+    char to[PATH_MAX];
+    CHECK(utils_join_path(pending, "1", from, sizeof(from)) == 0);
+    CHECK(storage_task_log_dir(&paths, 1, true, to, sizeof(to)) == 0 && rmdir(to) == 0 && rename(from, to) == 0);
+
+    /* Le démarrage termine la migration. */
+    paths.layout = STORAGE_LAYOUT_FLAT;
+    CHECK(storage_load_layout(&paths) == 0);
+    CHECK(paths.layout == STORAGE_LAYOUT_SHARDED);
+    CHECK(!path_exists(root, "logs.flat"));
+    CHECK(path_exists(logs, STORAGE_LAYOUT_FILE));
+    for (size_t i = 0; i < 3; ++i) {
+        CHECK(task_log_present(&paths, ids[i]));
+    }
+
+    /* Lecture suivante : le marqueur suffit. */
+    paths.layout = STORAGE_LAYOUT_FLAT;
+    CHECK(storage_load_layout(&paths) == 0 && paths.layout == STORAGE_LAYOUT_SHARDED);
+}
+
+static void test_id_lease(void) {
+    char root[PATH_MAX];
+    CHECK(case_dir("lease", root, sizeof(root)) == 0);
+    storage_paths_t paths;
+    memset(&paths, 0, sizeof(paths));
+    paths.root_dir = root;
+    paths.tasks_dir = root;
+    paths.logs_dir = root;
+    uint64_t next_id = 0;
+    CHECK(storage_load_next_task_id(&paths, &next_id) == 0 && next_id == 1);
+
+    /* Seule la fin du bail est écrite : après un arrêt brutal, l'attribution reprend au-delà. */
+    CHECK(storage_reserve_task_ids(&paths, 1 + 1024) == 0);
+    CHECK(storage_load_next_task_id(&paths, &next_id) == 0 && next_id == 1025);
+
+    /* Un bail ne recule jamais. */
+    CHECK(storage_reserve_task_ids(&paths, 512) == 0);
+    CHECK(storage_load_next_task_id(&paths, &next_id) == 0 && next_id == 1025);
+    CHECK(storage_reserve_task_ids(&paths, 1025 + 1024) == 0);
+    CHECK(storage_load_next_task_id(&paths, &next_id) == 0 && next_id == 2049);
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "d:")) != -1) {
+        switch (opt) {
+            case 'd':
+                base_dir = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage : %s [-d DIR]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    static const struct {
+        const char *name;
+        void (*run)(void);
+    } cases[] = {
+        {"catalogue : journal tronqué ou corrompu", test_catalog_wal},
+        {"historique : recherche et fin incomplète", test_history_search},
+        {"historique : conversion de la version 1", test_history_upgrade},
+        {"historique : compaction interrompue", test_compaction_recovery},
+        {"logs/ : migration reprise", test_layout_resume},
+        {"tasks/next_id : bail d'identifiants", test_id_lease},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        int before = failures;
+        cases[i].run();
+        printf("%-45s %s\n", cases[i].name, failures == before ? "ok" : "ÉCHEC");
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}